@@ -0,0 +1,710 @@
+#include"BallKernels.h"
+#include"SimdLanes.h"
+#include<algorithm>
+#include<cmath>
+#include<iostream>
+#include<limits>
+#include<vector>
+#include<glm/gtc/constants.hpp>
+
+namespace
+{
+	const float NO_CONTACT = std::numeric_limits<float>::infinity();
+	const float STATE_TOLERANCE = 1e-5f;     // meters, m/s, and rad/s times the radius
+	const float CONTACT_TOLERANCE = 1e-4f;   // meters of gap left at a contact time
+
+	// Lanes past balls.count read as stationary so they come out untouched
+	void LoadPhases(const BallSet& balls, float* phases)
+	{
+		for (int i = 0; i < MAX_BALLS; i++) {
+			phases[i] = static_cast<float>(i < balls.count ? balls.phase[i] : BallPhase::Stationary);
+		}
+	}
+
+	alignas(32) const float LANE_INDEX[MAX_BALLS] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 };
+
+	// 1 for balls still on the table, 0 for pocketed balls and padding
+	void LoadLive(const BallSet& balls, float* live)
+	{
+		for (int i = 0; i < MAX_BALLS; i++) {
+			live[i] = i < balls.count && balls.phase[i] != BallPhase::Pocketed ? 1.0f : 0.0f;
+		}
+	}
+
+	inline float HorizontalMin(Lanes lanes)
+	{
+		alignas(32) float values[LANE_WIDTH];
+		lanes.Store(values);
+		float result = values[0];
+		for (int k = 1; k < LANE_WIDTH; k++) {
+			result = std::min(result, values[k]);
+		}
+		return result;
+	}
+
+	inline Lanes PhaseLanes(BallPhase phase)
+	{
+		return Lanes::Set(static_cast<float>(phase));
+	}
+
+	// Contact time of a block of balls with one cushion segment, shared by
+	// the per-ball and the earliest-contact kernels. Lanes where the mask is
+	// clear hold garbage in t.
+	struct SegmentLanes
+	{
+		Lanes zero, one, R, segmentLength, sx, sz, nx, nz, tx, tz;
+
+		SegmentLanes(const CushionSegment& segment, float radius)
+		{
+			glm::vec2 along = segment.end - segment.start;
+			float length = glm::length(along);
+			glm::vec2 tangent = length > 0.0f ? along / length : glm::vec2(0.0f);
+			zero = Lanes::Set(0.0f);
+			one = Lanes::Set(1.0f);
+			R = Lanes::Set(radius);
+			segmentLength = Lanes::Set(length);
+			sx = Lanes::Set(segment.start.x);
+			sz = Lanes::Set(segment.start.y);
+			nx = Lanes::Set(segment.normal.x);
+			nz = Lanes::Set(segment.normal.y);
+			tx = Lanes::Set(tangent.x);
+			tz = Lanes::Set(tangent.y);
+		}
+
+		LaneMask Contact(const BallSet& balls, int base, Lanes& t) const
+		{
+			Lanes dx = Lanes::Load(balls.px + base) - sx;
+			Lanes dz = Lanes::Load(balls.pz + base) - sz;
+			Lanes vx = Lanes::Load(balls.vx + base);
+			Lanes vz = Lanes::Load(balls.vz + base);
+			Lanes side = nx * dx + nz * dz;
+			Lanes gap = Abs(side) - R;
+			Lanes rate = CopySign(one, side) * (nx * vx + nz * vz);
+
+			t = Select(gap > zero, gap / (zero - rate), zero);
+			Lanes u = tx * (dx + vx * t) + tz * (dz + vz * t);
+			return (rate < zero) & (u >= zero) & (u <= segmentLength);
+		}
+	};
+
+	// The arc's circle is met from outside at distance r + R or from inside
+	// at r - R, the inner one also by a ball that came in through the open
+	// part of the circle. Each candidate counts only on the arc itself.
+	struct ArcLanes
+	{
+		Lanes zero, never, cx, cz, radius2, outer2, inner2, fromX, fromZ, toX, toZ, sign;
+		bool wide;        // more than half a turn: on the arc is after 'from' OR before 'to'
+		bool hasInside;   // the circle is larger than a ball
+
+		ArcLanes(const CushionArc& arc, float radius)
+		{
+			zero = Lanes::Set(0.0f);
+			never = Lanes::Set(NO_CONTACT);
+			cx = Lanes::Set(arc.center.x);
+			cz = Lanes::Set(arc.center.y);
+			radius2 = Lanes::Set(arc.radius * arc.radius);
+			outer2 = Lanes::Set((arc.radius + radius) * (arc.radius + radius));
+			inner2 = Lanes::Set((arc.radius - radius) * (arc.radius - radius));
+			fromX = Lanes::Set(arc.from.x);
+			fromZ = Lanes::Set(arc.from.y);
+			toX = Lanes::Set(arc.to.x);
+			toZ = Lanes::Set(arc.to.y);
+			sign = Lanes::Set(arc.sweep >= 0.0f ? 1.0f : -1.0f);
+			wide = std::fabs(arc.sweep) > glm::pi<float>();
+			hasInside = arc.radius > radius;
+		}
+
+		LaneMask OnArc(Lanes qx, Lanes qz) const
+		{
+			LaneMask afterFrom = (fromX * qz - fromZ * qx) * sign >= zero;
+			LaneMask beforeTo = (qx * toZ - qz * toX) * sign >= zero;
+			return wide ? (afterFrom | beforeTo) : (afterFrom & beforeTo);
+		}
+
+		LaneMask Contact(const BallSet& balls, int base, Lanes& t) const
+		{
+			Lanes dx = Lanes::Load(balls.px + base) - cx;
+			Lanes dz = Lanes::Load(balls.pz + base) - cz;
+			Lanes vx = Lanes::Load(balls.vx + base);
+			Lanes vz = Lanes::Load(balls.vz + base);
+			Lanes distance2 = dx * dx + dz * dz;
+			LaneMask inside = distance2 < radius2;
+			Lanes a = vx * vx + vz * vz;
+			Lanes b = dx * vx + dz * vz;
+
+			// Outside: closing in, as for two balls
+			Lanes c = distance2 - outer2;
+			Lanes discriminant = b * b - a * c;
+			Lanes tOuter = Max(c, zero) / (Sqrt(Max(discriminant, zero)) - b);
+			LaneMask outerHit = AndNot((b < zero) & (discriminant >= zero), inside)
+				& OnArc(dx + vx * tOuter, dz + vz * tOuter);
+			t = Select(outerHit, tOuter, never);
+			if (!hasInside) {
+				return outerHit;
+			}
+
+			// Inside: pressed against the circle and heading out, or leaving
+			// the inner circle at its later root
+			c = distance2 - inner2;
+			discriminant = b * b - a * c;
+			Lanes root = Sqrt(Max(discriminant, zero));
+			LaneMask outward = b > zero;
+			LaneMask pressed = inside & (c >= zero) & outward;
+			Lanes later = Select(outward, (zero - c) / (b + root), (root - b) / a);
+			Lanes tInner = Select(pressed, zero, later);
+			LaneMask innerHit = (pressed | ((a > zero) & (discriminant >= zero) & (later >= zero)))
+				& OnArc(dx + vx * tInner, dz + vz * tInner);
+			t = Min(t, Select(innerHit, tInner, never));
+			return outerHit | innerHit;
+		}
+	};
+
+	// Deterministic generator for the verification tables
+	struct Random
+	{
+		uint32_t state;
+
+		float Next(float lo, float hi)
+		{
+			state = state * 1664525u + 1013904223u;
+			return lo + (hi - lo) * static_cast<float>(state >> 8) / 16777216.0f;
+		}
+	};
+}
+
+const char* BallKernels::GetBackendName()
+{
+	return LANE_BACKEND;
+}
+
+void BallKernels::IntegrateBalls(BallSet& balls, float dt, const PhysicsParams& params, float radius)
+{
+	alignas(32) float phases[MAX_BALLS];
+	LoadPhases(balls, phases);
+	BallArrays arrays = { phases, balls.px, balls.pz, balls.vx, balls.vz, balls.wx, balls.wy, balls.wz, balls.count };
+	IntegrateArrays(arrays, dt, params, radius);
+	for (int i = 0; i < balls.count; i++) {
+		balls.phase[i] = static_cast<BallPhase>(static_cast<int>(phases[i]));
+	}
+}
+
+// Branch-free EvolveBall: each lane runs the sliding piece, the rolling piece
+// and the spin decay, and Select keeps what applies to its phase
+void BallKernels::IntegrateArrays(const BallArrays& arrays, float dt, const PhysicsParams& params, float radius)
+{
+	if (dt <= 0.0f) {
+		return;
+	}
+
+	const float g = params.gravity;
+	const Lanes zero = Lanes::Set(0.0f);
+	const Lanes one = Lanes::Set(1.0f);
+	const Lanes half = Lanes::Set(0.5f);
+	const Lanes two = Lanes::Set(2.0f);
+	const Lanes R = Lanes::Set(radius);
+	const Lanes step = Lanes::Set(dt);
+	const Lanes slideDecel = Lanes::Set(params.slidingFriction * g);
+	const Lanes slideAngular = Lanes::Set(5.0f * params.slidingFriction * g / (2.0f * radius));
+	const Lanes slideDenominator = Lanes::Set(7.0f * params.slidingFriction * g);
+	const Lanes rollDecel = Lanes::Set(params.rollingFriction * g);
+	const Lanes spinDecay = Lanes::Set(5.0f * params.spinningFriction * g / (2.0f * radius) * dt);
+	const Lanes velocityEpsilon = Lanes::Set(BilliardPhysics::VELOCITY_EPSILON);
+	const Lanes spinEpsilon = Lanes::Set(BilliardPhysics::SPIN_EPSILON);
+
+	for (int base = 0; base < arrays.count; base += LANE_WIDTH) {
+		Lanes phase = Lanes::Load(arrays.phase + base);
+		Lanes px = Lanes::Load(arrays.px + base);
+		Lanes pz = Lanes::Load(arrays.pz + base);
+		Lanes vx = Lanes::Load(arrays.vx + base);
+		Lanes vz = Lanes::Load(arrays.vz + base);
+		Lanes wx = Lanes::Load(arrays.wx + base);
+		Lanes wy = Lanes::Load(arrays.wy + base);
+		Lanes wz = Lanes::Load(arrays.wz + base);
+
+		LaneMask sliding = phase == PhaseLanes(BallPhase::Sliding);
+		LaneMask active = sliding | (phase == PhaseLanes(BallPhase::Rolling)) | (phase == PhaseLanes(BallPhase::Spinning));
+
+		// Sliding until the slip is gone or the step ends
+		Lanes ux = vx + R * wz;
+		Lanes uz = vz - R * wx;
+		Lanes slip = Sqrt(ux * ux + uz * uz);
+		Lanes slideTime = two * slip / slideDenominator;
+		Lanes h = Select(sliding, Min(step, slideTime), zero);
+		LaneMask slipping = sliding & (slip > zero);
+		Lanes safeSlip = Select(slipping, slip, one);
+		Lanes dirX = ux / safeSlip;
+		Lanes dirZ = uz / safeSlip;
+		Lanes linear = slideDecel * h;
+		Lanes angular = slideAngular * h;
+		Lanes vx1 = Select(slipping, vx - linear * dirX, vx);
+		Lanes vz1 = Select(slipping, vz - linear * dirZ, vz);
+		wx = Select(slipping, wx + angular * dirZ, wx);
+		wz = Select(slipping, wz - angular * dirX, wz);
+		px = Select(slipping, px + half * (vx + vx1) * h, px);
+		pz = Select(slipping, pz + half * (vz + vz1) * h, pz);
+		Lanes remaining = step - h;
+		LaneMask reachedRoll = sliding & (slideTime <= step);
+		wx = Select(reachedRoll, vz1 / R, wx);
+		wz = Select(reachedRoll, zero - vx1 / R, wz);
+
+		// Rolling for whatever is left of the step
+		LaneMask rolling = ((phase == PhaseLanes(BallPhase::Rolling)) | reachedRoll) & (remaining > zero);
+		Lanes speed = Sqrt(vx1 * vx1 + vz1 * vz1);
+		Lanes stopTime = speed / rollDecel;
+		Lanes hr = Min(remaining, stopTime);
+		Lanes scale = Select(stopTime > remaining, (speed - rollDecel * hr) / speed, zero);
+		Lanes vx2 = Select(rolling, vx1 * scale, vx1);
+		Lanes vz2 = Select(rolling, vz1 * scale, vz1);
+		wx = Select(rolling, vz2 / R, wx);
+		wz = Select(rolling, zero - vx2 / R, wz);
+		px = Select(rolling, px + half * (vx1 + vx2) * hr, px);
+		pz = Select(rolling, pz + half * (vz1 + vz2) * hr, pz);
+
+		Lanes decayed = Select(Abs(wy) > spinDecay, wy - CopySign(spinDecay, wy), zero);
+		wy = Select(active, decayed, wy);
+
+		// ClassifyPhase
+		Lanes slipX = vx2 + R * wz;
+		Lanes slipZ = vz2 - R * wx;
+		LaneMask stillSliding = Sqrt(slipX * slipX + slipZ * slipZ) > velocityEpsilon;
+		LaneMask moving = Sqrt(vx2 * vx2 + vz2 * vz2) > velocityEpsilon;
+		LaneMask spinning = Abs(wy) > spinEpsilon;
+		Lanes classified = Select(stillSliding, PhaseLanes(BallPhase::Sliding),
+			Select(moving, PhaseLanes(BallPhase::Rolling),
+			Select(spinning, PhaseLanes(BallPhase::Spinning), PhaseLanes(BallPhase::Stationary))));
+		phase = Select(active, classified, phase);
+
+		phase.Store(arrays.phase + base);
+		px.Store(arrays.px + base);
+		pz.Store(arrays.pz + base);
+		vx2.Store(arrays.vx + base);
+		vz2.Store(arrays.vz + base);
+		wx.Store(arrays.wx + base);
+		wy.Store(arrays.wy + base);
+		wz.Store(arrays.wz + base);
+	}
+}
+
+
+void BallKernels::IntegrateBallsScalar(BallSet& balls, float dt, const PhysicsParams& params, float radius)
+{
+	for (int i = 0; i < balls.count; i++) {
+		BilliardPhysics::EvolveBall(balls, i, dt, params, radius);
+	}
+}
+
+// |C + B t| = 2R with C, B the offset and velocity of each ball relative to
+// ball i; the earlier root of a t^2 + 2 b t + c is c / (-b + sqrt(b^2 - a c)),
+// which stays accurate when the balls barely move relative to each other
+void BallKernels::BallContactTimes(const BallSet& balls, int i, float radius, float maxTime, float* times)
+{
+	const Lanes zero = Lanes::Set(0.0f);
+	const Lanes never = Lanes::Set(NO_CONTACT);
+	const Lanes limit = Lanes::Set(maxTime);
+	const Lanes diameter2 = Lanes::Set(4.0f * radius * radius);
+	const Lanes pxi = Lanes::Set(balls.px[i]);
+	const Lanes pzi = Lanes::Set(balls.pz[i]);
+	const Lanes vxi = Lanes::Set(balls.vx[i]);
+	const Lanes vzi = Lanes::Set(balls.vz[i]);
+
+	for (int base = 0; base < balls.count; base += LANE_WIDTH) {
+		Lanes cx = Lanes::Load(balls.px + base) - pxi;
+		Lanes cz = Lanes::Load(balls.pz + base) - pzi;
+		Lanes bx = Lanes::Load(balls.vx + base) - vxi;
+		Lanes bz = Lanes::Load(balls.vz + base) - vzi;
+		Lanes a = bx * bx + bz * bz;
+		Lanes b = cx * bx + cz * bz;
+		Lanes c = cx * cx + cz * cz - diameter2;
+		Lanes discriminant = b * b - a * c;
+
+		LaneMask closing = b < zero;
+		Lanes t = c / (zero - b + Sqrt(Max(discriminant, zero)));
+		LaneMask hit = closing & (discriminant >= zero) & (t <= limit);
+		Select(closing & (c <= zero), zero, Select(hit, t, never)).Store(times + base);
+	}
+
+	// Ball i itself, pocketed balls and padding lanes never touch
+	bool ballPocketed = balls.phase[i] == BallPhase::Pocketed;
+	for (int k = 0; k < MAX_BALLS; k++) {
+		if (ballPocketed || k >= balls.count || k == i || balls.phase[k] == BallPhase::Pocketed) {
+			times[k] = NO_CONTACT;
+		}
+	}
+}
+
+void BallKernels::BallContactTimesScalar(const BallSet& balls, int i, float radius, float maxTime, float* times)
+{
+	const float diameter2 = 4.0f * radius * radius;
+	for (int k = 0; k < MAX_BALLS; k++) {
+		times[k] = NO_CONTACT;
+		if (k >= balls.count || k == i || balls.phase[k] == BallPhase::Pocketed || balls.phase[i] == BallPhase::Pocketed) {
+			continue;
+		}
+		float cx = balls.px[k] - balls.px[i];
+		float cz = balls.pz[k] - balls.pz[i];
+		float bx = balls.vx[k] - balls.vx[i];
+		float bz = balls.vz[k] - balls.vz[i];
+		float a = bx * bx + bz * bz;
+		float b = cx * bx + cz * bz;
+		float c = cx * cx + cz * cz - diameter2;
+		if (b >= 0.0f) {
+			continue;
+		}
+		if (c <= 0.0f) {
+			times[k] = 0.0f;
+			continue;
+		}
+		float discriminant = b * b - a * c;
+		if (discriminant < 0.0f) {
+			continue;
+		}
+		float t = c / (-b + std::sqrt(discriminant));
+		if (t <= maxTime) {
+			times[k] = t;
+		}
+	}
+}
+
+// The ball is on the side s = n.(p - start) points to; the gap |s| - R
+// closes at sign(s) n.v, and the contact counts when the touching point lies
+// along the segment
+void BallKernels::SegmentContactTimes(const BallSet& balls, const CushionSegment& segment, float radius, float maxTime, float* times)
+{
+	SegmentLanes kernel(segment, radius);
+	const Lanes never = Lanes::Set(NO_CONTACT);
+	const Lanes limit = Lanes::Set(maxTime);
+	for (int base = 0; base < balls.count; base += LANE_WIDTH) {
+		Lanes t;
+		LaneMask hit = kernel.Contact(balls, base, t);
+		hit = hit & (t <= limit);
+		Select(hit, t, never).Store(times + base);
+	}
+	for (int k = 0; k < MAX_BALLS; k++) {
+		if (k >= balls.count || balls.phase[k] == BallPhase::Pocketed) {
+			times[k] = NO_CONTACT;
+		}
+	}
+}
+
+void BallKernels::SegmentContactTimesScalar(const BallSet& balls, const CushionSegment& segment, float radius, float maxTime, float* times)
+{
+	glm::vec2 along = segment.end - segment.start;
+	float length = glm::length(along);
+	glm::vec2 tangent = length > 0.0f ? along / length : glm::vec2(0.0f);
+	for (int k = 0; k < MAX_BALLS; k++) {
+		times[k] = NO_CONTACT;
+		if (k >= balls.count || balls.phase[k] == BallPhase::Pocketed) {
+			continue;
+		}
+		float dx = balls.px[k] - segment.start.x;
+		float dz = balls.pz[k] - segment.start.y;
+		float side = segment.normal.x * dx + segment.normal.y * dz;
+		float gap = std::fabs(side) - radius;
+		float rate = std::copysign(1.0f, side) * (segment.normal.x * balls.vx[k] + segment.normal.y * balls.vz[k]);
+		if (rate >= 0.0f) {
+			continue;
+		}
+		float t = gap > 0.0f ? gap / -rate : 0.0f;
+		float u = tangent.x * (dx + balls.vx[k] * t) + tangent.y * (dz + balls.vz[k] * t);
+		if (t <= maxTime && u >= 0.0f && u <= length) {
+			times[k] = t;
+		}
+	}
+}
+
+// |d + v t| reaches r + R from outside the circle or r - R from inside, see
+// ArcLanes
+void BallKernels::ArcContactTimes(const BallSet& balls, const CushionArc& arc, float radius, float maxTime, float* times)
+{
+	ArcLanes kernel(arc, radius);
+	const Lanes never = Lanes::Set(NO_CONTACT);
+	const Lanes limit = Lanes::Set(maxTime);
+	for (int base = 0; base < balls.count; base += LANE_WIDTH) {
+		Lanes t;
+		LaneMask hit = kernel.Contact(balls, base, t);
+		hit = hit & (t <= limit);
+		Select(hit, t, never).Store(times + base);
+	}
+	for (int k = 0; k < MAX_BALLS; k++) {
+		if (k >= balls.count || balls.phase[k] == BallPhase::Pocketed) {
+			times[k] = NO_CONTACT;
+		}
+	}
+}
+
+void BallKernels::ArcContactTimesScalar(const BallSet& balls, const CushionArc& arc, float radius, float maxTime, float* times)
+{
+	for (int k = 0; k < MAX_BALLS; k++) {
+		times[k] = NO_CONTACT;
+		if (k >= balls.count || balls.phase[k] == BallPhase::Pocketed) {
+			continue;
+		}
+		glm::vec2 d(balls.px[k] - arc.center.x, balls.pz[k] - arc.center.y);
+		glm::vec2 v(balls.vx[k], balls.vz[k]);
+		float distance2 = d.x * d.x + d.y * d.y;
+		bool inside = distance2 < arc.radius * arc.radius;
+		float a = v.x * v.x + v.y * v.y;
+		float b = d.x * v.x + d.y * v.y;
+		float t = NO_CONTACT;
+
+		float outer = arc.radius + radius;
+		float c = distance2 - outer * outer;
+		float discriminant = b * b - a * c;
+		if (!inside && b < 0.0f && discriminant >= 0.0f) {
+			float candidate = std::max(c, 0.0f) / (std::sqrt(discriminant) - b);
+			if (arc.Contains(d + v * candidate)) {
+				t = candidate;
+			}
+		}
+
+		if (arc.radius > radius) {
+			float inner = arc.radius - radius;
+			c = distance2 - inner * inner;
+			discriminant = b * b - a * c;
+			float candidate = -1.0f;
+			if (inside && c >= 0.0f && b > 0.0f) {
+				candidate = 0.0f;
+			}
+			else if (a > 0.0f && discriminant >= 0.0f) {
+				// The later root, in whichever form avoids cancellation
+				float root = std::sqrt(discriminant);
+				candidate = b > 0.0f ? -c / (b + root) : (root - b) / a;
+			}
+			if (candidate >= 0.0f && arc.Contains(d + v * candidate)) {
+				t = std::min(t, candidate);
+			}
+		}
+		if (t <= maxTime) {
+			times[k] = t;
+		}
+	}
+}
+
+// The upper triangle of the pair matrix, a row per ball, starting at the
+// block that holds the first ball after it
+float BallKernels::EarliestBallContact(const BallSet& balls, float radius, float maxTime)
+{
+	alignas(32) float live[MAX_BALLS];
+	LoadLive(balls, live);
+
+	const Lanes zero = Lanes::Set(0.0f);
+	const Lanes never = Lanes::Set(NO_CONTACT);
+	const Lanes diameter2 = Lanes::Set(4.0f * radius * radius);
+	Lanes earliest = Lanes::Set(maxTime);
+
+	for (int i = 0; i + 1 < balls.count; i++) {
+		if (live[i] == 0.0f) {
+			continue;
+		}
+		const Lanes self = Lanes::Set(static_cast<float>(i));
+		const Lanes pxi = Lanes::Set(balls.px[i]);
+		const Lanes pzi = Lanes::Set(balls.pz[i]);
+		const Lanes vxi = Lanes::Set(balls.vx[i]);
+		const Lanes vzi = Lanes::Set(balls.vz[i]);
+		for (int base = (i + 1) / LANE_WIDTH * LANE_WIDTH; base < balls.count; base += LANE_WIDTH) {
+			Lanes cx = Lanes::Load(balls.px + base) - pxi;
+			Lanes cz = Lanes::Load(balls.pz + base) - pzi;
+			Lanes bx = Lanes::Load(balls.vx + base) - vxi;
+			Lanes bz = Lanes::Load(balls.vz + base) - vzi;
+			Lanes a = bx * bx + bz * bz;
+			Lanes b = cx * bx + cz * bz;
+			Lanes c = cx * cx + cz * cz - diameter2;
+			Lanes discriminant = b * b - a * c;
+
+			LaneMask closing = (b < zero) & (discriminant >= zero)
+				& (Lanes::Load(live + base) > zero) & (Lanes::Load(LANE_INDEX + base) > self);
+			Lanes t = Max(c, zero) / (zero - b + Sqrt(Max(discriminant, zero)));
+			earliest = Min(earliest, Select(closing, t, never));
+		}
+	}
+	return HorizontalMin(earliest);
+}
+
+float BallKernels::EarliestSegmentContact(const BallSet& balls, const CushionSegment& segment, float radius, float maxTime)
+{
+	alignas(32) float live[MAX_BALLS];
+	LoadLive(balls, live);
+
+	SegmentLanes kernel(segment, radius);
+	const Lanes zero = Lanes::Set(0.0f);
+	const Lanes never = Lanes::Set(NO_CONTACT);
+	Lanes earliest = Lanes::Set(maxTime);
+	for (int base = 0; base < balls.count; base += LANE_WIDTH) {
+		Lanes t;
+		LaneMask hit = kernel.Contact(balls, base, t) & (Lanes::Load(live + base) > zero);
+		earliest = Min(earliest, Select(hit, t, never));
+	}
+	return HorizontalMin(earliest);
+}
+
+float BallKernels::EarliestArcContact(const BallSet& balls, const CushionArc& arc, float radius, float maxTime)
+{
+	alignas(32) float live[MAX_BALLS];
+	LoadLive(balls, live);
+
+	ArcLanes kernel(arc, radius);
+	const Lanes zero = Lanes::Set(0.0f);
+	const Lanes never = Lanes::Set(NO_CONTACT);
+	Lanes earliest = Lanes::Set(maxTime);
+	for (int base = 0; base < balls.count; base += LANE_WIDTH) {
+		Lanes t;
+		LaneMask hit = kernel.Contact(balls, base, t) & (Lanes::Load(live + base) > zero);
+		earliest = Min(earliest, Select(hit, t, never));
+	}
+	return HorizontalMin(earliest);
+}
+
+bool BallKernels::VerifyAgainstScalar(int trials, uint32_t seed)
+{
+	Random random = { seed };
+	PhysicsParams params;
+	TableSpec table;
+	table.PlacePockets();
+	const float R = table.ballRadius;
+	std::array<CushionSegment, 4> rails = table.GetRails();
+	std::vector<CushionSegment> segments(rails.begin(), rails.end());
+	std::vector<CushionArc> arcs;
+
+	float worstState = 0.0f;
+	float worstContact = 0.0f;
+	int phaseMismatches = 0;
+	int earliestMismatches = 0;
+	// Near a grazing contact the time itself is ill-conditioned, so where the
+	// paths disagree the vector time is checked to really be a contact: the
+	// gap left at that time, evaluated in double precision
+	auto compareTimes = [&worstContact](int count, const float* a, const float* b, auto gapAt) {
+		for (int k = 0; k < count; k++) {
+			if (a[k] == b[k]) {
+				continue;
+			}
+			if (std::isinf(a[k]) || std::isinf(b[k])) {
+				worstContact = NO_CONTACT;
+				continue;
+			}
+			worstContact = std::max(worstContact, static_cast<float>(std::fabs(gapAt(k, a[k]))));
+		}
+	};
+
+	for (int trial = 0; trial < trials; trial++) {
+		BallSet balls;
+		balls.count = 1 + trial % MAX_BALLS;
+		for (int i = 0; i < balls.count; i++) {
+			balls.px[i] = random.Next(-table.halfSizeX, table.halfSizeX);
+			balls.pz[i] = random.Next(-table.halfSizeZ, table.halfSizeZ);
+			// A mix of sliding, rolling, spinning and resting balls
+			int kind = static_cast<int>(random.Next(0.0f, 4.0f));
+			if (kind <= 1) {
+				balls.vx[i] = random.Next(-4.0f, 4.0f);
+				balls.vz[i] = random.Next(-4.0f, 4.0f);
+				balls.wx[i] = kind == 0 ? random.Next(-200.0f, 200.0f) : balls.vz[i] / R;
+				balls.wz[i] = kind == 0 ? random.Next(-200.0f, 200.0f) : -balls.vx[i] / R;
+			}
+			balls.wy[i] = kind == 3 ? 0.0f : random.Next(-100.0f, 100.0f);
+			balls.phase[i] = BilliardPhysics::ClassifyPhase(balls, i, R);
+		}
+		if (balls.count > 2) {
+			balls.phase[balls.count - 1] = BallPhase::Pocketed;
+		}
+		float dt = trial % 3 == 0 ? random.Next(0.0f, 2.0f) : BilliardPhysics::FIXED_TIMESTEP;
+
+		BallSet vector = balls;
+		BallSet scalar = balls;
+		IntegrateBalls(vector, dt, params, R);
+		IntegrateBallsScalar(scalar, dt, params, R);
+		for (int i = 0; i < balls.count; i++) {
+			const float* a[] = { vector.px, vector.pz, vector.vx, vector.vz, vector.wx, vector.wy, vector.wz };
+			const float* b[] = { scalar.px, scalar.pz, scalar.vx, scalar.vz, scalar.wx, scalar.wy, scalar.wz };
+			for (int k = 0; k < 7; k++) {
+				// Spin components scale with 1/R, compare them in surface speed
+				float scale = k >= 4 ? R : 1.0f;
+				worstState = std::max(worstState, std::fabs(a[k][i] - b[k][i]) * scale);
+			}
+			phaseMismatches += vector.phase[i] != scalar.phase[i];
+		}
+
+		// A diagonal line across the table and a few jaws, from corner points
+		// to whole turns, so balls meet them from both sides
+		segments.resize(rails.size());
+		CushionSegment diagonal;
+		diagonal.start = glm::vec2(random.Next(-table.halfSizeX, 0.0f), random.Next(-table.halfSizeZ, table.halfSizeZ));
+		diagonal.end = glm::vec2(random.Next(0.0f, table.halfSizeX), random.Next(-table.halfSizeZ, table.halfSizeZ));
+		glm::vec2 along = glm::normalize(diagonal.end - diagonal.start);
+		diagonal.normal = glm::vec2(-along.y, along.x);
+		segments.push_back(diagonal);
+		arcs.clear();
+		for (int k = 0; k < 3; k++) {
+			CushionArc arc;
+			arc.center = glm::vec2(random.Next(-table.halfSizeX, table.halfSizeX), random.Next(-table.halfSizeZ, table.halfSizeZ));
+			arc.radius = k == 0 ? 0.0f : random.Next(0.0f, 0.3f);
+			float start = random.Next(0.0f, glm::two_pi<float>());
+			arc.sweep = k == 0 ? glm::two_pi<float>() : random.Next(-glm::two_pi<float>(), glm::two_pi<float>());
+			arc.from = glm::vec2(std::cos(start), std::sin(start));
+			arc.to = glm::vec2(std::cos(start + arc.sweep), std::sin(start + arc.sweep));
+			arcs.push_back(arc);
+		}
+
+		alignas(32) float vectorTimes[MAX_BALLS];
+		alignas(32) float scalarTimes[MAX_BALLS];
+		const float maxTime = 1.0f;
+		float scalarEarliest = maxTime;
+		for (int i = 0; i < balls.count; i++) {
+			BallContactTimesScalar(balls, i, R, maxTime, scalarTimes);
+			for (int k = 0; k < balls.count; k++) {
+				scalarEarliest = std::min(scalarEarliest, scalarTimes[k]);
+			}
+		}
+		earliestMismatches += EarliestBallContact(balls, R, maxTime) != scalarEarliest
+			&& std::fabs(EarliestBallContact(balls, R, maxTime) - scalarEarliest) > CONTACT_TOLERANCE;
+		auto scalarMin = [&]() {
+			float result = maxTime;
+			for (int k = 0; k < balls.count; k++) {
+				result = std::min(result, scalarTimes[k]);
+			}
+			return result;
+		};
+		for (const CushionSegment& segment : segments) {
+			SegmentContactTimesScalar(balls, segment, R, maxTime, scalarTimes);
+			earliestMismatches += std::fabs(EarliestSegmentContact(balls, segment, R, maxTime) - scalarMin()) > CONTACT_TOLERANCE;
+		}
+		for (const CushionArc& arc : arcs) {
+			ArcContactTimesScalar(balls, arc, R, maxTime, scalarTimes);
+			earliestMismatches += std::fabs(EarliestArcContact(balls, arc, R, maxTime) - scalarMin()) > CONTACT_TOLERANCE;
+		}
+
+		for (int i = 0; i < balls.count; i++) {
+			BallContactTimes(balls, i, R, 1.0f, vectorTimes);
+			BallContactTimesScalar(balls, i, R, 1.0f, scalarTimes);
+			compareTimes(balls.count, vectorTimes, scalarTimes, [&](int k, double t) {
+				double x = (balls.px[k] - balls.px[i]) + (static_cast<double>(balls.vx[k]) - balls.vx[i]) * t;
+				double z = (balls.pz[k] - balls.pz[i]) + (static_cast<double>(balls.vz[k]) - balls.vz[i]) * t;
+				return std::sqrt(x * x + z * z) - 2.0 * R;
+			});
+		}
+		for (const CushionSegment& segment : segments) {
+			SegmentContactTimes(balls, segment, R, 1.0f, vectorTimes);
+			SegmentContactTimesScalar(balls, segment, R, 1.0f, scalarTimes);
+			compareTimes(balls.count, vectorTimes, scalarTimes, [&](int k, double t) {
+				double x = balls.px[k] + static_cast<double>(balls.vx[k]) * t - segment.start.x;
+				double z = balls.pz[k] + static_cast<double>(balls.vz[k]) * t - segment.start.y;
+				return std::fabs(segment.normal.x * x + segment.normal.y * z) - R;
+			});
+		}
+		for (const CushionArc& arc : arcs) {
+			ArcContactTimes(balls, arc, R, 1.0f, vectorTimes);
+			ArcContactTimesScalar(balls, arc, R, 1.0f, scalarTimes);
+			compareTimes(balls.count, vectorTimes, scalarTimes, [&](int k, double t) {
+				double x = balls.px[k] - arc.center.x + balls.vx[k] * t;
+				double z = balls.pz[k] - arc.center.y + balls.vz[k] * t;
+				double distance = std::sqrt(x * x + z * z);
+				return std::min(std::fabs(distance - (arc.radius + R)), std::fabs(distance - (arc.radius - R)));
+			});
+		}
+	}
+
+	bool passed = worstState <= STATE_TOLERANCE && worstContact <= CONTACT_TOLERANCE
+		&& phaseMismatches == 0 && earliestMismatches == 0;
+	std::cout << "[KERNELS] " << LANE_BACKEND << " vs scalar over " << trials << " tables: state diff "
+			  << worstState << ", contact gap " << worstContact << ", phase mismatches "
+			  << phaseMismatches << ", earliest contact mismatches " << earliestMismatches << (passed ? " - OK" : " - MISMATCH") << std::endl;
+	return passed;
+}
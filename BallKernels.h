@@ -0,0 +1,69 @@
+#ifndef BALL_KERNELS_CLASS_H
+#define BALL_KERNELS_CLASS_H
+
+#include<cstdint>
+
+#include"BilliardPhysics.h"
+#include"TableGeometry.h"
+
+// Ball state as separate float arrays, e.g. one ball across many tables.
+// Phases are BallPhase values stored as floats. Every array is alignas(32)
+// and count a multiple of the lane width, or MAX_BALLS-sized.
+struct BallArrays
+{
+	float* phase;
+	float* px;
+	float* pz;
+	float* vx;
+	float* vz;
+	float* wx;
+	float* wy;
+	float* wz;
+	int count;
+};
+
+// Vectorized versions of the per-ball work of a fixed step, one ball per
+// SIMD lane (see SimdLanes.h for the backends). Every kernel has a scalar
+// reference with identical results up to float rounding; VerifyAgainstScalar
+// runs both on random tables and compares them.
+//
+// Time-of-impact kernels assume straight-line motion at the current
+// velocities, which over one fixed step is off by at most a*dt^2/2. Output
+// arrays hold MAX_BALLS floats, alignas(32); a lane without contact in
+// [0, maxTime] is +infinity.
+class BallKernels
+{
+public:
+	static const char* GetBackendName();
+
+	// BilliardPhysics::EvolveBall for every ball, phases reclassified
+	static void IntegrateBalls(BallSet& balls, float dt, const PhysicsParams& params, float radius);
+	// The same on bare arrays, the lanes being whatever the arrays hold
+	static void IntegrateArrays(const BallArrays& arrays, float dt, const PhysicsParams& params, float radius);
+	static void IntegrateBallsScalar(BallSet& balls, float dt, const PhysicsParams& params, float radius);
+
+	// When ball i first touches each other ball; ball i itself and pocketed
+	// balls never do. Balls already touching and closing in report 0.
+	static void BallContactTimes(const BallSet& balls, int i, float radius, float maxTime, float* times);
+	static void BallContactTimesScalar(const BallSet& balls, int i, float radius, float maxTime, float* times);
+
+	// When each ball first touches the segment, from whichever side it is on
+	static void SegmentContactTimes(const BallSet& balls, const CushionSegment& segment, float radius, float maxTime, float* times);
+	static void SegmentContactTimesScalar(const BallSet& balls, const CushionSegment& segment, float radius, float maxTime, float* times);
+	// And the arc, from inside or outside its circle
+	static void ArcContactTimes(const BallSet& balls, const CushionArc& arc, float radius, float maxTime, float* times);
+	static void ArcContactTimesScalar(const BallSet& balls, const CushionArc& arc, float radius, float maxTime, float* times);
+
+	// Earliest of all the contact times above: every live pair, or every
+	// live ball against one segment or arc; maxTime when nothing touches
+	// before it
+	static float EarliestBallContact(const BallSet& balls, float radius, float maxTime);
+	static float EarliestSegmentContact(const BallSet& balls, const CushionSegment& segment, float radius, float maxTime);
+	static float EarliestArcContact(const BallSet& balls, const CushionArc& arc, float radius, float maxTime);
+
+	// Runs the vector and scalar paths on random ball sets and prints the
+	// largest differences; false when one is beyond rounding error
+	static bool VerifyAgainstScalar(int trials, uint32_t seed);
+};
+
+#endif
@@ -0,0 +1,566 @@
+#include"BilliardPhysics.h"
+#include"BallKernels.h"
+#include"TableGeometry.h"
+#include<algorithm>
+#include<cmath>
+#include<limits>
+#include<glm/gtc/quaternion.hpp>
+
+namespace
+{
+	const float MAX_TIP_OFFSET = 0.5f;      // further out the cue would miscue
+	const int MAX_CONTACT_PASSES = 16;      // swept contacts handled per step, the rest fall back to overlap tests
+	const float CONTACT_SLOP = 0.01f;       // in ball radii, covers the straight-line sweep ignoring friction
+	const int MAX_NEARBY_CUSHIONS = 256;    // cushion pieces gathered per query before falling back to all of them
+
+	inline float Length2(float x, float z)
+	{
+		return std::sqrt(x * x + z * z);
+	}
+
+	// Calls visit once for every cushion piece whose box overlaps one of the
+	// boxes, or for all of them when too many do
+	template<typename Visit>
+	void ForEachCushion(const TableGeometry& geometry, const glm::vec2* boxMin, const glm::vec2* boxMax, int boxCount, Visit visit)
+	{
+		int refs[MAX_NEARBY_CUSHIONS];
+		int count = 0;
+		for (int k = 0; k < boxCount && count <= MAX_NEARBY_CUSHIONS; k++) {
+			count += geometry.Query(boxMin[k], boxMax[k], refs + count, MAX_NEARBY_CUSHIONS - count);
+		}
+		if (count > MAX_NEARBY_CUSHIONS) {
+			for (int r = 0; r < static_cast<int>(geometry.segments.size()); r++) {
+				visit(r);
+			}
+			for (int r = 0; r < static_cast<int>(geometry.arcs.size()); r++) {
+				visit(~r);
+			}
+			return;
+		}
+		std::sort(refs, refs + count);
+		count = static_cast<int>(std::unique(refs, refs + count) - refs);
+		for (int k = 0; k < count; k++) {
+			visit(refs[k]);
+		}
+	}
+}
+
+void TableSpec::PlacePockets()
+{
+	pocketCount = 6;
+	bool longX = halfSizeX >= halfSizeZ;
+	int index = 0;
+	for (int side = -1; side <= 1; side += 2) {
+		for (int along = -1; along <= 1; along++) {
+			pockets[index++] = center + (longX
+				? glm::vec2(along * halfSizeX, side * halfSizeZ)
+				: glm::vec2(side * halfSizeX, along * halfSizeZ));
+		}
+	}
+}
+
+std::array<CushionSegment, 4> TableSpec::GetRails() const
+{
+	glm::vec2 low = center - glm::vec2(halfSizeX, halfSizeZ);
+	glm::vec2 high = center + glm::vec2(halfSizeX, halfSizeZ);
+	return { {
+		{ low, glm::vec2(low.x, high.y), glm::vec2(1.0f, 0.0f) },
+		{ glm::vec2(high.x, low.y), high, glm::vec2(-1.0f, 0.0f) },
+		{ low, glm::vec2(high.x, low.y), glm::vec2(0.0f, 1.0f) },
+		{ glm::vec2(low.x, high.y), high, glm::vec2(0.0f, -1.0f) },
+	} };
+}
+
+int BilliardPhysics::AddBall(glm::vec2 position)
+{
+	if (balls.count >= MAX_BALLS) {
+		return -1;
+	}
+	int i = balls.count++;
+	balls.px[i] = position.x;
+	balls.pz[i] = position.y;
+	balls.vx[i] = balls.vz[i] = 0.0f;
+	balls.wx[i] = balls.wy[i] = balls.wz[i] = 0.0f;
+	balls.qw[i] = 1.0f;
+	balls.qx[i] = balls.qy[i] = balls.qz[i] = 0.0f;
+	balls.phase[i] = BallPhase::Stationary;
+	return i;
+}
+
+void BilliardPhysics::RemoveAllBalls()
+{
+	balls = BallSet();
+	accumulator = 0.0f;
+}
+
+void BilliardPhysics::Strike(int ball, glm::vec2 direction, float speed, float follow, float english)
+{
+	if (ball < 0 || ball >= balls.count) {
+		return;
+	}
+	ApplyStrike(balls, ball, direction, speed, follow, english, table.ballRadius);
+}
+
+void BilliardPhysics::ApplyStrike(BallSet& balls, int i, glm::vec2 direction, float speed, float follow, float english, float radius)
+{
+	if (balls.phase[i] == BallPhase::Pocketed) {
+		return;
+	}
+	float length = glm::length(direction);
+	if (length <= 0.0f) {
+		return;
+	}
+	float dx = direction.x / length;
+	float dz = direction.y / length;
+	follow = std::clamp(follow, -MAX_TIP_OFFSET, MAX_TIP_OFFSET);
+	english = std::clamp(english, -MAX_TIP_OFFSET, MAX_TIP_OFFSET);
+
+	// Impulse through the tip contact r = R * (english * side + follow * up):
+	// w = 5 v / (2 R) * (english * up + follow * (up x d))
+	float k = 5.0f * speed / (2.0f * radius);
+	balls.vx[i] = dx * speed;
+	balls.vz[i] = dz * speed;
+	balls.wx[i] = k * follow * dz;
+	balls.wy[i] = k * english;
+	balls.wz[i] = -k * follow * dx;
+	balls.phase[i] = ClassifyPhase(balls, i, radius);
+}
+
+int BilliardPhysics::Advance(float deltaTime)
+{
+	accumulator += deltaTime;
+	int steps = 0;
+	while (accumulator >= FIXED_TIMESTEP) {
+		Step();
+		accumulator -= FIXED_TIMESTEP;
+		steps++;
+	}
+	return steps;
+}
+
+// The step is swept rather than sampled: it advances to the earliest
+// ball-ball or ball-cushion contact within the step, resolves it and goes on
+// with the rest, so fast balls cannot pass through each other
+void BilliardPhysics::Step()
+{
+	const float R = table.ballRadius;
+	std::array<CushionSegment, 4> rails = table.GetRails();
+	float remaining = FIXED_TIMESTEP;
+	for (int pass = 0; remaining > 0.0f; pass++) {
+		float h = pass < MAX_CONTACT_PASSES ? EarliestContact(rails, remaining) : remaining;
+		BallKernels::IntegrateBalls(balls, h, params, R);
+		remaining -= h;
+		if (remaining > 0.0f) {
+			ResolveContacts(rails);
+		}
+	}
+
+	ResolveBallCollisions();
+	for (int i = 0; i < balls.count; i++) {
+		IntegrateOrientation(balls, i, FIXED_TIMESTEP);
+		ResolvePockets(i);
+		ResolveCushions(i);
+	}
+}
+
+bool BilliardPhysics::IsAtRest() const
+{
+	for (int i = 0; i < balls.count; i++) {
+		if (balls.phase[i] != BallPhase::Stationary && balls.phase[i] != BallPhase::Pocketed) {
+			return false;
+		}
+	}
+	return true;
+}
+
+uint64_t BilliardPhysics::StateHash() const
+{
+	uint64_t hash = 1469598103934665603ull;
+	auto mix = [&hash](const void* data, size_t size) {
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+		for (size_t i = 0; i < size; i++) {
+			hash = (hash ^ bytes[i]) * 1099511628211ull;
+		}
+	};
+	size_t bytes = sizeof(float) * balls.count;
+	mix(balls.px, bytes);
+	mix(balls.pz, bytes);
+	mix(balls.vx, bytes);
+	mix(balls.vz, bytes);
+	mix(balls.wx, bytes);
+	mix(balls.wy, bytes);
+	mix(balls.wz, bytes);
+	mix(balls.phase, sizeof(BallPhase) * balls.count);
+	return hash;
+}
+
+BallPhase BilliardPhysics::ClassifyPhase(const BallSet& balls, int i, float radius)
+{
+	if (balls.phase[i] == BallPhase::Pocketed) {
+		return BallPhase::Pocketed;
+	}
+	float ux = balls.vx[i] + radius * balls.wz[i];
+	float uz = balls.vz[i] - radius * balls.wx[i];
+	if (Length2(ux, uz) > VELOCITY_EPSILON) {
+		return BallPhase::Sliding;
+	}
+	if (Length2(balls.vx[i], balls.vz[i]) > VELOCITY_EPSILON) {
+		return BallPhase::Rolling;
+	}
+	if (std::fabs(balls.wy[i]) > SPIN_EPSILON) {
+		return BallPhase::Spinning;
+	}
+	return BallPhase::Stationary;
+}
+
+glm::vec2 BilliardPhysics::PhaseAcceleration(const BallSet& balls, int i, const PhysicsParams& params, float radius)
+{
+	const float g = params.gravity;
+	if (balls.phase[i] == BallPhase::Sliding) {
+		float ux = balls.vx[i] + radius * balls.wz[i];
+		float uz = balls.vz[i] - radius * balls.wx[i];
+		float slip = Length2(ux, uz);
+		if (slip > 0.0f) {
+			return -params.slidingFriction * g / slip * glm::vec2(ux, uz);
+		}
+	}
+	else if (balls.phase[i] == BallPhase::Rolling) {
+		float speed = Length2(balls.vx[i], balls.vz[i]);
+		if (speed > 0.0f) {
+			return -params.rollingFriction * g / speed * glm::vec2(balls.vx[i], balls.vz[i]);
+		}
+	}
+	return glm::vec2(0.0f);
+}
+
+float BilliardPhysics::PhaseDuration(const BallSet& balls, int i, const PhysicsParams& params, float radius)
+{
+	const float g = params.gravity;
+	switch (balls.phase[i]) {
+	case BallPhase::Sliding:
+		return 2.0f * Length2(balls.vx[i] + radius * balls.wz[i], balls.vz[i] - radius * balls.wx[i])
+			/ (7.0f * params.slidingFriction * g);
+	case BallPhase::Rolling:
+		return Length2(balls.vx[i], balls.vz[i]) / (params.rollingFriction * g);
+	case BallPhase::Spinning:
+		return std::fabs(balls.wy[i]) * 2.0f * radius / (5.0f * params.spinningFriction * g);
+	default:
+		return std::numeric_limits<float>::infinity();
+	}
+}
+
+// Applies cloth friction for dt and moves the ball. Each phase has constant
+// acceleration, so every piece of the step moves with its exact average
+// velocity; reaching the end of a phase snaps the state onto the next one so
+// the phase boundary is hit exactly rather than approached.
+void BilliardPhysics::EvolveBall(BallSet& balls, int i, float dt, const PhysicsParams& params, float radius)
+{
+	BallPhase phase = balls.phase[i];
+	if (phase == BallPhase::Pocketed || phase == BallPhase::Stationary || dt <= 0.0f) {
+		return;
+	}
+
+	const float R = radius;
+	const float g = params.gravity;
+	float remaining = dt;
+
+	if (phase == BallPhase::Sliding) {
+		float ux = balls.vx[i] + R * balls.wz[i];
+		float uz = balls.vz[i] - R * balls.wx[i];
+		float slip = Length2(ux, uz);
+		float slideTime = PhaseDuration(balls, i, params, R);
+		float h = std::min(remaining, slideTime);
+		if (slip > 0.0f) {
+			float dirX = ux / slip;
+			float dirZ = uz / slip;
+			float linear = params.slidingFriction * g * h;
+			float angular = 5.0f * params.slidingFriction * g / (2.0f * R) * h;
+			float vx0 = balls.vx[i];
+			float vz0 = balls.vz[i];
+			balls.vx[i] -= linear * dirX;
+			balls.vz[i] -= linear * dirZ;
+			balls.wx[i] += angular * dirZ;
+			balls.wz[i] -= angular * dirX;
+			balls.px[i] += 0.5f * (vx0 + balls.vx[i]) * h;
+			balls.pz[i] += 0.5f * (vz0 + balls.vz[i]) * h;
+		}
+		remaining -= h;
+		if (slideTime <= dt) {
+			// Slip reached zero: lock the spin to the motion
+			balls.wx[i] = balls.vz[i] / R;
+			balls.wz[i] = -balls.vx[i] / R;
+			phase = BallPhase::Rolling;
+		}
+	}
+
+	if (phase == BallPhase::Rolling && remaining > 0.0f) {
+		float speed = Length2(balls.vx[i], balls.vz[i]);
+		float stopTime = speed / (params.rollingFriction * g);
+		float h = std::min(remaining, stopTime);
+		float scale = stopTime > remaining ? (speed - params.rollingFriction * g * h) / speed : 0.0f;
+		float vx0 = balls.vx[i];
+		float vz0 = balls.vz[i];
+		balls.vx[i] *= scale;
+		balls.vz[i] *= scale;
+		balls.wx[i] = balls.vz[i] / R;
+		balls.wz[i] = -balls.vx[i] / R;
+		balls.px[i] += 0.5f * (vx0 + balls.vx[i]) * h;
+		balls.pz[i] += 0.5f * (vz0 + balls.vz[i]) * h;
+	}
+
+	// Spin about the vertical axis decays in every phase
+	float spinDecay = 5.0f * params.spinningFriction * g / (2.0f * R) * dt;
+	float spin = balls.wy[i];
+	balls.wy[i] = std::fabs(spin) > spinDecay ? spin - std::copysign(spinDecay, spin) : 0.0f;
+
+	balls.phase[i] = ClassifyPhase(balls, i, R);
+}
+
+float BilliardPhysics::ApproachSpeed(const BallSet& balls, int i, int j, glm::vec2* normal)
+{
+	float dx = balls.px[j] - balls.px[i];
+	float dz = balls.pz[j] - balls.pz[i];
+	float distance = Length2(dx, dz);
+	float nx = distance > 0.0f ? dx / distance : 1.0f;
+	float nz = distance > 0.0f ? dz / distance : 0.0f;
+	if (normal != nullptr) {
+		*normal = glm::vec2(nx, nz);
+	}
+	return (balls.vx[i] - balls.vx[j]) * nx + (balls.vz[i] - balls.vz[j]) * nz;
+}
+
+bool BilliardPhysics::CollideBalls(BallSet& balls, int i, int j, float restitution, float radius)
+{
+	glm::vec2 normal;
+	float approach = ApproachSpeed(balls, i, j, &normal);
+	float nx = normal.x;
+	float nz = normal.y;
+	if (approach <= 0.0f) {
+		return false;
+	}
+	float impulse = 0.5f * (1.0f + restitution) * approach;
+	balls.vx[i] -= impulse * nx;
+	balls.vz[i] -= impulse * nz;
+	balls.vx[j] += impulse * nx;
+	balls.vz[j] += impulse * nz;
+	balls.phase[i] = ClassifyPhase(balls, i, radius);
+	balls.phase[j] = ClassifyPhase(balls, j, radius);
+	return true;
+}
+
+bool BilliardPhysics::BounceOffCushion(BallSet& balls, int i, glm::vec2 normal, float restitution, float radius)
+{
+	float approach = balls.vx[i] * normal.x + balls.vz[i] * normal.y;
+	if (approach >= 0.0f) {
+		return false;
+	}
+	float impulse = (1.0f + restitution) * approach;
+	balls.vx[i] -= impulse * normal.x;
+	balls.vz[i] -= impulse * normal.y;
+	balls.phase[i] = ClassifyPhase(balls, i, radius);
+	return true;
+}
+
+void BilliardPhysics::IntegrateOrientation(BallSet& balls, int i, float dt)
+{
+	// Orientation for drawing: rotate by |w| * dt about w
+	float wx = balls.wx[i], wy = balls.wy[i], wz = balls.wz[i];
+	float omega = std::sqrt(wx * wx + wy * wy + wz * wz);
+	if (omega > SPIN_EPSILON) {
+		glm::quat delta = glm::angleAxis(omega * dt, glm::vec3(wx, wy, wz) / omega);
+		glm::quat q = glm::normalize(delta * glm::quat(balls.qw[i], balls.qx[i], balls.qy[i], balls.qz[i]));
+		balls.qw[i] = q.w;
+		balls.qx[i] = q.x;
+		balls.qy[i] = q.y;
+		balls.qz[i] = q.z;
+	}
+}
+
+float BilliardPhysics::EarliestContact(const std::array<CushionSegment, 4>& rails, float maxTime) const
+{
+	const float R = table.ballRadius;
+	float earliest = BallKernels::EarliestBallContact(balls, R, maxTime);
+	if (table.geometry == nullptr) {
+		for (const CushionSegment& rail : rails) {
+			earliest = BallKernels::EarliestSegmentContact(balls, rail, R, earliest);
+		}
+		return earliest;
+	}
+
+	// Only the pieces near where a moving ball can get to within maxTime
+	glm::vec2 boxMin[MAX_BALLS], boxMax[MAX_BALLS];
+	int boxCount = 0;
+	for (int i = 0; i < balls.count; i++) {
+		if (balls.phase[i] != BallPhase::Sliding && balls.phase[i] != BallPhase::Rolling) {
+			continue;
+		}
+		glm::vec2 position(balls.px[i], balls.pz[i]);
+		float reach = R * (1.0f + CONTACT_SLOP) + Length2(balls.vx[i], balls.vz[i]) * maxTime;
+		boxMin[boxCount] = position - glm::vec2(reach);
+		boxMax[boxCount] = position + glm::vec2(reach);
+		boxCount++;
+	}
+	const TableGeometry& geometry = *table.geometry;
+	ForEachCushion(geometry, boxMin, boxMax, boxCount, [&](int ref) {
+		earliest = ref >= 0
+			? BallKernels::EarliestSegmentContact(balls, geometry.segments[ref], R, earliest)
+			: BallKernels::EarliestArcContact(balls, geometry.arcs[~ref], R, earliest);
+	});
+	return earliest;
+}
+
+// Applies the impacts of everything touching at the current instant
+void BilliardPhysics::ResolveContacts(const std::array<CushionSegment, 4>& rails)
+{
+	const float R = table.ballRadius;
+	const float reach = 2.0f * R + CONTACT_SLOP * R;
+	for (int i = 0; i < balls.count; i++) {
+		if (balls.phase[i] == BallPhase::Pocketed) {
+			continue;
+		}
+		for (int j = i + 1; j < balls.count; j++) {
+			if (balls.phase[j] == BallPhase::Pocketed) {
+				continue;
+			}
+			float dx = balls.px[j] - balls.px[i];
+			float dz = balls.pz[j] - balls.pz[i];
+			if (dx * dx + dz * dz <= reach * reach) {
+				CollideBalls(balls, i, j, params.ballRestitution, R);
+			}
+		}
+
+		glm::vec2 position(balls.px[i], balls.pz[i]);
+		if (table.geometry == nullptr) {
+			for (const CushionSegment& rail : rails) {
+				float gap = glm::dot(rail.normal, position - rail.start) - R;
+				if (gap <= CONTACT_SLOP * R && gap >= -R) {
+					BounceOffCushion(balls, i, rail.normal, params.cushionRestitution, R);
+				}
+			}
+			continue;
+		}
+		glm::vec2 boxMin = position - glm::vec2(R + CONTACT_SLOP * R);
+		glm::vec2 boxMax = position + glm::vec2(R + CONTACT_SLOP * R);
+		ForEachCushion(*table.geometry, &boxMin, &boxMax, 1, [&](int ref) {
+			float distance;
+			glm::vec2 normal;
+			if (table.geometry->Separation(ref, position, distance, normal) && distance - R <= CONTACT_SLOP * R) {
+				BounceOffCushion(balls, i, normal, params.cushionRestitution, R);
+			}
+		});
+	}
+}
+
+// Overlaps the swept step missed: equal-mass, frictionless impacts; pairs in
+// index order so runs repeat exactly
+void BilliardPhysics::ResolveBallCollisions()
+{
+	const float diameter = 2.0f * table.ballRadius;
+	const float restitution = params.ballRestitution;
+	for (int i = 0; i < balls.count; i++) {
+		if (balls.phase[i] == BallPhase::Pocketed) {
+			continue;
+		}
+		for (int j = i + 1; j < balls.count; j++) {
+			if (balls.phase[j] == BallPhase::Pocketed) {
+				continue;
+			}
+			float dx = balls.px[j] - balls.px[i];
+			float dz = balls.pz[j] - balls.pz[i];
+			float distance2 = dx * dx + dz * dz;
+			if (distance2 >= diameter * diameter) {
+				continue;
+			}
+
+			float distance = std::sqrt(distance2);
+			float nx = distance > 0.0f ? dx / distance : 1.0f;
+			float nz = distance > 0.0f ? dz / distance : 0.0f;
+
+			// Separate the overlap symmetrically
+			float push = 0.5f * (diameter - distance);
+			balls.px[i] -= nx * push;
+			balls.pz[i] -= nz * push;
+			balls.px[j] += nx * push;
+			balls.pz[j] += nz * push;
+
+			CollideBalls(balls, i, j, restitution, table.ballRadius);
+		}
+	}
+}
+
+void BilliardPhysics::ResolvePockets(int i)
+{
+	if (balls.phase[i] == BallPhase::Pocketed) {
+		return;
+	}
+	float radius2 = table.pocketRadius * table.pocketRadius;
+	for (int p = 0; p < table.pocketCount; p++) {
+		float dx = balls.px[i] - table.pockets[p].x;
+		float dz = balls.pz[i] - table.pockets[p].y;
+		if (dx * dx + dz * dz < radius2) {
+			balls.px[i] = table.pockets[p].x;
+			balls.pz[i] = table.pockets[p].y;
+			balls.vx[i] = balls.vz[i] = 0.0f;
+			balls.wx[i] = balls.wy[i] = balls.wz[i] = 0.0f;
+			balls.phase[i] = BallPhase::Pocketed;
+			return;
+		}
+	}
+}
+
+// Axis aligned cushions at the table extents, reflected with restitution.
+// With table geometry the ball is pushed back out of any piece it overlaps.
+void BilliardPhysics::ResolveCushions(int i)
+{
+	if (balls.phase[i] == BallPhase::Pocketed) {
+		return;
+	}
+	const float R = table.ballRadius;
+	if (table.geometry != nullptr) {
+		glm::vec2 position(balls.px[i], balls.pz[i]);
+		glm::vec2 boxMin = position - glm::vec2(R);
+		glm::vec2 boxMax = position + glm::vec2(R);
+		ForEachCushion(*table.geometry, &boxMin, &boxMax, 1, [&](int ref) {
+			float distance;
+			glm::vec2 normal;
+			glm::vec2 current(balls.px[i], balls.pz[i]);
+			if (table.geometry->Separation(ref, current, distance, normal) && distance < R) {
+				balls.px[i] += normal.x * (R - distance);
+				balls.pz[i] += normal.y * (R - distance);
+				BounceOffCushion(balls, i, normal, params.cushionRestitution, R);
+			}
+		});
+		return;
+	}
+	const float e = params.cushionRestitution;
+	const float minX = table.center.x - table.halfSizeX + R;
+	const float maxX = table.center.x + table.halfSizeX - R;
+	const float minZ = table.center.y - table.halfSizeZ + R;
+	const float maxZ = table.center.y + table.halfSizeZ - R;
+	bool hit = false;
+
+	if (balls.px[i] < minX) {
+		balls.px[i] = minX + (minX - balls.px[i]) * e;
+		balls.vx[i] = std::fabs(balls.vx[i]) * e;
+		hit = true;
+	}
+	else if (balls.px[i] > maxX) {
+		balls.px[i] = maxX - (balls.px[i] - maxX) * e;
+		balls.vx[i] = -std::fabs(balls.vx[i]) * e;
+		hit = true;
+	}
+	if (balls.pz[i] < minZ) {
+		balls.pz[i] = minZ + (minZ - balls.pz[i]) * e;
+		balls.vz[i] = std::fabs(balls.vz[i]) * e;
+		hit = true;
+	}
+	else if (balls.pz[i] > maxZ) {
+		balls.pz[i] = maxZ - (balls.pz[i] - maxZ) * e;
+		balls.vz[i] = -std::fabs(balls.vz[i]) * e;
+		hit = true;
+	}
+
+	if (hit) {
+		balls.phase[i] = ClassifyPhase(balls, i, R);
+	}
+}
@@ -0,0 +1,157 @@
+#ifndef BILLIARD_PHYSICS_CLASS_H
+#define BILLIARD_PHYSICS_CLASS_H
+
+#include<array>
+#include<cstdint>
+#include<glm/glm.hpp>
+
+// Billiards physics in world units. Balls move in the world X/Z plane on a
+// cloth at constant Y; angular velocity is a full 3D vector so sliding,
+// rolling and spin about the vertical axis (english) are handled separately.
+//
+// Contact point velocity with up = +Y: u = (vx + R*wz, vz - R*wx).
+// Sliding: u shrinks along a fixed direction at 7/2 * muS * g.
+// Rolling: u = 0, speed drops at muR * g.
+// Spin:    wy decays at 5/2 * muSp * g / R.
+
+class TableGeometry;
+
+const int MAX_BALLS = 16;
+const int MAX_POCKETS = 6;
+
+enum class BallPhase : uint8_t
+{
+	Stationary,
+	Spinning,    // not translating, still turning about the vertical axis
+	Rolling,     // contact point at rest, rolling resistance only
+	Sliding,     // contact point slipping over the cloth
+	Pocketed
+};
+
+struct PhysicsParams
+{
+	float gravity = 9.81f;
+	float slidingFriction = 0.2f;
+	float rollingFriction = 0.01f;
+	float spinningFriction = 0.044f;
+	float ballRestitution = 0.95f;
+	float cushionRestitution = 0.75f;
+};
+
+// A straight cushion nose. For the rails the normal points from the cushion
+// into the table; TableGeometry segments are hit from either side.
+struct CushionSegment
+{
+	glm::vec2 start = glm::vec2(0.0f);
+	glm::vec2 end = glm::vec2(0.0f);
+	glm::vec2 normal = glm::vec2(0.0f);
+};
+
+struct TableSpec
+{
+	glm::vec2 center = glm::vec2(0.0f);  // world X/Z of the cloth center
+	float halfSizeX = 1.27f;             // center to cushion nose along world X
+	float halfSizeZ = 0.635f;            // and along world Z
+	float surfaceHeight = 0.0f;          // world Y of the cloth
+	float ballRadius = 0.028575f;
+	float pocketRadius = 0.06f;          // capture radius around a pocket center
+	int pocketCount = 0;
+	std::array<glm::vec2, MAX_POCKETS> pockets = {};
+	// Cushion noses and pocket jaws taken from the table mesh, not owned.
+	// Without it the cushions are the four rails.
+	const TableGeometry* geometry = nullptr;
+
+	// Six pockets: the four corners and the middle of both long cushions,
+	// whichever axis is the long one
+	void PlacePockets();
+	// The four cushion noses at the table extents, corner to corner
+	std::array<CushionSegment, 4> GetRails() const;
+};
+
+// Structure-of-arrays ball state with a fixed capacity, so a table copies
+// with a memcpy and stepping never allocates
+struct BallSet
+{
+	int count = 0;
+	alignas(32) float px[MAX_BALLS] = {};
+	alignas(32) float pz[MAX_BALLS] = {};
+	alignas(32) float vx[MAX_BALLS] = {};
+	alignas(32) float vz[MAX_BALLS] = {};
+	alignas(32) float wx[MAX_BALLS] = {};
+	alignas(32) float wy[MAX_BALLS] = {};
+	alignas(32) float wz[MAX_BALLS] = {};
+	// Orientation quaternion, only used for drawing
+	alignas(32) float qw[MAX_BALLS] = {};
+	alignas(32) float qx[MAX_BALLS] = {};
+	alignas(32) float qy[MAX_BALLS] = {};
+	alignas(32) float qz[MAX_BALLS] = {};
+	BallPhase phase[MAX_BALLS] = {};
+};
+
+class BilliardPhysics
+{
+public:
+	static constexpr float FIXED_TIMESTEP = 1.0f / 240.0f;
+	static constexpr float VELOCITY_EPSILON = 1e-4f;   // m/s, below this a ball counts as not moving
+	static constexpr float SPIN_EPSILON = 1e-3f;       // rad/s
+
+	TableSpec table;
+	PhysicsParams params;
+	BallSet balls;
+
+	// Returns the new ball's index, -1 when the set is full
+	int AddBall(glm::vec2 position);
+	void RemoveAllBalls();
+
+	// Cue strike along direction (X/Z) at speed m/s. follow and english are
+	// the tip offsets from the ball center in ball radii: follow > 0 is top
+	// spin, english > 0 is right side spin. Offsets beyond 0.5 are clamped.
+	void Strike(int ball, glm::vec2 direction, float speed, float follow, float english);
+
+	// Runs as many fixed steps as fit into deltaTime, carrying the rest over
+	int Advance(float deltaTime);
+	// One fixed step, split at every contact inside it
+	void Step();
+
+	bool IsAtRest() const;
+	// FNV-1a over the simulated state, used to check runs are bit identical
+	uint64_t StateHash() const;
+
+	// Phase implied by the current velocities
+	static BallPhase ClassifyPhase(const BallSet& balls, int i, float radius);
+
+	// Closed-form motion shared with EventSimulator. Within one phase a ball
+	// has constant acceleration, PhaseDuration is the time until the phase
+	// ends (infinite at rest) and EvolveBall moves a ball exactly by dt,
+	// crossing phase boundaries as needed. Orientation is left alone.
+	static glm::vec2 PhaseAcceleration(const BallSet& balls, int i, const PhysicsParams& params, float radius);
+	static float PhaseDuration(const BallSet& balls, int i, const PhysicsParams& params, float radius);
+	static void EvolveBall(BallSet& balls, int i, float dt, const PhysicsParams& params, float radius);
+
+	// Speed at which i closes on j along the line between their centres,
+	// negative while they separate; the unit vector from i to j goes to normal
+	static float ApproachSpeed(const BallSet& balls, int i, int j, glm::vec2* normal = nullptr);
+	// Velocity responses at the moment of contact. Both return false, and
+	// change nothing, when the balls are already separating.
+	static bool CollideBalls(BallSet& balls, int i, int j, float restitution, float radius);
+	// normal points from the cushion toward the ball
+	static bool BounceOffCushion(BallSet& balls, int i, glm::vec2 normal, float restitution, float radius);
+
+	// Sets the ball's velocities for a cue strike, see Strike()
+	static void ApplyStrike(BallSet& balls, int i, glm::vec2 direction, float speed, float follow, float english, float radius);
+	// Turns the drawing orientation by the current angular velocity over dt
+	static void IntegrateOrientation(BallSet& balls, int i, float dt);
+
+private:
+	float accumulator = 0.0f;
+
+	// Time to the first contact within maxTime, maxTime when there is none.
+	// Cushions are table.geometry when set, else the rails.
+	float EarliestContact(const std::array<CushionSegment, 4>& rails, float maxTime) const;
+	void ResolveContacts(const std::array<CushionSegment, 4>& rails);
+	void ResolveBallCollisions();
+	void ResolvePockets(int i);
+	void ResolveCushions(int i);
+};
+
+#endif
@@ -0,0 +1,337 @@
+#include"BilliardTable.h"
+#include<algorithm>
+#include<cctype>
+#include<iostream>
+#include<vector>
+#include<glm/gtc/quaternion.hpp>
+
+namespace
+{
+	const float BALL_SHAPE_TOLERANCE = 1.2f;      // largest / smallest extent of a ball's box
+	const float BALL_SIZE_FRACTION = 0.08f;       // a ball is smaller than this share of the table
+	const float BALL_MATCH_TOLERANCE = 0.1f;      // radius spread allowed around the median ball
+	const float CUSHION_INSET_FRACTION = 0.06f;   // frame trimmed per side when there is no cloth node
+	const float POCKET_RADIUS_IN_BALLS = 2.0f;
+	const float STANDARD_CLOTH_LENGTH = 2.54f;    // 9 ft table, meters
+	const float STANDARD_GRAVITY = 9.81f;
+	const float CUSHION_SEARCH_FRACTION = 0.08f;  // cloth half size searched beyond the cloth for cushions and jaws
+	const float CUSHION_FIT_TOLERANCE = 0.05f;    // in ball radii, how far lines and arcs may stray from the mesh
+
+	bool NameContains(const std::string& name, std::initializer_list<const char*> words)
+	{
+		std::string lower = name;
+		std::transform(lower.begin(), lower.end(), lower.begin(),
+			[](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+		for (const char* word : words) {
+			if (lower.find(word) != std::string::npos) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	struct BallCandidate
+	{
+		int node;
+		glm::vec3 center;
+		float radius;
+	};
+}
+
+bool BilliardTable::Bind(Model& model)
+{
+	model.UpdateTransforms();
+	ballCount = 0;
+
+	// The table frame is the mesh with the largest footprint
+	int tableNode = -1;
+	float tableSize = 0.0f;
+	glm::vec3 tableMin(0.0f), tableMax(0.0f);
+	for (int i = 0; i < model.GetNodeCount(); i++) {
+		glm::vec3 boundsMin, boundsMax;
+		if (!model.GetNodeWorldBounds(i, boundsMin, boundsMax)) {
+			continue;
+		}
+		float size = std::max(boundsMax.x - boundsMin.x, boundsMax.z - boundsMin.z);
+		if (size > tableSize) {
+			tableSize = size;
+			tableNode = i;
+			tableMin = boundsMin;
+			tableMax = boundsMax;
+		}
+	}
+	if (tableNode < 0) {
+		std::cout << "[PHYSICS] No meshes in the table model" << std::endl;
+		return false;
+	}
+
+	std::vector<BallCandidate> candidates;
+	int clothNode = -1;
+	for (int i = 0; i < model.GetNodeCount(); i++) {
+		glm::vec3 boundsMin, boundsMax;
+		if (i == tableNode || !model.GetNodeWorldBounds(i, boundsMin, boundsMax)) {
+			continue;
+		}
+		const std::string& name = model.GetNode(i).name;
+		if (clothNode < 0 && NameContains(name, { "cloth", "felt", "sukno", "playfield" })) {
+			clothNode = i;
+			continue;
+		}
+
+		glm::vec3 extent = boundsMax - boundsMin;
+		float largest = std::max(extent.x, std::max(extent.y, extent.z));
+		float smallest = std::min(extent.x, std::min(extent.y, extent.z));
+		bool named = NameContains(name, { "ball", "kula", "bila", "bile" });
+		bool shaped = smallest > 0.0f && largest / smallest < BALL_SHAPE_TOLERANCE
+			&& largest < tableSize * BALL_SIZE_FRACTION;
+		if (named || shaped) {
+			candidates.push_back({ i, 0.5f * (boundsMin + boundsMax), 0.25f * (extent.x + extent.z) });
+		}
+	}
+	if (candidates.empty()) {
+		std::cout << "[PHYSICS] No balls found in the table model" << std::endl;
+		return false;
+	}
+
+	// Keep the candidates that agree with the median ball in size and height
+	std::vector<float> radii, heights;
+	for (const BallCandidate& candidate : candidates) {
+		radii.push_back(candidate.radius);
+		heights.push_back(candidate.center.y);
+	}
+	std::nth_element(radii.begin(), radii.begin() + radii.size() / 2, radii.end());
+	std::nth_element(heights.begin(), heights.begin() + heights.size() / 2, heights.end());
+	float medianRadius = radii[radii.size() / 2];
+	float medianHeight = heights[heights.size() / 2];
+
+	TableSpec& table = physics.table;
+	table.ballRadius = medianRadius;
+	ballCenterHeight = medianHeight;
+	table.surfaceHeight = medianHeight - medianRadius;
+
+	glm::vec3 clothMin, clothMax;
+	if (clothNode >= 0 && model.GetNodeWorldBounds(clothNode, clothMin, clothMax)) {
+		table.center = glm::vec2(0.5f * (clothMin.x + clothMax.x), 0.5f * (clothMin.z + clothMax.z));
+		table.halfSizeX = 0.5f * (clothMax.x - clothMin.x);
+		table.halfSizeZ = 0.5f * (clothMax.z - clothMin.z);
+	}
+	else {
+		float inset = tableSize * CUSHION_INSET_FRACTION;
+		table.center = glm::vec2(0.5f * (tableMin.x + tableMax.x), 0.5f * (tableMin.z + tableMax.z));
+		table.halfSizeX = 0.5f * (tableMax.x - tableMin.x) - inset;
+		table.halfSizeZ = 0.5f * (tableMax.z - tableMin.z) - inset;
+	}
+	table.pocketRadius = POCKET_RADIUS_IN_BALLS * table.ballRadius;
+	// The model need not be in meters; scale gravity so a shot plays out like
+	// on a real table of the same proportions
+	worldScale = 2.0f * std::max(table.halfSizeX, table.halfSizeZ) / STANDARD_CLOTH_LENGTH;
+	physics.params.gravity = STANDARD_GRAVITY * worldScale;
+	table.PlacePockets();
+
+	physics.RemoveAllBalls();
+	int namedCue = -1;
+	for (const BallCandidate& candidate : candidates) {
+		if (std::fabs(candidate.radius - medianRadius) > BALL_MATCH_TOLERANCE * medianRadius
+			|| std::fabs(candidate.center.y - medianHeight) > medianRadius) {
+			continue;
+		}
+		if (ballCount == MAX_BALLS) {
+			std::cout << "[PHYSICS] More than " << MAX_BALLS << " balls, ignoring the rest" << std::endl;
+			break;
+		}
+
+		const Node& node = model.GetNode(candidate.node);
+		BallBinding& binding = bindings[ballCount];
+		binding.node = candidate.node;
+		binding.parentInverse = glm::inverse(node.globalTransform * glm::inverse(node.localTransform));
+		binding.baseRotationScale = node.globalTransform;
+		binding.baseRotationScale[3] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+		// Mesh center relative to the node origin, so balls turn about their middle
+		binding.meshOffset = candidate.center - glm::vec3(node.globalTransform[3]);
+		binding.restPosition = glm::vec2(candidate.center.x, candidate.center.z);
+		physics.AddBall(binding.restPosition);
+
+		if (namedCue < 0 && NameContains(node.name, { "cue", "white", "biala" })) {
+			namedCue = ballCount;
+		}
+		ballCount++;
+	}
+
+	// Without a name, the cue ball is the one furthest from the rack
+	cueBall = namedCue;
+	if (cueBall < 0) {
+		glm::vec2 centroid(0.0f);
+		for (int i = 0; i < ballCount; i++) {
+			centroid += bindings[i].restPosition;
+		}
+		centroid /= static_cast<float>(ballCount);
+		float furthest = -1.0f;
+		for (int i = 0; i < ballCount; i++) {
+			float distance = glm::length(bindings[i].restPosition - centroid);
+			if (distance > furthest) {
+				furthest = distance;
+				cueBall = i;
+			}
+		}
+	}
+
+	ExtractCushions(model);
+	replay.Begin(table, physics.params, physics.balls);
+
+	std::cout << "[PHYSICS] " << ballCount << " balls, radius " << table.ballRadius
+			  << ", cloth " << 2.0f * table.halfSizeX << " x " << 2.0f * table.halfSizeZ
+			  << " at height " << table.surfaceHeight << ", cue ball node '"
+			  << model.GetNode(bindings[cueBall].node).name << "'" << std::endl;
+	return true;
+}
+
+// Slices every mesh except the balls at ball-center height, around the cloth
+void BilliardTable::ExtractCushions(const Model& model)
+{
+	TableSpec& table = physics.table;
+	table.geometry = nullptr;
+	std::vector<glm::vec3> triangles;
+	for (int i = 0; i < model.GetNodeCount(); i++) {
+		bool ball = std::any_of(bindings.begin(), bindings.begin() + ballCount,
+			[i](const BallBinding& binding) { return binding.node == i; });
+		if (!ball) {
+			model.GetNodeWorldTriangles(i, triangles);
+		}
+	}
+
+	glm::vec2 margin(CUSHION_SEARCH_FRACTION * std::max(table.halfSizeX, table.halfSizeZ));
+	glm::vec2 halfSize(table.halfSizeX, table.halfSizeZ);
+	if (!cushions.BuildFromTriangles(triangles, ballCenterHeight, table.center - halfSize - margin,
+		table.center + halfSize + margin, CUSHION_FIT_TOLERANCE * table.ballRadius)) {
+		std::cout << "[PHYSICS] No cushions at ball height in the table model, using the cloth edges" << std::endl;
+		return;
+	}
+	table.geometry = &cushions;
+
+	int corners = static_cast<int>(std::count_if(cushions.arcs.begin(), cushions.arcs.end(),
+		[](const CushionArc& arc) { return arc.radius == 0.0f; }));
+	std::cout << "[PHYSICS] Cushion geometry from " << triangles.size() / 3 << " triangles: "
+			  << cushions.segments.size() << " lines, " << cushions.arcs.size() - corners << " arcs, "
+			  << corners << " corners" << std::endl;
+}
+
+void BilliardTable::ResetRack()
+{
+	physics.RemoveAllBalls();
+	for (int i = 0; i < ballCount; i++) {
+		physics.AddBall(bindings[i].restPosition);
+	}
+}
+
+bool BilliardTable::TraceAim(glm::vec2 direction, float& distance, glm::vec2& normal) const
+{
+	const TableSpec& table = physics.table;
+	if (table.geometry == nullptr || glm::dot(direction, direction) <= 0.0f) {
+		return false;
+	}
+	const BallSet& balls = physics.balls;
+	glm::vec2 origin(balls.px[cueBall], balls.pz[cueBall]);
+	float reach = 4.0f * std::max(table.halfSizeX, table.halfSizeZ);
+	return table.geometry->CastCircle(origin, glm::normalize(direction), table.ballRadius, reach, distance, normal);
+}
+
+void BilliardTable::PlayShot(glm::vec2 direction, float speed, float follow, float english)
+{
+	float aimDistance;
+	glm::vec2 aimNormal;
+	if (TraceAim(direction, aimDistance, aimNormal)) {
+		std::cout << "[PHYSICS] Aim line meets a cushion after " << aimDistance << std::endl;
+	}
+	ReplayLog::SettleBalls(physics.balls);
+	shot.table = physics.table;
+	shot.params = physics.params;
+	shot.Reset(physics.balls);
+	shot.Strike(cueBall, direction, speed, follow, english);
+	int events = shot.SimulateToRest();
+	shotTime = 0.0;
+	replay.RecordShot(physics.balls, cueBall, direction, speed, follow, english, shot.GetBalls());
+	std::cout << "[PHYSICS] Shot solved in " << events << " events, "
+			  << shot.GetTime() << " s until the balls rest" << std::endl;
+}
+
+bool BilliardTable::AdvanceShot(float deltaTime)
+{
+	shotTime += deltaTime;
+	BallSet sample;
+	shot.StateAt(shotTime, sample);
+	BallSet& balls = physics.balls;
+	for (int i = 0; i < balls.count; i++) {
+		balls.px[i] = sample.px[i];
+		balls.pz[i] = sample.pz[i];
+		balls.vx[i] = sample.vx[i];
+		balls.vz[i] = sample.vz[i];
+		balls.wx[i] = sample.wx[i];
+		balls.wy[i] = sample.wy[i];
+		balls.wz[i] = sample.wz[i];
+		balls.phase[i] = sample.phase[i];
+		BilliardPhysics::IntegrateOrientation(balls, i, deltaTime);
+	}
+	return shotTime < shot.GetTime();
+}
+
+bool BilliardTable::LoadReplay(const std::string& path)
+{
+	ReplayLog loaded;
+	if (!loaded.Load(path)) {
+		return false;
+	}
+	if (loaded.GetBallCount() != ballCount || !loaded.AttachGeometry(physics.table.geometry)) {
+		std::cout << "[REPLAY] " << path << " was recorded on a different table" << std::endl;
+		return false;
+	}
+	int diverged = loaded.Verify(shot);
+	if (diverged >= 0) {
+		std::cout << "[REPLAY] Shot " << diverged << " no longer plays out as recorded" << std::endl;
+	}
+	replay = loaded;
+	return true;
+}
+
+bool BilliardTable::SeekReplay(int shotIndex, double time)
+{
+	BallSet sample;
+	if (!replay.Seek(shotIndex, time, shot, sample)) {
+		return false;
+	}
+	physics.balls = sample;
+	shotTime = time;
+	return true;
+}
+
+void BilliardTable::ApplyToModel(Model& model) const
+{
+	for (int i = 0; i < ballCount; i++) {
+		model.SetNodeLocalTransform(bindings[i].node, BallLocalTransform(physics.balls, i));
+	}
+}
+
+void BilliardTable::ApplyToTransforms(const BallSet& balls, std::vector<glm::mat4>& localTransforms) const
+{
+	for (int i = 0; i < ballCount; i++) {
+		localTransforms[bindings[i].node] = BallLocalTransform(balls, i);
+	}
+}
+
+glm::mat4 BilliardTable::BallLocalTransform(const BallSet& balls, int i) const
+{
+	const BallBinding& binding = bindings[i];
+	glm::mat4 world;
+	if (balls.phase[i] == BallPhase::Pocketed) {
+		// Collapsed to nothing while it sits in the pocket
+		world = glm::scale(glm::mat4(1.0f), glm::vec3(0.0f));
+	}
+	else {
+		glm::vec3 center(balls.px[i], ballCenterHeight, balls.pz[i]);
+		glm::quat orientation(balls.qw[i], balls.qx[i], balls.qy[i], balls.qz[i]);
+		world = glm::translate(glm::mat4(1.0f), center)
+			* glm::mat4_cast(orientation)
+			* glm::translate(glm::mat4(1.0f), -binding.meshOffset)
+			* binding.baseRotationScale;
+	}
+	return binding.parentInverse * world;
+}
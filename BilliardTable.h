@@ -0,0 +1,95 @@
+#ifndef BILLIARD_TABLE_CLASS_H
+#define BILLIARD_TABLE_CLASS_H
+
+#include<array>
+#include<string>
+#include<vector>
+#include<glm/glm.hpp>
+
+#include"BilliardPhysics.h"
+#include"EventSimulator.h"
+#include"Model.h"
+#include"ReplayLog.h"
+#include"TableGeometry.h"
+
+// Connects BilliardPhysics to the ball nodes of bilard.glb. Bind() reads the
+// table extents, cloth height and ball radius from the node hierarchy:
+// balls are small, roughly cubic mesh bounds (or nodes named ball/kula/bila),
+// the cloth is a node named cloth/felt/sukno or else the largest mesh inset
+// to its cushions. ApplyToModel() writes the simulated positions and
+// orientations back into the ball nodes' local transforms.
+//
+// The cushions come from the table meshes too: everything but the balls is
+// sliced at ball-center height and the cut around the cloth becomes the
+// lines and arcs of GetCushions(). Without such a cut the physics falls back
+// to the four rails of the cloth rectangle.
+//
+// Shots are solved up front by the event simulator and then played back:
+// each frame samples the solved shot at the playback time. Every shot also
+// goes into the replay log, which can be saved and played back later.
+class BilliardTable
+{
+public:
+	BilliardPhysics physics;
+	EventSimulator shot;
+	ReplayLog replay;
+
+	// False when no balls could be identified in the model
+	bool Bind(Model& model);
+	bool IsBound() const { return ballCount > 0; }
+
+	// Puts every ball back where the model placed it
+	void ResetRack();
+	// The ball furthest from the rest of the rack, or one named cue/white/biala
+	int GetCueBall() const { return cueBall; }
+	int GetBallCount() const { return ballCount; }
+	// Model node the ball drives
+	int GetBallNode(int ball) const { return bindings[ball].node; }
+	// Model units per meter of a standard table; multiply shot speeds by it
+	float GetWorldScale() const { return worldScale; }
+	// Cushion noses and pocket jaws, e.g. for tracing an aim line
+	const TableGeometry& GetCushions() const { return cushions; }
+	// Distance the cue ball travels along direction before it meets a cushion
+	// and the cushion normal there; false without mesh cushions or a hit
+	bool TraceAim(glm::vec2 direction, float& distance, glm::vec2& normal) const;
+
+	// Strikes the cue ball and solves the shot until every ball rests
+	void PlayShot(glm::vec2 direction, float speed, float follow, float english);
+	// Moves physics.balls along the solved shot; false once it is over
+	bool AdvanceShot(float deltaTime);
+
+	// Replaces the replay log with a saved one for this table
+	bool LoadReplay(const std::string& path);
+	// Shows the replay time seconds into one of its shots; AdvanceShot plays
+	// on from there
+	bool SeekReplay(int shotIndex, double time);
+
+	void ApplyToModel(Model& model) const;
+	// The same for a copy of the model's node transforms, indexed by node,
+	// e.g. for a simulation running on its own thread
+	void ApplyToTransforms(const BallSet& balls, std::vector<glm::mat4>& localTransforms) const;
+
+private:
+	struct BallBinding
+	{
+		int node = -1;
+		glm::mat4 parentInverse = glm::mat4(1.0f);   // world -> parent space
+		glm::mat4 baseRotationScale = glm::mat4(1.0f);
+		glm::vec3 meshOffset = glm::vec3(0.0f);       // world offset from node origin to mesh center
+		glm::vec2 restPosition = glm::vec2(0.0f);
+	};
+
+	std::array<BallBinding, MAX_BALLS> bindings;
+	TableGeometry cushions;
+	int ballCount = 0;
+	int cueBall = 0;
+	float ballCenterHeight = 0.0f;
+	float worldScale = 1.0f;
+	double shotTime = 0.0;
+
+	// Fills cushions and points physics.table at them when the slice worked
+	void ExtractCushions(const Model& model);
+	glm::mat4 BallLocalTransform(const BallSet& balls, int i) const;
+};
+
+#endif
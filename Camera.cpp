@@ -1,4 +1,5 @@
 #include"Camera.h"
+#include<cmath>
 
 Camera::Camera(int width, int height, glm::vec3 position)
 {
@@ -19,8 +20,30 @@ void Camera::Matrix(float FOVdeg, float nearPlane, float farPlane, Shader& shade
 	// Adds perspective to the scene
 	projection = glm::perspective(glm::radians(FOVdeg), (float)width / height, nearPlane, farPlane);
 
+	cameraMatrix = projection * view;
+	viewMatrix = view;
+	projectionMatrix = projection;
+	projectionScale = height / (2.0f * std::tan(glm::radians(FOVdeg) * 0.5f));
+
 	// Exports the camera matrix to the Vertex Shader
-	glUniformMatrix4fv(glGetUniformLocation(shader.ID, uniform), 1, GL_FALSE, glm::value_ptr(projection * view));
+	shader.SetMat4(uniform, cameraMatrix);
+}
+
+Frustum Camera::GetFrustum() const
+{
+	return Frustum::FromMatrix(cameraMatrix);
+}
+
+void Camera::CursorRay(double cursorX, double cursorY, glm::vec3& origin, glm::vec3& direction) const
+{
+	// Cursor to normalized device coordinates, then back through the camera matrix
+	float x = static_cast<float>(2.0 * cursorX / width - 1.0);
+	float y = static_cast<float>(1.0 - 2.0 * cursorY / height);
+	glm::mat4 inverse = glm::inverse(cameraMatrix);
+	glm::vec4 nearPoint = inverse * glm::vec4(x, y, -1.0f, 1.0f);
+	glm::vec4 farPoint = inverse * glm::vec4(x, y, 1.0f, 1.0f);
+	origin = glm::vec3(nearPoint) / nearPoint.w;
+	direction = glm::normalize(glm::vec3(farPoint) / farPoint.w - origin);
 }
 
 void Camera::Inputs(GLFWwindow* window, float deltaTime)
@@ -9,6 +9,7 @@
 #include<glm/gtx/rotate_vector.hpp>
 #include<glm/gtx/vector_angle.hpp>
 
+#include"Frustum.h"
 #include"shaderClass.h"
 
 class Camera
@@ -22,6 +23,14 @@ public:
 	// Prevents the camera from jumping around when first clicking left click
 	bool firstClick = true;
 
+	// Projection * view from the last call to Matrix, and its two halves
+	glm::mat4 cameraMatrix = glm::mat4(1.0f);
+	glm::mat4 viewMatrix = glm::mat4(1.0f);
+	glm::mat4 projectionMatrix = glm::mat4(1.0f);
+	// Pixels a world unit facing the camera covers at distance 1, from the
+	// last call to Matrix; divide by the distance for any other
+	float projectionScale = 1.0f;
+
 	// Stores the width and height of the window
 	int width;
 	int height;
@@ -44,6 +53,11 @@ public:
 
 	// Updates and exports the camera matrix to the Vertex Shader
 	void Matrix(float FOVdeg, float nearPlane, float farPlane, Shader& shader, const char* uniform);
+	// View frustum of cameraMatrix, for culling
+	Frustum GetFrustum() const;
+	// World space ray through a cursor position in pixels (origin top left),
+	// from the near plane; direction is normalized
+	void CursorRay(double cursorX, double cursorY, glm::vec3& origin, glm::vec3& direction) const;
 	// Handles camera inputs
 	void Inputs(GLFWwindow* window, float deltaTime);
 
@@ -1,27 +1,31 @@
 #include"EBO.h"
+#include"Tracer.h"
+#include"RenderDevice.h"
 
 // Constructor that generates a Elements Buffer Object and links it to indices
 EBO::EBO(GLuint* indices, GLsizeiptr size)
 {
-	glGenBuffers(1, &ID);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ID);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, size, indices, GL_STATIC_DRAW);
+	TRACE_ZONE("glBufferData EBO");
+	RenderDevice& device = RenderDevice::Get();
+	ID = device.GenBuffer();
+	device.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, ID);
+	device.BufferData(GL_ELEMENT_ARRAY_BUFFER, size, indices, GL_STATIC_DRAW);
 }
 
 // Binds the EBO
 void EBO::Bind()
 {
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ID);
+	RenderDevice::Get().BindBuffer(GL_ELEMENT_ARRAY_BUFFER, ID);
 }
 
 // Unbinds the EBO
 void EBO::Unbind()
 {
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	RenderDevice::Get().BindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 }
 
 // Deletes the EBO
 void EBO::Delete()
 {
-	glDeleteBuffers(1, &ID);
+	RenderDevice::Get().DeleteBuffer(ID);
 }
\ No newline at end of file
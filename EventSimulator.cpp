@@ -0,0 +1,663 @@
+#include"EventSimulator.h"
+#include<algorithm>
+#include<cmath>
+#include<limits>
+
+namespace
+{
+	const double ROOT_TOLERANCE = 1e-12;   // seconds
+	const int MAX_ROOT_ITERATIONS = 64;
+	const size_t QUEUE_RESERVE = 1024;
+	const size_t HISTORY_RESERVE = 64;
+	const int MAX_NEARBY_CUSHIONS = 256;   // cushion pieces gathered per prediction before testing all of them
+	const float PATH_BOX_SLACK = 1.01f;    // float path boxes are widened so rounding never drops a contact
+	const float CONTACT_SEPARATION = 3.5e-4f; // of the ball radius, the gap left after a contact; well above float rounding at any table scale
+	const double NEVER = std::numeric_limits<double>::infinity();
+
+	// Min-heap order; ties broken by kind and index so runs repeat exactly
+	bool Later(const SimEvent& a, const SimEvent& b)
+	{
+		if (a.time != b.time) {
+			return a.time > b.time;
+		}
+		if (a.type != b.type) {
+			return a.type > b.type;
+		}
+		if (a.ball != b.ball) {
+			return a.ball > b.ball;
+		}
+		return a.other > b.other;
+	}
+
+	bool IsMoving(BallPhase phase)
+	{
+		return phase == BallPhase::Sliding || phase == BallPhase::Rolling;
+	}
+
+	// Box around p + v t + a t^2 / 2 for t in [0, duration]: both ends and,
+	// per axis, the turning point of the parabola
+	void PathBounds(glm::dvec2 p, glm::dvec2 v, glm::dvec2 a, double duration, glm::dvec2& pathMin, glm::dvec2& pathMax)
+	{
+		glm::dvec2 end = p + v * duration + 0.5 * a * duration * duration;
+		pathMin = glm::min(p, end);
+		pathMax = glm::max(p, end);
+		for (int axis = 0; axis < 2; axis++) {
+			double turn = a[axis] != 0.0 ? -v[axis] / a[axis] : -1.0;
+			if (turn > 0.0 && turn < duration) {
+				double extreme = p[axis] + v[axis] * turn + 0.5 * a[axis] * turn * turn;
+				pathMin[axis] = std::min(pathMin[axis], extreme);
+				pathMax[axis] = std::max(pathMax[axis], extreme);
+			}
+		}
+	}
+
+	// c[0] + c[1] t + ... + c[degree] t^degree
+	double Evaluate(const double* c, int degree, double t)
+	{
+		double value = c[degree];
+		for (int k = degree - 1; k >= 0; k--) {
+			value = value * t + c[k];
+		}
+		return value;
+	}
+
+	double EvaluateDerivative(const double* c, int degree, double t)
+	{
+		double value = degree * c[degree];
+		for (int k = degree - 1; k >= 1; k--) {
+			value = value * t + k * c[k];
+		}
+		return value;
+	}
+
+	// Newton steps kept inside a sign-changing bracket, bisecting whenever a
+	// step would leave it
+	double RefineRoot(const double* c, int degree, double a, double b, double fa)
+	{
+		double t = 0.5 * (a + b);
+		for (int iteration = 0; iteration < MAX_ROOT_ITERATIONS; iteration++) {
+			double f = Evaluate(c, degree, t);
+			if (f == 0.0) {
+				return t;
+			}
+			if ((f < 0.0) == (fa < 0.0)) {
+				a = t;
+			}
+			else {
+				b = t;
+			}
+			double slope = EvaluateDerivative(c, degree, t);
+			double next = slope != 0.0 ? t - f / slope : a;
+			if (!(next > a && next < b)) {
+				next = 0.5 * (a + b);
+			}
+			if (std::fabs(next - t) <= ROOT_TOLERANCE) {
+				return next;
+			}
+			t = next;
+		}
+		return t;
+	}
+
+	// Real roots in [lo, hi] in ascending order, up to degree 4. The critical
+	// points (roots of the derivative, found the same way) split the interval
+	// into monotonic pieces that hold at most one root each.
+	int RootsInInterval(const double* c, int degree, double lo, double hi, double* roots)
+	{
+		while (degree > 0 && c[degree] == 0.0) {
+			degree--;
+		}
+		int count = 0;
+		auto add = [&](double t) {
+			if (t >= lo && t <= hi && (count == 0 || t > roots[count - 1])) {
+				roots[count++] = t;
+			}
+		};
+
+		if (degree == 1) {
+			add(-c[0] / c[1]);
+			return count;
+		}
+		if (degree == 2) {
+			double discriminant = c[1] * c[1] - 4.0 * c[2] * c[0];
+			if (discriminant < 0.0) {
+				return 0;
+			}
+			// Stable form: no cancellation when c[2] is tiny
+			double q = -0.5 * (c[1] + std::copysign(std::sqrt(discriminant), c[1]));
+			double r1 = q / c[2];
+			double r2 = q != 0.0 ? c[0] / q : r1;
+			add(std::min(r1, r2));
+			add(std::max(r1, r2));
+			return count;
+		}
+		if (degree < 1) {
+			return 0;
+		}
+
+		double derivative[4];
+		for (int k = 0; k < degree; k++) {
+			derivative[k] = (k + 1) * c[k + 1];
+		}
+		double critical[4];
+		int criticalCount = RootsInInterval(derivative, degree - 1, lo, hi, critical);
+
+		double a = lo;
+		double fa = Evaluate(c, degree, a);
+		for (int k = 0; k <= criticalCount; k++) {
+			double b = k < criticalCount ? critical[k] : hi;
+			double fb = Evaluate(c, degree, b);
+			if (fa == 0.0) {
+				add(a);
+			}
+			else if (fb != 0.0 && (fa < 0.0) != (fb < 0.0)) {
+				add(RefineRoot(c, degree, a, b, fa));
+			}
+			a = b;
+			fa = fb;
+		}
+		if (fa == 0.0) {
+			add(hi);
+		}
+		return count;
+	}
+
+	// First time in [0, horizon] at which f drops through zero and accept(t)
+	// holds, -1 if never. f is a separation measure (distance squared minus
+	// contact distance squared, or distance to a cushion minus the radius),
+	// so only a falling crossing is a contact; touching but separating at
+	// t = 0 is not, and touching and closing only counts when allowed.
+	template<typename Accept>
+	double FirstContactWhere(const double* c, int degree, double horizon, bool touching, Accept accept)
+	{
+		if (c[0] <= 0.0 && c[1] < 0.0 && touching) {
+			return accept(0.0) ? 0.0 : -1.0;
+		}
+		double roots[4];
+		int count = RootsInInterval(c, degree, 0.0, horizon, roots);
+		for (int k = 0; k < count; k++) {
+			if (roots[k] <= 0.0 && c[0] <= 0.0) {
+				continue;
+			}
+			if (EvaluateDerivative(c, degree, roots[k]) < 0.0 && accept(roots[k])) {
+				return roots[k];
+			}
+		}
+		return -1.0;
+	}
+
+	double FirstContact(const double* c, int degree, double horizon)
+	{
+		return FirstContactWhere(c, degree, horizon, true, [](double) { return true; });
+	}
+
+	// |C + B t + A t^2|^2 - distance^2 as a quartic
+	void SeparationQuartic(glm::dvec2 C, glm::dvec2 B, glm::dvec2 A, double distance, double* c)
+	{
+		c[4] = glm::dot(A, A);
+		c[3] = 2.0 * glm::dot(A, B);
+		c[2] = glm::dot(B, B) + 2.0 * glm::dot(A, C);
+		c[1] = 2.0 * glm::dot(B, C);
+		c[0] = glm::dot(C, C) - distance * distance;
+	}
+
+	// Moves both balls along the line between them until their centres are
+	// at least distance apart, undoing the rounding that leaves them inside
+	// contact after a collision
+	void SetApart(BallSet& balls, int i, int j, float distance)
+	{
+		glm::vec2 normal;
+		BilliardPhysics::ApproachSpeed(balls, i, j, &normal);
+		float current = std::hypot(balls.px[j] - balls.px[i], balls.pz[j] - balls.pz[i]);
+		if (current >= distance) {
+			return;
+		}
+		glm::vec2 shift = 0.5f * (distance - current) * normal;
+		balls.px[i] -= shift.x;
+		balls.pz[i] -= shift.y;
+		balls.px[j] += shift.x;
+		balls.pz[j] += shift.y;
+	}
+
+	void CopyBall(const BallSet& from, int i, BallSet& to, int j)
+	{
+		to.px[j] = from.px[i];
+		to.pz[j] = from.pz[i];
+		to.vx[j] = from.vx[i];
+		to.vz[j] = from.vz[i];
+		to.wx[j] = from.wx[i];
+		to.wy[j] = from.wy[i];
+		to.wz[j] = from.wz[i];
+		to.qw[j] = from.qw[i];
+		to.qx[j] = from.qx[i];
+		to.qy[j] = from.qy[i];
+		to.qz[j] = from.qz[i];
+		to.phase[j] = from.phase[i];
+	}
+}
+
+void EventSimulator::Reset(const BallSet& initial)
+{
+	balls = initial;
+	now = 0.0;
+	eventCount = 0;
+	ballTime.fill(0.0);
+	version.fill(0);
+	ownEventTime.fill(NEVER);
+	queue.clear();
+	queue.reserve(QUEUE_RESERVE);
+	if (table.geometry == nullptr) {
+		railGeometry.BuildFromRails(table);
+	}
+
+	for (int i = 0; i < balls.count; i++) {
+		history[i].clear();
+		history[i].reserve(HISTORY_RESERVE);
+		Record(i);
+	}
+	for (int i = 0; i < balls.count; i++) {
+		PredictBall(i);
+	}
+	for (int i = 0; i < balls.count; i++) {
+		for (int j = i + 1; j < balls.count; j++) {
+			PredictPair(i, j);
+		}
+	}
+}
+
+void EventSimulator::Strike(int ball, glm::vec2 direction, float speed, float follow, float english)
+{
+	if (ball < 0 || ball >= balls.count) {
+		return;
+	}
+	Synchronize(ball);
+	BilliardPhysics::ApplyStrike(balls, ball, direction, speed, follow, english, table.ballRadius);
+	Touch(ball);
+}
+
+bool EventSimulator::ProcessNextEvent(SimEvent* processed)
+{
+	while (!queue.empty()) {
+		std::pop_heap(queue.begin(), queue.end(), Later);
+		SimEvent event = queue.back();
+		queue.pop_back();
+		if (IsStale(event)) {
+			continue;
+		}
+
+		now = std::max(now, event.time);
+		int i = event.ball;
+		Synchronize(i);
+		switch (event.type) {
+		case SimEventType::Transition:
+			Touch(i);
+			break;
+		case SimEventType::BallBall:
+			Synchronize(event.other);
+			BilliardPhysics::CollideBalls(balls, i, event.other, params.ballRestitution, table.ballRadius);
+			SetApart(balls, i, event.other, (2.0f + CONTACT_SEPARATION) * table.ballRadius);
+			Touch(i, event.other);
+			break;
+		case SimEventType::Cushion: {
+			float distance;
+			glm::vec2 normal;
+			Cushions().Separation(event.other, glm::vec2(balls.px[i], balls.pz[i]), distance, normal);
+			BilliardPhysics::BounceOffCushion(balls, i, normal, params.cushionRestitution, table.ballRadius);
+			Touch(i);
+			break;
+		}
+		case SimEventType::Pocket:
+			balls.px[i] = table.pockets[event.other].x;
+			balls.pz[i] = table.pockets[event.other].y;
+			balls.vx[i] = balls.vz[i] = 0.0f;
+			balls.wx[i] = balls.wy[i] = balls.wz[i] = 0.0f;
+			balls.phase[i] = BallPhase::Pocketed;
+			Touch(i);
+			break;
+		}
+
+		eventCount++;
+		if (processed != nullptr) {
+			*processed = event;
+		}
+		return true;
+	}
+	return false;
+}
+
+void EventSimulator::AdvanceTo(double time)
+{
+	while (GetNextEventTime() <= time) {
+		ProcessNextEvent();
+	}
+	now = std::max(now, time);
+}
+
+int EventSimulator::SimulateToRest(int maxEvents)
+{
+	int processed = 0;
+	while (processed < maxEvents && ProcessNextEvent()) {
+		processed++;
+	}
+	return processed;
+}
+
+void EventSimulator::StateAt(double time, BallSet& out) const
+{
+	out.count = balls.count;
+	for (int i = 0; i < balls.count; i++) {
+		double start = ballTime[i];
+		if (time >= start || history[i].empty()) {
+			CopyBall(balls, i, out, i);
+		}
+		else {
+			// Last recorded state at or before time
+			const std::vector<HistoryEntry>& entries = history[i];
+			auto next = std::upper_bound(entries.begin(), entries.end(), time,
+				[](double t, const HistoryEntry& entry) { return t < entry.time; });
+			const HistoryEntry& entry = next == entries.begin() ? entries.front() : *(next - 1);
+			start = entry.time;
+			out.px[i] = entry.px;
+			out.pz[i] = entry.pz;
+			out.vx[i] = entry.vx;
+			out.vz[i] = entry.vz;
+			out.wx[i] = entry.wx;
+			out.wy[i] = entry.wy;
+			out.wz[i] = entry.wz;
+			out.qw[i] = balls.qw[i];
+			out.qx[i] = balls.qx[i];
+			out.qy[i] = balls.qy[i];
+			out.qz[i] = balls.qz[i];
+			out.phase[i] = entry.phase;
+		}
+		if (time > start) {
+			BilliardPhysics::EvolveBall(out, i, static_cast<float>(time - start), params, table.ballRadius);
+		}
+	}
+}
+
+double EventSimulator::GetNextEventTime()
+{
+	while (!queue.empty() && IsStale(queue.front())) {
+		std::pop_heap(queue.begin(), queue.end(), Later);
+		queue.pop_back();
+	}
+	return queue.empty() ? NEVER : queue.front().time;
+}
+
+bool EventSimulator::IsAtRest() const
+{
+	for (int i = 0; i < balls.count; i++) {
+		if (balls.phase[i] != BallPhase::Stationary && balls.phase[i] != BallPhase::Pocketed) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void EventSimulator::Push(const SimEvent& event)
+{
+	if (queue.size() == queue.capacity()) {
+		CompactQueue();
+	}
+	queue.push_back(event);
+	std::push_heap(queue.begin(), queue.end(), Later);
+}
+
+bool EventSimulator::IsStale(const SimEvent& event) const
+{
+	if (version[event.ball] != event.ballVersion) {
+		return true;
+	}
+	return event.type == SimEventType::BallBall && version[event.other] != event.otherVersion;
+}
+
+// Drops invalidated predictions before the queue would have to grow
+void EventSimulator::CompactQueue()
+{
+	queue.erase(std::remove_if(queue.begin(), queue.end(),
+		[this](const SimEvent& event) { return IsStale(event); }), queue.end());
+	std::make_heap(queue.begin(), queue.end(), Later);
+}
+
+void EventSimulator::Synchronize(int i)
+{
+	if (now > ballTime[i]) {
+		BilliardPhysics::EvolveBall(balls, i, static_cast<float>(now - ballTime[i]), params, table.ballRadius);
+		ballTime[i] = now;
+	}
+}
+
+void EventSimulator::Touch(int i, int j)
+{
+	version[i]++;
+	Record(i);
+	if (j >= 0) {
+		version[j]++;
+		Record(j);
+	}
+
+	// Both balls' own events first, they bound the pair predictions
+	PredictBall(i);
+	if (j >= 0) {
+		PredictBall(j);
+	}
+	for (int k = 0; k < balls.count; k++) {
+		if (k != i) {
+			PredictPair(i, k);
+		}
+	}
+	if (j >= 0) {
+		for (int k = 0; k < balls.count; k++) {
+			if (k != i && k != j) {
+				PredictPair(j, k);
+			}
+		}
+	}
+}
+
+// Phase change, cushion and pocket events of one ball, which must be at the
+// current time
+void EventSimulator::PredictBall(int i)
+{
+	ownEventTime[i] = NEVER;
+	pathMin[i] = pathMax[i] = glm::vec2(balls.px[i], balls.pz[i]);
+	BallPhase phase = balls.phase[i];
+	if (phase == BallPhase::Pocketed || phase == BallPhase::Stationary) {
+		return;
+	}
+
+	double duration = BilliardPhysics::PhaseDuration(balls, i, params, table.ballRadius);
+	SimEvent event;
+	event.ball = static_cast<int8_t>(i);
+	event.ballVersion = version[i];
+	event.time = now + duration;
+	event.type = SimEventType::Transition;
+	Push(event);
+	ownEventTime[i] = event.time;
+	if (!IsMoving(phase)) {
+		return;
+	}
+
+	glm::dvec2 p(balls.px[i], balls.pz[i]);
+	glm::dvec2 v(balls.vx[i], balls.vz[i]);
+	glm::dvec2 a(BilliardPhysics::PhaseAcceleration(balls, i, params, table.ballRadius));
+	double c[5];
+
+	// Cushion pieces near the path up to the phase change
+	const double R = table.ballRadius;
+	glm::dvec2 phaseMin, phaseMax;
+	PathBounds(p, v, a, duration, phaseMin, phaseMax);
+	const TableGeometry& geometry = Cushions();
+	int refs[MAX_NEARBY_CUSHIONS];
+	int found = geometry.Query(glm::vec2(phaseMin - R), glm::vec2(phaseMax + R), refs, MAX_NEARBY_CUSHIONS);
+	int segmentCount = static_cast<int>(geometry.segments.size());
+	bool everything = found > MAX_NEARBY_CUSHIONS;
+	int count = everything ? segmentCount + static_cast<int>(geometry.arcs.size()) : found;
+
+	for (int k = 0; k < count; k++) {
+		int ref = !everything ? refs[k] : (k < segmentCount ? k : ~(k - segmentCount));
+		double t;
+		if (ref >= 0) {
+			// Distance to the line on the side the ball is on, checked to
+			// touch within the segment
+			const CushionSegment& segment = geometry.segments[ref];
+			glm::dvec2 normal(segment.normal);
+			double side = glm::dot(normal, p - glm::dvec2(segment.start));
+			double sign = side != 0.0 ? std::copysign(1.0, side) : (glm::dot(normal, v) <= 0.0 ? 1.0 : -1.0);
+			c[2] = sign * 0.5 * glm::dot(normal, a);
+			c[1] = sign * glm::dot(normal, v);
+			c[0] = std::fabs(side) - R;
+			glm::dvec2 along = glm::dvec2(segment.end) - glm::dvec2(segment.start);
+			t = FirstContactWhere(c, 2, duration, true, [&](double time) {
+				double u = glm::dot(along, p + v * time + 0.5 * a * time * time - glm::dvec2(segment.start));
+				return u >= 0.0 && u <= glm::dot(along, along);
+			});
+		}
+		else {
+			// The circle from outside at r + R, or from inside at r - R, also
+			// after coming in through the open part; only on the arc counts
+			const CushionArc& arc = geometry.arcs[~ref];
+			glm::dvec2 offset = p - glm::dvec2(arc.center);
+			bool inside = glm::dot(offset, offset) < static_cast<double>(arc.radius) * arc.radius;
+			auto onArc = [&](double time) {
+				return arc.Contains(glm::vec2(offset + v * time + 0.5 * a * time * time));
+			};
+			t = -1.0;
+			if (!inside) {
+				SeparationQuartic(offset, v, 0.5 * a, arc.radius + R, c);
+				t = FirstContactWhere(c, 4, duration, true, onArc);
+			}
+			if (arc.radius > R) {
+				SeparationQuartic(offset, v, 0.5 * a, arc.radius - R, c);
+				for (double& coefficient : c) {
+					coefficient = -coefficient;
+				}
+				double innerTime = FirstContactWhere(c, 4, t >= 0.0 ? t : duration, inside, onArc);
+				t = innerTime >= 0.0 ? innerTime : t;
+			}
+		}
+		if (t >= 0.0) {
+			event.time = now + t;
+			event.type = SimEventType::Cushion;
+			event.other = ref;
+			Push(event);
+			ownEventTime[i] = std::min(ownEventTime[i], event.time);
+		}
+	}
+
+	for (int k = 0; k < table.pocketCount; k++) {
+		glm::dvec2 pocket(table.pockets[k]);
+		glm::dvec2 pocketGap = glm::max(phaseMin - pocket, pocket - phaseMax);
+		if (std::max(pocketGap.x, pocketGap.y) > table.pocketRadius) {
+			continue;
+		}
+		SeparationQuartic(p - pocket, v, 0.5 * a, table.pocketRadius, c);
+		double t = FirstContact(c, 4, duration);
+		if (t >= 0.0) {
+			event.time = now + t;
+			event.type = SimEventType::Pocket;
+			event.other = k;
+			Push(event);
+			ownEventTime[i] = std::min(ownEventTime[i], event.time);
+		}
+	}
+
+	// Where the ball can be until its next own event, for PredictPair
+	glm::dvec2 untilMin, untilMax;
+	PathBounds(p, v, a, ownEventTime[i] - now, untilMin, untilMax);
+	pathMin[i] = glm::vec2(untilMin);
+	pathMax[i] = glm::vec2(untilMax);
+}
+
+// Contact of balls i and j, i being at the current time. The prediction only
+// looks as far as the earlier of their phase changes; that event predicts
+// again. Likewise it stops at either ball's own next cushion or pocket
+// event, which renews every prediction of that ball anyway.
+void EventSimulator::PredictPair(int i, int j)
+{
+	if (balls.phase[i] == BallPhase::Pocketed || balls.phase[j] == BallPhase::Pocketed) {
+		return;
+	}
+	if (!IsMoving(balls.phase[i]) && !IsMoving(balls.phase[j])) {
+		return;
+	}
+	// Paths up to their next own events that never come within a diameter
+	glm::vec2 gap = glm::max(pathMin[i] - pathMax[j], pathMin[j] - pathMax[i]);
+	if (std::max(gap.x, gap.y) > 2.0f * table.ballRadius * PATH_BOX_SLACK) {
+		return;
+	}
+
+	// Both balls at the current time, without moving j's reference time
+	BallSet& pair = scratch;
+	pair.count = 2;
+	CopyBall(balls, i, pair, 0);
+	CopyBall(balls, j, pair, 1);
+	if (now > ballTime[j]) {
+		BilliardPhysics::EvolveBall(pair, 1, static_cast<float>(now - ballTime[j]), params, table.ballRadius);
+	}
+	if (!IsMoving(pair.phase[0]) && !IsMoving(pair.phase[1])) {
+		return;
+	}
+
+	const float R = table.ballRadius;
+	double horizon = std::min(BilliardPhysics::PhaseDuration(pair, 0, params, R),
+		BilliardPhysics::PhaseDuration(pair, 1, params, R));
+	horizon = std::min(horizon, std::max(std::min(ownEventTime[i], ownEventTime[j]) - now, 0.0));
+	glm::dvec2 C(pair.px[0] - pair.px[1], pair.pz[0] - pair.pz[1]);
+	glm::dvec2 B(pair.vx[0] - pair.vx[1], pair.vz[0] - pair.vz[1]);
+	glm::dvec2 A = 0.5 * (glm::dvec2(BilliardPhysics::PhaseAcceleration(pair, 0, params, R))
+		- glm::dvec2(BilliardPhysics::PhaseAcceleration(pair, 1, params, R)));
+	double diameter = 2.0 * R;
+
+	// Cheap reject: even closing at full speed they cannot meet in time
+	double reach = glm::length(B) * horizon + glm::length(A) * horizon * horizon;
+	if (glm::length(C) - diameter > reach) {
+		return;
+	}
+
+	// Balls closing in while touching, or a rounding error inside contact,
+	// meet now. Touching ones that are not count from slightly inside where
+	// they are, so a shallow dip still shows as a falling root and one
+	// pressed together by spin meets once it closes in at a real speed.
+	double c[5];
+	double separation = glm::length(C);
+	double contact = separation > diameter ? diameter : separation - CONTACT_SEPARATION * R;
+	SeparationQuartic(C, B, A, contact, c);
+	double t;
+	if (separation <= diameter && BilliardPhysics::ApproachSpeed(pair, 0, 1) > 0.0f) {
+		t = 0.0;
+	}
+	else {
+		t = FirstContactWhere(c, 4, horizon, false, [](double) { return true; });
+	}
+	if (t < 0.0) {
+		return;
+	}
+	SimEvent event;
+	event.time = now + t;
+	event.type = SimEventType::BallBall;
+	event.ball = static_cast<int8_t>(i);
+	event.other = j;
+	event.ballVersion = version[i];
+	event.otherVersion = version[j];
+	Push(event);
+}
+
+void EventSimulator::Record(int i)
+{
+	if (!recordHistory) {
+		return;
+	}
+	HistoryEntry entry;
+	entry.time = ballTime[i];
+	entry.px = balls.px[i];
+	entry.pz = balls.pz[i];
+	entry.vx = balls.vx[i];
+	entry.vz = balls.vz[i];
+	entry.wx = balls.wx[i];
+	entry.wy = balls.wy[i];
+	entry.wz = balls.wz[i];
+	entry.phase = balls.phase[i];
+	history[i].push_back(entry);
+}
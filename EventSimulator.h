@@ -0,0 +1,112 @@
+#ifndef EVENT_SIMULATOR_CLASS_H
+#define EVENT_SIMULATOR_CLASS_H
+
+#include<array>
+#include<cstdint>
+#include<vector>
+#include<glm/glm.hpp>
+
+#include"BilliardPhysics.h"
+#include"TableGeometry.h"
+
+// Event driven counterpart of BilliardPhysics. Between events every ball moves
+// in closed form (constant acceleration per phase), so instead of stepping the
+// simulator solves for the exact time of the next phase change, ball-ball
+// contact, cushion contact and pocket capture, keeps those in a priority queue
+// and jumps straight from one event to the next. A shot typically takes a few
+// hundred events where fixed steps would need tens of thousands.
+//
+// Each ball carries its own reference time; only the balls an event touches
+// are brought forward to it. Predictions are invalidated lazily through a
+// per-ball version number instead of being searched for in the queue.
+enum class SimEventType : uint8_t
+{
+	Transition,   // sliding -> rolling -> spinning -> stationary
+	BallBall,
+	Cushion,
+	Pocket
+};
+
+struct SimEvent
+{
+	double time = 0.0;
+	SimEventType type = SimEventType::Transition;
+	int8_t ball = -1;
+	int32_t other = -1;         // second ball, cushion piece (see TableGeometry::Query) or pocket
+	uint32_t ballVersion = 0;
+	uint32_t otherVersion = 0;  // only used by BallBall
+};
+
+class EventSimulator
+{
+public:
+	static const int DEFAULT_MAX_EVENTS = 10000;
+
+	TableSpec table;
+	PhysicsParams params;
+	// Keeps every ball's state after each of its events so StateAt can look
+	// back to any time of the shot
+	bool recordHistory = true;
+
+	// Starts a new simulation at time 0 from the given state
+	void Reset(const BallSet& balls);
+	// Strikes a ball at the current time, see BilliardPhysics::Strike
+	void Strike(int ball, glm::vec2 direction, float speed, float follow, float english);
+
+	// Handles the earliest pending event; false when nothing will happen anymore
+	bool ProcessNextEvent(SimEvent* processed = nullptr);
+	// Handles every event up to and including time
+	void AdvanceTo(double time);
+	// Runs until every ball rests or maxEvents were handled, returns the count
+	int SimulateToRest(int maxEvents = DEFAULT_MAX_EVENTS);
+
+	// Table state at time: O(balls) closed-form evaluations. Earlier than a
+	// ball's last event it is read from the history, later than the next
+	// pending event the result is only valid once AdvanceTo has run.
+	void StateAt(double time, BallSet& out) const;
+
+	double GetTime() const { return now; }
+	// Time of the next pending event, infinity when there is none
+	double GetNextEventTime();
+	int GetEventCount() const { return eventCount; }
+	bool IsAtRest() const;
+	// Ball states at their own reference times, not a snapshot of one moment
+	const BallSet& GetBalls() const { return balls; }
+
+private:
+	struct HistoryEntry
+	{
+		double time;
+		float px, pz, vx, vz, wx, wy, wz;
+		BallPhase phase;
+	};
+
+	BallSet balls;
+	BallSet scratch;   // two balls brought to the current time for a pair prediction
+	std::array<double, MAX_BALLS> ballTime = {};
+	std::array<uint32_t, MAX_BALLS> version = {};
+	std::array<double, MAX_BALLS> ownEventTime = {};   // earliest transition, cushion or pocket event per ball
+	std::array<glm::vec2, MAX_BALLS> pathMin = {};     // box around each ball's path until then
+	std::array<glm::vec2, MAX_BALLS> pathMax = {};
+	TableGeometry railGeometry;   // the cushions when table.geometry is not set
+	double now = 0.0;
+	int eventCount = 0;
+
+	std::vector<SimEvent> queue;   // binary min-heap, stale entries dropped on pop
+	std::array<std::vector<HistoryEntry>, MAX_BALLS> history;
+
+	const TableGeometry& Cushions() const { return table.geometry != nullptr ? *table.geometry : railGeometry; }
+	void Push(const SimEvent& event);
+	bool IsStale(const SimEvent& event) const;
+	void CompactQueue();
+	// Brings ball i forward to the current time
+	void Synchronize(int i);
+	// Invalidates the old predictions of ball i (and j, after a ball-ball
+	// contact), records the new state and predicts again
+	void Touch(int i, int j = -1);
+	void PredictBall(int i);
+	void PredictPair(int i, int j);
+	void Record(int i);
+};
+
+#endif
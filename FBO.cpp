@@ -0,0 +1,77 @@
+#include"FBO.h"
+#include"RenderDevice.h"
+#include<cstring>
+
+// Constructor that generates a Framebuffer Object with its attachments
+FBO::FBO(int width, int height)
+	: width(width), height(height)
+{
+	RenderDevice& device = RenderDevice::Get();
+
+	colorRBO = device.GenRenderbuffer();
+	device.BindRenderbuffer(colorRBO);
+	device.RenderbufferStorage(GL_RGBA8, width, height);
+
+	depthRBO = device.GenRenderbuffer();
+	device.BindRenderbuffer(depthRBO);
+	device.RenderbufferStorage(GL_DEPTH_COMPONENT24, width, height);
+	device.BindRenderbuffer(0);
+
+	ID = device.GenFramebuffer();
+	device.BindFramebuffer(GL_FRAMEBUFFER, ID);
+	device.FramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, colorRBO);
+	device.FramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthRBO);
+	device.BindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+bool FBO::IsComplete()
+{
+	RenderDevice& device = RenderDevice::Get();
+	device.BindFramebuffer(GL_FRAMEBUFFER, ID);
+	bool complete = device.CheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+	device.BindFramebuffer(GL_FRAMEBUFFER, 0);
+	return complete;
+}
+
+// Binds the FBO for drawing and reading
+void FBO::Bind()
+{
+	RenderDevice::Get().BindFramebuffer(GL_FRAMEBUFFER, ID);
+}
+
+// Rebinds the default framebuffer
+void FBO::Unbind()
+{
+	RenderDevice::Get().BindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+// Reads the color attachment as tightly packed RGBA8, top row first
+void FBO::ReadPixels(std::vector<unsigned char>& pixels)
+{
+	const size_t rowBytes = static_cast<size_t>(width) * 4;
+	pixels.resize(rowBytes * height);
+
+	RenderDevice& device = RenderDevice::Get();
+	device.BindFramebuffer(GL_READ_FRAMEBUFFER, ID);
+	device.ReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+
+	// GL returns the bottom row first, image files expect the top row first
+	std::vector<unsigned char> row(rowBytes);
+	for (int y = 0; y < height / 2; y++) {
+		unsigned char* top = pixels.data() + rowBytes * y;
+		unsigned char* bottom = pixels.data() + rowBytes * (height - 1 - y);
+		memcpy(row.data(), top, rowBytes);
+		memcpy(top, bottom, rowBytes);
+		memcpy(bottom, row.data(), rowBytes);
+	}
+}
+
+// Deletes the FBO and its renderbuffers
+void FBO::Delete()
+{
+	RenderDevice& device = RenderDevice::Get();
+	device.DeleteFramebuffer(ID);
+	device.DeleteRenderbuffer(colorRBO);
+	device.DeleteRenderbuffer(depthRBO);
+	ID = colorRBO = depthRBO = 0;
+}
@@ -0,0 +1,36 @@
+#ifndef FBO_CLASS_H
+#define FBO_CLASS_H
+
+#include<glad/glad.h>
+#include<vector>
+
+// Offscreen render target with an RGBA8 color and a 24-bit depth renderbuffer
+class FBO
+{
+public:
+	// Reference ID of the Framebuffer Object
+	GLuint ID = 0;
+	GLuint colorRBO = 0;
+	GLuint depthRBO = 0;
+	int width = 0;
+	int height = 0;
+
+	FBO() {}
+
+	// Constructor that generates a Framebuffer Object with its attachments
+	FBO(int width, int height);
+
+	// True when the driver accepted the attachment combination
+	bool IsComplete();
+
+	// Binds the FBO for drawing and reading
+	void Bind();
+	// Rebinds the default framebuffer
+	void Unbind();
+	// Reads the color attachment as tightly packed RGBA8, top row first
+	void ReadPixels(std::vector<unsigned char>& pixels);
+	// Deletes the FBO and its renderbuffers
+	void Delete();
+};
+
+#endif
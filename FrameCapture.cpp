@@ -0,0 +1,349 @@
+#include"FrameCapture.h"
+#include"RenderDevice.h"
+#include"Tracer.h"
+#include"stb_image_write.h"
+
+#include<algorithm>
+#include<chrono>
+#include<filesystem>
+#include<iostream>
+
+namespace fs = std::filesystem;
+
+#ifdef _WIN32
+#define CAPTURE_POPEN _popen
+#define CAPTURE_PCLOSE _pclose
+#define CAPTURE_PIPE_MODE "wb"
+#else
+#define CAPTURE_POPEN popen
+#define CAPTURE_PCLOSE pclose
+#define CAPTURE_PIPE_MODE "w"
+#endif
+
+namespace
+{
+	const GLuint64 STOP_WAIT_NS = 1000000000;    // per fence when draining on Stop()
+}
+
+FrameCapture::FrameCapture(int width, int height, int ringSize)
+	: width(width), height(height),
+	  frameBytes(static_cast<size_t>(width) * height * 4),
+	  ringSize(std::max(ringSize, READBACK_LATENCY + 1)),
+	  slots(new Slot[std::max(ringSize, READBACK_LATENCY + 1)])
+{
+	RenderDevice& device = RenderDevice::Get();
+	for (int i = 0; i < this->ringSize; i++) {
+		slots[i].pbo = device.GenBuffer();
+		device.BindBuffer(GL_PIXEL_PACK_BUFFER, slots[i].pbo);
+		device.BufferData(GL_PIXEL_PACK_BUFFER, static_cast<GLsizeiptr>(frameBytes), nullptr, GL_STREAM_READ);
+	}
+	device.BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+FrameCapture::~FrameCapture()
+{
+	Delete();
+}
+
+bool FrameCapture::StartPngSequence(const std::string& directory)
+{
+	if (IsRecording()) {
+		return false;
+	}
+	std::error_code error;
+	fs::create_directories(directory, error);
+
+	outputDir = directory;
+	mode = Mode::PngSequence;
+	StartWorker();
+	std::cout << "[CAPTURE] Recording PNG frames to " << outputDir << std::endl;
+	return true;
+}
+
+bool FrameCapture::StartRawPipe(const std::string& command)
+{
+	if (IsRecording()) {
+		return false;
+	}
+	pipe = CAPTURE_POPEN(command.c_str(), CAPTURE_PIPE_MODE);
+	if (pipe == nullptr) {
+		std::cout << "[CAPTURE] Failed to open pipe: " << command << std::endl;
+		return false;
+	}
+
+	mode = Mode::RawPipe;
+	StartWorker();
+	std::cout << "[CAPTURE] Recording raw " << width << "x" << height << " RGBA frames to: " << command << std::endl;
+	return true;
+}
+
+void FrameCapture::RequestScreenshot(const std::string& path)
+{
+	fs::path parent = fs::path(path).parent_path();
+	if (!parent.empty()) {
+		std::error_code error;
+		fs::create_directories(parent, error);
+	}
+	screenshotPath = path;
+	StartWorker();
+}
+
+void FrameCapture::Stop()
+{
+	// Map everything still in flight and let the encoder finish it
+	Retire(true);
+	{
+		std::unique_lock<std::mutex> lock(queueMutex);
+		idleCondition.wait(lock, [this] { return queue.empty() && !encoding; });
+	}
+	Reclaim();
+
+	if (mode != Mode::Idle) {
+		std::cout << "[CAPTURE] Stopped after " << framesWritten.load() << " frames" << std::endl;
+	}
+	StopWorker();
+	if (pipe != nullptr) {
+		CAPTURE_PCLOSE(pipe);
+		pipe = nullptr;
+	}
+	mode = Mode::Idle;
+}
+
+void FrameCapture::CaptureFrame()
+{
+	if (mode == Mode::Idle && screenshotPath.empty() && busySlots == 0) {
+		return;
+	}
+
+	TRACE_ZONE("FrameCapture::CaptureFrame");
+	auto start = std::chrono::steady_clock::now();
+
+	Reclaim();
+	Retire(false);
+
+	if (mode != Mode::Idle || !screenshotPath.empty()) {
+		std::string path = screenshotPath;
+		if (mode == Mode::PngSequence && path.empty()) {
+			char name[32];
+			snprintf(name, sizeof(name), "frame_%05llu.png", static_cast<unsigned long long>(frameIndex));
+			path = (fs::path(outputDir) / name).string();
+		}
+		Issue(path, mode == Mode::RawPipe);
+		screenshotPath.clear();
+	}
+	frameIndex++;
+
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	stats.lastCaptureMs = ms;
+	stats.maxCaptureMs = std::max(stats.maxCaptureMs, ms);
+	stats.totalCaptureMs += ms;
+}
+
+FrameCaptureStats FrameCapture::GetStats() const
+{
+	FrameCaptureStats result = stats;
+	result.framesWritten = framesWritten.load();
+	return result;
+}
+
+void FrameCapture::PrintStats() const
+{
+	FrameCaptureStats current = GetStats();
+	double averageMs = current.framesIssued > 0 ? current.totalCaptureMs / current.framesIssued : 0.0;
+	std::cout << "[CAPTURE] issued: " << current.framesIssued
+			  << ", written: " << current.framesWritten
+			  << ", dropped: " << current.framesDropped
+			  << ", render thread avg: " << averageMs << " ms, max: " << current.maxCaptureMs << " ms" << std::endl;
+}
+
+void FrameCapture::Delete()
+{
+	if (slots == nullptr) {
+		return;
+	}
+	Stop();
+	RenderDevice& device = RenderDevice::Get();
+	for (int i = 0; i < ringSize; i++) {
+		device.DeleteBuffer(slots[i].pbo);
+	}
+	slots.reset();
+}
+
+void FrameCapture::StartWorker()
+{
+	if (worker.joinable()) {
+		return;
+	}
+	quit = false;
+	worker = std::thread(&FrameCapture::WorkerLoop, this);
+}
+
+void FrameCapture::StopWorker()
+{
+	if (!worker.joinable()) {
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		quit = true;
+	}
+	queueCondition.notify_all();
+	worker.join();
+}
+
+void FrameCapture::WorkerLoop()
+{
+	for (;;) {
+		int index = -1;
+		{
+			std::unique_lock<std::mutex> lock(queueMutex);
+			queueCondition.wait(lock, [this] { return quit || !queue.empty(); });
+			if (queue.empty()) {
+				return;
+			}
+			index = queue.front();
+			queue.pop_front();
+			encoding = true;
+		}
+
+		Encode(slots[index]);
+		slots[index].state.store(SlotState::Released, std::memory_order_release);
+		framesWritten++;
+
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			encoding = false;
+		}
+		idleCondition.notify_all();
+	}
+}
+
+void FrameCapture::Encode(Slot& slot)
+{
+	TRACE_ZONE("FrameCapture::Encode");
+	const int rowBytes = width * 4;
+	// GL rows start at the bottom; walk them backwards so files are top row first
+	const unsigned char* lastRow = slot.pixels + static_cast<size_t>(rowBytes) * (height - 1);
+
+	if (!slot.path.empty()) {
+		if (!stbi_write_png(slot.path.c_str(), width, height, 4, lastRow, -rowBytes)) {
+			std::cout << "[CAPTURE] Failed to write " << slot.path << std::endl;
+		}
+		else if (slot.screenshot) {
+			std::cout << "[CAPTURE] Saved " << slot.path << std::endl;
+		}
+	}
+	if (slot.toPipe && pipe != nullptr) {
+		for (int y = 0; y < height; y++) {
+			fwrite(lastRow - static_cast<size_t>(rowBytes) * y, 1, rowBytes, pipe);
+		}
+	}
+}
+
+// Unmaps buffers the encoder is done with
+void FrameCapture::Reclaim()
+{
+	RenderDevice& device = RenderDevice::Get();
+	bool bound = false;
+	for (int i = 0; i < ringSize; i++) {
+		if (slots[i].state.load(std::memory_order_acquire) != SlotState::Released) {
+			continue;
+		}
+		device.BindBuffer(GL_PIXEL_PACK_BUFFER, slots[i].pbo);
+		device.UnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		bound = true;
+		slots[i].pixels = nullptr;
+		slots[i].state.store(SlotState::Free, std::memory_order_relaxed);
+		busySlots--;
+	}
+	if (bound) {
+		device.BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	}
+}
+
+// Maps readbacks that are old enough and whose fence has signaled, oldest
+// first so piped frames stay in order. With wait set, blocks until all are
+// done, dropping a frame whose fence has not signaled after STOP_WAIT_NS.
+void FrameCapture::Retire(bool wait)
+{
+	RenderDevice& device = RenderDevice::Get();
+	while (!pending.empty()) {
+		int index = pending.front();
+		Slot& slot = slots[index];
+		if (!wait && frameIndex - slot.frame < READBACK_LATENCY) {
+			break;
+		}
+		GLenum result = device.ClientWaitSync(slot.fence, wait ? STOP_WAIT_NS : 0);
+		if (result == GL_TIMEOUT_EXPIRED && !wait) {
+			break;
+		}
+		device.DeleteSync(slot.fence);
+		slot.fence = nullptr;
+		pending.pop_front();
+
+		// A fence still unsignaled after the full wait, or a failed wait, means
+		// a hung or lost context; the frame is dropped rather than mapped
+		if (result == GL_TIMEOUT_EXPIRED || result == GL_WAIT_FAILED) {
+			std::cout << "[CAPTURE] " << (result == GL_WAIT_FAILED ? "Waiting for a readback failed" : "A readback timed out")
+					  << ", dropping the frame" << std::endl;
+			slot.state.store(SlotState::Free, std::memory_order_relaxed);
+			busySlots--;
+			stats.framesDropped++;
+			continue;
+		}
+
+		device.BindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+		slot.pixels = static_cast<const unsigned char*>(
+			device.MapBufferRange(GL_PIXEL_PACK_BUFFER, 0, static_cast<GLsizeiptr>(frameBytes), GL_MAP_READ_BIT));
+		device.BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+		if (slot.pixels == nullptr) {
+			std::cout << "[CAPTURE] Failed to map pixel pack buffer" << std::endl;
+			slot.state.store(SlotState::Free, std::memory_order_relaxed);
+			busySlots--;
+			stats.framesDropped++;
+			continue;
+		}
+
+		slot.state.store(SlotState::Mapped, std::memory_order_relaxed);
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			queue.push_back(index);
+		}
+		queueCondition.notify_one();
+	}
+}
+
+// Starts an asynchronous readback into the next free buffer
+void FrameCapture::Issue(const std::string& path, bool toPipe)
+{
+	int index = -1;
+	for (int i = 0; i < ringSize; i++) {
+		int candidate = (nextSlot + i) % ringSize;
+		if (slots[candidate].state.load(std::memory_order_acquire) == SlotState::Free) {
+			index = candidate;
+			break;
+		}
+	}
+	if (index < 0) {
+		stats.framesDropped++;
+		return;
+	}
+	nextSlot = (index + 1) % ringSize;
+
+	Slot& slot = slots[index];
+	RenderDevice& device = RenderDevice::Get();
+	device.BindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+	device.ReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	device.BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	slot.fence = device.FenceSync();
+	slot.frame = frameIndex;
+	slot.path = path;
+	slot.toPipe = toPipe;
+	slot.screenshot = !screenshotPath.empty();
+	slot.state.store(SlotState::Pending, std::memory_order_relaxed);
+	pending.push_back(index);
+	busySlots++;
+	stats.framesIssued++;
+}
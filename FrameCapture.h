@@ -0,0 +1,117 @@
+#ifndef FRAME_CAPTURE_CLASS_H
+#define FRAME_CAPTURE_CLASS_H
+
+#include<glad/glad.h>
+#include<atomic>
+#include<condition_variable>
+#include<cstdio>
+#include<deque>
+#include<memory>
+#include<mutex>
+#include<string>
+#include<thread>
+
+struct FrameCaptureStats
+{
+	uint64_t framesIssued = 0;
+	uint64_t framesWritten = 0;
+	uint64_t framesDropped = 0;     // no free pixel pack buffer (the encoder fell behind) or a failed readback
+	double lastCaptureMs = 0.0;     // render thread cost of the last CaptureFrame()
+	double maxCaptureMs = 0.0;
+	double totalCaptureMs = 0.0;
+};
+
+// Stall-free readback of the framebuffer bound for reading. CaptureFrame()
+// issues glReadPixels into a ring of pixel pack buffers and drops a fence;
+// two frames later, once the fence has signaled, the buffer is mapped and
+// handed to the encoder thread, which writes a PNG (flipped through a
+// negative stride, no copy) or pushes raw RGBA frames, top row first, into
+// a pipe such as
+//   ffmpeg -f rawvideo -pix_fmt rgba -s 1920x1080 -r 60 -i - out.mp4
+// A buffer stays mapped while it is being encoded and is unmapped by the
+// render thread afterwards, so the render thread never copies or waits.
+class FrameCapture
+{
+public:
+	static const int DEFAULT_RING_SIZE = 3;
+	static const int READBACK_LATENCY = 2;    // frames between glReadPixels and map
+
+	FrameCapture(int width, int height, int ringSize = DEFAULT_RING_SIZE);
+	~FrameCapture();
+
+	FrameCapture(const FrameCapture&) = delete;
+	FrameCapture& operator=(const FrameCapture&) = delete;
+
+	// Every frame becomes outputDir/frame_NNNNN.png until Stop()
+	bool StartPngSequence(const std::string& outputDir);
+	// Every frame is written as raw RGBA to the stdin of command until Stop()
+	bool StartRawPipe(const std::string& command);
+	// Only the next captured frame, written to path
+	void RequestScreenshot(const std::string& path);
+	// Drains the ring, waits for the encoder and closes the pipe
+	void Stop();
+
+	bool IsRecording() const { return mode != Mode::Idle; }
+
+	// Call once per frame after drawing, before swapping buffers
+	void CaptureFrame();
+
+	FrameCaptureStats GetStats() const;
+	void PrintStats() const;
+
+	// Deletes the pixel pack buffers; stops any recording first
+	void Delete();
+
+private:
+	enum class Mode { Idle, PngSequence, RawPipe };
+	enum class SlotState { Free, Pending, Mapped, Released };
+
+	struct Slot
+	{
+		GLuint pbo = 0;
+		GLsync fence = nullptr;
+		uint64_t frame = 0;
+		std::string path;                    // PNG target, empty when not wanted
+		bool toPipe = false;
+		bool screenshot = false;
+		const unsigned char* pixels = nullptr;
+		std::atomic<SlotState> state{ SlotState::Free };
+	};
+
+	int width;
+	int height;
+	size_t frameBytes;
+	int ringSize;
+	std::unique_ptr<Slot[]> slots;
+	std::deque<int> pending;                 // slot indices in issue order
+	int busySlots = 0;
+	int nextSlot = 0;
+	uint64_t frameIndex = 0;
+
+	Mode mode = Mode::Idle;
+	std::string outputDir;
+	std::string screenshotPath;
+	FILE* pipe = nullptr;
+
+	std::thread worker;
+	std::mutex queueMutex;
+	std::condition_variable queueCondition;
+	std::condition_variable idleCondition;
+	std::deque<int> queue;                   // mapped slots waiting for the encoder
+	bool encoding = false;
+	bool quit = false;
+
+	FrameCaptureStats stats;
+	std::atomic<uint64_t> framesWritten{ 0 };
+
+	void StartWorker();
+	void StopWorker();
+	void WorkerLoop();
+	void Encode(Slot& slot);
+
+	void Reclaim();
+	void Retire(bool wait);
+	void Issue(const std::string& path, bool toPipe);
+};
+
+#endif
@@ -0,0 +1,96 @@
+#include"Frustum.h"
+#include"SimdLanes.h"
+#include<algorithm>
+
+void SphereBatch::Resize(int count)
+{
+	this->count = std::max(count, 0);
+	const int blockWidth = static_cast<int>(sizeof(LaneBlock) / sizeof(float));
+	stride = (this->count + blockWidth - 1) / blockWidth * blockWidth;
+	// Padding spheres sit at the origin with a negative radius, outside every plane
+	storage.assign(static_cast<size_t>(4) * std::max(stride, blockWidth) / blockWidth, LaneBlock());
+	std::fill(Row(3), Row(3) + stride, -1.0f);
+}
+
+void SphereBatch::Set(int i, glm::vec3 center, float radius)
+{
+	Row(0)[i] = center.x;
+	Row(1)[i] = center.y;
+	Row(2)[i] = center.z;
+	Row(3)[i] = radius;
+}
+
+Frustum Frustum::FromMatrix(const glm::mat4& viewProjection)
+{
+	// Rows of the matrix; glm stores columns
+	glm::vec4 rows[4];
+	for (int r = 0; r < 4; r++) {
+		rows[r] = glm::vec4(viewProjection[0][r], viewProjection[1][r], viewProjection[2][r], viewProjection[3][r]);
+	}
+
+	Frustum frustum;
+	frustum.planes[0] = rows[3] + rows[0];
+	frustum.planes[1] = rows[3] - rows[0];
+	frustum.planes[2] = rows[3] + rows[1];
+	frustum.planes[3] = rows[3] - rows[1];
+	frustum.planes[4] = rows[3] + rows[2];
+	frustum.planes[5] = rows[3] - rows[2];
+	for (glm::vec4& plane : frustum.planes) {
+		float length = glm::length(glm::vec3(plane));
+		if (length > 0.0f) {
+			plane /= length;
+		}
+	}
+	return frustum;
+}
+
+bool Frustum::IntersectsSphere(glm::vec3 center, float radius) const
+{
+	for (const glm::vec4& plane : planes) {
+		if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool Frustum::IntersectsBox(glm::vec3 boundsMin, glm::vec3 boundsMax) const
+{
+	for (const glm::vec4& plane : planes) {
+		// The corner furthest along the plane normal
+		glm::vec3 corner(
+			plane.x >= 0.0f ? boundsMax.x : boundsMin.x,
+			plane.y >= 0.0f ? boundsMax.y : boundsMin.y,
+			plane.z >= 0.0f ? boundsMax.z : boundsMin.z);
+		if (glm::dot(glm::vec3(plane), corner) + plane.w < 0.0f) {
+			return false;
+		}
+	}
+	return true;
+}
+
+int Frustum::CullSpheres(const SphereBatch& spheres, std::vector<uint8_t>& visible) const
+{
+	int count = spheres.GetCount();
+	visible.resize(count);
+	int visibleCount = 0;
+	for (int base = 0; base < count; base += LANE_WIDTH) {
+		Lanes x = Lanes::Load(spheres.X() + base);
+		Lanes y = Lanes::Load(spheres.Y() + base);
+		Lanes z = Lanes::Load(spheres.Z() + base);
+		Lanes negativeRadius = Lanes::Set(0.0f) - Lanes::Load(spheres.Radius() + base);
+		LaneMask outside = negativeRadius > Lanes::Set(0.0f);
+		for (const glm::vec4& plane : planes) {
+			Lanes distance = Lanes::Set(plane.x) * x + Lanes::Set(plane.y) * y + Lanes::Set(plane.z) * z + Lanes::Set(plane.w);
+			outside = outside | (distance < negativeRadius);
+		}
+		int bits = MoveMask(outside);
+		int lanes = std::min(LANE_WIDTH, count - base);
+		for (int lane = 0; lane < lanes; lane++) {
+			uint8_t inside = (bits >> lane) & 1 ? 0 : 1;
+			visible[base + lane] = inside;
+			visibleCount += inside;
+		}
+	}
+	return visibleCount;
+}
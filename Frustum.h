@@ -0,0 +1,75 @@
+#ifndef FRUSTUM_CLASS_H
+#define FRUSTUM_CLASS_H
+
+#include<cstdint>
+#include<vector>
+#include<glm/glm.hpp>
+
+// Meshes submitted and skipped by one Draw (or one frame, summed over models)
+struct CullStats
+{
+	int tested = 0;
+	int culled = 0;
+	int drawn = 0;
+	int triangles = 0;   // drawn, at the meshes' levels of detail
+
+	void Add(const CullStats& other)
+	{
+		tested += other.tested;
+		culled += other.culled;
+		drawn += other.drawn;
+		triangles += other.triangles;
+	}
+};
+
+// World space bounding spheres as structure of arrays, padded to whole lane
+// blocks so Frustum::CullSpheres can load LANE_WIDTH of them at once
+class SphereBatch
+{
+public:
+	void Resize(int count);
+	int GetCount() const { return count; }
+	void Set(int i, glm::vec3 center, float radius);
+
+	const float* X() const { return Row(0); }
+	const float* Y() const { return Row(1); }
+	const float* Z() const { return Row(2); }
+	const float* Radius() const { return Row(3); }
+
+private:
+	struct alignas(32) LaneBlock
+	{
+		float values[8];
+	};
+
+	int count = 0;
+	int stride = 0;   // spheres per row, padded to whole lane blocks
+	std::vector<LaneBlock> storage;
+
+	float* Row(int field) { return reinterpret_cast<float*>(storage.data()) + static_cast<size_t>(field) * stride; }
+	const float* Row(int field) const { return reinterpret_cast<const float*>(storage.data()) + static_cast<size_t>(field) * stride; }
+};
+
+// The six planes of a view-projection matrix (Gribb/Hartmann), normalized
+// and facing inwards: a point p is inside when dot(plane.xyz, p) + plane.w
+// >= 0 for all six
+class Frustum
+{
+public:
+	static const int PLANE_COUNT = 6;   // left, right, bottom, top, near, far
+
+	glm::vec4 planes[PLANE_COUNT];
+
+	static Frustum FromMatrix(const glm::mat4& viewProjection);
+
+	bool IntersectsSphere(glm::vec3 center, float radius) const;
+	// Conservative: a box outside no single plane counts as visible
+	bool IntersectsBox(glm::vec3 boundsMin, glm::vec3 boundsMax) const;
+
+	// Tests every sphere of the batch against all planes, LANE_WIDTH at a
+	// time; visible[i] is 1 unless sphere i lies entirely outside a plane.
+	// Returns the number visible.
+	int CullSpheres(const SphereBatch& spheres, std::vector<uint8_t>& visible) const;
+};
+
+#endif
@@ -0,0 +1,165 @@
+#include"HeadlessContext.h"
+#include"RenderDevice.h"
+#include<glad/glad.h>
+#include<iostream>
+
+#if defined(__linux__) && !defined(HEADLESS_USE_GLFW)
+#define HEADLESS_USE_EGL
+#include<EGL/egl.h>
+#include<EGL/eglext.h>
+#else
+#include<GLFW/glfw3.h>
+#endif
+
+HeadlessContext::~HeadlessContext()
+{
+	Destroy();
+}
+
+#ifdef HEADLESS_USE_EGL
+
+bool HeadlessContext::Create(int width, int height)
+{
+	EGLDisplay eglDisplay = EGL_NO_DISPLAY;
+
+	// The surfaceless platform needs neither a display server nor a GPU
+	auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+	if (getPlatformDisplay != nullptr) {
+		eglDisplay = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+		backendName = "egl-surfaceless";
+	}
+
+	EGLint major = 0, minor = 0;
+	if (eglDisplay == EGL_NO_DISPLAY || !eglInitialize(eglDisplay, &major, &minor)) {
+		eglDisplay = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+		backendName = "egl";
+		if (eglDisplay == EGL_NO_DISPLAY || !eglInitialize(eglDisplay, &major, &minor)) {
+			std::cout << "[HEADLESS] Failed to initialize an EGL display" << std::endl;
+			return false;
+		}
+	}
+	display = eglDisplay;
+
+	const EGLint configAttribs[] = {
+		EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_RED_SIZE, 8,
+		EGL_GREEN_SIZE, 8,
+		EGL_BLUE_SIZE, 8,
+		EGL_ALPHA_SIZE, 8,
+		EGL_DEPTH_SIZE, 24,
+		EGL_NONE
+	};
+	EGLConfig config = nullptr;
+	EGLint configCount = 0;
+	if (!eglChooseConfig(eglDisplay, configAttribs, &config, 1, &configCount) || configCount == 0) {
+		std::cout << "[HEADLESS] No EGL config with pbuffer and desktop GL support" << std::endl;
+		Destroy();
+		return false;
+	}
+
+	const EGLint pbufferAttribs[] = {
+		EGL_WIDTH, width,
+		EGL_HEIGHT, height,
+		EGL_NONE
+	};
+	EGLSurface eglSurface = eglCreatePbufferSurface(eglDisplay, config, pbufferAttribs);
+	if (eglSurface == EGL_NO_SURFACE) {
+		std::cout << "[HEADLESS] Failed to create EGL pbuffer surface" << std::endl;
+		Destroy();
+		return false;
+	}
+	surface = eglSurface;
+
+	eglBindAPI(EGL_OPENGL_API);
+	const EGLint contextAttribs[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 3,
+		EGL_CONTEXT_MINOR_VERSION, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+	EGLContext eglContext = eglCreateContext(eglDisplay, config, EGL_NO_CONTEXT, contextAttribs);
+	if (eglContext == EGL_NO_CONTEXT) {
+		std::cout << "[HEADLESS] Failed to create OpenGL 3.3 core context" << std::endl;
+		Destroy();
+		return false;
+	}
+	context = eglContext;
+
+	if (!eglMakeCurrent(eglDisplay, eglSurface, eglSurface, eglContext)) {
+		std::cout << "[HEADLESS] Failed to make EGL context current" << std::endl;
+		Destroy();
+		return false;
+	}
+
+	if (!gladLoadGLLoader(reinterpret_cast<GLADloadproc>(eglGetProcAddress))) {
+		std::cout << "[HEADLESS] Failed to load OpenGL functions" << std::endl;
+		Destroy();
+		return false;
+	}
+	GLRenderDevice::LoadExtensions(reinterpret_cast<GLADloadproc>(eglGetProcAddress));
+
+	std::cout << "[HEADLESS] EGL " << major << "." << minor << " (" << backendName << ")" << std::endl;
+	return true;
+}
+
+void HeadlessContext::Destroy()
+{
+	if (display == nullptr) {
+		return;
+	}
+	eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	if (context != nullptr) {
+		eglDestroyContext(display, context);
+	}
+	if (surface != nullptr) {
+		eglDestroySurface(display, surface);
+	}
+	eglTerminate(display);
+	display = surface = context = nullptr;
+}
+
+#else
+
+bool HeadlessContext::Create(int width, int height)
+{
+	backendName = "glfw-hidden";
+	if (!glfwInit()) {
+		std::cout << "[HEADLESS] Failed to initialize GLFW" << std::endl;
+		return false;
+	}
+
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+	GLFWwindow* hiddenWindow = glfwCreateWindow(width, height, "JakubSputoOpenGL headless", NULL, NULL);
+	if (hiddenWindow == NULL) {
+		std::cout << "[HEADLESS] Failed to create hidden GLFW window" << std::endl;
+		glfwTerminate();
+		return false;
+	}
+	window = hiddenWindow;
+
+	glfwMakeContextCurrent(hiddenWindow);
+	if (!gladLoadGL()) {
+		std::cout << "[HEADLESS] Failed to load OpenGL functions" << std::endl;
+		Destroy();
+		return false;
+	}
+	GLRenderDevice::LoadExtensions(reinterpret_cast<GLADloadproc>(glfwGetProcAddress));
+	return true;
+}
+
+void HeadlessContext::Destroy()
+{
+	if (window == nullptr) {
+		return;
+	}
+	glfwDestroyWindow(static_cast<GLFWwindow*>(window));
+	glfwTerminate();
+	window = nullptr;
+}
+
+#endif
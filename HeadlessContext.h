@@ -0,0 +1,34 @@
+#ifndef HEADLESS_CONTEXT_CLASS_H
+#define HEADLESS_CONTEXT_CLASS_H
+
+#include<string>
+
+// OpenGL 3.3 core context without a visible window. On Linux it uses an EGL
+// pbuffer (surfaceless Mesa platform first, so llvmpipe works with no X or
+// Wayland server); elsewhere, or when built with HEADLESS_USE_GLFW, it falls
+// back to a hidden GLFW window. Rendering is expected to go to an FBO.
+class HeadlessContext
+{
+public:
+	HeadlessContext() {}
+	~HeadlessContext();
+
+	HeadlessContext(const HeadlessContext&) = delete;
+	HeadlessContext& operator=(const HeadlessContext&) = delete;
+
+	// Creates the context, makes it current and loads GL entry points
+	bool Create(int width, int height);
+	void Destroy();
+
+	// "egl-surfaceless", "egl" or "glfw-hidden"
+	const std::string& GetBackendName() const { return backendName; }
+
+private:
+	std::string backendName;
+	void* display = nullptr;
+	void* surface = nullptr;
+	void* context = nullptr;
+	void* window = nullptr;
+};
+
+#endif
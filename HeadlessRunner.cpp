@@ -0,0 +1,206 @@
+#include"HeadlessRunner.h"
+#include"FBO.h"
+#include"RenderDevice.h"
+#include"Tracer.h"
+#include"json.hpp"
+#include"stb_image_write.h"
+
+#include<algorithm>
+#include<chrono>
+#include<cmath>
+#include<cstdio>
+#include<cstdlib>
+#include<filesystem>
+#include<fstream>
+#include<iostream>
+#include<sstream>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+	const double FIXED_TIMESTEP = 1.0 / 60.0;
+	const float PATH_RADIUS = 2.8f;          // stays inside the camera bounds used in Main
+	const float PATH_HEIGHT = 2.4f;
+	const float PATH_HEIGHT_SWING = 0.4f;
+	const glm::vec3 PATH_LOOK_AT(0.0f, 0.8f, 0.0f);
+
+	double Percentile(const std::vector<double>& sorted, double fraction)
+	{
+		if (sorted.empty()) {
+			return 0.0;
+		}
+		size_t index = static_cast<size_t>(std::ceil(fraction * sorted.size())) - 1;
+		return sorted[std::min(index, sorted.size() - 1)];
+	}
+
+	std::string GLString(GLenum name)
+	{
+		const GLubyte* value = glGetString(name);
+		return value != nullptr ? reinterpret_cast<const char*>(value) : "";
+	}
+}
+
+bool HeadlessRunner::ParseArgument(HeadlessOptions& options, int& i, int argc, char** argv)
+{
+	std::string arg = argv[i];
+	if (i + 1 >= argc) {
+		return false;
+	}
+
+	if (arg == "--frames") {
+		options.frames = std::max(1, std::atoi(argv[++i]));
+	}
+	else if (arg == "--warmup") {
+		options.warmupFrames = std::max(0, std::atoi(argv[++i]));
+	}
+	else if (arg == "--dump-frames") {
+		// Comma separated frame indices, e.g. 0,120,239
+		std::stringstream list(argv[++i]);
+		std::string item;
+		while (std::getline(list, item, ',')) {
+			if (!item.empty()) {
+				options.dumpFrames.push_back(std::atoi(item.c_str()));
+			}
+		}
+	}
+	else if (arg == "--size") {
+		int width = 0, height = 0;
+		char separator = 0;
+		std::stringstream size(argv[++i]);
+		if (size >> width >> separator >> height && width > 0 && height > 0) {
+			options.width = width;
+			options.height = height;
+		}
+	}
+	else if (arg == "--out") {
+		options.outputDir = argv[++i];
+	}
+	else if (arg == "--report") {
+		options.reportFile = argv[++i];
+	}
+	else {
+		return false;
+	}
+	return true;
+}
+
+glm::vec3 HeadlessRunner::PathPosition(float t)
+{
+	// One orbit around the table per run, bobbing up and down twice
+	float angle = t * 2.0f * glm::pi<float>();
+	return glm::vec3(
+		PATH_RADIUS * std::cos(angle),
+		PATH_HEIGHT + PATH_HEIGHT_SWING * std::sin(2.0f * angle),
+		PATH_RADIUS * std::sin(angle));
+}
+
+glm::vec3 HeadlessRunner::PathTarget()
+{
+	return PATH_LOOK_AT;
+}
+
+int HeadlessRunner::Run(const HeadlessOptions& options, const std::string& backendName, double loadMs,
+	Camera& camera, const RenderFrameFn& renderFrame)
+{
+	using Clock = std::chrono::steady_clock;
+	RenderDevice& device = RenderDevice::Get();
+
+	FBO fbo(options.width, options.height);
+	if (!fbo.IsComplete()) {
+		std::cout << "[HEADLESS] Framebuffer is incomplete" << std::endl;
+		fbo.Delete();
+		return -1;
+	}
+
+	if (!options.dumpFrames.empty()) {
+		std::error_code error;
+		fs::create_directories(options.outputDir, error);
+	}
+
+	std::vector<double> frameMs;
+	frameMs.reserve(options.frames);
+	nlohmann::json dumped = nlohmann::json::array();
+	std::vector<unsigned char> pixels;
+
+	auto runStart = Clock::now();
+	for (int frame = 0; frame < options.frames; frame++) {
+		float t = static_cast<float>(frame) / options.frames;
+		camera.Position = PathPosition(t);
+		camera.Orientation = glm::normalize(PathTarget() - camera.Position);
+
+		auto frameStart = Clock::now();
+		{
+			TRACE_ZONE("Headless frame");
+			fbo.Bind();
+			device.Viewport(0, 0, options.width, options.height);
+			renderFrame(frame * FIXED_TIMESTEP, static_cast<float>(FIXED_TIMESTEP));
+			// Wait for the GPU (or llvmpipe) so the time covers the whole frame
+			device.Finish();
+		}
+		frameMs.push_back(std::chrono::duration<double, std::milli>(Clock::now() - frameStart).count());
+
+		if (std::find(options.dumpFrames.begin(), options.dumpFrames.end(), frame) != options.dumpFrames.end()) {
+			TRACE_ZONE("Headless frame dump");
+			auto readStart = Clock::now();
+			fbo.ReadPixels(pixels);
+			double readbackMs = std::chrono::duration<double, std::milli>(Clock::now() - readStart).count();
+
+			char name[32];
+			snprintf(name, sizeof(name), "frame_%05d.png", frame);
+			std::string path = (fs::path(options.outputDir) / name).string();
+			if (!stbi_write_png(path.c_str(), options.width, options.height, 4, pixels.data(), options.width * 4)) {
+				std::cout << "[HEADLESS] Failed to write " << path << std::endl;
+			}
+			dumped.push_back({ { "frame", frame }, { "file", path }, { "readbackMs", readbackMs } });
+		}
+	}
+	double totalMs = std::chrono::duration<double, std::milli>(Clock::now() - runStart).count();
+	fbo.Unbind();
+	fbo.Delete();
+
+	int warmup = std::min(options.warmupFrames, static_cast<int>(frameMs.size()) - 1);
+	std::vector<double> measured(frameMs.begin() + warmup, frameMs.end());
+	std::sort(measured.begin(), measured.end());
+	double sum = 0.0;
+	for (double ms : measured) {
+		sum += ms;
+	}
+	double averageMs = sum / measured.size();
+
+	nlohmann::json report = {
+		{ "backend", backendName },
+		{ "renderer", GLString(GL_RENDERER) },
+		{ "vendor", GLString(GL_VENDOR) },
+		{ "version", GLString(GL_VERSION) },
+		{ "width", options.width },
+		{ "height", options.height },
+		{ "frames", options.frames },
+		{ "warmupFrames", warmup },
+		{ "loadMs", loadMs },
+		{ "totalMs", totalMs },
+		{ "stats", {
+			{ "avgMs", averageMs },
+			{ "minMs", measured.front() },
+			{ "maxMs", measured.back() },
+			{ "p50Ms", Percentile(measured, 0.50) },
+			{ "p95Ms", Percentile(measured, 0.95) },
+			{ "p99Ms", Percentile(measured, 0.99) },
+			{ "fps", averageMs > 0.0 ? 1000.0 / averageMs : 0.0 }
+		} },
+		{ "frameMs", frameMs },
+		{ "dumpedFrames", dumped }
+	};
+
+	std::ofstream out(options.reportFile);
+	if (!out) {
+		std::cout << "[HEADLESS] Failed to write report " << options.reportFile << std::endl;
+		return -1;
+	}
+	out << report.dump(2) << std::endl;
+
+	std::cout << "[HEADLESS] " << options.frames << " frames at " << options.width << "x" << options.height
+			  << ", avg " << averageMs << " ms, p95 " << Percentile(measured, 0.95) << " ms, report: "
+			  << options.reportFile << std::endl;
+	return 0;
+}
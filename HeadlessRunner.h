@@ -0,0 +1,46 @@
+#ifndef HEADLESS_RUNNER_CLASS_H
+#define HEADLESS_RUNNER_CLASS_H
+
+#include<functional>
+#include<string>
+#include<vector>
+#include<glm/glm.hpp>
+
+#include"Camera.h"
+
+struct HeadlessOptions
+{
+	int width = 1280;
+	int height = 720;
+	int frames = 240;
+	int warmupFrames = 10;           // rendered but left out of the statistics
+	std::vector<int> dumpFrames;     // frame indices written as PNG
+	std::string outputDir = "headless";
+	std::string reportFile = "headless_report.json";
+};
+
+// Drives the scene for a fixed number of frames on a scripted camera orbit,
+// rendering into an FBO at a fixed 60 Hz timestep so every run sees exactly
+// the same frames. Each frame is timed up to glFinish; the selected frames
+// are read back and written as PNG, and the timings go to a JSON report.
+class HeadlessRunner
+{
+public:
+	// Renders one frame into the bound framebuffer; the camera is already placed
+	using RenderFrameFn = std::function<void(double time, float deltaTime)>;
+
+	// Parses "--frames", "--dump-frames", "--size", "--out" and "--report";
+	// returns false when argv[i] is not one of them
+	static bool ParseArgument(HeadlessOptions& options, int& i, int argc, char** argv);
+
+	// Camera position at a point of the path, t in [0, 1), and the point it
+	// looks at all along the path
+	static glm::vec3 PathPosition(float t);
+	static glm::vec3 PathTarget();
+
+	// Returns the process exit code
+	static int Run(const HeadlessOptions& options, const std::string& backendName, double loadMs,
+		Camera& camera, const RenderFrameFn& renderFrame);
+};
+
+#endif
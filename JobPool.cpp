@@ -0,0 +1,135 @@
+#include"JobPool.h"
+#include<algorithm>
+
+JobPool::JobPool(int threadCount)
+{
+	if (threadCount <= 0) {
+		threadCount = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+	}
+	workerCount = threadCount;
+	queues.reset(new Queue[workerCount]);
+	for (int i = 1; i < workerCount; i++) {
+		threads.emplace_back(&JobPool::WorkerLoop, this, i);
+	}
+}
+
+JobPool::~JobPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quit = true;
+	}
+	wakeCondition.notify_all();
+	for (auto& thread : threads) {
+		thread.join();
+	}
+}
+
+void JobPool::Run(int count, int chunk, RangeFunction body, void* bodyContext)
+{
+	if (count <= 0) {
+		return;
+	}
+	grain = std::max(chunk, 1);
+	function = body;
+	context = bodyContext;
+	for (int i = 0; i < workerCount; i++) {
+		std::lock_guard<std::mutex> lock(queues[i].mutex);
+		queues[i].begin = static_cast<int>(static_cast<int64_t>(count) * i / workerCount);
+		queues[i].end = static_cast<int>(static_cast<int64_t>(count) * (i + 1) / workerCount);
+	}
+
+	if (workerCount > 1) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			generation++;
+			helpersRunning = workerCount - 1;
+		}
+		wakeCondition.notify_all();
+	}
+	Work(0);
+	if (workerCount > 1) {
+		std::unique_lock<std::mutex> lock(mutex);
+		doneCondition.wait(lock, [this] { return helpersRunning == 0; });
+	}
+}
+
+void JobPool::WorkerLoop(int worker)
+{
+	uint64_t seen = 0;
+	for (;;) {
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wakeCondition.wait(lock, [this, seen] { return quit || generation != seen; });
+			if (quit) {
+				return;
+			}
+			seen = generation;
+		}
+
+		Work(worker);
+
+		bool last;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			last = --helpersRunning == 0;
+		}
+		if (last) {
+			doneCondition.notify_one();
+		}
+	}
+}
+
+void JobPool::Work(int worker)
+{
+	// No loop spawns more work, so once neither the own queue nor any
+	// victim has something left this worker is done
+	int begin, end;
+	for (;;) {
+		while (TakeLocal(worker, begin, end)) {
+			function(context, begin, end, worker);
+		}
+		if (!Steal(worker)) {
+			return;
+		}
+	}
+}
+
+bool JobPool::TakeLocal(int worker, int& begin, int& end)
+{
+	Queue& queue = queues[worker];
+	std::lock_guard<std::mutex> lock(queue.mutex);
+	if (queue.begin >= queue.end) {
+		return false;
+	}
+	begin = queue.begin;
+	end = std::min(queue.begin + grain, queue.end);
+	queue.begin = end;
+	return true;
+}
+
+bool JobPool::Steal(int worker)
+{
+	for (int offset = 1; offset < workerCount; offset++) {
+		Queue& victim = queues[(worker + offset) % workerCount];
+		int begin, end;
+		{
+			std::lock_guard<std::mutex> lock(victim.mutex);
+			int left = victim.end - victim.begin;
+			if (left <= 0) {
+				continue;
+			}
+			// The back half, or all of it when only one chunk is left
+			end = victim.end;
+			begin = left <= grain ? victim.begin : victim.end - left / 2;
+			victim.end = begin;
+		}
+		Queue& own = queues[worker];
+		std::lock_guard<std::mutex> lock(own.mutex);
+		own.begin = begin;
+		own.end = end;
+		steals.fetch_add(1, std::memory_order_relaxed);
+		return true;
+	}
+	return false;
+}
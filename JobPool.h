@@ -0,0 +1,78 @@
+#ifndef JOB_POOL_CLASS_H
+#define JOB_POOL_CLASS_H
+
+#include<atomic>
+#include<condition_variable>
+#include<cstdint>
+#include<memory>
+#include<mutex>
+#include<thread>
+#include<vector>
+
+// Persistent worker threads for data-parallel loops. ParallelFor splits
+// [0, count) evenly over the workers' queues; a worker takes grain-sized
+// chunks off the front of its own range and, once that is empty, steals the
+// back half of another worker's range. Nothing is allocated per loop, so a
+// body can run thousands of small jobs without touching the heap.
+//
+// The calling thread works as worker 0 and ParallelFor returns once every
+// index ran. Bodies must not call ParallelFor on the same pool.
+class JobPool
+{
+public:
+	// threadCount 0 uses every hardware thread
+	explicit JobPool(int threadCount = 0);
+	~JobPool();
+
+	JobPool(const JobPool&) = delete;
+	JobPool& operator=(const JobPool&) = delete;
+
+	int GetWorkerCount() const { return workerCount; }
+	// Ranges taken from another worker's queue since the pool started
+	uint64_t GetStealCount() const { return steals.load(std::memory_order_relaxed); }
+
+	// Calls body(begin, end, worker) on consecutive ranges of at most grain
+	// indices; worker is in [0, GetWorkerCount())
+	template<class Body>
+	void ParallelFor(int count, int grain, Body& body)
+	{
+		Run(count, grain, [](void* context, int begin, int end, int worker) {
+			(*static_cast<Body*>(context))(begin, end, worker);
+		}, &body);
+	}
+
+private:
+	using RangeFunction = void(*)(void* context, int begin, int end, int worker);
+
+	// One cache line per queue so neighbouring workers do not share one
+	struct alignas(64) Queue
+	{
+		std::mutex mutex;
+		int begin = 0;
+		int end = 0;
+	};
+
+	int workerCount = 1;
+	std::unique_ptr<Queue[]> queues;
+	std::vector<std::thread> threads;
+
+	std::mutex mutex;
+	std::condition_variable wakeCondition;
+	std::condition_variable doneCondition;
+	uint64_t generation = 0;   // bumped for every loop
+	int helpersRunning = 0;    // helper threads still inside the current loop
+	bool quit = false;
+
+	RangeFunction function = nullptr;
+	void* context = nullptr;
+	int grain = 1;
+	std::atomic<uint64_t> steals{ 0 };
+
+	void Run(int count, int chunk, RangeFunction body, void* bodyContext);
+	void WorkerLoop(int worker);
+	void Work(int worker);
+	bool TakeLocal(int worker, int& begin, int& end);
+	bool Steal(int worker);
+};
+
+#endif
@@ -0,0 +1,305 @@
+#include"LightClusters.h"
+#include"RenderDevice.h"
+#include"SimdLanes.h"
+#include"Tracer.h"
+#include<algorithm>
+#include<chrono>
+#include<cmath>
+
+namespace
+{
+	double MillisecondsSince(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+}
+
+void LightClusters::SphereSet::Reserve(int capacity)
+{
+	size_t blocks = static_cast<size_t>(capacity + 7) / 8 + 1;
+	if (x.size() < blocks) {
+		x.resize(blocks);
+		y.resize(blocks);
+		z.resize(blocks);
+		radius.resize(blocks);
+	}
+	if (light.size() < static_cast<size_t>(capacity)) {
+		light.resize(capacity);
+	}
+}
+
+void LightClusters::SphereSet::Push(float sx, float sy, float sz, float sr, uint16_t index)
+{
+	Floats(x)[count] = sx;
+	Floats(y)[count] = sy;
+	Floats(z)[count] = sz;
+	Floats(radius)[count] = sr;
+	light[count] = index;
+	count++;
+}
+
+LightClusters::LightClusters(int threadCount)
+	: pool(threadCount)
+{
+	RenderDevice& device = RenderDevice::Get();
+	lightBuffer = device.GenBuffer();
+	rangeBuffer = device.GenBuffer();
+	indexBuffer = device.GenBuffer();
+
+	// Texture buffers read the buffers as they are at the draw
+	const GLuint buffers[3] = { lightBuffer, rangeBuffer, indexBuffer };
+	const GLenum formats[3] = { GL_RGBA32F, GL_RG32UI, GL_R16UI };
+	GLuint* textures[3] = { &lightTexture, &rangeTexture, &indexTexture };
+	for (int i = 0; i < 3; i++) {
+		*textures[i] = device.GenTexture();
+		device.BindTexture(GL_TEXTURE_BUFFER, *textures[i]);
+		device.BindBuffer(GL_TEXTURE_BUFFER, buffers[i]);
+		device.BufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+		device.TexBuffer(formats[i], buffers[i]);
+	}
+	device.BindTexture(GL_TEXTURE_BUFFER, 0);
+	device.BindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	slices.resize(CLUSTERS_Z);
+	ranges.assign(CLUSTER_COUNT * 2, 0);
+}
+
+void LightClusters::SetLights(const std::vector<PointLight>& newLights)
+{
+	lights.assign(newLights.begin(), newLights.begin() + std::min<size_t>(newLights.size(), MAX_LIGHTS));
+
+	lightTexels.clear();
+	for (const PointLight& light : lights) {
+		lightTexels.insert(lightTexels.end(), { light.position.x, light.position.y, light.position.z, light.radius,
+			light.color.r, light.color.g, light.color.b, 0.0f });
+	}
+	lightsDirty = true;
+}
+
+float LightClusters::SliceDepth(int slice) const
+{
+	return nearPlane * std::pow(farPlane / nearPlane, static_cast<float>(slice) / CLUSTERS_Z);
+}
+
+void LightClusters::BuildClusterBoxes(const glm::mat4& newProjection)
+{
+	projection = newProjection;
+	// Planes of a glm::perspective matrix
+	nearPlane = projection[3][2] / (projection[2][2] - 1.0f);
+	farPlane = projection[3][2] / (projection[2][2] + 1.0f);
+
+	// A tile spans [ndc0, ndc1] on the screen, so ndc * depth / scale in view
+	// space at a depth; the box of a cluster takes both its slice's depths
+	auto span = [](int cell, int cells, float scale, float nearDepth, float farDepth, float& low, float& high)
+	{
+		float ndc0 = -1.0f + 2.0f * cell / cells;
+		float ndc1 = -1.0f + 2.0f * (cell + 1) / cells;
+		low = std::min({ ndc0 * nearDepth, ndc0 * farDepth }) / scale;
+		high = std::max({ ndc1 * nearDepth, ndc1 * farDepth }) / scale;
+	};
+
+	clusterBoxes.resize(CLUSTER_COUNT);
+	rowBoxes.resize(CLUSTERS_Z * CLUSTERS_Y);
+	sliceBoxes.resize(CLUSTERS_Z);
+	for (int z = 0; z < CLUSTERS_Z; z++) {
+		float nearDepth = SliceDepth(z);
+		float farDepth = SliceDepth(z + 1);
+		Box& sliceBox = sliceBoxes[z];
+		span(0, 1, projection[0][0], nearDepth, farDepth, sliceBox.boundsMin.x, sliceBox.boundsMax.x);
+		span(0, 1, projection[1][1], nearDepth, farDepth, sliceBox.boundsMin.y, sliceBox.boundsMax.y);
+		sliceBox.boundsMin.z = -farDepth;
+		sliceBox.boundsMax.z = -nearDepth;
+
+		for (int y = 0; y < CLUSTERS_Y; y++) {
+			Box& rowBox = rowBoxes[z * CLUSTERS_Y + y];
+			rowBox = sliceBox;
+			span(y, CLUSTERS_Y, projection[1][1], nearDepth, farDepth, rowBox.boundsMin.y, rowBox.boundsMax.y);
+
+			for (int x = 0; x < CLUSTERS_X; x++) {
+				Box& box = clusterBoxes[ClusterIndex(x, y, z)];
+				box = rowBox;
+				span(x, CLUSTERS_X, projection[0][0], nearDepth, farDepth, box.boundsMin.x, box.boundsMax.x);
+			}
+		}
+	}
+}
+
+int LightClusters::Touching(const SphereSet& set, int first, const Box& box)
+{
+	Lanes x = Lanes::Load(SphereSet::Floats(set.x) + first);
+	Lanes y = Lanes::Load(SphereSet::Floats(set.y) + first);
+	Lanes z = Lanes::Load(SphereSet::Floats(set.z) + first);
+	Lanes radius = Lanes::Load(SphereSet::Floats(set.radius) + first);
+	Lanes zero = Lanes::Set(0.0f);
+
+	// Distance from each center to the box, zero on an axis it lies within
+	Lanes dx = Max(Max(Lanes::Set(box.boundsMin.x) - x, x - Lanes::Set(box.boundsMax.x)), zero);
+	Lanes dy = Max(Max(Lanes::Set(box.boundsMin.y) - y, y - Lanes::Set(box.boundsMax.y)), zero);
+	Lanes dz = Max(Max(Lanes::Set(box.boundsMin.z) - z, z - Lanes::Set(box.boundsMax.z)), zero);
+	int mask = MoveMask(dx * dx + dy * dy + dz * dz <= radius * radius);
+
+	int valid = set.count - first;
+	return valid >= LANE_WIDTH ? mask : mask & ((1 << valid) - 1);
+}
+
+void LightClusters::Gather(const SphereSet& source, const Box& box, SphereSet& target)
+{
+	const float* x = SphereSet::Floats(source.x);
+	const float* y = SphereSet::Floats(source.y);
+	const float* z = SphereSet::Floats(source.z);
+	const float* radius = SphereSet::Floats(source.radius);
+	for (int first = 0; first < source.count; first += LANE_WIDTH) {
+		int bits = Touching(source, first, box);
+		for (int lane = 0; bits != 0 && lane < LANE_WIDTH; lane++) {
+			if ((bits >> lane) & 1) {
+				int i = first + lane;
+				target.Push(x[i], y[i], z[i], radius[i], source.light[i]);
+			}
+		}
+	}
+}
+
+void LightClusters::AssignSlice(int slice, Scratch& work)
+{
+	SliceLists& lists = slices[slice];
+	lists.indices.clear();
+	lists.counts.assign(CLUSTERS_X * CLUSTERS_Y, 0);
+	lists.dropped = 0;
+
+	work.slice.count = 0;
+	Gather(viewLights, sliceBoxes[slice], work.slice);
+	if (work.slice.count == 0) {
+		return;
+	}
+	for (int y = 0; y < CLUSTERS_Y; y++) {
+		work.row.count = 0;
+		Gather(work.slice, rowBoxes[slice * CLUSTERS_Y + y], work.row);
+		for (int x = 0; x < CLUSTERS_X && work.row.count > 0; x++) {
+			const Box& box = clusterBoxes[ClusterIndex(x, y, slice)];
+			uint32_t& count = lists.counts[y * CLUSTERS_X + x];
+			for (int first = 0; first < work.row.count; first += LANE_WIDTH) {
+				int bits = Touching(work.row, first, box);
+				for (int lane = 0; bits != 0 && lane < LANE_WIDTH; lane++) {
+					if (((bits >> lane) & 1) == 0) {
+						continue;
+					}
+					if (count == MAX_CLUSTER_LIGHTS) {
+						lists.dropped++;
+					} else {
+						lists.indices.push_back(work.row.light[first + lane]);
+						count++;
+					}
+				}
+			}
+		}
+	}
+}
+
+void LightClusters::Update(const glm::mat4& newView, const glm::mat4& newProjection)
+{
+	TRACE_ZONE("LightClusters::Update");
+	auto start = std::chrono::steady_clock::now();
+	if (newProjection != projection) {
+		BuildClusterBoxes(newProjection);
+	}
+	view = newView;
+
+	int lightCount = static_cast<int>(lights.size());
+	viewLights.Reserve(lightCount);
+	viewLights.count = 0;
+	for (int i = 0; i < lightCount; i++) {
+		glm::vec3 center = glm::vec3(view * glm::vec4(lights[i].position, 1.0f));
+		viewLights.Push(center.x, center.y, center.z, lights[i].radius, static_cast<uint16_t>(i));
+	}
+
+	scratch.resize(pool.GetWorkerCount());
+	for (Scratch& work : scratch) {
+		work.slice.Reserve(lightCount);
+		work.row.Reserve(lightCount);
+	}
+	if (lightCount > 0) {
+		auto assign = [&](int begin, int end, int worker)
+		{
+			for (int slice = begin; slice < end; slice++) {
+				AssignSlice(slice, scratch[worker]);
+			}
+		};
+		pool.ParallelFor(CLUSTERS_Z, 1, assign);
+	}
+
+	// Slices one after another, in cluster order
+	stats = LightClusterStats();
+	stats.lights = lightCount;
+	indices.clear();
+	for (int slice = 0; slice < CLUSTERS_Z; slice++) {
+		const SliceLists& lists = slices[slice];
+		uint32_t first = static_cast<uint32_t>(indices.size());
+		for (int tile = 0; tile < CLUSTERS_X * CLUSTERS_Y; tile++) {
+			uint32_t count = lightCount > 0 ? lists.counts[tile] : 0;
+			int cluster = slice * CLUSTERS_X * CLUSTERS_Y + tile;
+			ranges[cluster * 2] = first;
+			ranges[cluster * 2 + 1] = count;
+			first += count;
+			stats.maxPerCluster = std::max(stats.maxPerCluster, static_cast<int>(count));
+		}
+		if (lightCount > 0) {
+			indices.insert(indices.end(), lists.indices.begin(), lists.indices.end());
+			stats.dropped += lists.dropped;
+		}
+	}
+	stats.assigned = static_cast<int>(indices.size());
+	stats.assignMs = MillisecondsSince(start);
+}
+
+void LightClusters::Apply(Shader& shader, int viewportWidth, int viewportHeight)
+{
+	auto start = std::chrono::steady_clock::now();
+	RenderDevice& device = RenderDevice::Get();
+	// Empty lists keep the buffers' last contents, no cluster points at them
+	if (lightsDirty && !lightTexels.empty()) {
+		device.BindBuffer(GL_TEXTURE_BUFFER, lightBuffer);
+		device.BufferData(GL_TEXTURE_BUFFER, lightTexels.size() * sizeof(float), lightTexels.data(), GL_STATIC_DRAW);
+	}
+	lightsDirty = false;
+	device.BindBuffer(GL_TEXTURE_BUFFER, rangeBuffer);
+	device.BufferData(GL_TEXTURE_BUFFER, ranges.size() * sizeof(uint32_t), ranges.data(), GL_STREAM_DRAW);
+	if (!indices.empty()) {
+		device.BindBuffer(GL_TEXTURE_BUFFER, indexBuffer);
+		device.BufferData(GL_TEXTURE_BUFFER, indices.size() * sizeof(uint16_t), indices.data(), GL_STREAM_DRAW);
+	}
+	device.BindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	device.ActiveTexture(GL_TEXTURE0 + LIGHT_UNIT);
+	device.BindTexture(GL_TEXTURE_BUFFER, lightTexture);
+	device.ActiveTexture(GL_TEXTURE0 + RANGE_UNIT);
+	device.BindTexture(GL_TEXTURE_BUFFER, rangeTexture);
+	device.ActiveTexture(GL_TEXTURE0 + INDEX_UNIT);
+	device.BindTexture(GL_TEXTURE_BUFFER, indexTexture);
+	device.ActiveTexture(GL_TEXTURE0);
+
+	// Tile from gl_FragCoord, slice from the log of the view depth
+	float logRange = std::log(farPlane / nearPlane);
+	glm::vec4 depthRow = -glm::vec4(view[0][2], view[1][2], view[2][2], view[3][2]);
+	shader.SetInt("clusterLights", LIGHT_UNIT);
+	shader.SetInt("clusterRanges", RANGE_UNIT);
+	shader.SetInt("clusterIndices", INDEX_UNIT);
+	shader.SetVec3("clusterCounts", glm::vec3(CLUSTERS_X, CLUSTERS_Y, CLUSTERS_Z));
+	shader.SetVec3("clusterScale", glm::vec3(static_cast<float>(CLUSTERS_X) / viewportWidth,
+		static_cast<float>(CLUSTERS_Y) / viewportHeight, CLUSTERS_Z / logRange));
+	shader.SetFloat("clusterBias", -CLUSTERS_Z * std::log(nearPlane) / logRange);
+	shader.SetVec4("clusterDepthRow", depthRow);
+	stats.uploadMs = MillisecondsSince(start);
+}
+
+void LightClusters::Delete()
+{
+	RenderDevice& device = RenderDevice::Get();
+	for (GLuint* texture : { &lightTexture, &rangeTexture, &indexTexture }) {
+		device.DeleteTexture(*texture);
+		*texture = 0;
+	}
+	for (GLuint* buffer : { &lightBuffer, &rangeBuffer, &indexBuffer }) {
+		device.DeleteBuffer(*buffer);
+		*buffer = 0;
+	}
+}
@@ -0,0 +1,163 @@
+#ifndef LIGHT_CLUSTERS_CLASS_H
+#define LIGHT_CLUSTERS_CLASS_H
+
+#include<glad/glad.h>
+#include<cstdint>
+#include<vector>
+#include<glm/glm.hpp>
+
+#include"JobPool.h"
+#include"shaderClass.h"
+
+// A lamp of the hall; it reaches radius and fades out smoothly before it
+struct PointLight
+{
+	glm::vec3 position = glm::vec3(0.0f);   // world space
+	float radius = 1.0f;
+	glm::vec3 color = glm::vec3(1.0f);
+};
+
+struct LightClusterStats
+{
+	int lights = 0;
+	int assigned = 0;          // light references over all clusters
+	int maxPerCluster = 0;
+	int dropped = 0;           // references past MAX_CLUSTER_LIGHTS
+	double assignMs = 0.0;
+	double uploadMs = 0.0;
+
+	void Add(const LightClusterStats& other)
+	{
+		lights += other.lights;
+		assigned += other.assigned;
+		maxPerCluster = maxPerCluster > other.maxPerCluster ? maxPerCluster : other.maxPerCluster;
+		dropped += other.dropped;
+		assignMs += other.assignMs;
+		uploadMs += other.uploadMs;
+	}
+};
+
+// Clustered forward shading. The view frustum is cut into CLUSTERS_X x
+// CLUSTERS_Y screen tiles and CLUSTERS_Z slices whose depth grows
+// exponentially from the near to the far plane. Every frame the lights are
+// assigned to the clusters their sphere touches, and default.frag loops
+// over only the lights of its fragment's cluster, so its cost follows the
+// lights that reach a pixel rather than all the lights of the hall.
+//
+// Assignment narrows down by depth slice, then tile row, then tile, testing
+// LANE_WIDTH spheres at a time against the cluster boxes in view space;
+// slices run in parallel on a JobPool. The lights, the index range of each
+// cluster and the light indices go to the shader in three texture buffers.
+class LightClusters
+{
+public:
+	static const int CLUSTERS_X = 16;
+	static const int CLUSTERS_Y = 9;
+	static const int CLUSTERS_Z = 24;
+	static const int CLUSTER_COUNT = CLUSTERS_X * CLUSTERS_Y * CLUSTERS_Z;
+	static const int MAX_LIGHTS = 4096;          // indices are 16 bit
+	static const int MAX_CLUSTER_LIGHTS = 64;    // further lights of a cluster are dropped
+	static const int LIGHT_UNIT = 3;             // texture units, after the diffuse texture and the shadow maps
+	static const int RANGE_UNIT = 4;
+	static const int INDEX_UNIT = 5;
+
+	// threadCount 0 uses every hardware thread
+	explicit LightClusters(int threadCount = 0);
+
+	LightClusters(const LightClusters&) = delete;
+	LightClusters& operator=(const LightClusters&) = delete;
+
+	// Lights past MAX_LIGHTS are ignored
+	void SetLights(const std::vector<PointLight>& lights);
+	const std::vector<PointLight>& GetLights() const { return lights; }
+
+	// Assigns the lights to the clusters of a view; the cluster boxes are
+	// rebuilt only when the projection changes
+	void Update(const glm::mat4& view, const glm::mat4& projection);
+	// Uploads the light lists and binds them, with the uniforms that find a
+	// fragment's cluster; viewportWidth and viewportHeight in pixels
+	void Apply(Shader& shader, int viewportWidth, int viewportHeight);
+
+	// Light indices of cluster (x, y, z) after Update
+	int GetClusterLightCount(int x, int y, int z) const { return ranges[ClusterIndex(x, y, z) * 2 + 1]; }
+	int GetClusterLight(int x, int y, int z, int i) const { return indices[ranges[ClusterIndex(x, y, z) * 2] + i]; }
+	const LightClusterStats& GetStats() const { return stats; }
+
+	void Delete();
+
+private:
+	// Rows are whole blocks, so every row starts 32 byte aligned
+	struct alignas(32) LaneBlock
+	{
+		float values[8];
+	};
+
+	// Spheres in view space as lanes, with the light each one is
+	struct SphereSet
+	{
+		std::vector<LaneBlock> x, y, z, radius;
+		std::vector<uint16_t> light;
+		int count = 0;
+
+		// Room for capacity spheres, Push does not grow the rows
+		void Reserve(int capacity);
+		void Push(float sx, float sy, float sz, float sr, uint16_t index);
+
+		// A row as one float array across its blocks, not just the first block's values
+		static float* Floats(std::vector<LaneBlock>& row) { return reinterpret_cast<float*>(row.data()); }
+		static const float* Floats(const std::vector<LaneBlock>& row) { return reinterpret_cast<const float*>(row.data()); }
+	};
+
+	struct Box
+	{
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+	};
+
+	// Per worker: the lights of the slice and row being assigned
+	struct Scratch
+	{
+		SphereSet slice;
+		SphereSet row;
+	};
+
+	// Per slice, filled by its worker and joined afterwards
+	struct SliceLists
+	{
+		std::vector<uint16_t> indices;
+		std::vector<uint32_t> counts;     // per cluster of the slice
+		int dropped = 0;
+	};
+
+	JobPool pool;
+	std::vector<PointLight> lights;
+	glm::mat4 view = glm::mat4(1.0f);
+	glm::mat4 projection = glm::mat4(0.0f);
+	float nearPlane = 0.1f;
+	float farPlane = 100.0f;
+	std::vector<Box> clusterBoxes;     // view space
+	std::vector<Box> rowBoxes;         // per slice and tile row
+	std::vector<Box> sliceBoxes;
+	SphereSet viewLights;
+	std::vector<Scratch> scratch;
+	std::vector<SliceLists> slices;
+	std::vector<uint32_t> ranges;      // first index and count per cluster
+	std::vector<uint16_t> indices;
+	std::vector<float> lightTexels;    // position and radius, color and 0 per light
+	bool lightsDirty = true;           // lightTexels not uploaded yet
+	GLuint lightBuffer = 0, rangeBuffer = 0, indexBuffer = 0;
+	GLuint lightTexture = 0, rangeTexture = 0, indexTexture = 0;
+	LightClusterStats stats;
+
+	static int ClusterIndex(int x, int y, int z) { return (z * CLUSTERS_Y + y) * CLUSTERS_X + x; }
+	float SliceDepth(int slice) const;
+	void BuildClusterBoxes(const glm::mat4& newProjection);
+	void AssignSlice(int slice, Scratch& scratch);
+	// Bit i set when sphere first + i of the set touches box, for the
+	// LANE_WIDTH spheres from first
+	static int Touching(const SphereSet& set, int first, const Box& box);
+	// Appends the spheres of source that touch box to target
+	static void Gather(const SphereSet& source, const Box& box, SphereSet& target);
+};
+
+#endif
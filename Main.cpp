@@ -1,5 +1,11 @@
 #include <iostream>
 #include <filesystem>
+#include <chrono>
+#include <functional>
+#include <algorithm>
+#include <cstdlib>
+#include <cassert>
+#include <cmath>
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
@@ -15,6 +21,20 @@
 #include "Camera.h"
 #include "Model.h"
 #include "Skybox.h"
+#include "Tracer.h"
+#include "HeadlessContext.h"
+#include "HeadlessRunner.h"
+#include "FrameCapture.h"
+#include "BilliardTable.h"
+#include "BallKernels.h"
+#include "ShotEvaluator.h"
+#include "ShotPlanner.h"
+#include "SimulationThread.h"
+#include "SceneBvh.h"
+#include "OcclusionCuller.h"
+#include "ShadowMap.h"
+#include "LightClusters.h"
+#include "ShaderCompileThread.h"
 
 namespace fs = std::filesystem;
 
@@ -25,17 +45,76 @@ const int ANIMATION_KEY = GLFW_KEY_T;
 const int FILTER_KEY = GLFW_KEY_F;
 const int RAINBOW_LIGHT_KEY = GLFW_KEY_R;
 const int EXIT_KEY = GLFW_KEY_ESCAPE;
+const int TRACE_DUMP_KEY = GLFW_KEY_P;
+const int SCREENSHOT_KEY = GLFW_KEY_F12;
+const int RECORD_KEY = GLFW_KEY_V;
+const int SHOT_KEY = GLFW_KEY_B;
+const int AIM_KEY = GLFW_KEY_H;
+const int PLAN_KEY = GLFW_KEY_G;
+const int REPLAY_KEY = GLFW_KEY_J;
+const int REPLAY_SAVE_KEY = GLFW_KEY_L;
+const int SHADOW_KEY = GLFW_KEY_K;
+const int PICK_BUTTON = GLFW_MOUSE_BUTTON_RIGHT;
 
 const glm::vec3 CAMERA_START_POSITION(-3.0f, 2.0f, -1.5f);	// Starting position of the camera
 const glm::vec3 MIN_BOUNDS(-3.0f, 2.0f, -3.0f);			// Minimum XYZ boundaries
 const glm::vec3 MAX_BOUNDS(3.0f, 3.0f, 3.0f);				// Maximum XYZ boundaries
 const float DIST_FROM_TABLE = 2.0f;							// Distance from the table center
+const float SHOT_SPEED = 6.0f;								// Cue ball speed for SHOT_KEY, m/s on a standard table
+const float MAX_PHYSICS_DELTA = 0.1f;						// Longest frame the simulation catches up on
+const int AIM_CANDIDATES = 10000;							// Shots tried by AIM_KEY
+const int AIM_TOP_SHOTS = 5;								// Best shots listed, the first one is played
+const float AIM_MIN_SPEED = 0.5f;							// m/s on a standard table
+const float AIM_MAX_SPEED = 8.0f;
+const float PICK_DISTANCE = 100.0f;							// Far plane of the camera
+const float LOD_PIXEL_ERROR = 1.0f;							// Largest surface error of a mesh's level of detail on screen
+const float SHADOW_FOV = 90.0f;								// Of the lamp's shadow frustum, pointing down at the table
+const float SHADOW_NEAR = 0.5f;
+const float SHADOW_FAR = 12.0f;
+const float HALL_LAMP_SPACING = 4.0f;						// Grid of the lamps added with --lamps
+const float HALL_LAMP_HEIGHT = 5.5f;
+const float HALL_LAMP_RADIUS = 6.0f;						// Distance a hall lamp reaches
+const glm::vec3 HALL_LAMP_COLOR(0.9f, 0.8f, 0.6f);
+const char* const PROGRAM_CACHE_PATH = "shader_programs.bin";	// Linked shader variants kept between runs
 
 bool grayscaleFilter = false;
 bool rainbowLightFilter = false;
 
+// Chrome trace output, enabled with --trace <file>
+std::string traceFile;
+
+// Offscreen run on a scripted camera path, enabled with --headless
+bool headless = false;
+HeadlessOptions headlessOptions;
+
+// Raw RGBA frames piped to this command from startup, set with --record-pipe <command>
+std::string recordPipeCommand;
+
+// Replay log played back from startup, set with --replay <file>
+std::string replayFile;
+
+// Simulation ticks per second in the window, set with --sim-rate <hz>
+int simulationRate = SimulationThread::DEFAULT_RATE;
+
+// Lamps over the rest of the hall, lit through the light clusters, set with --lamps <count>
+int hallLampCount = 0;
+
 //global pointer so we can access the model from the key callback
 Model* g_bilardModel = nullptr;
+FrameCapture* g_frameCapture = nullptr;
+BilliardTable* g_billiardTable = nullptr;
+ShotEvaluator* g_shotEvaluator = nullptr;
+ShotPlanner* g_shotPlanner = nullptr;
+SimulationThread* g_simulation = nullptr;
+ShadowMap* g_shadowMap = nullptr;
+std::vector<ShotCandidate> aimCandidates;
+std::vector<ShotResult> aimResults;
+uint32_t aimSeed = 1;
+// Simulation state, only touched by the simulation thread once it runs
+bool physicsActive = false;	// physics drives the balls instead of the glTF clip
+int replayShot = -1;		// shot of the replay log being played back, -1 when not replaying
+int screenshotCount = 0;
+int replayCount = 0;
 
 GLfloat vertices[] = {
 	// Wierzcho�ki          /  Kolory     /  TexCoord (u, v) //
@@ -85,6 +164,49 @@ GLuint indices[] = {
 	20, 21, 22, 22, 23, 20	// Prawa
 };
 
+// Meshes drawn and frustum culled, per frame on average
+static void PrintCullStats(const CullStats& totals, int frames)
+{
+	if (frames <= 0)
+		return;
+	std::cout << "[CULL] " << frames << " frames, " << static_cast<float>(totals.drawn) / frames << " meshes ("
+			  << static_cast<float>(totals.triangles) / frames << " triangles) drawn and "
+			  << static_cast<float>(totals.culled) / frames << " culled per frame" << std::endl;
+}
+
+// Meshes hidden behind occluders and the time it took, per frame on average
+static void PrintOcclusionStats(const OcclusionStats& totals, int frames)
+{
+	if (frames <= 0)
+		return;
+	std::cout << "[OCCLUSION] " << static_cast<float>(totals.occluders) / frames << " occluders ("
+			  << static_cast<float>(totals.occluderTriangles) / frames << " triangles), "
+			  << static_cast<float>(totals.occluded) / frames << " of " << static_cast<float>(totals.tested) / frames
+			  << " meshes hidden per frame, " << totals.rasterMs * 1000.0 / frames << " us rasterizing and "
+			  << totals.testMs * 1000.0 / frames << " us testing" << std::endl;
+}
+
+// Hall lamps reaching each cluster and the time it took to list them, per frame on average
+static void PrintClusterStats(const LightClusterStats& totals, int frames)
+{
+	if (frames <= 0 || totals.lights == 0)
+		return;
+	std::cout << "[CLUSTERS] " << static_cast<float>(totals.lights) / frames << " lamps, "
+			  << static_cast<float>(totals.assigned) / frames << " cluster references per frame (at most "
+			  << totals.maxPerCluster << " in a cluster, " << totals.dropped << " dropped), "
+			  << totals.assignMs * 1000.0 / frames << " us assigning and " << totals.uploadMs * 1000.0 / frames
+			  << " us uploading" << std::endl;
+}
+
+// Changes to the simulated table run on the simulation thread, between two ticks
+static void PostToSimulation(std::function<void()> command)
+{
+	if (g_simulation != nullptr)
+		g_simulation->Post(std::move(command));
+	else
+		command();
+}
+
 static void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods)
 {
 	if (key == FILTER_KEY && action == GLFW_PRESS)
@@ -95,53 +217,234 @@ static void keyCallback(GLFWwindow* window, int key, int scancode, int action, i
     {
         rainbowLightFilter = !rainbowLightFilter;
     }
+	if (key == SHADOW_KEY && action == GLFW_PRESS && g_shadowMap != nullptr)
+	{
+		int next = (static_cast<int>(g_shadowMap->GetQuality()) + 1) % static_cast<int>(ShadowQuality::Count);
+		g_shadowMap->SetQuality(static_cast<ShadowQuality>(next));
+		std::cout << "[SHADOW] Quality: " << ShadowMap::QualityName(g_shadowMap->GetQuality()) << std::endl;
+	}
 	if (key == EXIT_KEY && action == GLFW_PRESS)
 	{
 		glfwSetWindowShouldClose(window, GLFW_TRUE);
 	}
+	if (key == TRACE_DUMP_KEY && action == GLFW_PRESS && !traceFile.empty())
+	{
+		Tracer::WriteChromeTrace(traceFile);
+	}
+	if (key == SCREENSHOT_KEY && action == GLFW_PRESS && g_frameCapture != nullptr)
+	{
+		g_frameCapture->RequestScreenshot("screenshots/screenshot_" + std::to_string(screenshotCount++) + ".png");
+	}
+	if (key == RECORD_KEY && action == GLFW_PRESS && g_frameCapture != nullptr)
+	{
+		if (g_frameCapture->IsRecording())
+			g_frameCapture->Stop();
+		else
+			g_frameCapture->StartPngSequence("capture");
+	}
 	if (key == ANIMATION_KEY && action == GLFW_PRESS)
 	{
-		if (g_bilardModel != nullptr)
+		PostToSimulation([]()
+		{
+			if (g_bilardModel != nullptr)
+			{
+				g_bilardModel->TriggerOneShotAnimation();
+			}
+			// The clip restores the original ball transforms
+			if (g_billiardTable != nullptr && g_billiardTable->IsBound())
+			{
+				physicsActive = false;
+				replayShot = -1;
+				g_billiardTable->ResetRack();
+			}
+		});
+	}
+	if (key == SHOT_KEY && action == GLFW_PRESS && g_billiardTable != nullptr && g_billiardTable->IsBound())
+	{
+		PostToSimulation([]()
+		{
+			BilliardPhysics& physics = g_billiardTable->physics;
+			if (!physics.IsAtRest())
+				return;
+			// Aim the cue ball at the middle of the remaining balls
+			int cue = g_billiardTable->GetCueBall();
+			glm::vec2 cuePos(physics.balls.px[cue], physics.balls.pz[cue]);
+			glm::vec2 target(0.0f);
+			int targets = 0;
+			for (int i = 0; i < physics.balls.count; i++)
+			{
+				if (i != cue && physics.balls.phase[i] != BallPhase::Pocketed)
+				{
+					target += glm::vec2(physics.balls.px[i], physics.balls.pz[i]);
+					targets++;
+				}
+			}
+			if (targets > 0)
+			{
+				g_billiardTable->PlayShot(target / static_cast<float>(targets) - cuePos, SHOT_SPEED * g_billiardTable->GetWorldScale(), 0.2f, 0.0f);
+				physicsActive = true;
+				replayShot = -1;
+			}
+		});
+	}
+	if (key == AIM_KEY && action == GLFW_PRESS && g_shotEvaluator != nullptr && g_billiardTable != nullptr
+		&& g_billiardTable->IsBound())
+	{
+		// Random shots from the current table are tried in the background; the tick plays the best
+		PostToSimulation([]()
+		{
+			BilliardPhysics& physics = g_billiardTable->physics;
+			if (!physics.IsAtRest() || g_shotEvaluator->IsEvaluating())
+				return;
+			float scale = g_billiardTable->GetWorldScale();
+			ShotEvaluator::GenerateCandidates(AIM_CANDIDATES, AIM_MIN_SPEED * scale, AIM_MAX_SPEED * scale, aimSeed++, aimCandidates);
+			g_shotEvaluator->Begin(physics.table, physics.params, physics.balls, g_billiardTable->GetCueBall(),
+				aimCandidates, AIM_TOP_SHOTS);
+		});
+	}
+	if (key == PLAN_KEY && action == GLFW_PRESS && g_shotPlanner != nullptr && g_billiardTable != nullptr
+		&& g_billiardTable->IsBound())
+	{
+		// The AI opponent thinks in the background; the tick plays its shot once it is done
+		PostToSimulation([]()
+		{
+			BilliardPhysics& physics = g_billiardTable->physics;
+			if (!physics.IsAtRest() || g_shotPlanner->IsThinking())
+				return;
+			g_shotPlanner->Begin(physics.table, physics.params, physics.balls, g_billiardTable->GetCueBall(),
+				AIM_MAX_SPEED * g_billiardTable->GetWorldScale());
+		});
+	}
+	if (key == REPLAY_SAVE_KEY && action == GLFW_PRESS && g_billiardTable != nullptr && g_billiardTable->IsBound())
+	{
+		PostToSimulation([]()
 		{
-			g_bilardModel->TriggerOneShotAnimation();
-		}
+			g_billiardTable->replay.Save("replay_" + std::to_string(replayCount++) + ".bin");
+		});
+	}
+	if (key == REPLAY_KEY && action == GLFW_PRESS && g_billiardTable != nullptr && g_billiardTable->IsBound())
+	{
+		// Plays the shots of the log one after another from the first
+		PostToSimulation([]()
+		{
+			if (g_billiardTable->SeekReplay(0, 0.0))
+			{
+				replayShot = 0;
+				physicsActive = true;
+			}
+		});
 	}
 }
 
 
-int main()
+int main(int argc, char** argv)
 {
-    glfwInit();
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--trace" && i + 1 < argc)
+        {
+            traceFile = argv[++i];
+            Tracer::Enable(true);
+        }
+        else if (arg == "--record-pipe" && i + 1 < argc)
+        {
+            recordPipeCommand = argv[++i];
+        }
+        else if (arg == "--replay" && i + 1 < argc)
+        {
+            replayFile = argv[++i];
+        }
+        else if (arg == "--sim-rate" && i + 1 < argc)
+        {
+            simulationRate = std::max(std::atoi(argv[++i]), 1);
+        }
+        else if (arg == "--lamps" && i + 1 < argc)
+        {
+            hallLampCount = std::clamp(std::atoi(argv[++i]), 0, LightClusters::MAX_LIGHTS);
+        }
+        else if (arg == "--headless")
+        {
+            headless = true;
+        }
+        else
+        {
+            HeadlessRunner::ParseArgument(headlessOptions, i, argc, argv);
+        }
+    }
+
+    int renderWidth = headless ? headlessOptions.width : width;
+    int renderHeight = headless ? headlessOptions.height : height;
+    auto loadStart = std::chrono::steady_clock::now();
 
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    GLFWwindow* window = NULL;
+    HeadlessContext headlessContext;
+    if (headless)
+    {
+        if (!headlessContext.Create(renderWidth, renderHeight))
+        {
+            return -1;
+        }
+    }
+    else
+    {
+        glfwInit();
 
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 
-	GLFWmonitor* monitor = glfwGetPrimaryMonitor();
-    GLFWwindow* window = glfwCreateWindow(width, height, "JakubSputoOpenGL", monitor, NULL);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
-    if (window == NULL)
+        GLFWmonitor* monitor = glfwGetPrimaryMonitor();
+        window = glfwCreateWindow(width, height, "JakubSputoOpenGL", monitor, NULL);
+
+        if (window == NULL)
+        {
+            std::cout << "Failed to create GLFW window" << std::endl;
+            glfwTerminate();
+            return -1;
+        }
+
+        glfwMakeContextCurrent(window);
+        gladLoadGL();
+        GLRenderDevice::LoadExtensions(reinterpret_cast<GLADloadproc>(glfwGetProcAddress));
+    }
+    RenderDevice& device = RenderDevice::Get();
+    device.Viewport(0, 0, renderWidth, renderHeight);
+
+    // Every shader below is loaded from here when it was compiled before
+    ProgramCache programCache;
+    programCache.Load(PROGRAM_CACHE_PATH);
+    Shader::SetProgramCache(&programCache);
+
+    // Without KHR_parallel_shader_compile the builds go to a thread with the
+    // context of a hidden window, shared with this one
+    GLFWwindow* compileWindow = NULL;
+    ShaderCompileThread compileThread;
+    if (!headless && !device.SupportsParallelShaderCompile())
     {
-        std::cout << "Failed to create GLFW window" << std::endl;
-        glfwTerminate();
-        return -1;
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        compileWindow = glfwCreateWindow(1, 1, "JakubSputoOpenGL shaders", NULL, window);
+        if (compileWindow != NULL && compileThread.Start(
+            [compileWindow]() { glfwMakeContextCurrent(compileWindow); return true; },
+            []() { glfwMakeContextCurrent(NULL); }))
+        {
+            Shader::SetCompileThread(&compileThread);
+        }
     }
 
-    glfwMakeContextCurrent(window);
-    gladLoadGL();
-    glViewport(0, 0, width, height);
-
+    // Every variant the keys can pick is issued now and builds in the background
     Shader shaderProgram("default.vert", "default.frag");
+    shaderProgram.Precompile(SHADER_TEXTURED | SHADER_GRAYSCALE | SHADER_RAINBOW_LIGHT);
     
-    glEnable(GL_DEPTH_TEST);
-    glDepthFunc(GL_LESS);
-    glEnable(GL_CULL_FACE);
-    glCullFace(GL_BACK);
-    glFrontFace(GL_CCW);
+    device.Enable(GL_DEPTH_TEST);
+    device.DepthFunc(GL_LESS);
+    device.Enable(GL_CULL_FACE);
+    device.CullFace(GL_BACK);
+    device.FrontFace(GL_CCW);
 
 	//camera
-    Camera camera(width, height, CAMERA_START_POSITION);
+    Camera camera(renderWidth, renderHeight, CAMERA_START_POSITION);
 
 	camera.SetBounds(MIN_BOUNDS, MAX_BOUNDS);
 	camera.SetTableCollision(glm::vec3(0.0f, 0.0f, 0.0f), DIST_FROM_TABLE, 1.0f);     // Wczytanie modelu
@@ -156,14 +459,103 @@ int main()
     Model lampModel(lampPath, lampTransform);
     lampModel.SetDoubleSided(true); // Wyłączenie face culling dla lepszej widoczności od wewnątrz
 
-    bool playAnimation = false;
+    // Ball physics bound to the ball nodes of the table model
+    BilliardTable billiardTable;
+    billiardTable.Bind(bilardModel);
+    g_billiardTable = &billiardTable;
+    if (!replayFile.empty() && billiardTable.LoadReplay(replayFile) && billiardTable.SeekReplay(0, 0.0))
+    {
+        billiardTable.replay.PrintStats();
+        replayShot = 0;
+        physicsActive = true;
+    }
+    // Every mesh of the scene; the balls (and whatever the clip moves) are refit each frame
+    std::vector<int> ballNodes;
+    for (int ball = 0; ball < billiardTable.GetBallCount(); ball++)
+    {
+        ballNodes.push_back(billiardTable.GetBallNode(ball));
+    }
+    SceneBvh sceneBvh;
+    int tableInScene = sceneBvh.AddModel(bilardModel, ballNodes);
+    int lampInScene = sceneBvh.AddModel(lampModel);
+    sceneBvh.Build();
+    sceneBvh.PrintStats();
+    // Big meshes in view hide the rest from a small CPU depth buffer
+    OcclusionCuller occlusionCuller;
+    OcclusionStats occlusionTotals;
+
+    ShotEvaluator shotEvaluator;
+    g_shotEvaluator = &shotEvaluator;
+    ShotPlanner shotPlanner;
+    g_shotPlanner = &shotPlanner;
+#ifndef NDEBUG
+    // The vector kernels must match their scalar reference
+    bool kernelsMatch = BallKernels::VerifyAgainstScalar(256, 1);
+    if (!kernelsMatch)
+    {
+        std::cout << "[KERNELS] " << BallKernels::GetBackendName() << " kernels differ from the scalar reference" << std::endl;
+    }
+    assert(kernelsMatch);
+#endif
+
+    // One simulation tick: the glTF clip, then the physics over it. Runs on
+    // the simulation thread in the window and inline in a headless run.
+    std::vector<glm::mat4> simulationPose;
+    bilardModel.GetNodeLocalTransforms(simulationPose);
+    auto simulateTick = [&](float deltaTime, SimulationFrame& frame)
+    {
+        if (bilardModel.AdvanceAnimation(deltaTime))
+            bilardModel.SampleAnimation(simulationPose);
+
+        if (shotEvaluator.Poll(aimResults))
+        {
+            shotEvaluator.PrintStats();
+            float scale = billiardTable.GetWorldScale();
+            for (size_t i = 0; i < aimResults.size(); i++)
+            {
+                const ShotResult& result = aimResults[i];
+                std::cout << "[AIM] #" << i + 1 << " score " << result.score << ", pockets " << result.pocketed
+                          << (result.scratch ? ", scratch" : "") << (result.foul ? ", foul" : "")
+                          << ", speed " << result.shot.speed / scale << " m/s" << std::endl;
+            }
+            if (!aimResults.empty() && billiardTable.physics.IsAtRest())
+            {
+                const ShotCandidate& best = aimResults[0].shot;
+                billiardTable.PlayShot(best.direction, best.speed, best.follow, best.english);
+                physicsActive = true;
+                replayShot = -1;
+            }
+        }
+
+        PlannerResult plan;
+        if (shotPlanner.Poll(plan))
+        {
+            shotPlanner.PrintStats();
+            if (plan.depth > 0 && billiardTable.physics.IsAtRest())
+            {
+                billiardTable.PlayShot(plan.shot.direction, plan.shot.speed, plan.shot.follow, plan.shot.english);
+                physicsActive = true;
+                replayShot = -1;
+            }
+        }
+
+        if (physicsActive)
+        {
+            bool moving = billiardTable.AdvanceShot(deltaTime);
+            // A replay goes on with its next shot once this one has come to rest
+            if (!moving && replayShot >= 0)
+            {
+                replayShot = billiardTable.SeekReplay(replayShot + 1, 0.0) ? replayShot + 1 : -1;
+            }
+        }
+        frame.localTransforms = simulationPose;
+        frame.balls = billiardTable.physics.balls;
+        frame.ballsDriven = physicsActive;
+    };
+    SimulationThread simulation;
+    SimulationFrame renderState;
+    renderState.localTransforms = simulationPose;
 
-    // 60 FPS limiting
-    double prevTime = glfwGetTime();
-    double lastFrameTime = glfwGetTime();
-    const double targetFPS = 60.0;
-    const double targetFrameTime = 1.0 / targetFPS;
-    
     float rotation = 1.0f;
 
 	//skybox
@@ -182,8 +574,150 @@ int main()
     glm::vec3 lightPos(0.0, 6.0, 0.0);
     glm::vec3 lightColor(1.0, 1.0, 1.0);
 
+    // Shadows of the lamp's light; the lamp itself would shadow everything
+    ShadowMap shadowMap;
+    shadowMap.SetLight(lightPos, glm::vec3(0.0f, -1.0f, 0.0f), SHADOW_FOV, SHADOW_NEAR, SHADOW_FAR);
+    shadowMap.SetCaster(lampInScene, false);
+    if (!shadowMap.IsComplete())
+    {
+        std::cout << "[SHADOW] Framebuffer is incomplete, shadows are off" << std::endl;
+        shadowMap.SetQuality(ShadowQuality::Off);
+    }
+    g_shadowMap = &shadowMap;
+
+    // Further lamps in a square grid over the hall; each shades only the clusters it reaches
+    LightClusters lightClusters;
+    LightClusterStats clusterTotals;
+    std::vector<PointLight> hallLamps;
+    int hallColumns = static_cast<int>(std::ceil(std::sqrt(static_cast<float>(hallLampCount))));
+    for (int i = 0; i < hallLampCount; i++)
+    {
+        PointLight lamp;
+        lamp.position = glm::vec3((i % hallColumns - 0.5f * (hallColumns - 1)) * HALL_LAMP_SPACING, HALL_LAMP_HEIGHT,
+                                  (i / hallColumns - 0.5f * (hallColumns - 1)) * HALL_LAMP_SPACING);
+        lamp.radius = HALL_LAMP_RADIUS;
+        lamp.color = HALL_LAMP_COLOR;
+        hallLamps.push_back(lamp);
+    }
+    lightClusters.SetLights(hallLamps);
+
+    // Culling of the last frame and the sum over the run
+    CullStats frameCull;
+    CullStats cullTotals;
+    int cullFrames = 0;
+
+    // Draws everything for one frame; shared by the window loop and the headless run
+    auto renderFrame = [&](double currentTime, float deltaTime)
+    {
+		device.ClearColor(0.07f, 0.13f, 0.17f, 1.0f);
+		device.Clear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        shaderProgram.Activate();
+        shaderProgram.setInt("texture_diffuse1", 0); // 0 = GL_TEXTURE0
+        camera.Matrix(45.0f, 0.1f, 100.0f, shaderProgram, "camMatrix");
+
+        // Lighting settings
+        shaderProgram.SetVec3("camPos", camera.Position);
+        shaderProgram.SetVec3("lightPos", lightPos);
+        shaderProgram.SetVec3("lightColor", lightColor);
+        lightClusters.Update(camera.viewMatrix, camera.projectionMatrix);
+        lightClusters.Apply(shaderProgram, renderWidth, renderHeight);
+        clusterTotals.Add(lightClusters.GetStats());
+
+		// Filters pick the shader variants, the model picks textured or not per mesh
+		skybox.skyboxShader->SetRainbowLight(rainbowLightFilter, currentTime);
+		shaderProgram.SetRainbowLight(rainbowLightFilter, currentTime);
+
+		//turn on/off grayscale filter for both shaders
+		skybox.skyboxShader->SetGrayscale(grayscaleFilter);
+		shaderProgram.SetGrayscale(grayscaleFilter);
+
+        // Table transforms from the simulation thread, or one tick right here
+        if (simulation.IsRunning())
+        {
+            simulation.Sample(renderState);
+        }
+        else
+        {
+            simulateTick(std::min(deltaTime, MAX_PHYSICS_DELTA), renderState);
+        }
+        if (renderState.ballsDriven)
+        {
+            billiardTable.ApplyToTransforms(renderState.balls, renderState.localTransforms);
+        }
+        bilardModel.SetNodeLocalTransforms(renderState.localTransforms);
+        bilardModel.UpdateTransforms();
+        sceneBvh.Refit();
+        // Static casters once, the balls only when they moved
+        shadowMap.Update(sceneBvh);
+        shadowMap.Apply(shaderProgram);
+
+        sceneBvh.CullModels(camera.GetFrustum());
+        occlusionCuller.Cull(sceneBvh, camera.cameraMatrix);
+        occlusionTotals.Add(occlusionCuller.GetStats());
+        bilardModel.SelectLods(camera.Position, camera.projectionScale, LOD_PIXEL_ERROR);
+        lampModel.SelectLods(camera.Position, camera.projectionScale, LOD_PIXEL_ERROR);
+        bilardModel.Draw(shaderProgram, sceneBvh.GetVisibleNodes(tableInScene));
+        lampModel.Draw(shaderProgram, sceneBvh.GetVisibleNodes(lampInScene));
+        frameCull = bilardModel.GetCullStats();
+        frameCull.Add(lampModel.GetCullStats());
+        cullTotals.Add(frameCull);
+        cullFrames++;
+
+		skybox.Draw(camera, renderWidth, renderHeight);
+    };
+
+    if (headless)
+    {
+        double loadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - loadStart).count();
+        int result = HeadlessRunner::Run(headlessOptions, headlessContext.GetBackendName(), loadMs, camera, renderFrame);
+        PrintCullStats(cullTotals, cullFrames);
+        PrintOcclusionStats(occlusionTotals, cullFrames);
+        shadowMap.PrintStats();
+        PrintClusterStats(clusterTotals, cullFrames);
+        sceneBvh.PrintStats();
+
+        shadowMap.Delete();
+        lightClusters.Delete();
+        shaderProgram.Delete();
+        skybox.Delete();
+        // Deleting the shaders finished their pending builds
+        Shader::PrintCompileStats();
+        if (programCache.IsDirty())
+        {
+            programCache.Save(PROGRAM_CACHE_PATH);
+        }
+        Shader::SetProgramCache(nullptr);
+
+        if (!traceFile.empty())
+        {
+            Tracer::WriteChromeTrace(traceFile);
+        }
+        return result;
+    }
+
+    // 60 FPS limiting
+    double prevTime = glfwGetTime();
+    double lastFrameTime = glfwGetTime();
+    const double targetFPS = 60.0;
+    const double targetFrameTime = 1.0 / targetFPS;
+    
+    FrameCapture frameCapture(width, height);
+    g_frameCapture = &frameCapture;
+    if (!recordPipeCommand.empty())
+    {
+        frameCapture.StartRawPipe(recordPipeCommand);
+    }
+
+    simulation.Start(simulationRate, renderState, simulateTick);
+    g_simulation = &simulation;
     glfwSetKeyCallback(window, keyCallback);
 
+    // Mesh under the cursor, highlighted on hover
+    double lastCursorX = -1.0;
+    double lastCursorY = -1.0;
+    bool pickHeld = false;
+
 	while (!glfwWindowShouldClose(window))
 	{
         // 60 FPS frame rate limiting
@@ -197,53 +731,84 @@ int main()
             currentFrameTime = glfwGetTime();
         }
         lastFrameTime = currentFrameTime;
-        
-		glClearColor(0.07f, 0.13f, 0.17f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        shaderProgram.Activate();
-        shaderProgram.setInt("texture_diffuse1", 0); // 0 = GL_TEXTURE0
 
         double currentTime = glfwGetTime();
         float deltaTime = static_cast<float>(currentTime - prevTime);
-        prevTime = currentTime;        camera.Inputs(window, deltaTime);
-        camera.Matrix(45.0f, 0.1f, 100.0f, shaderProgram, "camMatrix");
-
-
-        // Lighting settings
-        glUniform3f(glGetUniformLocation(shaderProgram.ID, "camPos"), camera.Position.x, camera.Position.y, camera.Position.z);
-        glUniform3f(glGetUniformLocation(shaderProgram.ID, "lightPos"), lightPos.x, lightPos.y, lightPos.z);
-        glUniform3f(glGetUniformLocation(shaderProgram.ID, "lightColor"), lightColor.x, lightColor.y, lightColor.z);
-        glUniform1f(glGetUniformLocation(shaderProgram.ID, "time"), currentTime);
-        glUniform1i(glGetUniformLocation(shaderProgram.ID, "enableRainbowLight"), rainbowLightFilter ? 1 : 0);
-
-		skybox.skyboxShader->SetRainbowLight(rainbowLightFilter, currentTime);
-
-		//turn on/off grayscale filter for both shaders
-		skybox.skyboxShader->SetGrayscale(grayscaleFilter);
-		shaderProgram.SetGrayscale(grayscaleFilter);
-
-
-        static double lastDebugTime = 0.0;
-        if (currentTime - lastDebugTime >= 1.0)
-            lastDebugTime = currentTime; // Update animation based on playAnimation state or one-shot animation
-        if (playAnimation || bilardModel.IsAnimationPlaying())
-            bilardModel.UpdateAnimation(deltaTime);
-        else
-            bilardModel.UpdateAnimation(0.0f);
-
-        bilardModel.Draw(shaderProgram);
-        lampModel.Draw(shaderProgram);
+        prevTime = currentTime;
+        camera.Inputs(window, deltaTime);
+
+        double cursorX, cursorY;
+        glfwGetCursorPos(window, &cursorX, &cursorY);
+        bool pickPressed = glfwGetMouseButton(window, PICK_BUTTON) == GLFW_PRESS;
+        if (cursorX != lastCursorX || cursorY != lastCursorY || (pickPressed && !pickHeld))
+        {
+            auto pickStart = std::chrono::steady_clock::now();
+            glm::vec3 rayOrigin, rayDirection;
+            camera.CursorRay(cursorX, cursorY, rayOrigin, rayDirection);
+            ScenePick pick;
+            bool picked = sceneBvh.Pick(rayOrigin, rayDirection, PICK_DISTANCE, pick);
+            bilardModel.SetHighlightNode(picked && pick.model == tableInScene ? pick.node : -1);
+            lampModel.SetHighlightNode(picked && pick.model == lampInScene ? pick.node : -1);
+            if (pickPressed && !pickHeld && picked)
+            {
+                const Model& model = sceneBvh.GetModel(pick.model);
+                double pickMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - pickStart).count();
+                std::cout << "[PICK] " << model.GetNode(pick.node).name << " (node " << pick.node << ", mesh " << pick.mesh
+                          << ", triangle " << pick.triangle << ") at " << pick.point.x << ", " << pick.point.y << ", "
+                          << pick.point.z << " in " << pickMs << " ms" << std::endl;
+            }
+            lastCursorX = cursorX;
+            lastCursorY = cursorY;
+        }
+        pickHeld = pickPressed;
 
-		skybox.Draw(camera, width, height);
+        renderFrame(currentTime, deltaTime);
+        // Reads back the back buffer asynchronously when recording or a screenshot is pending
+        frameCapture.CaptureFrame();
 
 		glfwSwapBuffers(window);
 		glfwPollEvents();
 	}
 
+	g_simulation = nullptr;
+	simulation.Stop();
+	simulation.PrintStats();
+	PrintCullStats(cullTotals, cullFrames);
+	PrintOcclusionStats(occlusionTotals, cullFrames);
+	shadowMap.PrintStats();
+	PrintClusterStats(clusterTotals, cullFrames);
+	sceneBvh.PrintStats();
+
+	if (frameCapture.GetStats().framesIssued > 0)
+	{
+		frameCapture.PrintStats();
+	}
+	frameCapture.Delete();
+	g_frameCapture = nullptr;
+	g_shadowMap = nullptr;
+	shadowMap.Delete();
+	lightClusters.Delete();
 	shaderProgram.Delete();
 	skybox.Delete();
+	compileThread.Stop();
+	Shader::SetCompileThread(nullptr);
+	// Deleting the shaders finished their pending builds
+	Shader::PrintCompileStats();
+	if (programCache.IsDirty())
+	{
+		programCache.Save(PROGRAM_CACHE_PATH);
+	}
+	Shader::SetProgramCache(nullptr);
 
+	if (!traceFile.empty())
+	{
+		Tracer::WriteChromeTrace(traceFile);
+	}
+
+	if (compileWindow != NULL)
+	{
+		glfwDestroyWindow(compileWindow);
+	}
 	glfwDestroyWindow(window);
 	glfwTerminate();
 	return 0;
@@ -0,0 +1,417 @@
+#include"MeshSimplifier.h"
+#include<algorithm>
+#include<cmath>
+#include<cstring>
+#include<fstream>
+#include<iostream>
+#include<iterator>
+#include<limits>
+#include<unordered_map>
+
+namespace
+{
+	const uint32_t LOD_MAGIC = 0x444F4C42;   // "BLOD" read as little-endian bytes
+	const uint64_t FNV_OFFSET = 1469598103934665603ull;
+	const uint64_t FNV_PRIME = 1099511628211ull;
+	const double MIN_FLIP_COSINE = 0.2;      // new triangle normals may turn at most ~78 degrees
+
+	// Symmetric 4x4 error matrix of a set of planes: the sum of squared
+	// distances of a point to them, weighted by triangle area
+	struct Quadric
+	{
+		double xx = 0.0, xy = 0.0, xz = 0.0, yy = 0.0, yz = 0.0, zz = 0.0;
+		double x = 0.0, y = 0.0, z = 0.0, constant = 0.0;
+		double weight = 0.0;
+
+		void AddPlane(glm::dvec3 normal, double distance, double area)
+		{
+			xx += area * normal.x * normal.x;
+			xy += area * normal.x * normal.y;
+			xz += area * normal.x * normal.z;
+			yy += area * normal.y * normal.y;
+			yz += area * normal.y * normal.z;
+			zz += area * normal.z * normal.z;
+			x += area * normal.x * distance;
+			y += area * normal.y * distance;
+			z += area * normal.z * distance;
+			constant += area * distance * distance;
+			weight += area;
+		}
+
+		void Add(const Quadric& other)
+		{
+			xx += other.xx; xy += other.xy; xz += other.xz;
+			yy += other.yy; yz += other.yz; zz += other.zz;
+			x += other.x; y += other.y; z += other.z;
+			constant += other.constant;
+			weight += other.weight;
+		}
+
+		double Evaluate(glm::dvec3 p) const
+		{
+			return xx * p.x * p.x + yy * p.y * p.y + zz * p.z * p.z
+				+ 2.0 * (xy * p.x * p.y + xz * p.x * p.z + yz * p.y * p.z)
+				+ 2.0 * (x * p.x + y * p.y + z * p.z) + constant;
+		}
+	};
+
+	struct Collapse
+	{
+		unsigned int from;
+		unsigned int to;
+		double cost;   // squared distance
+	};
+
+	struct PositionHash
+	{
+		size_t operator()(const glm::vec3& p) const
+		{
+			uint32_t bits[3];
+			static_assert(sizeof(bits) == sizeof(glm::vec3), "glm::vec3 must be three floats");
+			std::memcpy(bits, &p, sizeof(bits));
+			return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+		}
+	};
+
+	template<class T>
+	void Put(std::vector<uint8_t>& out, const T& value)
+	{
+		const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+		out.insert(out.end(), bytes, bytes + sizeof(T));
+	}
+
+	struct Reader
+	{
+		const std::vector<uint8_t>& data;
+		size_t offset = 0;
+
+		template<class T>
+		bool Get(T& value)
+		{
+			if (offset + sizeof(T) > data.size())
+				return false;
+			std::memcpy(&value, data.data() + offset, sizeof(T));
+			offset += sizeof(T);
+			return true;
+		}
+	};
+
+	uint64_t Fnv(uint64_t hash, const void* data, size_t size)
+	{
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		for (size_t i = 0; i < size; i++) {
+			hash = (hash ^ bytes[i]) * FNV_PRIME;
+		}
+		return hash;
+	}
+
+	glm::dvec3 TriangleNormal(glm::vec3 a, glm::vec3 b, glm::vec3 c)
+	{
+		return glm::cross(glm::dvec3(b) - glm::dvec3(a), glm::dvec3(c) - glm::dvec3(a));
+	}
+}
+
+float MeshSimplifier::Simplify(const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& indices,
+	size_t targetIndexCount, float maxError, std::vector<unsigned int>& result)
+{
+	result.assign(indices.begin(), indices.end() - indices.size() % 3);
+	size_t vertexCount = positions.size();
+
+	// Seams: the first vertex of every position, locked when it is shared
+	std::vector<unsigned int> welded(vertexCount);
+	std::vector<uint8_t> locked(vertexCount, 0);
+	{
+		std::unordered_map<glm::vec3, unsigned int, PositionHash> first;
+		first.reserve(vertexCount);
+		for (unsigned int v = 0; v < vertexCount; v++) {
+			auto inserted = first.emplace(positions[v], v);
+			welded[v] = inserted.first->second;
+			if (!inserted.second) {
+				locked[v] = 1;
+				locked[welded[v]] = 1;
+			}
+		}
+	}
+	// Borders: edges of welded positions used by one triangle only
+	{
+		std::unordered_map<uint64_t, int> edgeUses;
+		edgeUses.reserve(result.size());
+		for (size_t i = 0; i < result.size(); i++) {
+			unsigned int a = welded[result[i]];
+			unsigned int b = welded[result[i - i % 3 + (i + 1) % 3]];
+			edgeUses[(static_cast<uint64_t>(std::min(a, b)) << 32) | std::max(a, b)]++;
+		}
+		for (size_t i = 0; i < result.size(); i++) {
+			unsigned int a = result[i];
+			unsigned int b = result[i - i % 3 + (i + 1) % 3];
+			uint64_t key = (static_cast<uint64_t>(std::min(welded[a], welded[b])) << 32) | std::max(welded[a], welded[b]);
+			if (edgeUses[key] == 1) {
+				locked[a] = 1;
+				locked[b] = 1;
+			}
+		}
+	}
+
+	std::vector<Quadric> quadrics(vertexCount);
+	for (size_t i = 0; i + 2 < result.size(); i += 3) {
+		glm::dvec3 normal = TriangleNormal(positions[result[i]], positions[result[i + 1]], positions[result[i + 2]]);
+		double length = glm::length(normal);
+		if (length <= 0.0)
+			continue;
+		normal /= length;
+		double distance = -glm::dot(normal, glm::dvec3(positions[result[i]]));
+		for (int k = 0; k < 3; k++) {
+			quadrics[result[i + k]].AddPlane(normal, distance, 0.5 * length);
+		}
+	}
+
+	double maxCost = static_cast<double>(maxError) * maxError;
+	double reached = 0.0;
+	std::vector<Collapse> collapses;
+	std::vector<unsigned int> remap(vertexCount);
+	std::vector<uint8_t> touched(vertexCount);
+	std::vector<int> firstTriangle(vertexCount + 1);
+	std::vector<int> vertexTriangles;
+	while (result.size() > targetIndexCount) {
+		// Triangles around every vertex
+		int triangleCount = static_cast<int>(result.size() / 3);
+		std::fill(firstTriangle.begin(), firstTriangle.end(), 0);
+		for (unsigned int v : result) {
+			firstTriangle[v + 1]++;
+		}
+		for (size_t v = 1; v <= vertexCount; v++) {
+			firstTriangle[v] += firstTriangle[v - 1];
+		}
+		vertexTriangles.resize(result.size());
+		std::vector<int> fill(firstTriangle.begin(), firstTriangle.end() - 1);
+		for (int t = 0; t < triangleCount; t++) {
+			for (int k = 0; k < 3; k++) {
+				vertexTriangles[fill[result[3 * t + k]]++] = t;
+			}
+		}
+
+		collapses.clear();
+		for (int t = 0; t < triangleCount; t++) {
+			for (int k = 0; k < 3; k++) {
+				unsigned int from = result[3 * t + k];
+				unsigned int to = result[3 * t + (k + 1) % 3];
+				if (locked[from])
+					continue;
+				Quadric merged = quadrics[from];
+				merged.Add(quadrics[to]);
+				double cost = merged.Evaluate(glm::dvec3(positions[to])) / std::max(merged.weight, 1e-30);
+				collapses.push_back({ from, to, std::max(cost, 0.0) });
+			}
+		}
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.cost < b.cost; });
+
+		for (unsigned int v = 0; v < vertexCount; v++) {
+			remap[v] = v;
+		}
+		std::fill(touched.begin(), touched.end(), 0);
+		// Every collapse takes about two triangles with it
+		size_t removable = (result.size() - targetIndexCount) / 3;
+		size_t removed = 0;
+		int collapsed = 0;
+		for (const Collapse& collapse : collapses) {
+			// Cheaper ones skipped here come back in the next pass
+			if (removed >= removable || collapse.cost > maxCost)
+				break;
+			if (touched[collapse.from] || touched[collapse.to])
+				continue;
+
+			bool flips = false;
+			for (int i = firstTriangle[collapse.from]; i < firstTriangle[collapse.from + 1] && !flips; i++) {
+				const unsigned int* corner = &result[3 * vertexTriangles[i]];
+				if (corner[0] == collapse.to || corner[1] == collapse.to || corner[2] == collapse.to)
+					continue;
+				glm::vec3 moved[3];
+				for (int k = 0; k < 3; k++) {
+					moved[k] = positions[corner[k] == collapse.from ? collapse.to : corner[k]];
+				}
+				glm::dvec3 before = TriangleNormal(positions[corner[0]], positions[corner[1]], positions[corner[2]]);
+				glm::dvec3 after = TriangleNormal(moved[0], moved[1], moved[2]);
+				double lengths = glm::length(before) * glm::length(after);
+				flips = lengths <= 0.0 || glm::dot(before, after) < MIN_FLIP_COSINE * lengths;
+			}
+			if (flips)
+				continue;
+
+			// The triangles around the collapse change; their vertices wait for the next pass
+			for (int i = firstTriangle[collapse.from]; i < firstTriangle[collapse.from + 1]; i++) {
+				const unsigned int* corner = &result[3 * vertexTriangles[i]];
+				touched[corner[0]] = 1;
+				touched[corner[1]] = 1;
+				touched[corner[2]] = 1;
+			}
+			remap[collapse.from] = collapse.to;
+			quadrics[collapse.to].Add(quadrics[collapse.from]);
+			reached = std::max(reached, collapse.cost);
+			removed += 2;
+			collapsed++;
+		}
+		if (collapsed == 0)
+			break;
+
+		size_t kept = 0;
+		for (size_t i = 0; i + 2 < result.size(); i += 3) {
+			unsigned int a = remap[result[i]];
+			unsigned int b = remap[result[i + 1]];
+			unsigned int c = remap[result[i + 2]];
+			if (a == b || b == c || a == c)
+				continue;
+			result[kept++] = a;
+			result[kept++] = b;
+			result[kept++] = c;
+		}
+		result.resize(kept);
+	}
+	return static_cast<float>(std::sqrt(reached));
+}
+
+void MeshSimplifier::BuildLods(const std::vector<glm::vec3>& positions, std::vector<unsigned int>& indices, int indexCount,
+	std::vector<MeshLod>& lods)
+{
+	lods.clear();
+	MeshLod full;
+	full.indexCount = indexCount;
+	lods.push_back(full);
+	if (indexCount < 3 * MIN_TRIANGLES || indexCount > static_cast<int>(indices.size()))
+		return;
+
+	std::vector<unsigned int> source(indices.begin(), indices.begin() + indexCount);
+	glm::vec3 boundsMin(std::numeric_limits<float>::max());
+	glm::vec3 boundsMax(-std::numeric_limits<float>::max());
+	for (unsigned int v : source) {
+		if (v >= positions.size())
+			return;
+		boundsMin = glm::min(boundsMin, positions[v]);
+		boundsMax = glm::max(boundsMax, positions[v]);
+	}
+	float maxError = MAX_RELATIVE_ERROR * 0.5f * glm::length(boundsMax - boundsMin);
+
+	std::vector<unsigned int> simplified;
+	while (static_cast<int>(lods.size()) < MAX_LODS) {
+		size_t target = static_cast<size_t>(source.size() / 3 * LEVEL_RATIO) * 3;
+		float error = Simplify(positions, source, target, maxError, simplified);
+		if (simplified.empty() || simplified.size() > source.size() * (1.0f - MIN_SAVING))
+			break;
+		// Each level starts from the one before, so their errors add up
+		MeshLod lod;
+		lod.firstIndex = static_cast<int>(indices.size());
+		lod.indexCount = static_cast<int>(simplified.size());
+		lod.error = lods.back().error + error;
+		indices.insert(indices.end(), simplified.begin(), simplified.end());
+		lods.push_back(lod);
+		source.swap(simplified);
+	}
+}
+
+uint64_t LodCache::Key(const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& indices, int indexCount)
+{
+	uint64_t hash = Fnv(FNV_OFFSET, &FORMAT_VERSION, sizeof(FORMAT_VERSION));
+	hash = Fnv(hash, positions.data(), positions.size() * sizeof(glm::vec3));
+	return Fnv(hash, indices.data(), std::min<size_t>(indexCount, indices.size()) * sizeof(unsigned int));
+}
+
+bool LodCache::Load(const std::string& path)
+{
+	entries.clear();
+	dirty = false;
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+	std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	Reader reader{ bytes };
+	uint32_t magic = 0, version = 0, count = 0;
+	bool ok = reader.Get(magic) && magic == LOD_MAGIC && reader.Get(version) && version == FORMAT_VERSION && reader.Get(count);
+	for (uint32_t e = 0; ok && e < count; e++) {
+		Entry entry;
+		uint32_t levels = 0;
+		ok = reader.Get(entry.key) && reader.Get(levels) && levels < MeshSimplifier::MAX_LODS;
+		int total = 0;
+		for (uint32_t l = 0; ok && l < levels; l++) {
+			MeshLod lod;
+			uint32_t indexCount = 0;
+			ok = reader.Get(indexCount) && reader.Get(lod.error) && indexCount % 3 == 0 && indexCount <= bytes.size();
+			lod.firstIndex = total;
+			lod.indexCount = static_cast<int>(indexCount);
+			total += lod.indexCount;
+			entry.lods.push_back(lod);
+		}
+		ok = ok && reader.offset + static_cast<size_t>(total) * sizeof(unsigned int) <= bytes.size();
+		if (ok) {
+			entry.indices.resize(total);
+			for (int i = 0; i < total; i++) {
+				reader.Get(entry.indices[i]);
+			}
+			entries.push_back(std::move(entry));
+		}
+	}
+	if (!ok) {
+		std::cout << "[LOD] Ignoring " << path << ", not a LOD cache of this version" << std::endl;
+		entries.clear();
+	}
+	return ok;
+}
+
+bool LodCache::Save(const std::string& path) const
+{
+	std::vector<uint8_t> bytes;
+	Put(bytes, LOD_MAGIC);
+	Put(bytes, FORMAT_VERSION);
+	Put(bytes, static_cast<uint32_t>(entries.size()));
+	for (const Entry& entry : entries) {
+		Put(bytes, entry.key);
+		Put(bytes, static_cast<uint32_t>(entry.lods.size()));
+		for (const MeshLod& lod : entry.lods) {
+			Put(bytes, static_cast<uint32_t>(lod.indexCount));
+			Put(bytes, lod.error);
+		}
+		for (unsigned int index : entry.indices) {
+			Put(bytes, static_cast<uint32_t>(index));
+		}
+	}
+	std::ofstream file(path, std::ios::binary);
+	if (!file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size())) {
+		std::cout << "[LOD] Could not write " << path << std::endl;
+		return false;
+	}
+	std::cout << "[LOD] Saved " << entries.size() << " meshes to " << path << " (" << bytes.size() << " bytes)" << std::endl;
+	return true;
+}
+
+bool LodCache::Find(uint64_t key, size_t vertexCount, std::vector<unsigned int>& indices, std::vector<MeshLod>& lods) const
+{
+	for (const Entry& entry : entries) {
+		if (entry.key != key)
+			continue;
+		for (unsigned int index : entry.indices) {
+			if (index >= vertexCount)
+				return false;
+		}
+		int base = static_cast<int>(indices.size());
+		indices.insert(indices.end(), entry.indices.begin(), entry.indices.end());
+		for (MeshLod lod : entry.lods) {
+			lod.firstIndex += base;
+			lods.push_back(lod);
+		}
+		return true;
+	}
+	return false;
+}
+
+void LodCache::Store(uint64_t key, const std::vector<unsigned int>& indices, const std::vector<MeshLod>& lods)
+{
+	Entry entry;
+	entry.key = key;
+	for (size_t l = 1; l < lods.size(); l++) {
+		MeshLod lod = lods[l];
+		lod.firstIndex = static_cast<int>(entry.indices.size());
+		entry.indices.insert(entry.indices.end(), indices.begin() + lods[l].firstIndex,
+			indices.begin() + lods[l].firstIndex + lods[l].indexCount);
+		entry.lods.push_back(lod);
+	}
+	entries.push_back(std::move(entry));
+	dirty = true;
+}
@@ -0,0 +1,86 @@
+#ifndef MESH_SIMPLIFIER_CLASS_H
+#define MESH_SIMPLIFIER_CLASS_H
+
+#include<cstdint>
+#include<string>
+#include<vector>
+#include<glm/glm.hpp>
+
+// One level of detail of a mesh: a range of its index buffer, drawn with
+// the mesh's own vertex buffer
+struct MeshLod
+{
+	int firstIndex = 0;
+	int indexCount = 0;
+	float error = 0.0f;   // how far the surface may lie from the full mesh, in local units
+};
+
+// Quadric error metric simplification (Garland and Heckbert) by half-edge
+// collapses: a vertex only ever moves onto a neighbour, so every level
+// indexes the original vertices and shares their buffer. Each pass sorts
+// the edges by the error their collapse would add and collapses the
+// cheapest ones that touch no vertex collapsed in the same pass, skipping
+// any that would flip a triangle.
+//
+// Vertices on open edges and on attribute seams (one position, several
+// vertices) stay where they are, so borders keep their shape and textures
+// do not stretch.
+class MeshSimplifier
+{
+public:
+	static const int MAX_LODS = 4;                       // including the full mesh
+	static const int MIN_TRIANGLES = 64;                 // smaller meshes get no levels
+	static constexpr float LEVEL_RATIO = 0.5f;           // triangles of a level over the one before
+	static constexpr float MIN_SAVING = 0.15f;           // a level must drop this much to be kept
+	static constexpr float MAX_RELATIVE_ERROR = 0.05f;   // of the mesh's radius
+
+	// Collapses edges of the triangles in indices until at most
+	// targetIndexCount indices are left, or the next collapse would move the
+	// surface further than maxError. Returns the largest error collapsed.
+	static float Simplify(const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& indices,
+		size_t targetIndexCount, float maxError, std::vector<unsigned int>& result);
+
+	// Levels from the first indexCount indices: lods[0] is that range, each
+	// further level is appended to indices
+	static void BuildLods(const std::vector<glm::vec3>& positions, std::vector<unsigned int>& indices, int indexCount,
+		std::vector<MeshLod>& lods);
+};
+
+// LOD chains of a model's meshes on disk, so BuildLods runs once per model
+// rather than at every start. A mesh is found by a hash of its positions
+// and indices, so an edited model simply misses and is rebuilt.
+//
+// The binary file is little-endian:
+//   header   magic "BLOD", version, mesh count
+//   meshes   key u64, level count, per level index count and error, indices
+class LodCache
+{
+public:
+	static constexpr uint32_t FORMAT_VERSION = 1;
+
+	static uint64_t Key(const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& indices, int indexCount);
+
+	// False, leaving the cache empty, when the file is missing or not a cache
+	bool Load(const std::string& path);
+	bool Save(const std::string& path) const;
+	bool IsDirty() const { return dirty; }
+
+	// Appends the stored levels past the full mesh to indices and lods, as
+	// BuildLods would; false when the key is not stored or an index is not
+	// below vertexCount
+	bool Find(uint64_t key, size_t vertexCount, std::vector<unsigned int>& indices, std::vector<MeshLod>& lods) const;
+	void Store(uint64_t key, const std::vector<unsigned int>& indices, const std::vector<MeshLod>& lods);
+
+private:
+	struct Entry
+	{
+		uint64_t key = 0;
+		std::vector<MeshLod> lods;          // firstIndex into indices below
+		std::vector<unsigned int> indices;
+	};
+
+	std::vector<Entry> entries;
+	bool dirty = false;
+};
+
+#endif
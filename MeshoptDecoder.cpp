@@ -0,0 +1,726 @@
+#include "MeshoptDecoder.h"
+#include "Tracer.h"
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MESHOPT_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	const unsigned char kVertexHeader = 0xa0;
+	const unsigned char kIndexHeader = 0xe0;
+	const unsigned char kSequenceHeader = 0xd0;
+
+	const size_t kVertexBlockSizeBytes = 8192;
+	const size_t kVertexBlockMaxSize = 256;
+	const size_t kByteGroupSize = 16;
+	const size_t kByteGroupDecodeLimit = 24;
+	const size_t kTailMaxSize = 32;
+
+	size_t getVertexBlockSize(size_t vertexSize)
+	{
+		// Block has to fit into the 8 KB budget and be a multiple of a byte group
+		size_t result = kVertexBlockSizeBytes / vertexSize;
+		result &= ~(kByteGroupSize - 1);
+		return (result < kVertexBlockMaxSize) ? result : kVertexBlockMaxSize;
+	}
+
+	// Decodes 16 values packed with 0, 2, 4 or 8 bits each; values equal to the
+	// maximum of the bit width are escapes and are read from the trailing bytes
+	const unsigned char* decodeBytesGroup(const unsigned char* data, unsigned char* buffer, int bitslog2)
+	{
+		switch (bitslog2)
+		{
+		case 0:
+			memset(buffer, 0, kByteGroupSize);
+			return data;
+		case 1:
+		case 2:
+		{
+			const int bits = 1 << bitslog2;
+			const int perByte = 8 / bits;
+			const unsigned char escape = static_cast<unsigned char>((1 << bits) - 1);
+			const unsigned char* dataVar = data + kByteGroupSize / perByte;
+
+			for (size_t i = 0; i < kByteGroupSize / perByte; i++)
+			{
+				unsigned char byte = data[i];
+				for (int j = 0; j < perByte; j++)
+				{
+					unsigned char enc = static_cast<unsigned char>(byte >> (8 - bits));
+					byte = static_cast<unsigned char>(byte << bits);
+					*buffer++ = (enc == escape) ? *dataVar : enc;
+					dataVar += (enc == escape);
+				}
+			}
+			return dataVar;
+		}
+		default:
+			memcpy(buffer, data, kByteGroupSize);
+			return data + kByteGroupSize;
+		}
+	}
+
+	const unsigned char* decodeBytes(const unsigned char* data, const unsigned char* dataEnd, unsigned char* buffer, size_t bufferSize)
+	{
+		const unsigned char* header = data;
+
+		// 2 bits of header per group, rounded up to whole bytes
+		size_t headerSize = (bufferSize / kByteGroupSize + 3) / 4;
+		if (static_cast<size_t>(dataEnd - data) < headerSize) {
+			return nullptr;
+		}
+		data += headerSize;
+
+		for (size_t i = 0; i < bufferSize; i += kByteGroupSize)
+		{
+			if (static_cast<size_t>(dataEnd - data) < kByteGroupDecodeLimit) {
+				return nullptr;
+			}
+			size_t headerOffset = i / kByteGroupSize;
+			int bitslog2 = (header[headerOffset / 4] >> ((headerOffset % 4) * 2)) & 3;
+			data = decodeBytesGroup(data, buffer + i, bitslog2);
+		}
+		return data;
+	}
+
+	// Turns one decoded byte channel (zigzag deltas) back into vertex bytes
+	void decodeDeltas(const unsigned char* deltas, unsigned char* vertexData, size_t vertexCount, size_t vertexSize, unsigned char& last)
+	{
+		unsigned char p = last;
+		size_t i = 0;
+
+#ifdef MESHOPT_SSE2
+		const __m128i one = _mm_set1_epi8(1);
+		const __m128i lowBits = _mm_set1_epi8(0x7f);
+		alignas(16) unsigned char decoded[kByteGroupSize];
+
+		for (; i + kByteGroupSize <= vertexCount; i += kByteGroupSize)
+		{
+			__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(deltas + i));
+
+			// unzigzag: (0 - (v & 1)) ^ (v >> 1)
+			__m128i sign = _mm_sub_epi8(_mm_setzero_si128(), _mm_and_si128(v, one));
+			__m128i half = _mm_and_si128(_mm_srli_epi16(v, 1), lowBits);
+			__m128i d = _mm_xor_si128(sign, half);
+
+			// inclusive prefix sum over 16 lanes, then add the running value
+			d = _mm_add_epi8(d, _mm_slli_si128(d, 1));
+			d = _mm_add_epi8(d, _mm_slli_si128(d, 2));
+			d = _mm_add_epi8(d, _mm_slli_si128(d, 4));
+			d = _mm_add_epi8(d, _mm_slli_si128(d, 8));
+			d = _mm_add_epi8(d, _mm_set1_epi8(static_cast<char>(p)));
+
+			_mm_store_si128(reinterpret_cast<__m128i*>(decoded), d);
+			for (size_t j = 0; j < kByteGroupSize; j++) {
+				vertexData[(i + j) * vertexSize] = decoded[j];
+			}
+			p = decoded[kByteGroupSize - 1];
+		}
+#endif
+
+		for (; i < vertexCount; i++)
+		{
+			unsigned char v = deltas[i];
+			unsigned char d = static_cast<unsigned char>((0 - (v & 1)) ^ (v >> 1));
+			p = static_cast<unsigned char>(p + d);
+			vertexData[i * vertexSize] = p;
+		}
+		last = p;
+	}
+
+	const unsigned char* decodeVertexBlock(const unsigned char* data, const unsigned char* dataEnd, unsigned char* vertexData,
+		size_t vertexCount, size_t vertexSize, unsigned char lastVertex[256])
+	{
+		unsigned char buffer[kVertexBlockMaxSize];
+		size_t vertexCountAligned = (vertexCount + kByteGroupSize - 1) & ~(kByteGroupSize - 1);
+
+		for (size_t k = 0; k < vertexSize; k++)
+		{
+			data = decodeBytes(data, dataEnd, buffer, vertexCountAligned);
+			if (!data) {
+				return nullptr;
+			}
+			decodeDeltas(buffer, vertexData + k, vertexCount, vertexSize, lastVertex[k]);
+		}
+		return data;
+	}
+
+	unsigned int decodeVByte(const unsigned char*& data)
+	{
+		unsigned char lead = *data++;
+		if (lead < 128) {
+			return lead;
+		}
+
+		// 7 bits per byte, little endian groups, at most 5 bytes
+		unsigned int result = lead & 127;
+		unsigned int shift = 7;
+		for (int i = 0; i < 4; i++)
+		{
+			unsigned char group = *data++;
+			result |= static_cast<unsigned int>(group & 127) << shift;
+			shift += 7;
+			if (group < 128) {
+				break;
+			}
+		}
+		return result;
+	}
+
+	unsigned int decodeIndex(const unsigned char*& data, unsigned int last)
+	{
+		unsigned int v = decodeVByte(data);
+		unsigned int d = (v >> 1) ^ -static_cast<int>(v & 1);
+		return last + d;
+	}
+
+	void writeIndex(void* destination, size_t offset, size_t indexSize, unsigned int value)
+	{
+		if (indexSize == 2) {
+			static_cast<unsigned short*>(destination)[offset] = static_cast<unsigned short>(value);
+		} else {
+			static_cast<unsigned int*>(destination)[offset] = value;
+		}
+	}
+
+	void writeTriangle(void* destination, size_t offset, size_t indexSize, unsigned int a, unsigned int b, unsigned int c)
+	{
+		writeIndex(destination, offset + 0, indexSize, a);
+		writeIndex(destination, offset + 1, indexSize, b);
+		writeIndex(destination, offset + 2, indexSize, c);
+	}
+
+	void pushEdgeFifo(unsigned int fifo[16][2], unsigned int a, unsigned int b, size_t& offset)
+	{
+		fifo[offset][0] = a;
+		fifo[offset][1] = b;
+		offset = (offset + 1) & 15;
+	}
+
+	void pushVertexFifo(unsigned int fifo[16], unsigned int v, size_t& offset, int cond = 1)
+	{
+		fifo[offset] = v;
+		offset = (offset + cond) & 15;
+	}
+
+	template <typename T>
+	void decodeOct(T* data, size_t count)
+	{
+		const float maxValue = float((1 << (sizeof(T) * 8 - 1)) - 1);
+		size_t i = 0;
+
+#ifdef MESHOPT_SSE2
+		const __m128 signMask = _mm_set1_ps(-0.f);
+		const __m128 half = _mm_set1_ps(0.5f);
+		const __m128 zero = _mm_setzero_ps();
+
+		for (; i + 4 <= count; i += 4)
+		{
+			T* p = data + i * 4;
+			__m128 x = _mm_setr_ps(float(p[0]), float(p[4]), float(p[8]), float(p[12]));
+			__m128 y = _mm_setr_ps(float(p[1]), float(p[5]), float(p[9]), float(p[13]));
+			__m128 z = _mm_setr_ps(float(p[2]), float(p[6]), float(p[10]), float(p[14]));
+
+			// z = z - |x| - |y|; fold back the lower hemisphere
+			z = _mm_sub_ps(_mm_sub_ps(z, _mm_andnot_ps(signMask, x)), _mm_andnot_ps(signMask, y));
+			__m128 t = _mm_min_ps(z, zero);
+			x = _mm_add_ps(x, _mm_xor_ps(t, _mm_and_ps(x, signMask)));
+			y = _mm_add_ps(y, _mm_xor_ps(t, _mm_and_ps(y, signMask)));
+
+			__m128 ll = _mm_add_ps(_mm_mul_ps(x, x), _mm_add_ps(_mm_mul_ps(y, y), _mm_mul_ps(z, z)));
+			__m128 s = _mm_div_ps(_mm_set1_ps(maxValue), _mm_sqrt_ps(ll));
+
+			// rounded signed float->int
+			__m128i xf = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(x, s), _mm_or_ps(_mm_and_ps(x, signMask), half)));
+			__m128i yf = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(y, s), _mm_or_ps(_mm_and_ps(y, signMask), half)));
+			__m128i zf = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(z, s), _mm_or_ps(_mm_and_ps(z, signMask), half)));
+
+			alignas(16) int xs[4], ys[4], zs[4];
+			_mm_store_si128(reinterpret_cast<__m128i*>(xs), xf);
+			_mm_store_si128(reinterpret_cast<__m128i*>(ys), yf);
+			_mm_store_si128(reinterpret_cast<__m128i*>(zs), zf);
+			for (int j = 0; j < 4; j++)
+			{
+				p[j * 4 + 0] = T(xs[j]);
+				p[j * 4 + 1] = T(ys[j]);
+				p[j * 4 + 2] = T(zs[j]);
+			}
+		}
+#endif
+
+		for (; i < count; i++)
+		{
+			float x = float(data[i * 4 + 0]);
+			float y = float(data[i * 4 + 1]);
+			float z = float(data[i * 4 + 2]) - fabsf(x) - fabsf(y);
+
+			float t = (z < 0.f) ? z : 0.f;
+			x += (x >= 0.f) ? t : -t;
+			y += (y >= 0.f) ? t : -t;
+
+			float l = sqrtf(x * x + y * y + z * z);
+			float s = maxValue / l;
+
+			data[i * 4 + 0] = T(int(x * s + (x >= 0.f ? 0.5f : -0.5f)));
+			data[i * 4 + 1] = T(int(y * s + (y >= 0.f ? 0.5f : -0.5f)));
+			data[i * 4 + 2] = T(int(z * s + (z >= 0.f ? 0.5f : -0.5f)));
+		}
+	}
+}
+
+int MeshoptDecoder::DecodeVertexBuffer(void* destination, size_t vertexCount, size_t vertexSize, const unsigned char* buffer, size_t bufferSize)
+{
+	if (vertexSize == 0 || vertexSize > 256 || vertexSize % 4 != 0) {
+		return -1;
+	}
+
+	unsigned char* vertexData = static_cast<unsigned char*>(destination);
+	const unsigned char* data = buffer;
+	const unsigned char* dataEnd = buffer + bufferSize;
+
+	if (static_cast<size_t>(dataEnd - data) < 1 + vertexSize) {
+		return -2;
+	}
+
+	unsigned char dataHeader = *data++;
+	if ((dataHeader & 0xf0) != kVertexHeader || (dataHeader & 0x0f) > 0) {
+		return -1;
+	}
+
+	// The first vertex of the stream is stored verbatim at the end of the tail
+	unsigned char lastVertex[256];
+	memcpy(lastVertex, dataEnd - vertexSize, vertexSize);
+
+	size_t vertexBlockSize = getVertexBlockSize(vertexSize);
+	size_t vertexOffset = 0;
+
+	while (vertexOffset < vertexCount)
+	{
+		size_t blockSize = std::min(vertexBlockSize, vertexCount - vertexOffset);
+		data = decodeVertexBlock(data, dataEnd, vertexData + vertexOffset * vertexSize, blockSize, vertexSize, lastVertex);
+		if (!data) {
+			return -2;
+		}
+		vertexOffset += blockSize;
+	}
+
+	size_t tailSize = vertexSize < kTailMaxSize ? kTailMaxSize : vertexSize;
+	if (static_cast<size_t>(dataEnd - data) != tailSize) {
+		return -3;
+	}
+	return 0;
+}
+
+int MeshoptDecoder::DecodeIndexBuffer(void* destination, size_t indexCount, size_t indexSize, const unsigned char* buffer, size_t bufferSize)
+{
+	if (indexCount % 3 != 0 || (indexSize != 2 && indexSize != 4)) {
+		return -1;
+	}
+
+	// Minimum valid encoding: header, one code byte per triangle and the 16 byte codeaux table
+	if (bufferSize < 1 + indexCount / 3 + 16) {
+		return -2;
+	}
+
+	if ((buffer[0] & 0xf0) != kIndexHeader) {
+		return -1;
+	}
+	int version = buffer[0] & 0x0f;
+	if (version > 1) {
+		return -1;
+	}
+
+	unsigned int edgeFifo[16][2];
+	memset(edgeFifo, -1, sizeof(edgeFifo));
+	unsigned int vertexFifo[16];
+	memset(vertexFifo, -1, sizeof(vertexFifo));
+	size_t edgeFifoOffset = 0;
+	size_t vertexFifoOffset = 0;
+
+	unsigned int next = 0;
+	unsigned int last = 0;
+	int fecMax = version >= 1 ? 13 : 15;
+
+	const unsigned char* code = buffer + 1;
+	const unsigned char* data = code + indexCount / 3;
+	const unsigned char* dataSafeEnd = buffer + bufferSize - 16;
+	const unsigned char* codeauxTable = dataSafeEnd;
+
+	for (size_t i = 0; i < indexCount; i += 3)
+	{
+		// A triangle reads at most 16 bytes, which the codeaux table pads for us
+		if (data > dataSafeEnd) {
+			return -2;
+		}
+
+		unsigned char codeTri = *code++;
+
+		if (codeTri < 0xf0)
+		{
+			// Edge from the fifo plus a vertex from the fifo, a new vertex or a free index
+			int fe = codeTri >> 4;
+			unsigned int a = edgeFifo[(edgeFifoOffset - 1 - fe) & 15][0];
+			unsigned int b = edgeFifo[(edgeFifoOffset - 1 - fe) & 15][1];
+			int fec = codeTri & 15;
+
+			if (fec < fecMax)
+			{
+				unsigned int cf = vertexFifo[(vertexFifoOffset - 1 - fec) & 15];
+				unsigned int c = (fec == 0) ? next : cf;
+				int fec0 = fec == 0;
+				next += fec0;
+
+				writeTriangle(destination, i, indexSize, a, b, c);
+				pushVertexFifo(vertexFifo, c, vertexFifoOffset, fec0);
+				pushEdgeFifo(edgeFifo, c, b, edgeFifoOffset);
+				pushEdgeFifo(edgeFifo, a, c, edgeFifoOffset);
+			}
+			else
+			{
+				// fec - (fec ^ 3) maps 13, 14 to -1, 1
+				unsigned int c = (fec != 15) ? last + (fec - (fec ^ 3)) : decodeIndex(data, last);
+				last = c;
+
+				writeTriangle(destination, i, indexSize, a, b, c);
+				pushVertexFifo(vertexFifo, c, vertexFifoOffset);
+				pushEdgeFifo(edgeFifo, c, b, edgeFifoOffset);
+				pushEdgeFifo(edgeFifo, a, c, edgeFifoOffset);
+			}
+		}
+		else if (codeTri < 0xfe)
+		{
+			// Triangle without a shared edge, vertices described by the codeaux table
+			unsigned char codeaux = codeauxTable[codeTri & 15];
+			int feb = codeaux >> 4;
+			int fec = codeaux & 15;
+
+			unsigned int a = next++;
+
+			unsigned int bf = vertexFifo[(vertexFifoOffset - feb) & 15];
+			unsigned int b = (feb == 0) ? next : bf;
+			int feb0 = feb == 0;
+			next += feb0;
+
+			unsigned int cf = vertexFifo[(vertexFifoOffset - fec) & 15];
+			unsigned int c = (fec == 0) ? next : cf;
+			int fec0 = fec == 0;
+			next += fec0;
+
+			writeTriangle(destination, i, indexSize, a, b, c);
+			pushVertexFifo(vertexFifo, a, vertexFifoOffset);
+			pushVertexFifo(vertexFifo, b, vertexFifoOffset, feb0);
+			pushVertexFifo(vertexFifo, c, vertexFifoOffset, fec0);
+			pushEdgeFifo(edgeFifo, b, a, edgeFifoOffset);
+			pushEdgeFifo(edgeFifo, c, b, edgeFifoOffset);
+			pushEdgeFifo(edgeFifo, a, c, edgeFifoOffset);
+		}
+		else
+		{
+			// Same as above but codeaux is stored inline and indices may be free
+			unsigned char codeaux = *data++;
+			int fea = codeTri == 0xfe ? 0 : 15;
+			int feb = codeaux >> 4;
+			int fec = codeaux & 15;
+
+			// codeaux 0 encoded inline resets the new vertex counter
+			if (codeaux == 0) {
+				next = 0;
+			}
+
+			unsigned int a = (fea == 0) ? next++ : 0;
+			unsigned int b = (feb == 0) ? next++ : vertexFifo[(vertexFifoOffset - feb) & 15];
+			unsigned int c = (fec == 0) ? next++ : vertexFifo[(vertexFifoOffset - fec) & 15];
+
+			if (fea == 15) {
+				last = a = decodeIndex(data, last);
+			}
+			if (feb == 15) {
+				last = b = decodeIndex(data, last);
+			}
+			if (fec == 15) {
+				last = c = decodeIndex(data, last);
+			}
+
+			writeTriangle(destination, i, indexSize, a, b, c);
+			pushVertexFifo(vertexFifo, a, vertexFifoOffset);
+			pushVertexFifo(vertexFifo, b, vertexFifoOffset, (feb == 0) | (feb == 15));
+			pushVertexFifo(vertexFifo, c, vertexFifoOffset, (fec == 0) | (fec == 15));
+			pushEdgeFifo(edgeFifo, b, a, edgeFifoOffset);
+			pushEdgeFifo(edgeFifo, c, b, edgeFifoOffset);
+			pushEdgeFifo(edgeFifo, a, c, edgeFifoOffset);
+		}
+	}
+
+	// All triangle data must end exactly where the codeaux table starts
+	if (data != dataSafeEnd) {
+		return -3;
+	}
+	return 0;
+}
+
+int MeshoptDecoder::DecodeIndexSequence(void* destination, size_t indexCount, size_t indexSize, const unsigned char* buffer, size_t bufferSize)
+{
+	if (indexSize != 2 && indexSize != 4) {
+		return -1;
+	}
+
+	// Minimum valid encoding: header, one byte per index and a 4 byte tail
+	if (bufferSize < 1 + indexCount + 4) {
+		return -2;
+	}
+
+	if ((buffer[0] & 0xf0) != kSequenceHeader || (buffer[0] & 0x0f) > 1) {
+		return -1;
+	}
+
+	const unsigned char* data = buffer + 1;
+	const unsigned char* dataSafeEnd = buffer + bufferSize - 4;
+
+	unsigned int last[2] = {};
+
+	for (size_t i = 0; i < indexCount; i++)
+	{
+		if (data >= dataSafeEnd) {
+			return -2;
+		}
+
+		unsigned int v = decodeVByte(data);
+
+		// lowest bit selects one of two baselines, the rest is a zigzag delta
+		unsigned int current = v & 1;
+		v >>= 1;
+		unsigned int d = (v >> 1) ^ -static_cast<int>(v & 1);
+		unsigned int index = last[current] + d;
+		last[current] = index;
+
+		writeIndex(destination, i, indexSize, index);
+	}
+
+	if (data != dataSafeEnd) {
+		return -3;
+	}
+	return 0;
+}
+
+void MeshoptDecoder::DecodeFilterOct(void* buffer, size_t count, size_t stride)
+{
+	if (stride == 4) {
+		decodeOct(static_cast<signed char*>(buffer), count);
+	} else if (stride == 8) {
+		decodeOct(static_cast<short*>(buffer), count);
+	}
+}
+
+void MeshoptDecoder::DecodeFilterQuat(void* buffer, size_t count, size_t stride)
+{
+	if (stride != 8) {
+		return;
+	}
+
+	short* data = static_cast<short*>(buffer);
+	const float scale = 1.f / sqrtf(2.f);
+
+	for (size_t i = 0; i < count; i++)
+	{
+		// two low bits of the 4th component hold the index of the dropped (largest) component
+		int sf = data[i * 4 + 3] | 3;
+		float ss = scale / float(sf);
+
+		float x = float(data[i * 4 + 0]) * ss;
+		float y = float(data[i * 4 + 1]) * ss;
+		float z = float(data[i * 4 + 2]) * ss;
+
+		float ww = 1.f - x * x - y * y - z * z;
+		float w = sqrtf(ww >= 0.f ? ww : 0.f);
+
+		int xf = int(x * 32767.f + (x >= 0.f ? 0.5f : -0.5f));
+		int yf = int(y * 32767.f + (y >= 0.f ? 0.5f : -0.5f));
+		int zf = int(z * 32767.f + (z >= 0.f ? 0.5f : -0.5f));
+		int wf = int(w * 32767.f + 0.5f);
+
+		int qc = data[i * 4 + 3] & 3;
+
+		data[i * 4 + ((qc + 1) & 3)] = short(xf);
+		data[i * 4 + ((qc + 2) & 3)] = short(yf);
+		data[i * 4 + ((qc + 3) & 3)] = short(zf);
+		data[i * 4 + ((qc + 0) & 3)] = short(wf);
+	}
+}
+
+void MeshoptDecoder::DecodeFilterExp(void* buffer, size_t count, size_t stride)
+{
+	unsigned int* data = static_cast<unsigned int*>(buffer);
+	size_t valueCount = count * (stride / 4);
+	size_t i = 0;
+
+#ifdef MESHOPT_SSE2
+	for (; i + 4 <= valueCount; i += 4)
+	{
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+
+		// 24-bit signed mantissa, 8-bit signed exponent; ldexp(m, e) via exponent bits
+		__m128i m = _mm_srai_epi32(_mm_slli_epi32(v, 8), 8);
+		__m128i e = _mm_srai_epi32(v, 24);
+		__m128 scale = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(e, _mm_set1_epi32(127)), 23));
+		__m128 r = _mm_mul_ps(scale, _mm_cvtepi32_ps(m));
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(data + i), _mm_castps_si128(r));
+	}
+#endif
+
+	for (; i < valueCount; i++)
+	{
+		unsigned int v = data[i];
+		int m = static_cast<int>(v << 8) >> 8;
+		int e = static_cast<int>(v) >> 24;
+
+		unsigned int bits = static_cast<unsigned int>(e + 127) << 23;
+		float f;
+		memcpy(&f, &bits, sizeof(f));
+		f *= float(m);
+		memcpy(&data[i], &f, sizeof(f));
+	}
+}
+
+bool MeshoptDecoder::DecodeBufferView(tinygltf::Model& model, int bufferViewIndex, std::string& error)
+{
+	TRACE_ZONE("Meshopt decode bufferView");
+
+	auto& bufferView = model.bufferViews[bufferViewIndex];
+	const auto& ext = bufferView.extensions.at("EXT_meshopt_compression");
+
+	int sourceIndex = ext.Get("buffer").GetNumberAsInt();
+	size_t byteOffset = ext.Has("byteOffset") ? static_cast<size_t>(ext.Get("byteOffset").GetNumberAsInt()) : 0;
+	size_t byteLength = static_cast<size_t>(ext.Get("byteLength").GetNumberAsInt());
+	size_t byteStride = static_cast<size_t>(ext.Get("byteStride").GetNumberAsInt());
+	size_t count = static_cast<size_t>(ext.Get("count").GetNumberAsInt());
+	std::string mode = ext.Get("mode").Get<std::string>();
+	std::string filter = ext.Has("filter") ? ext.Get("filter").Get<std::string>() : "NONE";
+
+	if (sourceIndex < 0 || sourceIndex >= static_cast<int>(model.buffers.size())) {
+		error = "invalid source buffer";
+		return false;
+	}
+
+	const auto& source = model.buffers[sourceIndex].data;
+	if (byteOffset + byteLength > source.size()) {
+		error = "compressed range is outside of the source buffer";
+		return false;
+	}
+
+	auto& target = model.buffers[bufferView.buffer].data;
+	if (count * byteStride > bufferView.byteLength || bufferView.byteOffset + count * byteStride > target.size()) {
+		error = "decoded data does not fit into the bufferView";
+		return false;
+	}
+
+	const unsigned char* input = source.data() + byteOffset;
+	unsigned char* output = target.data() + bufferView.byteOffset;
+
+	int result = -1;
+	if (mode == "ATTRIBUTES") {
+		result = DecodeVertexBuffer(output, count, byteStride, input, byteLength);
+	} else if (mode == "TRIANGLES") {
+		result = DecodeIndexBuffer(output, count, byteStride, input, byteLength);
+	} else if (mode == "INDICES") {
+		result = DecodeIndexSequence(output, count, byteStride, input, byteLength);
+	} else {
+		error = "unknown mode " + mode;
+		return false;
+	}
+
+	if (result != 0) {
+		error = mode + " decode failed with code " + std::to_string(result);
+		return false;
+	}
+
+	if (filter == "OCTAHEDRAL") {
+		DecodeFilterOct(output, count, byteStride);
+	} else if (filter == "QUATERNION") {
+		DecodeFilterQuat(output, count, byteStride);
+	} else if (filter == "EXPONENTIAL") {
+		DecodeFilterExp(output, count, byteStride);
+	}
+
+	return true;
+}
+
+bool MeshoptDecoder::DecodeModel(tinygltf::Model& model)
+{
+	std::vector<int> compressedViews;
+	for (int i = 0; i < static_cast<int>(model.bufferViews.size()); i++) {
+		if (model.bufferViews[i].extensions.count("EXT_meshopt_compression")) {
+			compressedViews.push_back(i);
+		}
+	}
+
+	if (compressedViews.empty()) {
+		return true;
+	}
+
+	TRACE_ZONE("MeshoptDecoder::DecodeModel");
+
+	// Fallback buffers are loaded without data; size them up front so the
+	// workers only ever write to disjoint ranges of existing storage
+	for (int viewIndex : compressedViews) {
+		const auto& bufferView = model.bufferViews[viewIndex];
+		if (bufferView.buffer < 0 || bufferView.buffer >= static_cast<int>(model.buffers.size())) {
+			continue;
+		}
+		auto& data = model.buffers[bufferView.buffer].data;
+		size_t required = bufferView.byteOffset + bufferView.byteLength;
+		if (data.size() < required) {
+			data.resize(required);
+		}
+	}
+
+	std::vector<std::string> errors(compressedViews.size());
+	std::atomic<size_t> nextView(0);
+	std::atomic<bool> failed(false);
+
+	auto worker = [&]() {
+		for (size_t job = nextView++; job < compressedViews.size(); job = nextView++) {
+			const auto& bufferView = model.bufferViews[compressedViews[job]];
+			if (bufferView.buffer < 0 || bufferView.buffer >= static_cast<int>(model.buffers.size())) {
+				errors[job] = "invalid fallback buffer";
+				failed = true;
+				continue;
+			}
+			if (!DecodeBufferView(model, compressedViews[job], errors[job])) {
+				failed = true;
+			}
+		}
+	};
+
+	size_t threadCount = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), compressedViews.size());
+	std::vector<std::thread> threads;
+	for (size_t i = 1; i < threadCount; i++) {
+		threads.emplace_back(worker);
+	}
+	worker();
+	for (auto& thread : threads) {
+		thread.join();
+	}
+
+	for (size_t i = 0; i < errors.size(); i++) {
+		if (!errors[i].empty()) {
+			std::cout << "[MESHOPT] bufferView " << compressedViews[i] << ": " << errors[i] << std::endl;
+		}
+	}
+
+#ifndef NDEBUG
+	std::cout << "[MESHOPT] Decoded " << compressedViews.size() << " compressed bufferViews on "
+			  << threadCount << " threads" << std::endl;
+#endif
+
+	return !failed;
+}
@@ -0,0 +1,34 @@
+#ifndef MESHOPT_DECODER_H
+#define MESHOPT_DECODER_H
+
+#include <cstddef>
+#include <string>
+#include "tiny_gltf.h"
+
+// Decoder for the EXT_meshopt_compression bufferView extension.
+// Compressed bufferViews are decoded in place into their fallback buffer,
+// so after DecodeModel() the rest of the loader reads plain buffer views.
+// The OCTAHEDRAL and QUATERNION filters leave normalized integers, which
+// Model reads through the accessor's componentType like any quantized data.
+class MeshoptDecoder
+{
+public:
+	// Decodes every compressed bufferView of the model, in parallel.
+	// Returns false if any bufferView failed to decode.
+	static bool DecodeModel(tinygltf::Model& model);
+
+	// Codecs (return 0 on success, negative value on malformed input)
+	static int DecodeVertexBuffer(void* destination, size_t vertexCount, size_t vertexSize, const unsigned char* buffer, size_t bufferSize);
+	static int DecodeIndexBuffer(void* destination, size_t indexCount, size_t indexSize, const unsigned char* buffer, size_t bufferSize);
+	static int DecodeIndexSequence(void* destination, size_t indexCount, size_t indexSize, const unsigned char* buffer, size_t bufferSize);
+
+	// Filters applied in place after ATTRIBUTES decoding
+	static void DecodeFilterOct(void* buffer, size_t count, size_t stride);
+	static void DecodeFilterQuat(void* buffer, size_t count, size_t stride);
+	static void DecodeFilterExp(void* buffer, size_t count, size_t stride);
+
+private:
+	static bool DecodeBufferView(tinygltf::Model& model, int bufferViewIndex, std::string& error);
+};
+
+#endif
@@ -1,11 +1,98 @@
 #include "Model.h"
+#include "MeshoptDecoder.h"
+#include "Tracer.h"
 #include <iostream>
 #include <filesystem>
 #include <map>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <glm/gtc/type_ptr.hpp>
 
 namespace fs = std::filesystem;
 
+namespace {
+    const float LOD_HYSTERESIS = 0.75f; // czesc progu, ponizej ktorej wchodzi grubszy poziom
+
+    // Axis aligned box around the mesh box transformed by transform
+    void TransformBounds(const Mesh& mesh, const glm::mat4& transform, glm::vec3& boundsMin, glm::vec3& boundsMax) {
+        for (int corner = 0; corner < 8; corner++) {
+            glm::vec3 local(
+                (corner & 1) ? mesh.boundsMax.x : mesh.boundsMin.x,
+                (corner & 2) ? mesh.boundsMax.y : mesh.boundsMin.y,
+                (corner & 4) ? mesh.boundsMax.z : mesh.boundsMin.z);
+            glm::vec3 world = glm::vec3(transform * glm::vec4(local, 1.0f));
+            boundsMin = corner == 0 ? world : glm::min(boundsMin, world);
+            boundsMax = corner == 0 ? world : glm::max(boundsMax, world);
+        }
+    }
+
+    // Every element of the accessor as up to four floats, the missing ones 0.
+    // Normalized integers (meshopt OCTAHEDRAL normals, QUATERNION rotations,
+    // quantized UVs and colors) are scaled to [-1, 1] or [0, 1] as glTF
+    // defines them. Empty when the accessor does not fit its buffer.
+    std::vector<glm::vec4> ReadAccessor(const tinygltf::Model& model, const tinygltf::Accessor& accessor) {
+        std::vector<glm::vec4> values;
+        if (accessor.bufferView < 0 || accessor.bufferView >= static_cast<int>(model.bufferViews.size())) {
+            return values;
+        }
+        const auto& bufferView = model.bufferViews[accessor.bufferView];
+        const auto& buffer = model.buffers[bufferView.buffer];
+        int components = std::min(tinygltf::GetNumComponentsInType(accessor.type), 4);
+        int componentSize = tinygltf::GetComponentSizeInBytes(accessor.componentType);
+        int stride = accessor.ByteStride(bufferView);
+        size_t start = bufferView.byteOffset + accessor.byteOffset;
+        size_t length = components > 0 && componentSize > 0 && accessor.count > 0
+            ? accessor.byteOffset + (accessor.count - 1) * stride + components * componentSize : 0;
+        if (length == 0 || stride <= 0 || length > bufferView.byteLength || bufferView.byteOffset + bufferView.byteLength > buffer.data.size()) {
+            return values;
+        }
+        values.assign(accessor.count, glm::vec4(0.0f));
+        for (size_t i = 0; i < accessor.count; i++) {
+            const unsigned char* element = buffer.data.data() + start + i * stride;
+            for (int c = 0; c < components; c++) {
+                const unsigned char* bytes = element + c * componentSize;
+                float value = 0.0f;
+                switch (accessor.componentType) {
+                case TINYGLTF_COMPONENT_TYPE_FLOAT: {
+                    std::memcpy(&value, bytes, sizeof(float));
+                    break;
+                }
+                case TINYGLTF_COMPONENT_TYPE_BYTE: {
+                    int8_t raw = static_cast<int8_t>(bytes[0]);
+                    value = accessor.normalized ? std::max(raw / 127.0f, -1.0f) : raw;
+                    break;
+                }
+                case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE: {
+                    value = accessor.normalized ? bytes[0] / 255.0f : bytes[0];
+                    break;
+                }
+                case TINYGLTF_COMPONENT_TYPE_SHORT: {
+                    int16_t raw;
+                    std::memcpy(&raw, bytes, sizeof(raw));
+                    value = accessor.normalized ? std::max(raw / 32767.0f, -1.0f) : raw;
+                    break;
+                }
+                case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT: {
+                    uint16_t raw;
+                    std::memcpy(&raw, bytes, sizeof(raw));
+                    value = accessor.normalized ? raw / 65535.0f : raw;
+                    break;
+                }
+                case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT: {
+                    uint32_t raw;
+                    std::memcpy(&raw, bytes, sizeof(raw));
+                    value = static_cast<float>(raw);
+                    break;
+                }
+                }
+                values[i][c] = value;
+            }
+        }
+        return values;
+    }
+}
+
 Model::Model(const std::string& filePath) {
     animationTime = 0.0f;
     animationPlaying = false;
@@ -36,6 +123,7 @@ Model::~Model() {
 }
 
 void Model::LoadModel(const std::string& path) {
+    TRACE_ZONE("Model::LoadModel");
     tinygltf::Model gltfModel;
     tinygltf::TinyGLTF loader;
     std::string err;
@@ -43,8 +131,10 @@ void Model::LoadModel(const std::string& path) {
 
     bool ret;
     if (path.ends_with(".glb")) {
+        TRACE_ZONE("LoadBinaryFromFile");
         ret = loader.LoadBinaryFromFile(&gltfModel, &err, &warn, path);
     } else {
+        TRACE_ZONE("LoadASCIIFromFile");
         ret = loader.LoadASCIIFromFile(&gltfModel, &err, &warn, path);
     }
 
@@ -59,7 +149,14 @@ void Model::LoadModel(const std::string& path) {
     if (!ret) {
         std::cout << "Failed to load GLTF model: " << path << std::endl;
         return;
-    }    nodes.resize(gltfModel.nodes.size());
+    }
+
+    // Rozpakowanie buforow EXT_meshopt_compression przed ProcessMesh
+    if (!MeshoptDecoder::DecodeModel(gltfModel)) {
+        std::cout << "Failed to decode EXT_meshopt_compression data: " << path << std::endl;
+        return;
+    }
+    nodes.resize(gltfModel.nodes.size());
     for (int i = 0; i < nodes.size(); i++) {
         nodes[i].meshIndex = -1;
         nodes[i].parent = -1;
@@ -67,11 +164,18 @@ void Model::LoadModel(const std::string& path) {
         nodes[i].originalTransform = glm::mat4(1.0f);
     }
 
+    // Poziomy LOD z pliku obok modelu; brakujace liczy ProcessMesh i zapisujemy je
+    std::string lodPath = path + ".lod";
+    lodCache.Load(lodPath);
     if (gltfModel.scenes.size() > 0) {
         for (int rootNodeIdx : gltfModel.scenes[0].nodes) {
             ProcessNode(gltfModel, rootNodeIdx, -1);
         }
     }
+    if (lodCache.IsDirty()) {
+        lodCache.Save(lodPath);
+    }
+    lodCache = LodCache();
 
     ProcessAnimations(gltfModel);
 }
@@ -132,6 +236,8 @@ void Model::ProcessNode(tinygltf::Model& model, int nodeIndex, int parentIndex)
 }
 
 void Model::ProcessMesh(tinygltf::Model& model, int meshIndex) {
+    RenderDevice& device = RenderDevice::Get();
+    TRACE_ZONE("ProcessMesh");
     Mesh mesh;
     auto& gltfMesh = model.meshes[meshIndex];
     
@@ -142,78 +248,80 @@ void Model::ProcessMesh(tinygltf::Model& model, int meshIndex) {
         if (primitive.attributes.find("POSITION") == primitive.attributes.end()) {
             continue;
         }
+        TRACE_ZONE("ProcessMesh interleave");
         
         const auto& posAccessor = model.accessors[primitive.attributes["POSITION"]];
-        const auto& posBufferView = model.bufferViews[posAccessor.bufferView];
-        const auto& posBuffer = model.buffers[posBufferView.buffer];
         
-        int vertCount = static_cast<int>(posAccessor.count);
+        // Przez ReadAccessor, bo gltfpack kwantyzuje pozycje (SHORT/USHORT) i przeplata atrybuty
+        std::vector<glm::vec4> positionValues = ReadAccessor(model, posAccessor);
+        if (positionValues.empty()) {
+            continue;
+        }
+        int vertCount = static_cast<int>(positionValues.size());
         
         std::vector<glm::vec3> positions(vertCount);
         std::vector<glm::vec3> colors(vertCount, glm::vec3(1.0f));
         std::vector<glm::vec2> texCoords(vertCount, glm::vec2(0.0f));
         std::vector<glm::vec3> normals(vertCount, glm::vec3(0.0f, 1.0f, 0.0f));
         
-        const float* posData = reinterpret_cast<const float*>(
-            &posBuffer.data[posBufferView.byteOffset + posAccessor.byteOffset]);
-        
         for (int i = 0; i < vertCount; i++) {
-            positions[i] = glm::vec3(
-                posData[i * 3 + 0],
-                posData[i * 3 + 1],
-                posData[i * 3 + 2]
-            );
+            positions[i] = glm::vec3(positionValues[i]);
+        }
+
+        if (vertCount > 0) {
+            glm::vec3 primitiveMin = positions[0];
+            glm::vec3 primitiveMax = positions[0];
+            // glTF wymaga min/max dla POSITION; liczymy sami gdy ich brak albo gdy sa
+            // w surowych wartosciach znormalizowanych liczb calkowitych
+            bool rawBounds = posAccessor.normalized && posAccessor.componentType != TINYGLTF_COMPONENT_TYPE_FLOAT;
+            if (!rawBounds && posAccessor.minValues.size() == 3 && posAccessor.maxValues.size() == 3) {
+                primitiveMin = glm::vec3(posAccessor.minValues[0], posAccessor.minValues[1], posAccessor.minValues[2]);
+                primitiveMax = glm::vec3(posAccessor.maxValues[0], posAccessor.maxValues[1], posAccessor.maxValues[2]);
+            } else {
+                for (int i = 1; i < vertCount; i++) {
+                    primitiveMin = glm::min(primitiveMin, positions[i]);
+                    primitiveMax = glm::max(primitiveMax, positions[i]);
+                }
+            }
+            bool first = vertexData.empty();
+            mesh.boundsMin = first ? primitiveMin : glm::min(mesh.boundsMin, primitiveMin);
+            mesh.boundsMax = first ? primitiveMax : glm::max(mesh.boundsMax, primitiveMax);
         }
         
+        // Przez ReadAccessor, bo po filtrze OCTAHEDRAL normalne to znormalizowane liczby calkowite
         if (primitive.attributes.find("NORMAL") != primitive.attributes.end()) {
-            const auto& normalAccessor = model.accessors[primitive.attributes["NORMAL"]];
-            const auto& normalBufferView = model.bufferViews[normalAccessor.bufferView];
-            const auto& normalBuffer = model.buffers[normalBufferView.buffer];
-            
-            const float* normalData = reinterpret_cast<const float*>(
-                &normalBuffer.data[normalBufferView.byteOffset + normalAccessor.byteOffset]);
-            
-            for (int i = 0; i < vertCount; i++) {
-                normals[i] = glm::vec3(
-                    normalData[i * 3 + 0],
-                    normalData[i * 3 + 1],
-                    normalData[i * 3 + 2]
-                );
+            std::vector<glm::vec4> normalValues = ReadAccessor(model, model.accessors[primitive.attributes["NORMAL"]]);
+            for (int i = 0; i < vertCount && i < static_cast<int>(normalValues.size()); i++) {
+                normals[i] = glm::vec3(normalValues[i]);
             }
         }
         
         if (primitive.attributes.find("TEXCOORD_0") != primitive.attributes.end()) {
-            const auto& uvAccessor = model.accessors[primitive.attributes["TEXCOORD_0"]];
-            const auto& uvBufferView = model.bufferViews[uvAccessor.bufferView];
-            const auto& uvBuffer = model.buffers[uvBufferView.buffer];
-            
-            const float* uvData = reinterpret_cast<const float*>(
-                &uvBuffer.data[uvBufferView.byteOffset + uvAccessor.byteOffset]);
-            
-            for (int i = 0; i < vertCount; i++) {
-                texCoords[i] = glm::vec2(
-                    uvData[i * 2 + 0],
-                    uvData[i * 2 + 1]
-                );
+            std::vector<glm::vec4> uvValues = ReadAccessor(model, model.accessors[primitive.attributes["TEXCOORD_0"]]);
+            for (int i = 0; i < vertCount && i < static_cast<int>(uvValues.size()); i++) {
+                texCoords[i] = glm::vec2(uvValues[i]);
             }
         }
         
         if (primitive.attributes.find("COLOR_0") != primitive.attributes.end()) {
-            const auto& colorAccessor = model.accessors[primitive.attributes["COLOR_0"]];
-            const auto& colorBufferView = model.bufferViews[colorAccessor.bufferView];
-            const auto& colorBuffer = model.buffers[colorBufferView.buffer];
-            
-            const float* colorData = reinterpret_cast<const float*>(
-                &colorBuffer.data[colorBufferView.byteOffset + colorAccessor.byteOffset]);
-            
-            for (int i = 0; i < vertCount; i++) {
-                colors[i] = glm::vec3(
-                    colorData[i * 3 + 0],
-                    colorData[i * 3 + 1],
-                    colorData[i * 3 + 2]
-                );
+            std::vector<glm::vec4> colorValues = ReadAccessor(model, model.accessors[primitive.attributes["COLOR_0"]]);
+            for (int i = 0; i < vertCount && i < static_cast<int>(colorValues.size()); i++) {
+                colors[i] = glm::vec3(colorValues[i]);
+            }
+        }
+        // Trojkaty na CPU z przesunieciem o poczatek prymitywu
+        unsigned int cpuBase = static_cast<unsigned int>(mesh.positions.size());
+        mesh.positions.insert(mesh.positions.end(), positions.begin(), positions.end());
+        bool triangleMode = primitive.mode == TINYGLTF_MODE_TRIANGLES || primitive.mode < 0;
+        if (triangleMode && primitive.indices < 0) {
+            for (int i = 0; i + 2 < vertCount; i += 3) {
+                mesh.triangles.push_back(cpuBase + i);
+                mesh.triangles.push_back(cpuBase + i + 1);
+                mesh.triangles.push_back(cpuBase + i + 2);
             }
         }
+        size_t primitiveIndexStart = indices.size();
+
           for (int i = 0; i < vertCount; i++) {
             vertexData.push_back(positions[i].x);
             vertexData.push_back(positions[i].y);
@@ -233,30 +341,39 @@ void Model::ProcessMesh(tinygltf::Model& model, int meshIndex) {
             const auto& idxBuffer = model.buffers[idxBufferView.buffer];
             
             int idxCount = static_cast<int>(idxAccessor.count);
-            mesh.indexCount = idxCount;
+            // EBO wszystkich prymitywow, indeksy przesuniete o ich poczatek w VBO
+            mesh.indexCount += idxCount;
             
             if (idxAccessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT) {
                 const uint16_t* idxData = reinterpret_cast<const uint16_t*>(
                     &idxBuffer.data[idxBufferView.byteOffset + idxAccessor.byteOffset]);
                 
                 for (int i = 0; i < idxCount; i++) {
-                    indices.push_back(static_cast<unsigned int>(idxData[i]));
+                    indices.push_back(cpuBase + static_cast<unsigned int>(idxData[i]));
                 }
             } else if (idxAccessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT) {
                 const uint32_t* idxData = reinterpret_cast<const uint32_t*>(
                     &idxBuffer.data[idxBufferView.byteOffset + idxAccessor.byteOffset]);
                 
                 for (int i = 0; i < idxCount; i++) {
-                    indices.push_back(static_cast<unsigned int>(idxData[i]));
+                    indices.push_back(cpuBase + static_cast<unsigned int>(idxData[i]));
                 }
             } else if (idxAccessor.componentType == TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE) {
                 const uint8_t* idxData = reinterpret_cast<const uint8_t*>(
                     &idxBuffer.data[idxBufferView.byteOffset + idxAccessor.byteOffset]);
                 
                 for (int i = 0; i < idxCount; i++) {
-                    indices.push_back(static_cast<unsigned int>(idxData[i]));
+                    indices.push_back(cpuBase + static_cast<unsigned int>(idxData[i]));
+                }
+            }
+            if (triangleMode) {
+                for (size_t i = primitiveIndexStart; i + 2 < indices.size(); i += 3) {
+                    mesh.triangles.push_back(indices[i]);
+                    mesh.triangles.push_back(indices[i + 1]);
+                    mesh.triangles.push_back(indices[i + 2]);
                 }
-            }        }        if (primitive.material >= 0) {
+            }
+        }        if (primitive.material >= 0) {
             auto& material = model.materials[primitive.material];
             bool hasTexture = false;
             
@@ -281,20 +398,23 @@ void Model::ProcessMesh(tinygltf::Model& model, int meshIndex) {
                         int channels = gltfImg.component;
 
                         GLuint texID;
-                        glGenTextures(1, &texID);
-                        glActiveTexture(GL_TEXTURE0);
-                        glBindTexture(GL_TEXTURE_2D, texID);
-                        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_LINEAR);
-                        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-                        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-                        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+                        texID = device.GenTexture();
+                        device.ActiveTexture(GL_TEXTURE0);
+                        device.BindTexture(GL_TEXTURE_2D, texID);
+                        device.TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_LINEAR);
+                        device.TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+                        device.TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+                        device.TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 
                         GLenum format = (channels == 4) ? GL_RGBA : (channels == 3) ? GL_RGB : GL_RED;
-                        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, gltfImg.image.data());
-                        glGenerateMipmap(GL_TEXTURE_2D);
-                        glBindTexture(GL_TEXTURE_2D, 0);
+                        {
+                            TRACE_ZONE("glTexImage2D upload");
+                            device.TexImage2D(GL_TEXTURE_2D, 0, format, width, height, format, GL_UNSIGNED_BYTE, gltfImg.image.data());
+                        }
+                        device.GenerateMipmap(GL_TEXTURE_2D);
+                        device.BindTexture(GL_TEXTURE_2D, 0);
 
-                        GLenum err = glGetError();
+                        GLenum err = device.GetError();
                         if (err == GL_NO_ERROR) {
                             Texture tex;
                             tex.ID = texID;
@@ -327,6 +447,31 @@ void Model::ProcessMesh(tinygltf::Model& model, int meshIndex) {
         }
     }
     
+    // Sfera wokol srodka boxa, promien do najdalszego wierzcholka
+    mesh.sphereCenter = 0.5f * (mesh.boundsMin + mesh.boundsMax);
+    float radiusSquared = 0.0f;
+    for (const glm::vec3& position : mesh.positions) {
+        glm::vec3 offset = position - mesh.sphereCenter;
+        radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+    }
+    mesh.sphereRadius = std::sqrt(radiusSquared);
+    {
+        TRACE_ZONE("ProcessMesh triangle BVH");
+        mesh.triangleBvh.Build(mesh.positions, mesh.triangles);
+    }
+    // LOD tylko dla trojkatow z indeksami, gdy EBO to dokladnie lista trojkatow
+    if (mesh.indexCount > 0 && mesh.triangles.size() == indices.size()) {
+        TRACE_ZONE("ProcessMesh LOD");
+        uint64_t lodKey = LodCache::Key(mesh.positions, indices, mesh.indexCount);
+        mesh.lods.resize(1);
+        mesh.lods[0].indexCount = mesh.indexCount;
+        if (!lodCache.Find(lodKey, mesh.positions.size(), indices, mesh.lods)) {
+            mesh.lods.clear();
+            MeshSimplifier::BuildLods(mesh.positions, indices, mesh.indexCount, mesh.lods);
+            lodCache.Store(lodKey, indices, mesh.lods);
+        }
+    }
+
     mesh.vao.Bind();
 
     if (!vertexData.empty()) {
@@ -401,17 +546,9 @@ void Model::ProcessAnimations(tinygltf::Model& model) {
                 }
             } 
             else if (channel.path == "rotation") {
-                const float* valueData = reinterpret_cast<const float*>(
-                    &valueBuffer.data[valueBufferView.byteOffset + valueAccessor.byteOffset]);
-                
-                for (int i = 0; i < valueAccessor.count; i++) {
-                    channel.values.push_back(glm::vec4(
-                        valueData[i * 4 + 0],
-                        valueData[i * 4 + 1],
-                        valueData[i * 4 + 2],
-                        valueData[i * 4 + 3]
-                    ));
-                }
+                // Po filtrze QUATERNION to znormalizowane SHORT, nie float
+                std::vector<glm::vec4> rotations = ReadAccessor(model, valueAccessor);
+                channel.values.insert(channel.values.end(), rotations.begin(), rotations.end());
             }
             
             animation.channels.push_back(channel);
@@ -444,47 +581,72 @@ void Model::ProcessAnimations(tinygltf::Model& model) {
 }
 
 void Model::Draw(Shader& shader) {
+    DrawNodes(shader, nullptr);
+}
+
+void Model::Draw(Shader& shader, const std::vector<uint8_t>& visibleNodes) {
+    DrawNodes(shader, &visibleNodes);
+}
+
+void Model::DrawNodes(Shader& shader, const std::vector<uint8_t>* visibleNodes) {
+    RenderDevice& device = RenderDevice::Get();
     // Kontrola face culling
     if (doubleSided) {
-        glDisable(GL_CULL_FACE);
+        device.Disable(GL_CULL_FACE);
     } else {
-        glEnable(GL_CULL_FACE);
-        glCullFace(GL_BACK);
+        device.Enable(GL_CULL_FACE);
+        device.CullFace(GL_BACK);
     }
     
-    for (int i = 0; i < nodes.size(); i++) {
-        if (nodes[i].parent == -1) {
-            UpdateNodeHierarchy(i, modelTransform); // Zastosowanie transformacji modelu
-        }
-    }
+    UpdateTransforms();
+    cullStats = CullStats();
     
     for (int i = 0; i < nodes.size(); i++) {
         if (nodes[i].meshIndex >= 0) {
             auto& mesh = meshes[nodes[i].meshIndex];
+            cullStats.tested++;
+            bool visible = true;
+            if (visibleNodes != nullptr) {
+                visible = i < static_cast<int>(visibleNodes->size()) && (*visibleNodes)[i] != 0;
+            }
+            if (!visible) {
+                cullStats.culled++;
+                continue;
+            }
+            cullStats.drawn++;
+            // Wariant shadera bez galezi: z tekstura albo z baseColor
+            shader.SetFeature(SHADER_TEXTURED, !mesh.textures.empty());
+            shader.Activate();
+            device.Uniform1f(device.GetUniformLocation(shader.ID, "highlight"), i == highlightNode ? 1.0f : 0.0f);
             
-            glUniformMatrix4fv(
-                glGetUniformLocation(shader.ID, "modelMatrix"),
+            device.UniformMatrix4fv(
+                device.GetUniformLocation(shader.ID, "modelMatrix"),
                 1, GL_FALSE,
                 glm::value_ptr(nodes[i].globalTransform)
             );            if (!mesh.textures.empty()) {
-                glActiveTexture(GL_TEXTURE0);
+                device.ActiveTexture(GL_TEXTURE0);
                 mesh.textures[0].Bind();
-                glUniform1i(glGetUniformLocation(shader.ID, "texture_diffuse1"), 0);
-                glUniform1i(glGetUniformLocation(shader.ID, "hasTexture"), 1);
+                device.Uniform1i(device.GetUniformLocation(shader.ID, "texture_diffuse1"), 0);
                 std::cout << "[DRAW DEBUG] Using texture for mesh" << std::endl;
             } else {
-                glUniform1i(glGetUniformLocation(shader.ID, "hasTexture"), 0);
-                glUniform4fv(glGetUniformLocation(shader.ID, "baseColor"), 1, glm::value_ptr(mesh.baseColor));
+                device.Uniform4fv(device.GetUniformLocation(shader.ID, "baseColor"), 1, glm::value_ptr(mesh.baseColor));
                 std::cout << "[DRAW DEBUG] Using baseColor: " << mesh.baseColor.r << ", " << mesh.baseColor.g << ", " << mesh.baseColor.b << ", " << mesh.baseColor.a << std::endl;
             }
             
             mesh.vao.Bind();
             
-            if (mesh.indexCount > 0) {
-                glDrawElements(GL_TRIANGLES, mesh.indexCount, GL_UNSIGNED_INT, 0);
+            if (!mesh.lods.empty()) {
+                const MeshLod& lod = mesh.lods[std::min(nodes[i].lod, static_cast<int>(mesh.lods.size()) - 1)];
+                cullStats.triangles += lod.indexCount / 3;
+                device.DrawElements(GL_TRIANGLES, lod.indexCount, GL_UNSIGNED_INT,
+                    reinterpret_cast<const void*>(static_cast<size_t>(lod.firstIndex) * sizeof(GLuint)));
+            } else if (mesh.indexCount > 0) {
+                cullStats.triangles += mesh.indexCount / 3;
+                device.DrawElements(GL_TRIANGLES, mesh.indexCount, GL_UNSIGNED_INT, 0);
             } else {
                 int vertCount = static_cast<int>(mesh.vbo.GetSize() / (8 * sizeof(float)));
-                glDrawArrays(GL_TRIANGLES, 0, vertCount);
+                cullStats.triangles += vertCount / 3;
+                device.DrawArrays(GL_TRIANGLES, 0, vertCount);
             }
               mesh.vao.Unbind();
             if (!mesh.textures.empty()) {
@@ -494,7 +656,64 @@ void Model::Draw(Shader& shader) {
     }
 }
 
+void Model::DrawDepth(Shader& shader, const std::vector<int>& nodeList) {
+    RenderDevice& device = RenderDevice::Get();
+    shader.Activate();
+    GLint modelMatrixLocation = device.GetUniformLocation(shader.ID, "modelMatrix");
+    for (int index : nodeList) {
+        const Node& node = nodes[index];
+        if (node.meshIndex < 0) {
+            continue;
+        }
+        Mesh& mesh = meshes[node.meshIndex];
+        device.UniformMatrix4fv(modelMatrixLocation, 1, GL_FALSE, glm::value_ptr(node.globalTransform));
+        mesh.vao.Bind();
+        // lods[0] to pelny mesh na poczatku EBO
+        if (mesh.indexCount > 0) {
+            device.DrawElements(GL_TRIANGLES, mesh.indexCount, GL_UNSIGNED_INT, 0);
+        } else {
+            device.DrawArrays(GL_TRIANGLES, 0, static_cast<int>(mesh.vbo.GetSize() / (8 * sizeof(float))));
+        }
+        mesh.vao.Unbind();
+    }
+}
+
+void Model::SelectLods(glm::vec3 cameraPosition, float projectionScale, float maxPixelError) {
+    for (Node& node : nodes) {
+        if (node.meshIndex < 0) {
+            continue;
+        }
+        const std::vector<MeshLod>& lods = meshes[node.meshIndex].lods;
+        // Blad w pikselach liczony z najblizszego punktu sfery, w skali wezla
+        glm::mat3 basis(node.globalTransform);
+        float scale = std::max({ glm::length(basis[0]), glm::length(basis[1]), glm::length(basis[2]) });
+        float distance = glm::length(node.worldCenter - cameraPosition) - node.worldRadius;
+        if (lods.size() < 2 || !node.boundsValid || distance <= 0.0f) {
+            node.lod = 0;
+            continue;
+        }
+        float pixelsPerUnit = scale * projectionScale / distance;
+        int lod = std::min(node.lod, static_cast<int>(lods.size()) - 1);
+        while (lod > 0 && lods[lod].error * pixelsPerUnit > maxPixelError) {
+            lod--;
+        }
+        while (lod + 1 < static_cast<int>(lods.size()) && lods[lod + 1].error * pixelsPerUnit <= maxPixelError * LOD_HYSTERESIS) {
+            lod++;
+        }
+        node.lod = lod;
+    }
+}
+
 void Model::UpdateAnimation(float deltaTime) {
+    if (!AdvanceAnimation(deltaTime)) {
+        return;
+    }
+    std::vector<glm::mat4> localTransforms;
+    SampleAnimation(localTransforms);
+    SetNodeLocalTransforms(localTransforms);
+}
+
+bool Model::AdvanceAnimation(float deltaTime) {
     if (animations.empty() || activeAnimations.empty()) {
         static bool warningShown = false;
         if (!warningShown) {
@@ -502,10 +721,10 @@ void Model::UpdateAnimation(float deltaTime) {
                       << ", activeAnimations.size(): " << activeAnimations.size() << std::endl;
             warningShown = true;
         }
-        return;
+        return false;
     }
       if (!animationPlaying) {
-        return;
+        return false;
     }
       animationTime += deltaTime;
     
@@ -529,7 +748,10 @@ void Model::UpdateAnimation(float deltaTime) {
         if (animationTime > maxDuration) {
             animationTime = fmodf(animationTime, maxDuration);
         }    }
-    
+    return true;
+}
+
+void Model::SampleAnimation(std::vector<glm::mat4>& localTransforms) const {
     std::map<int, glm::vec3> nodeTranslations;
     std::map<int, glm::quat> nodeRotations;
     std::map<int, glm::vec3> nodeScales;
@@ -557,6 +779,7 @@ void Model::UpdateAnimation(float deltaTime) {
             }
         }    }
     
+    localTransforms.resize(nodes.size());
     for (int i = 0; i < nodes.size(); i++) {
         glm::mat4 baseTransform = nodes[i].originalTransform;
         
@@ -579,16 +802,16 @@ void Model::UpdateAnimation(float deltaTime) {
             hasAnimationData = true;        }
         
         if (hasAnimationData) {
-            nodes[i].localTransform = translation * rotation * scale;
+            localTransforms[i] = translation * rotation * scale;
         } else {
-            nodes[i].localTransform = baseTransform;
+            localTransforms[i] = baseTransform;
         }
     }
 }
 
 glm::vec4 Model::InterpolateValues(const std::vector<float>& times,
                                  const std::vector<glm::vec4>& values, 
-                                 float currentTime) {
+                                 float currentTime) const {
     if (times.size() == 1) {
         return values[0];
     }
@@ -606,13 +829,35 @@ glm::vec4 Model::InterpolateValues(const std::vector<float>& times,
 void Model::UpdateNodeHierarchy(int nodeIndex, const glm::mat4& parentTransform) {
     auto& node = nodes[nodeIndex];
     
-    node.globalTransform = parentTransform * node.localTransform;
+    glm::mat4 globalTransform = parentTransform * node.localTransform;
+    if (!node.boundsValid || globalTransform != node.globalTransform) {
+        node.globalTransform = globalTransform;
+        UpdateNodeBounds(nodeIndex);
+    }
     
     for (int childIndex : node.children) {
         UpdateNodeHierarchy(childIndex, node.globalTransform);
     }
 }
 
+void Model::UpdateNodeBounds(int nodeIndex) {
+    auto& node = nodes[nodeIndex];
+    node.boundsValid = true;
+    if (node.meshIndex < 0) {
+        return;
+    }
+
+    const Mesh& mesh = meshes[node.meshIndex];
+    const glm::mat4& transform = node.globalTransform;
+    TransformBounds(mesh, transform, node.worldBoundsMin, node.worldBoundsMax);
+    // Promien skalowany najwieksza skala osi, wiec sfera zostaje otaczajaca
+    float scaleSquared = std::max({ glm::dot(glm::vec3(transform[0]), glm::vec3(transform[0])),
+                                    glm::dot(glm::vec3(transform[1]), glm::vec3(transform[1])),
+                                    glm::dot(glm::vec3(transform[2]), glm::vec3(transform[2])) });
+    node.worldCenter = glm::vec3(transform * glm::vec4(mesh.sphereCenter, 1.0f));
+    node.worldRadius = mesh.sphereRadius * std::sqrt(scaleSquared);
+}
+
 void Model::TriggerOneShotAnimation() {
     std::cout << "[ANIMATION DEBUG] TriggerOneShotAnimation called" << std::endl;
     std::cout << "[ANIMATION DEBUG] animations.size(): " << animations.size() << std::endl;
@@ -646,3 +891,86 @@ bool Model::IsAnimationPlaying() const {
 void Model::SetDoubleSided(bool doubleSided) {
     this->doubleSided = doubleSided;
 }
+
+int Model::FindNode(const std::string& name) const {
+    for (int i = 0; i < static_cast<int>(nodes.size()); i++) {
+        if (nodes[i].name == name) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+bool Model::IsNodeAnimated(int index) const {
+    for (const auto& animation : animations) {
+        for (const auto& channel : animation.channels) {
+            if (channel.targetNode == index) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void Model::SetNodeLocalTransform(int index, const glm::mat4& transform) {
+    nodes[index].localTransform = transform;
+}
+
+void Model::GetNodeLocalTransforms(std::vector<glm::mat4>& localTransforms) const {
+    localTransforms.resize(nodes.size());
+    for (int i = 0; i < static_cast<int>(nodes.size()); i++) {
+        localTransforms[i] = nodes[i].localTransform;
+    }
+}
+
+void Model::SetNodeLocalTransforms(const std::vector<glm::mat4>& localTransforms) {
+    for (int i = 0; i < static_cast<int>(nodes.size()) && i < static_cast<int>(localTransforms.size()); i++) {
+        nodes[i].localTransform = localTransforms[i];
+    }
+}
+
+void Model::UpdateTransforms() {
+    for (int i = 0; i < static_cast<int>(nodes.size()); i++) {
+        if (nodes[i].parent == -1) {
+            UpdateNodeHierarchy(i, modelTransform); // Zastosowanie transformacji modelu
+        }
+    }
+}
+
+bool Model::GetNodeWorldBounds(int index, glm::vec3& boundsMin, glm::vec3& boundsMax) const {
+    int meshIndex = nodes[index].meshIndex;
+    if (meshIndex < 0) {
+        return false;
+    }
+
+    TransformBounds(meshes[meshIndex], nodes[index].globalTransform, boundsMin, boundsMax);
+    return true;
+}
+
+bool Model::GetNodeWorldTriangles(int index, std::vector<glm::vec3>& triangles) const {
+    int meshIndex = nodes[index].meshIndex;
+    if (meshIndex < 0) {
+        return false;
+    }
+
+    const Mesh& mesh = meshes[meshIndex];
+    const glm::mat4& transform = nodes[index].globalTransform;
+    triangles.reserve(triangles.size() + mesh.triangles.size());
+    for (unsigned int vertex : mesh.triangles) {
+        triangles.push_back(glm::vec3(transform * glm::vec4(mesh.positions[vertex], 1.0f)));
+    }
+    return true;
+}
+
+bool Model::RaycastNode(int index, glm::vec3 origin, glm::vec3 direction, float maxDistance, TriangleHit& hit) const {
+    int meshIndex = nodes[index].meshIndex;
+    if (meshIndex < 0 || meshes[meshIndex].triangleBvh.IsEmpty()) {
+        return false;
+    }
+
+    // Promien w przestrzeni lokalnej; bez normalizacji kierunku odleglosc zostaje ta sama
+    glm::mat4 worldToLocal = glm::inverse(nodes[index].globalTransform);
+    glm::vec3 localOrigin = glm::vec3(worldToLocal * glm::vec4(origin, 1.0f));
+    glm::vec3 localDirection = glm::vec3(worldToLocal * glm::vec4(direction, 0.0f));
+    return meshes[meshIndex].triangleBvh.Raycast(localOrigin, localDirection, maxDistance, hit);
+}
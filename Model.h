@@ -14,6 +14,9 @@
 #include "EBO.h"
 #include "Texture.h"
 #include "shaderClass.h"
+#include "Frustum.h"
+#include "TriangleBvh.h"
+#include "MeshSimplifier.h"
 #include <GLM/fwd.hpp>
 
 struct Mesh {
@@ -24,6 +27,15 @@ struct Mesh {
     int indexCount;
     std::string name;
     glm::vec4 baseColor = glm::vec4(1.0f);
+    glm::vec3 boundsMin = glm::vec3(0.0f); // Bounding box w przestrzeni lokalnej
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+    glm::vec3 sphereCenter = glm::vec3(0.0f); // Sfera otaczajaca w przestrzeni lokalnej
+    float sphereRadius = 0.0f;
+    // Kopia geometrii na CPU (kolizje, picking): pozycje lokalne i trojkaty
+    std::vector<glm::vec3> positions;
+    std::vector<unsigned int> triangles;
+    TriangleBvh triangleBvh; // Nad trojkatami, do pickingu
+    std::vector<MeshLod> lods; // [0] pelny mesh, uproszczone za nim w tym samym EBO
     Mesh() : indexCount(0) {}
 };
 
@@ -48,6 +60,13 @@ struct Node {
     int parent = -1;
     std::vector<int> children;
     int meshIndex = -1;
+    // Mesh bounds in world space, recomputed whenever globalTransform changes
+    glm::vec3 worldBoundsMin = glm::vec3(0.0f);
+    glm::vec3 worldBoundsMax = glm::vec3(0.0f);
+    glm::vec3 worldCenter = glm::vec3(0.0f);
+    float worldRadius = 0.0f;
+    bool boundsValid = false;
+    int lod = 0; // level of detail of the mesh drawn for this node, from SelectLods
 };
 
 class Model {
@@ -55,11 +74,51 @@ public:
     Model(const std::string& path);
     Model(const std::string& path, const glm::mat4& transform);
     ~Model();    void Draw(Shader& shader);
+    // Draws the mesh nodes flagged in visibleNodes (indexed by node), e.g. from SceneBvh::CullModels
+    void Draw(Shader& shader, const std::vector<uint8_t>& visibleNodes);
+    // Depth only pass (shadow maps): the listed mesh nodes at full detail,
+    // with their transforms from the last UpdateTransforms; only sets
+    // modelMatrix, leaves face culling and the rest of the state alone
+    void DrawDepth(Shader& shader, const std::vector<int>& nodeList);
+    // Meshes drawn and culled by the last Draw
+    const CullStats& GetCullStats() const { return cullStats; }
     void UpdateAnimation(float time);
+    // UpdateAnimation in two halves, so the clip can run on another thread
+    // than the one drawing: the clip clock (false when nothing is playing)
+    // and every node's local transform at the current clip time
+    bool AdvanceAnimation(float deltaTime);
+    void SampleAnimation(std::vector<glm::mat4>& localTransforms) const;
     void TriggerOneShotAnimation();
     bool IsAnimationPlaying() const;
     void SetDoubleSided(bool doubleSided); // Nowa metoda do kontrolowania face culling
 
+    // Node access for systems that drive transforms directly (physics)
+    int GetNodeCount() const { return static_cast<int>(nodes.size()); }
+    const Node& GetNode(int index) const { return nodes[index]; }
+    // Local space geometry of the node's mesh, nullptr when it has none
+    const Mesh* GetNodeMesh(int index) const { return nodes[index].meshIndex >= 0 ? &meshes[nodes[index].meshIndex] : nullptr; }
+    int FindNode(const std::string& name) const;
+    // True when a channel of the clip targets the node
+    bool IsNodeAnimated(int index) const;
+    void SetNodeLocalTransform(int index, const glm::mat4& transform);
+    void GetNodeLocalTransforms(std::vector<glm::mat4>& localTransforms) const;
+    void SetNodeLocalTransforms(const std::vector<glm::mat4>& localTransforms);
+    // Recomputes globalTransform of every node, including the model transform
+    void UpdateTransforms();
+    // World space box of the node's mesh; false when the node has no mesh
+    bool GetNodeWorldBounds(int index, glm::vec3& boundsMin, glm::vec3& boundsMax) const;
+    // Appends the node's triangles in world space, three vertices each
+    bool GetNodeWorldTriangles(int index, std::vector<glm::vec3>& triangles) const;
+    // World space ray against the node's mesh; hit.distance is along direction
+    bool RaycastNode(int index, glm::vec3 origin, glm::vec3 direction, float maxDistance, TriangleHit& hit) const;
+    // Node drawn highlighted (hover), -1 for none
+    void SetHighlightNode(int index) { highlightNode = index; }
+    // Picks each mesh node's level of detail: the coarsest whose error, times
+    // projectionScale (Camera::projectionScale) over the distance, stays under
+    // maxPixelError. A coarser level must fit well under it before it
+    // replaces the current one, so levels do not flicker at the boundary.
+    void SelectLods(glm::vec3 cameraPosition, float projectionScale, float maxPixelError);
+
 private:
     std::string path;
     std::vector<Mesh> meshes;
@@ -70,14 +129,19 @@ private:
     glm::vec4 baseColor = glm::vec4(1.0f);
     glm::mat4 modelTransform = glm::mat4(1.0f); // Dodana transformacja modelu
     bool doubleSided = false; // Flaga kontrolująca face culling
+    CullStats cullStats;
+    int highlightNode = -1;
+    LodCache lodCache; // Tylko podczas ladowania
     void LoadModel(const std::string& path);
     void ProcessNode(tinygltf::Model& model, int nodeIndex, int parentIndex);
     void ProcessMesh(tinygltf::Model& model, int meshIndex);
     void ProcessAnimations(tinygltf::Model& model);
     glm::vec4 InterpolateValues(const std::vector<float>& times, 
                                const std::vector<glm::vec4>& values, 
-                               float currentTime);
+                               float currentTime) const;
     void UpdateNodeHierarchy(int nodeIndex, const glm::mat4& parentTransform);
+    void UpdateNodeBounds(int nodeIndex);
+    void DrawNodes(Shader& shader, const std::vector<uint8_t>* visibleNodes);
 };
 
 #endif
@@ -0,0 +1,413 @@
+#include"OcclusionCuller.h"
+#include"SimdLanes.h"
+#include<algorithm>
+#include<chrono>
+#include<cmath>
+#include<limits>
+
+namespace
+{
+	// Pixel centers of a lane group, from its first pixel
+	alignas(32) const float LANE_CENTERS[8] = { 0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f };
+	const float MIN_TRIANGLE_AREA = 1e-4f;   // twice the area in pixels; smaller ones cover no center
+	const int NEXT_VERTEX[4] = { 1, 2, 0, 1 };
+
+	// std::floor and std::ceil are calls without SSE4.1; x must fit an int
+	int FloorToInt(float x)
+	{
+		int i = static_cast<int>(x);
+		return i - (static_cast<float>(i) > x ? 1 : 0);
+	}
+
+	int CeilToInt(float x)
+	{
+		int i = static_cast<int>(x);
+		return i + (static_cast<float>(i) < x ? 1 : 0);
+	}
+
+	// Pixel of an NDC coordinate, kept within [-1, size] so it fits an int
+	int ToPixel(float ndc, int size)
+	{
+		float pixel = std::floor((ndc * 0.5f + 0.5f) * size);
+		return static_cast<int>(std::clamp(pixel, -1.0f, static_cast<float>(size)));
+	}
+
+	double MillisecondsSince(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+}
+
+OcclusionCuller::OcclusionCuller(int threadCount)
+	: pool(threadCount)
+{
+	static_assert(BAND_ROWS == 1 << BAND_LEVELS, "a band must reduce to one row of the last band level");
+	static_assert(WIDTH % BAND_ROWS == 0 && HEIGHT % BAND_ROWS == 0, "the screen must split into whole bands");
+	static_assert(WIDTH % 8 == 0, "rows must be whole lane blocks");
+
+	bandStart.resize(HEIGHT / BAND_ROWS + 1);
+	depthStorage.resize(WIDTH * HEIGHT / 8);
+	depth = reinterpret_cast<float*>(depthStorage.data());
+	std::fill(depth, depth + WIDTH * HEIGHT, 1.0f);
+
+	levels.push_back({ WIDTH, HEIGHT, depth });
+	size_t pyramidSize = 0;
+	while (levels.back().width > 1 || levels.back().height > 1) {
+		Level level = { (levels.back().width + 1) / 2, (levels.back().height + 1) / 2, nullptr };
+		pyramidSize += static_cast<size_t>(level.width) * level.height;
+		levels.push_back(level);
+	}
+	pyramid.assign(pyramidSize, 1.0f);
+	float* data = pyramid.data();
+	for (size_t i = 1; i < levels.size(); i++) {
+		levels[i].data = data;
+		data += static_cast<size_t>(levels[i].width) * levels[i].height;
+	}
+}
+
+void OcclusionCuller::SetOccluder(int model, int node, bool occluder)
+{
+	if (model < 0 || node < 0)
+		return;
+	if (static_cast<int>(flags.size()) <= model)
+		flags.resize(model + 1);
+	if (static_cast<int>(flags[model].size()) <= node)
+		flags[model].resize(node + 1, 0);
+	flags[model][node] = occluder ? 1 : 0;
+}
+
+void OcclusionCuller::Cull(SceneBvh& scene, const glm::mat4& viewProjection)
+{
+	Begin(viewProjection);
+	const std::vector<int>& inView = scene.GetFrustumItems();
+	isOccluder.assign(scene.GetItemCount(), 0);
+
+	// Flagged occluders first, then the auto ones by screen area
+	candidates.clear();
+	for (int item : inView) {
+		const SceneItem& sceneItem = scene.GetItem(item);
+		const Mesh* mesh = scene.GetModel(sceneItem.model).GetNodeMesh(sceneItem.node);
+		if (mesh == nullptr || mesh->triangles.empty())
+			continue;
+		bool flagged = sceneItem.model < static_cast<int>(flags.size())
+			&& sceneItem.node < static_cast<int>(flags[sceneItem.model].size())
+			&& flags[sceneItem.model][sceneItem.node] != 0;
+		if (!flagged && static_cast<int>(mesh->triangles.size() / 3) > MAX_AUTO_TRIANGLES)
+			continue;
+		// A box through the near plane is as good as the whole screen
+		float area = 1.0f;
+		ScreenRect rect;
+		if (ProjectBox(sceneItem.boundsMin, sceneItem.boundsMax, rect)) {
+			area = static_cast<float>((rect.maxX - rect.minX + 1) * (rect.maxY - rect.minY + 1)) / (WIDTH * HEIGHT);
+		}
+		if (flagged || area >= AUTO_MIN_AREA)
+			candidates.push_back({ item, area, flagged });
+	}
+	std::sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) {
+		return a.flagged != b.flagged ? a.flagged : a.area > b.area;
+	});
+
+	int budget = MAX_TRIANGLES;
+	for (const Candidate& candidate : candidates) {
+		const SceneItem& sceneItem = scene.GetItem(candidate.item);
+		const Model& model = scene.GetModel(sceneItem.model);
+		const Mesh& mesh = *model.GetNodeMesh(sceneItem.node);
+		int count = static_cast<int>(mesh.triangles.size() / 3);
+		if (!candidate.flagged && count > budget)
+			continue;
+		budget -= count;
+		AddOccluder(mesh, model.GetNode(sceneItem.node).globalTransform);
+		isOccluder[candidate.item] = 1;
+	}
+	Rasterize();
+
+	auto testStart = std::chrono::steady_clock::now();
+	for (int item : inView) {
+		if (isOccluder[item])
+			continue;
+		stats.tested++;
+		const SceneItem& sceneItem = scene.GetItem(item);
+		if (!IsVisible(sceneItem.boundsMin, sceneItem.boundsMax)) {
+			scene.HideItem(item);
+			stats.occluded++;
+		}
+	}
+	stats.testMs = MillisecondsSince(testStart);
+}
+
+void OcclusionCuller::Begin(const glm::mat4& viewProjection)
+{
+	this->viewProjection = viewProjection;
+	occluders.clear();
+	stats = OcclusionStats();
+}
+
+void OcclusionCuller::AddOccluder(const Mesh& mesh, const glm::mat4& world)
+{
+	if (mesh.triangles.empty())
+		return;
+	Occluder occluder;
+	occluder.mesh = &mesh;
+	occluder.transform = viewProjection * world;
+	occluder.firstTriangle = stats.occluderTriangles;
+	occluder.firstVertex = occluders.empty() ? 0 : occluders.back().firstVertex + static_cast<int>(occluders.back().mesh->positions.size());
+	occluders.push_back(occluder);
+	stats.occluders++;
+	stats.occluderTriangles += static_cast<int>(mesh.triangles.size() / 3);
+}
+
+void OcclusionCuller::Rasterize()
+{
+	auto start = std::chrono::steady_clock::now();
+	int vertexCount = occluders.empty() ? 0 : occluders.back().firstVertex + static_cast<int>(occluders.back().mesh->positions.size());
+	screenVertices.resize(vertexCount);
+	triangles.resize(stats.occluderTriangles);
+	triangleBands.resize(stats.occluderTriangles);
+
+	auto setup = [this](int begin, int end, int) {
+		for (int i = begin; i < end; i++) {
+			SetupOccluder(occluders[i]);
+		}
+	};
+	pool.ParallelFor(static_cast<int>(occluders.size()), 1, setup);
+	BinTriangles();
+
+	auto rasterize = [this](int begin, int end, int) {
+		for (int band = begin; band < end; band++) {
+			RasterizeBand(band);
+		}
+	};
+	pool.ParallelFor(HEIGHT / BAND_ROWS, 1, rasterize);
+
+	for (int level = BAND_LEVELS + 1; level < static_cast<int>(levels.size()); level++) {
+		ReduceLevel(level, 0, levels[level].height);
+	}
+	stats.rasterMs = MillisecondsSince(start);
+}
+
+bool OcclusionCuller::IsVisible(glm::vec3 boundsMin, glm::vec3 boundsMax) const
+{
+	ScreenRect rect;
+	if (!ProjectBox(boundsMin, boundsMax, rect))
+		return true;
+
+	// The finest level where the rectangle spans at most TEST_TEXELS each way
+	int level = 0;
+	while (level + 1 < static_cast<int>(levels.size())
+		&& ((rect.maxX >> level) - (rect.minX >> level) >= TEST_TEXELS || (rect.maxY >> level) - (rect.minY >> level) >= TEST_TEXELS)) {
+		level++;
+	}
+	const Level& texels = levels[level];
+	for (int y = rect.minY >> level; y <= rect.maxY >> level; y++) {
+		const float* row = texels.data + y * texels.width;
+		for (int x = rect.minX >> level; x <= rect.maxX >> level; x++) {
+			if (row[x] >= rect.depth)
+				return true;
+		}
+	}
+	return false;
+}
+
+bool OcclusionCuller::ProjectBox(glm::vec3 boundsMin, glm::vec3 boundsMax, ScreenRect& rect) const
+{
+	glm::vec3 ndcMin(std::numeric_limits<float>::max());
+	glm::vec3 ndcMax(-std::numeric_limits<float>::max());
+	for (int corner = 0; corner < 8; corner++) {
+		glm::vec4 point(
+			corner & 1 ? boundsMax.x : boundsMin.x,
+			corner & 2 ? boundsMax.y : boundsMin.y,
+			corner & 4 ? boundsMax.z : boundsMin.z,
+			1.0f);
+		glm::vec4 clip = viewProjection * point;
+		if (clip.w <= 0.0f || clip.z < -clip.w)
+			return false;
+		glm::vec3 ndc = glm::vec3(clip) / clip.w;
+		ndcMin = glm::min(ndcMin, ndc);
+		ndcMax = glm::max(ndcMax, ndc);
+	}
+
+	rect.minX = ToPixel(ndcMin.x, WIDTH);
+	rect.maxX = ToPixel(ndcMax.x, WIDTH);
+	rect.minY = ToPixel(ndcMin.y, HEIGHT);
+	rect.maxY = ToPixel(ndcMax.y, HEIGHT);
+	if (rect.maxX < 0 || rect.minX >= WIDTH || rect.maxY < 0 || rect.minY >= HEIGHT)
+		return false;
+	rect.minX = std::max(rect.minX, 0);
+	rect.maxX = std::min(rect.maxX, WIDTH - 1);
+	rect.minY = std::max(rect.minY, 0);
+	rect.maxY = std::min(rect.maxY, HEIGHT - 1);
+	rect.depth = ndcMin.z;
+	return true;
+}
+
+void OcclusionCuller::SetupOccluder(const Occluder& occluder)
+{
+	// Vertices to pixels and depth once each; w = 0 marks one in front of
+	// the near plane
+	const Mesh& mesh = *occluder.mesh;
+	glm::vec4* screen = screenVertices.data() + occluder.firstVertex;
+	for (size_t i = 0; i < mesh.positions.size(); i++) {
+		glm::vec4 clip = occluder.transform * glm::vec4(mesh.positions[i], 1.0f);
+		if (clip.w <= 0.0f || clip.z < -clip.w) {
+			screen[i] = glm::vec4(0.0f);
+			continue;
+		}
+		float inverseW = 1.0f / clip.w;
+		screen[i] = glm::vec4(
+			(clip.x * inverseW * 0.5f + 0.5f) * WIDTH,
+			(clip.y * inverseW * 0.5f + 0.5f) * HEIGHT,
+			clip.z * inverseW,
+			1.0f);
+	}
+
+	int count = static_cast<int>(mesh.triangles.size() / 3);
+	for (int t = 0; t < count; t++) {
+		ScreenTriangle& triangle = triangles[occluder.firstTriangle + t];
+		BandRange& bands = triangleBands[occluder.firstTriangle + t];
+		bands.first = 1;
+		bands.last = 0;
+
+		// Triangles reaching in front of the near plane are dropped, not
+		// clipped; an occluder drawn smaller only hides less
+		glm::vec4 v0 = screen[mesh.triangles[3 * t]];
+		glm::vec4 v1 = screen[mesh.triangles[3 * t + 1]];
+		glm::vec4 v2 = screen[mesh.triangles[3 * t + 2]];
+		if (v0.w == 0.0f || v1.w == 0.0f || v2.w == 0.0f)
+			continue;
+
+		// Both windings occlude; turn clockwise ones around
+		float area = (v1.x - v0.x) * (v2.y - v0.y) - (v2.x - v0.x) * (v1.y - v0.y);
+		if (area < 0.0f) {
+			std::swap(v1, v2);
+			area = -area;
+		}
+		if (!(area > MIN_TRIANGLE_AREA))
+			continue;
+
+		float minX = std::max(std::min(std::min(v0.x, v1.x), v2.x), -1.0f);
+		float maxX = std::min(std::max(std::max(v0.x, v1.x), v2.x), WIDTH + 1.0f);
+		float minY = std::max(std::min(std::min(v0.y, v1.y), v2.y), -1.0f);
+		float maxY = std::min(std::max(std::max(v0.y, v1.y), v2.y), HEIGHT + 1.0f);
+		triangle.minX = std::max(CeilToInt(minX - 0.5f), 0);
+		triangle.maxX = std::min(FloorToInt(maxX - 0.5f), WIDTH - 1);
+		if (triangle.minX > triangle.maxX)
+			continue;
+
+		// Edge k runs between the other two vertices and weights vertex k;
+		// over twice the area they interpolate depth, which is affine on screen
+		const glm::vec4* vertices[3] = { &v0, &v1, &v2 };
+		float inverseArea = 1.0f / area;
+		triangle.depthX = 0.0f;
+		triangle.depthY = 0.0f;
+		triangle.depthZ = 0.0f;
+		for (int k = 0; k < 3; k++) {
+			const glm::vec4& a = *vertices[NEXT_VERTEX[k]];
+			const glm::vec4& b = *vertices[NEXT_VERTEX[k + 1]];
+			triangle.edgeX[k] = a.y - b.y;
+			triangle.edgeY[k] = b.x - a.x;
+			triangle.edgeZ[k] = a.x * b.y - b.x * a.y;
+			float weight = vertices[k]->z * inverseArea;
+			triangle.depthX += triangle.edgeX[k] * weight;
+			triangle.depthY += triangle.edgeY[k] * weight;
+			triangle.depthZ += triangle.edgeZ[k] * weight;
+		}
+		triangle.minY = std::max(CeilToInt(minY - 0.5f), 0);
+		triangle.maxY = std::min(FloorToInt(maxY - 0.5f), HEIGHT - 1);
+		if (triangle.minY <= triangle.maxY) {
+			bands.first = static_cast<int16_t>(triangle.minY / BAND_ROWS);
+			bands.last = static_cast<int16_t>(triangle.maxY / BAND_ROWS);
+		}
+	}
+}
+
+void OcclusionCuller::BinTriangles()
+{
+	// Counting sort of the triangles into the bands they cross
+	std::fill(bandStart.begin(), bandStart.end(), 0);
+	for (const BandRange& range : triangleBands) {
+		for (int band = range.first; band <= range.last; band++) {
+			bandStart[band + 1]++;
+		}
+	}
+	for (size_t band = 1; band < bandStart.size(); band++) {
+		bandStart[band] += bandStart[band - 1];
+	}
+	bandTriangles.resize(bandStart.back());
+	bandFill.assign(bandStart.begin(), bandStart.end() - 1);
+	for (int i = 0; i < static_cast<int>(triangleBands.size()); i++) {
+		for (int band = triangleBands[i].first; band <= triangleBands[i].last; band++) {
+			bandTriangles[bandFill[band]++] = i;
+		}
+	}
+}
+
+void OcclusionCuller::RasterizeBand(int band)
+{
+	int firstRow = band * BAND_ROWS;
+	int lastRow = firstRow + BAND_ROWS - 1;
+	std::fill(depth + firstRow * WIDTH, depth + (lastRow + 1) * WIDTH, 1.0f);
+
+	const Lanes centers = Lanes::Load(LANE_CENTERS);
+	const Lanes zero = Lanes::Set(0.0f);
+	for (int i = bandStart[band]; i < bandStart[band + 1]; i++) {
+		const ScreenTriangle& triangle = triangles[bandTriangles[i]];
+		int minY = std::max(triangle.minY, firstRow);
+		int maxY = std::min(triangle.maxY, lastRow);
+		int startX = triangle.minX & ~(LANE_WIDTH - 1);
+
+		// Edges and depth at the lane centers of the first group, stepped
+		// along the row and down the rows
+		Lanes firstX = Lanes::Set(static_cast<float>(startX)) + centers;
+		Lanes edgeStep[3];
+		Lanes edgeRowStart[3];
+		for (int k = 0; k < 3; k++) {
+			edgeStep[k] = Lanes::Set(triangle.edgeX[k] * LANE_WIDTH);
+			edgeRowStart[k] = Lanes::Set(triangle.edgeX[k]) * firstX + Lanes::Set(triangle.edgeY[k] * (minY + 0.5f) + triangle.edgeZ[k]);
+		}
+		Lanes depthStep = Lanes::Set(triangle.depthX * LANE_WIDTH);
+		Lanes depthRowStart = Lanes::Set(triangle.depthX) * firstX + Lanes::Set(triangle.depthY * (minY + 0.5f) + triangle.depthZ);
+		Lanes edgeRowStep[3] = { Lanes::Set(triangle.edgeY[0]), Lanes::Set(triangle.edgeY[1]), Lanes::Set(triangle.edgeY[2]) };
+		Lanes depthRowStep = Lanes::Set(triangle.depthY);
+
+		for (int y = minY; y <= maxY; y++) {
+			Lanes edge0 = edgeRowStart[0];
+			Lanes edge1 = edgeRowStart[1];
+			Lanes edge2 = edgeRowStart[2];
+			Lanes pixelDepth = depthRowStart;
+			float* row = depth + y * WIDTH;
+			for (int x = startX; x <= triangle.maxX; x += LANE_WIDTH) {
+				LaneMask inside = (edge0 >= zero) & (edge1 >= zero) & (edge2 >= zero);
+				Lanes current = Lanes::Load(row + x);
+				Select(inside & (pixelDepth < current), pixelDepth, current).Store(row + x);
+				edge0 = edge0 + edgeStep[0];
+				edge1 = edge1 + edgeStep[1];
+				edge2 = edge2 + edgeStep[2];
+				pixelDepth = pixelDepth + depthStep;
+			}
+			for (int k = 0; k < 3; k++) {
+				edgeRowStart[k] = edgeRowStart[k] + edgeRowStep[k];
+			}
+			depthRowStart = depthRowStart + depthRowStep;
+		}
+	}
+
+	for (int level = 1; level <= BAND_LEVELS; level++) {
+		ReduceLevel(level, firstRow >> level, BAND_ROWS >> level);
+	}
+}
+
+void OcclusionCuller::ReduceLevel(int level, int firstRow, int rowCount)
+{
+	const Level& source = levels[level - 1];
+	const Level& target = levels[level];
+	for (int y = firstRow; y < firstRow + rowCount; y++) {
+		const float* above = source.data + 2 * y * source.width;
+		const float* below = source.data + std::min(2 * y + 1, source.height - 1) * source.width;
+		float* row = target.data + y * target.width;
+		for (int x = 0; x < target.width; x++) {
+			int left = 2 * x;
+			int right = std::min(2 * x + 1, source.width - 1);
+			row[x] = std::max(std::max(above[left], above[right]), std::max(below[left], below[right]));
+		}
+	}
+}
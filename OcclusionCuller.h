@@ -0,0 +1,160 @@
+#ifndef OCCLUSION_CULLER_CLASS_H
+#define OCCLUSION_CULLER_CLASS_H
+
+#include<cstdint>
+#include<vector>
+#include<glm/glm.hpp>
+
+#include"JobPool.h"
+#include"Model.h"
+#include"SceneBvh.h"
+
+struct OcclusionStats
+{
+	int occluders = 0;
+	int occluderTriangles = 0;
+	int tested = 0;
+	int occluded = 0;
+	double rasterMs = 0.0;     // occluder setup, rasterization and the depth pyramid
+	double testMs = 0.0;
+
+	void Add(const OcclusionStats& other)
+	{
+		occluders += other.occluders;
+		occluderTriangles += other.occluderTriangles;
+		tested += other.tested;
+		occluded += other.occluded;
+		rasterMs += other.rasterMs;
+		testMs += other.testMs;
+	}
+};
+
+// Software occlusion culling on a WIDTH x HEIGHT depth buffer. Each frame
+// the occluders in view (nodes flagged with SetOccluder, plus meshes of at
+// most MAX_AUTO_TRIANGLES covering AUTO_MIN_AREA of the screen) are
+// rasterized LANE_WIDTH pixels at a time, nearest depth wins. The buffer is
+// then reduced to a pyramid of the farthest depth per 2x2 texels. An item
+// is hidden when every texel its projected box covers, at the level where
+// the box spans at most TEST_TEXELS, is nearer than the box's nearest corner.
+// Occluders are drawn whatever they are behind.
+//
+// Triangle setup runs per occluder and rasterization per band of
+// BAND_ROWS rows on a JobPool, each band walking only the triangles binned
+// into it. A band also builds the first pyramid levels above it, so only
+// the last few tiny levels are left to the calling thread.
+// Depths are NDC z, -1 at the near plane and 1 at the far plane.
+class OcclusionCuller
+{
+public:
+	static const int WIDTH = 256;
+	static const int HEIGHT = 144;
+	static const int BAND_ROWS = 16;
+	static const int TEST_TEXELS = 4;
+	static const int MAX_AUTO_TRIANGLES = 4096;     // heavier meshes are occluders only when flagged
+	static const int MAX_TRIANGLES = 65536;         // per frame, the largest occluders first
+	static constexpr float AUTO_MIN_AREA = 0.05f;   // of the screen, for the box of an auto occluder
+
+	// threadCount 0 uses every hardware thread
+	explicit OcclusionCuller(int threadCount = 0);
+
+	// Marks a node of a SceneBvh model as an occluder whenever it is in view,
+	// whatever its size
+	void SetOccluder(int model, int node, bool occluder);
+
+	// Hides the items of the last SceneBvh::CullModels that the occluders
+	// among them cover; viewProjection must be the matrix that frustum came from
+	void Cull(SceneBvh& scene, const glm::mat4& viewProjection);
+
+	// The steps of Cull, for occluders and items from elsewhere: clears the
+	// buffer, adds meshes with their world transform, rasterizes them and
+	// tests world boxes
+	void Begin(const glm::mat4& viewProjection);
+	void AddOccluder(const Mesh& mesh, const glm::mat4& world);
+	void Rasterize();
+	bool IsVisible(glm::vec3 boundsMin, glm::vec3 boundsMax) const;
+
+	// Depth at pixel (x, y) after Rasterize, y up
+	float GetDepth(int x, int y) const { return depth[y * WIDTH + x]; }
+	const OcclusionStats& GetStats() const { return stats; }
+
+private:
+	static const int BAND_LEVELS = 4;   // pyramid levels built by the bands, BAND_ROWS = 1 << BAND_LEVELS
+
+	struct Occluder
+	{
+		const Mesh* mesh;
+		glm::mat4 transform;   // world to clip space
+		int firstVertex;
+		int firstTriangle;
+	};
+
+	// Screen space, set up for the bands in its BandRange
+	struct ScreenTriangle
+	{
+		float edgeX[3], edgeY[3], edgeZ[3];   // edgeX[k] * x + edgeY[k] * y + edgeZ[k] >= 0 inside
+		float depthX, depthY, depthZ;         // depth = depthX * x + depthY * y + depthZ
+		int minX, maxX, minY, maxY;           // pixels whose centers may be covered
+	};
+
+	// Bands a triangle crosses, kept apart so binning reads little; empty
+	// for rejected triangles
+	struct BandRange
+	{
+		int16_t first;
+		int16_t last;
+	};
+
+	// Screen rectangle of a world box, in pixels, and its nearest depth
+	struct ScreenRect
+	{
+		int minX, maxX, minY, maxY;
+		float depth;
+	};
+
+	struct Candidate
+	{
+		int item;
+		float area;
+		bool flagged;
+	};
+
+	// Rows are whole blocks, so every row starts 32 byte aligned
+	struct alignas(32) LaneBlock
+	{
+		float values[8];
+	};
+
+	struct Level
+	{
+		int width;
+		int height;
+		float* data;
+	};
+
+	JobPool pool;
+	glm::mat4 viewProjection = glm::mat4(1.0f);
+	std::vector<LaneBlock> depthStorage;
+	float* depth = nullptr;
+	std::vector<float> pyramid;        // levels 1 and up, one after another
+	std::vector<Level> levels;         // level 0 is depth
+	std::vector<Occluder> occluders;
+	std::vector<glm::vec4> screenVertices;
+	std::vector<ScreenTriangle> triangles;
+	std::vector<BandRange> triangleBands;
+	std::vector<int> bandStart;        // bandTriangles[bandStart[band]] onwards cross the band
+	std::vector<int> bandFill;
+	std::vector<int> bandTriangles;
+	std::vector<std::vector<uint8_t>> flags;   // per model and node of SetOccluder
+	std::vector<Candidate> candidates;
+	std::vector<uint8_t> isOccluder;   // per item, this frame
+	OcclusionStats stats;
+
+	// False when the box reaches in front of the near plane or off the screen
+	bool ProjectBox(glm::vec3 boundsMin, glm::vec3 boundsMax, ScreenRect& rect) const;
+	void SetupOccluder(const Occluder& occluder);
+	void BinTriangles();
+	void RasterizeBand(int band);
+	void ReduceLevel(int level, int firstRow, int rowCount);
+};
+
+#endif
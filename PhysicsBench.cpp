@@ -0,0 +1,550 @@
+// Physics benchmark: plays a fixed set of canonical scenarios through the
+// event simulator (and the break once through the fixed-step physics),
+// measures events and shots per second, heap allocations and a determinism
+// hash, and writes the results as JSON. It fails when an event shot leaves
+// two balls closer than a diameter, and given a stored baseline when any
+// scenario got slower than the threshold allows, so it can gate a build.
+// Links only the physics, no window, GL context or GPU (PhysicsBench.vcxproj
+// on Windows). On Linux, with GLM installed:
+//   g++ -O2 -mavx2 -mfma -std=c++20 PhysicsBench.cpp BilliardPhysics.cpp
+//       BallKernels.cpp EventSimulator.cpp TableGeometry.cpp -o physicsbench
+//   ./physicsbench --out bench.json
+//   ./physicsbench --baseline bench.json --threshold 0.1
+
+#include<algorithm>
+#include<atomic>
+#include<chrono>
+#include<cmath>
+#include<cstdio>
+#include<cstdlib>
+#include<fstream>
+#include<functional>
+#include<iostream>
+#include<limits>
+#include<new>
+#include<random>
+#include<string>
+#include<vector>
+
+#include"BilliardPhysics.h"
+#include"EventSimulator.h"
+#include"SimdLanes.h"
+#include"TableGeometry.h"
+#include"json.hpp"
+
+using json = nlohmann::json;
+
+// Every heap allocation of the process goes through here, so a scenario can
+// report how many it made while timed (a steady state simulation makes none).
+// The array and nothrow forms call these; the aligned ones are replaced too,
+// and each form is freed by the matching function.
+namespace
+{
+	std::atomic<int64_t> allocationCount{ 0 };
+
+	void* Allocate(std::size_t size, std::size_t alignment)
+	{
+		allocationCount.fetch_add(1, std::memory_order_relaxed);
+		size = size != 0 ? size : 1;
+#ifdef _WIN32
+		void* memory = alignment != 0 ? _aligned_malloc(size, alignment) : std::malloc(size);
+#else
+		// aligned_alloc wants a whole number of alignments
+		void* memory = alignment != 0 ? std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment) : std::malloc(size);
+#endif
+		if (memory == nullptr) {
+			throw std::bad_alloc();
+		}
+		return memory;
+	}
+
+	void Release(void* memory, bool aligned) noexcept
+	{
+#ifdef _WIN32
+		if (aligned) {
+			_aligned_free(memory);
+			return;
+		}
+#else
+		(void)aligned;
+#endif
+		std::free(memory);
+	}
+}
+
+void* operator new(std::size_t size)
+{
+	return Allocate(size, 0);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+	return Allocate(size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void* memory) noexcept
+{
+	Release(memory, false);
+}
+
+void operator delete(void* memory, std::size_t) noexcept
+{
+	Release(memory, false);
+}
+
+void operator delete(void* memory, std::align_val_t) noexcept
+{
+	Release(memory, true);
+}
+
+void operator delete(void* memory, std::size_t, std::align_val_t) noexcept
+{
+	Release(memory, true);
+}
+
+namespace
+{
+	const int RACK_ROWS = 5;
+	const float RACK_GAP = 1.0001f;           // in ball diameters, so the rack starts just apart
+	const int MAX_STEPS_PER_SHOT = 240 * 60;  // a minute of fixed steps
+	const float OVERLAP_TOLERANCE = 3.5e-4f;  // of the ball radius, float rounding of resting balls in contact
+	const uint64_t FNV_OFFSET = 14695981039346656037ull;
+	const uint64_t FNV_PRIME = 1099511628211ull;
+
+	const int BREAK_SHOTS = 200;
+	const int CLUSTER_SHOTS = 200;
+	const int BANK_SHOTS = 256;
+	const int RANDOM_SHOTS = 10000;
+
+	struct BenchShot
+	{
+		glm::vec2 direction = glm::vec2(1.0f, 0.0f);
+		float speed = 0.0f;
+		float follow = 0.0f;
+		float english = 0.0f;
+	};
+
+	// One table and the shots played from it, each from the same start
+	struct Scenario
+	{
+		std::string name;
+		bool fixedStep = false;
+		BallSet start;
+		std::vector<BenchShot> shots;
+	};
+
+	struct ScenarioResult
+	{
+		int64_t shots = 0;
+		int64_t events = 0;     // events handled, or fixed steps taken
+		int64_t allocations = 0;
+		double seconds = 0.0;
+		uint64_t hash = FNV_OFFSET;
+		bool deterministic = true;
+		float closest = std::numeric_limits<float>::infinity();   // centres of two resting balls, in diameters
+		int overlaps = 0;       // event shots ending with balls inside each other
+	};
+
+	uint64_t MixHash(uint64_t hash, uint64_t value)
+	{
+		for (int i = 0; i < 8; i++) {
+			hash ^= (value >> (i * 8)) & 0xff;
+			hash *= FNV_PRIME;
+		}
+		return hash;
+	}
+
+	std::string HexHash(uint64_t hash)
+	{
+		char text[17];
+		std::snprintf(text, sizeof(text), "%016llx", static_cast<unsigned long long>(hash));
+		return text;
+	}
+
+	// Smallest distance between the centres of two balls on the table
+	float ClosestPair(const BallSet& balls)
+	{
+		float closest = std::numeric_limits<float>::infinity();
+		for (int i = 0; i < balls.count; i++) {
+			for (int j = i + 1; j < balls.count; j++) {
+				if (balls.phase[i] != BallPhase::Pocketed && balls.phase[j] != BallPhase::Pocketed) {
+					closest = std::min(closest, std::hypot(balls.px[j] - balls.px[i], balls.pz[j] - balls.pz[i]));
+				}
+			}
+		}
+		return closest;
+	}
+
+	void AddBall(BallSet& balls, glm::vec2 position)
+	{
+		int i = balls.count++;
+		balls.px[i] = position.x;
+		balls.pz[i] = position.y;
+		balls.qw[i] = 1.0f;
+	}
+
+	// Cue ball at the head spot, fifteen balls in a triangle at the foot spot
+	void RackBalls(const TableSpec& table, BallSet& balls)
+	{
+		balls = BallSet();
+		float R = table.ballRadius;
+		float spot = 0.5f * table.halfSizeX;
+		AddBall(balls, table.center + glm::vec2(-spot, 0.0f));
+		for (int row = 0; row < RACK_ROWS; row++) {
+			for (int k = 0; k <= row; k++) {
+				AddBall(balls, table.center + glm::vec2(spot + row * R * std::sqrt(3.0f) * RACK_GAP, (k - 0.5f * row) * 2.0f * R * RACK_GAP));
+			}
+		}
+	}
+
+	// Full rack, hard straight breaks with a little spread and spin
+	Scenario MakeBreak(const TableSpec& table, bool fixedStep, int shotCount)
+	{
+		Scenario scenario;
+		scenario.name = fixedStep ? "break_fixed_step" : "break";
+		scenario.fixedStep = fixedStep;
+		RackBalls(table, scenario.start);
+		std::mt19937 random(40);
+		std::uniform_real_distribution<float> spread(-0.02f, 0.02f);
+		std::uniform_real_distribution<float> tip(-0.3f, 0.3f);
+		for (int i = 0; i < shotCount; i++) {
+			scenario.shots.push_back({ glm::normalize(glm::vec2(1.0f, spread(random))), 8.0f, tip(random), tip(random) });
+		}
+		return scenario;
+	}
+
+	// Fifteen balls frozen against each other in a square block at the
+	// center, hit softly: many simultaneous, touching contacts
+	Scenario MakeCluster(const TableSpec& table)
+	{
+		Scenario scenario;
+		scenario.name = "cluster";
+		float R = table.ballRadius;
+		AddBall(scenario.start, table.center + glm::vec2(-0.4f * table.halfSizeX, 0.0f));
+		for (int k = 0; k < 15; k++) {
+			int row = k / 4;
+			int column = k % 4;
+			AddBall(scenario.start, table.center + glm::vec2((row - 1.5f) * 2.0f * R * RACK_GAP, (column - 1.5f) * 2.0f * R * RACK_GAP));
+		}
+		std::mt19937 random(41);
+		std::uniform_real_distribution<float> spread(-0.1f, 0.1f);
+		std::uniform_real_distribution<float> speed(1.0f, 3.0f);
+		for (int i = 0; i < CLUSTER_SHOTS; i++) {
+			scenario.shots.push_back({ glm::normalize(glm::vec2(1.0f, spread(random))), speed(random), 0.0f, 0.0f });
+		}
+		return scenario;
+	}
+
+	// Cue ball and one object ball, struck fast at shallow angles so it
+	// runs the length of the table off many cushions
+	Scenario MakeBanks(const TableSpec& table)
+	{
+		Scenario scenario;
+		scenario.name = "banks";
+		AddBall(scenario.start, table.center + glm::vec2(-0.6f * table.halfSizeX, -0.3f * table.halfSizeZ));
+		AddBall(scenario.start, table.center + glm::vec2(0.6f * table.halfSizeX, 0.5f * table.halfSizeZ));
+		for (int i = 0; i < BANK_SHOTS; i++) {
+			float angle = 6.2831853f * (i + 0.5f) / BANK_SHOTS;
+			scenario.shots.push_back({ glm::vec2(std::cos(angle), std::sin(angle)), 7.0f, (i % 3 - 1) * 0.3f, (i % 5 - 2) * 0.15f });
+		}
+		return scenario;
+	}
+
+	// Full rack, any direction, speed and spin from a fixed seed
+	Scenario MakeRandom(const TableSpec& table)
+	{
+		Scenario scenario;
+		scenario.name = "random";
+		RackBalls(table, scenario.start);
+		std::mt19937 random(42);
+		std::uniform_real_distribution<float> angle(0.0f, 6.2831853f);
+		std::uniform_real_distribution<float> speed(0.5f, 9.0f);
+		std::uniform_real_distribution<float> tip(-0.5f, 0.5f);
+		for (int i = 0; i < RANDOM_SHOTS; i++) {
+			float a = angle(random);
+			scenario.shots.push_back({ glm::vec2(std::cos(a), std::sin(a)), speed(random), tip(random), tip(random) });
+		}
+		return scenario;
+	}
+
+	struct BenchTable
+	{
+		EventSimulator simulator;
+		BilliardPhysics physics;
+		BilliardPhysics hasher;
+	};
+
+	// Plays one shot from the scenario start, returns the events or steps
+	// taken. An event shot also gives the closest pair it came to rest with.
+	int PlayShot(const Scenario& scenario, const BenchShot& shot, BenchTable& bench, uint64_t& hash, float& closest)
+	{
+		int events = 0;
+		if (scenario.fixedStep) {
+			BilliardPhysics& physics = bench.physics;
+			physics.balls = scenario.start;
+			physics.Strike(0, shot.direction, shot.speed, shot.follow, shot.english);
+			while (!physics.IsAtRest() && events < MAX_STEPS_PER_SHOT) {
+				physics.Step();
+				events++;
+			}
+			bench.hasher.balls = physics.balls;
+		}
+		else {
+			bench.simulator.Reset(scenario.start);
+			bench.simulator.Strike(0, shot.direction, shot.speed, shot.follow, shot.english);
+			events = bench.simulator.SimulateToRest();
+			bench.hasher.balls = bench.simulator.GetBalls();
+			closest = bench.simulator.IsAtRest() ? ClosestPair(bench.hasher.balls) : 0.0f;
+		}
+		hash = bench.hasher.StateHash();
+		return events;
+	}
+
+	ScenarioResult RunScenario(const Scenario& scenario, const TableSpec& table, const PhysicsParams& params)
+	{
+		BenchTable bench;
+		bench.simulator.table = table;
+		bench.simulator.params = params;
+		bench.simulator.recordHistory = false;
+		bench.physics.table = table;
+		bench.physics.params = params;
+
+		// One untimed shot grows the event queue, so the timed loop shows
+		// the steady state, which should not allocate at all
+		uint64_t shotHash = 0;
+		float closest = std::numeric_limits<float>::infinity();
+		if (!scenario.shots.empty()) {
+			PlayShot(scenario, scenario.shots.front(), bench, shotHash, closest);
+		}
+
+		ScenarioResult result;
+		int64_t allocationsBefore = allocationCount.load(std::memory_order_relaxed);
+		auto start = std::chrono::steady_clock::now();
+		for (const BenchShot& shot : scenario.shots) {
+			result.events += PlayShot(scenario, shot, bench, shotHash, closest);
+			result.hash = MixHash(result.hash, shotHash);
+			result.shots++;
+			// Balls never pass through each other, however slowly they meet
+			result.closest = std::min(result.closest, closest / (2.0f * table.ballRadius));
+			if (closest < (2.0f - OVERLAP_TOLERANCE) * table.ballRadius) {
+				result.overlaps++;
+			}
+		}
+		result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		result.allocations = allocationCount.load(std::memory_order_relaxed) - allocationsBefore;
+		return result;
+	}
+
+	// Runs the scenario repeat times and keeps the fastest; every run has to
+	// end on the same hash
+	ScenarioResult BestOf(const Scenario& scenario, const TableSpec& table, const PhysicsParams& params, int repeat)
+	{
+		ScenarioResult best = RunScenario(scenario, table, params);
+		for (int i = 1; i < repeat; i++) {
+			ScenarioResult run = RunScenario(scenario, table, params);
+			if (run.hash != best.hash) {
+				best.deterministic = false;
+			}
+			if (run.seconds < best.seconds) {
+				run.deterministic = best.deterministic;
+				best = run;
+			}
+		}
+		return best;
+	}
+
+	double PerSecond(int64_t count, double seconds)
+	{
+		return seconds > 0.0 ? count / seconds : 0.0;
+	}
+
+	bool LoadBaseline(const std::string& path, json& baseline)
+	{
+		std::ifstream file(path);
+		if (!file) {
+			std::cout << "[BENCH] Cannot open baseline " << path << std::endl;
+			return false;
+		}
+		try {
+			file >> baseline;
+		}
+		catch (const json::exception& error) {
+			std::cout << "[BENCH] Cannot parse baseline " << path << ": " << error.what() << std::endl;
+			return false;
+		}
+		return baseline.contains("scenarios") && baseline["scenarios"].is_array();
+	}
+
+	void PrintUsage()
+	{
+		std::cout << "Usage: physicsbench [--out file.json] [--baseline file.json] [--threshold fraction]" << std::endl
+				  << "                    [--repeat N] [--scenario name] [--strict-hash]" << std::endl;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::string outPath = "physics_bench.json";
+	std::string baselinePath;
+	std::string only;
+	double threshold = 0.1;
+	int repeat = 3;
+	bool strictHash = false;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--out" && hasValue) {
+			outPath = argv[++i];
+		}
+		else if (arg == "--baseline" && hasValue) {
+			baselinePath = argv[++i];
+		}
+		else if (arg == "--threshold" && hasValue) {
+			// atof would read a typo as 0 and fail every scenario
+			const char* text = argv[++i];
+			char* end = nullptr;
+			threshold = std::strtod(text, &end);
+			if (end == text || *end != '\0' || !(threshold >= 0.0)) {
+				std::cout << "[BENCH] --threshold wants a fraction of 0 or more, got " << text << std::endl;
+				PrintUsage();
+				return 1;
+			}
+		}
+		else if (arg == "--repeat" && hasValue) {
+			const char* text = argv[++i];
+			char* end = nullptr;
+			long count = std::strtol(text, &end, 10);
+			if (end == text || *end != '\0' || count < 1 || count > std::numeric_limits<int>::max()) {
+				std::cout << "[BENCH] --repeat wants a count of 1 or more, got " << text << std::endl;
+				PrintUsage();
+				return 1;
+			}
+			repeat = static_cast<int>(count);
+		}
+		else if (arg == "--scenario" && hasValue) {
+			only = argv[++i];
+		}
+		else if (arg == "--strict-hash") {
+			strictHash = true;
+		}
+		else {
+			PrintUsage();
+			return arg == "--help" ? 0 : 1;
+		}
+	}
+
+	json baseline;
+	if (!baselinePath.empty() && !LoadBaseline(baselinePath, baseline)) {
+		return 2;
+	}
+
+	TableSpec table;
+	table.PlacePockets();
+	TableGeometry rails;
+	rails.BuildFromRails(table);
+	table.geometry = &rails;
+	PhysicsParams params;
+
+	std::vector<Scenario> scenarios;
+	scenarios.push_back(MakeBreak(table, false, BREAK_SHOTS));
+	scenarios.push_back(MakeBreak(table, true, BREAK_SHOTS / 10));
+	scenarios.push_back(MakeCluster(table));
+	scenarios.push_back(MakeBanks(table));
+	scenarios.push_back(MakeRandom(table));
+	// A misspelt name would run nothing and pass
+	if (!only.empty() && std::none_of(scenarios.begin(), scenarios.end(),
+		[&only](const Scenario& scenario) { return scenario.name == only; })) {
+		std::cout << "[BENCH] No scenario named " << only << std::endl;
+		PrintUsage();
+		return 1;
+	}
+
+	json report;
+	report["laneBackend"] = LANE_BACKEND;
+	report["repeat"] = repeat;
+	report["threshold"] = threshold;
+	report["scenarios"] = json::array();
+	report["regressions"] = json::array();
+
+	bool failed = false;
+	for (const Scenario& scenario : scenarios) {
+		if (!only.empty() && scenario.name != only) {
+			continue;
+		}
+		ScenarioResult result = BestOf(scenario, table, params, repeat);
+		double shotsPerSecond = PerSecond(result.shots, result.seconds);
+		double eventsPerSecond = PerSecond(result.events, result.seconds);
+		std::string hash = HexHash(result.hash);
+
+		json entry;
+		entry["name"] = scenario.name;
+		entry["engine"] = scenario.fixedStep ? "fixed_step" : "event";
+		entry["shots"] = result.shots;
+		entry[scenario.fixedStep ? "steps" : "events"] = result.events;
+		entry["seconds"] = result.seconds;
+		entry["shotsPerSecond"] = shotsPerSecond;
+		entry[scenario.fixedStep ? "stepsPerSecond" : "eventsPerSecond"] = eventsPerSecond;
+		entry["allocations"] = result.allocations;
+		entry["hash"] = hash;
+		entry["deterministic"] = result.deterministic;
+		if (!scenario.fixedStep) {
+			entry["closestPair"] = result.closest;
+			entry["overlaps"] = result.overlaps;
+		}
+		report["scenarios"].push_back(entry);
+
+		std::cout << "[BENCH] " << scenario.name << ": " << result.shots << " shots in " << result.seconds << " s, "
+				  << static_cast<int64_t>(shotsPerSecond) << " shots/s, " << static_cast<int64_t>(eventsPerSecond)
+				  << (scenario.fixedStep ? " steps/s, " : " events/s, ") << result.allocations << " allocations, hash " << hash
+				  << std::endl;
+
+		if (!result.deterministic) {
+			std::cout << "[BENCH] " << scenario.name << ": runs ended on different states" << std::endl;
+			report["regressions"].push_back({ { "name", scenario.name }, { "reason", "nondeterministic" } });
+			failed = true;
+		}
+		if (result.overlaps > 0) {
+			std::cout << "[BENCH] " << scenario.name << ": " << result.overlaps << " shots left balls inside each other or moving, closest "
+					  << result.closest << " diameters" << std::endl;
+			report["regressions"].push_back({ { "name", scenario.name }, { "reason", "overlap" }, { "shots", result.overlaps } });
+			failed = true;
+		}
+		if (baseline.is_null()) {
+			continue;
+		}
+		for (const json& stored : baseline["scenarios"]) {
+			if (stored.value("name", "") != scenario.name) {
+				continue;
+			}
+			double baseShotsPerSecond = stored.value("shotsPerSecond", 0.0);
+			double ratio = baseShotsPerSecond > 0.0 ? shotsPerSecond / baseShotsPerSecond : 1.0;
+			if (ratio < 1.0 - threshold) {
+				std::cout << "[BENCH] " << scenario.name << ": " << static_cast<int>((1.0 - ratio) * 100.0 + 0.5)
+						  << "% slower than the baseline" << std::endl;
+				report["regressions"].push_back({ { "name", scenario.name }, { "reason", "throughput" }, { "ratio", ratio } });
+				failed = true;
+			}
+			// A changed hash is expected after a deliberate physics change, so only fail on request
+			if (stored.value("hash", hash) != hash) {
+				std::cout << "[BENCH] " << scenario.name << ": hash differs from the baseline (" << stored.value("hash", "")
+						  << ")" << std::endl;
+				if (strictHash) {
+					report["regressions"].push_back({ { "name", scenario.name }, { "reason", "hash" } });
+					failed = true;
+				}
+			}
+		}
+	}
+	report["passed"] = !failed;
+
+	std::ofstream file(outPath);
+	if (file) {
+		file << report.dump(2) << std::endl;
+		std::cout << "[BENCH] Results written to " << outPath << std::endl;
+	}
+	else {
+		std::cout << "[BENCH] Cannot write " << outPath << std::endl;
+	}
+	std::cout << "[BENCH] " << (failed ? "FAILED" : "passed") << std::endl;
+	return failed ? 1 : 0;
+}
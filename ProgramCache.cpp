@@ -0,0 +1,181 @@
+#include"ProgramCache.h"
+#include"RenderDevice.h"
+#include<cstring>
+#include<fstream>
+#include<iostream>
+#include<iterator>
+
+namespace
+{
+	const uint32_t PROGRAM_MAGIC = 0x47525042;   // "BPRG" read as little-endian bytes
+	const uint64_t FNV_OFFSET = 1469598103934665603ull;
+	const uint64_t FNV_PRIME = 1099511628211ull;
+
+	uint64_t Fnv(uint64_t hash, const void* data, size_t size)
+	{
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		for (size_t i = 0; i < size; i++) {
+			hash = (hash ^ bytes[i]) * FNV_PRIME;
+		}
+		return hash;
+	}
+
+	// Length first, so the end of one string never passes for the start of the next
+	uint64_t FnvString(uint64_t hash, const std::string& text)
+	{
+		uint64_t length = text.size();
+		hash = Fnv(hash, &length, sizeof(length));
+		return Fnv(hash, text.data(), text.size());
+	}
+
+	template<class T>
+	void Put(std::vector<uint8_t>& out, const T& value)
+	{
+		const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+		out.insert(out.end(), bytes, bytes + sizeof(T));
+	}
+
+	struct Reader
+	{
+		const std::vector<uint8_t>& data;
+		size_t offset = 0;
+
+		template<class T>
+		bool Get(T& value)
+		{
+			if (offset + sizeof(T) > data.size())
+				return false;
+			std::memcpy(&value, data.data() + offset, sizeof(T));
+			offset += sizeof(T);
+			return true;
+		}
+	};
+}
+
+uint64_t ProgramCache::Key(const std::string& vertexSource, const std::string& fragmentSource)
+{
+	uint64_t hash = Fnv(FNV_OFFSET, &FORMAT_VERSION, sizeof(FORMAT_VERSION));
+	hash = FnvString(hash, vertexSource);
+	return FnvString(hash, fragmentSource);
+}
+
+uint64_t ProgramCache::DriverHash()
+{
+	RenderDevice& device = RenderDevice::Get();
+	uint64_t hash = FNV_OFFSET;
+	for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION }) {
+		hash = FnvString(hash, device.GetString(name));
+	}
+	return hash;
+}
+
+bool ProgramCache::Load(const std::string& path)
+{
+	entries.clear();
+	dirty = false;
+	driver = DriverHash();
+	GLint formats = 0;
+	RenderDevice::Get().GetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+	enabled = formats > 0;
+	if (!enabled) {
+		std::cout << "[SHADER] The driver keeps no program binaries, every program is compiled" << std::endl;
+		return false;
+	}
+
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+	std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	Reader reader{ bytes };
+	uint32_t magic = 0, version = 0, count = 0;
+	uint64_t fileDriver = 0;
+	bool ok = reader.Get(magic) && magic == PROGRAM_MAGIC && reader.Get(version) && version == FORMAT_VERSION;
+	if (!ok) {
+		std::cout << "[SHADER] Ignoring " << path << ", not a program cache of this version" << std::endl;
+		return false;
+	}
+	if (!reader.Get(fileDriver) || fileDriver != driver) {
+		std::cout << "[SHADER] Ignoring " << path << ", written under another driver" << std::endl;
+		return false;
+	}
+	ok = reader.Get(count);
+	for (uint32_t e = 0; ok && e < count; e++) {
+		Entry entry;
+		uint32_t format = 0, size = 0;
+		ok = reader.Get(entry.key) && reader.Get(format) && reader.Get(size) && reader.offset + size <= bytes.size();
+		if (ok) {
+			entry.format = format;
+			entry.binary.assign(bytes.begin() + reader.offset, bytes.begin() + reader.offset + size);
+			reader.offset += size;
+			entries.push_back(std::move(entry));
+		}
+	}
+	if (!ok) {
+		std::cout << "[SHADER] Ignoring " << path << ", the program cache is cut short" << std::endl;
+		entries.clear();
+	}
+	return ok;
+}
+
+bool ProgramCache::Save(const std::string& path) const
+{
+	std::vector<uint8_t> bytes;
+	Put(bytes, PROGRAM_MAGIC);
+	Put(bytes, FORMAT_VERSION);
+	Put(bytes, driver);
+	Put(bytes, static_cast<uint32_t>(entries.size()));
+	for (const Entry& entry : entries) {
+		Put(bytes, entry.key);
+		Put(bytes, static_cast<uint32_t>(entry.format));
+		Put(bytes, static_cast<uint32_t>(entry.binary.size()));
+		bytes.insert(bytes.end(), entry.binary.begin(), entry.binary.end());
+	}
+	std::ofstream file(path, std::ios::binary);
+	if (!file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size())) {
+		std::cout << "[SHADER] Could not write " << path << std::endl;
+		return false;
+	}
+	std::cout << "[SHADER] Saved " << entries.size() << " programs to " << path << " (" << bytes.size() << " bytes)" << std::endl;
+	return true;
+}
+
+GLuint ProgramCache::Find(uint64_t key)
+{
+	if (!enabled)
+		return 0;
+	for (size_t i = 0; i < entries.size(); i++) {
+		const Entry& entry = entries[i];
+		if (entry.key != key)
+			continue;
+		RenderDevice& device = RenderDevice::Get();
+		GLuint program = device.CreateProgram();
+		device.ProgramBinary(program, entry.format, entry.binary.data(), static_cast<GLsizei>(entry.binary.size()));
+		GLint linked = GL_FALSE;
+		device.GetProgramiv(program, GL_LINK_STATUS, &linked);
+		if (linked == GL_TRUE)
+			return program;
+		// A driver update can refuse binaries even with the same strings
+		device.DeleteProgram(program);
+		entries.erase(entries.begin() + i);
+		dirty = true;
+		return 0;
+	}
+	return 0;
+}
+
+void ProgramCache::Store(uint64_t key, GLuint program)
+{
+	if (!enabled)
+		return;
+	RenderDevice& device = RenderDevice::Get();
+	GLint length = 0;
+	device.GetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+		return;
+	Entry entry;
+	entry.key = key;
+	entry.binary.resize(length);
+	device.GetProgramBinary(program, length, &entry.format, entry.binary.data());
+	entries.push_back(std::move(entry));
+	dirty = true;
+}
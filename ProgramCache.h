@@ -0,0 +1,60 @@
+#ifndef PROGRAM_CACHE_CLASS_H
+#define PROGRAM_CACHE_CLASS_H
+
+#include<glad/glad.h>
+#include<cstdint>
+#include<string>
+#include<vector>
+
+// Linked programs kept between runs as the driver's own binaries
+// (glGetProgramBinary), so a warm start loads every shader variant instead
+// of compiling it. A program is found by a hash of its vertex and fragment
+// source with the variant's defines in place, so an edited shader simply
+// misses and is compiled again. The file belongs to the driver that wrote
+// it, told by its vendor, renderer and version strings, and is ignored
+// under any other.
+//
+// The binary file is little-endian:
+//   header    magic "BPRG", version, driver hash u64, program count
+//   programs  key u64, binary format u32, byte count u32, bytes
+class ProgramCache
+{
+public:
+	static constexpr uint32_t FORMAT_VERSION = 1;
+
+	static uint64_t Key(const std::string& vertexSource, const std::string& fragmentSource);
+
+	// Needs the GL context. False, leaving the cache empty, when the file is
+	// missing, not a cache or written under another driver; the cache is
+	// still used and saved then, unless the driver keeps no binaries.
+	bool Load(const std::string& path);
+	bool Save(const std::string& path) const;
+	bool IsDirty() const { return dirty; }
+	// False before Load and when the driver has no program binary formats;
+	// Find and Store do nothing then
+	bool IsEnabled() const { return enabled; }
+
+	// A linked program made from the stored binary, or 0 when the key is not
+	// stored or the driver refuses the binary, which drops it
+	GLuint Find(uint64_t key);
+	// Keeps the binary of a linked program, which must have been linked
+	// with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set
+	void Store(uint64_t key, GLuint program);
+
+private:
+	struct Entry
+	{
+		uint64_t key = 0;
+		GLenum format = 0;
+		std::vector<uint8_t> binary;
+	};
+
+	std::vector<Entry> entries;
+	uint64_t driver = 0;    // hash of the driver's strings
+	bool enabled = false;
+	bool dirty = false;
+
+	static uint64_t DriverHash();
+};
+
+#endif
@@ -0,0 +1,549 @@
+#include"RecordingRenderDevice.h"
+#include<algorithm>
+#include<cstring>
+#include<iostream>
+
+namespace
+{
+	const char* commandNames[] = {
+		"GenBuffer", "BindBuffer", "BufferData", "DeleteBuffer",
+		"GenVertexArray", "BindVertexArray", "VertexAttribPointer", "EnableVertexAttribArray", "DeleteVertexArray",
+		"GenTexture", "ActiveTexture", "BindTexture", "TexParameteri", "TexImage2D", "GenerateMipmap", "TexBuffer", "DeleteTexture",
+		"CreateShader", "ShaderSource", "CompileShader", "DeleteShader",
+		"CreateProgram", "AttachShader", "LinkProgram", "UseProgram", "DeleteProgram",
+		"GetShaderiv", "GetShaderInfoLog", "GetProgramiv", "GetProgramInfoLog",
+		"ProgramParameteri", "GetProgramBinary", "ProgramBinary",
+		"GetUniformLocation", "Uniform1i", "Uniform1f", "Uniform3f", "Uniform4fv", "UniformMatrix4fv",
+		"Enable", "Disable", "CullFace", "FrontFace", "DepthFunc", "PolygonOffset", "Viewport", "ClearColor", "Clear",
+		"DrawArrays", "DrawElements", "GetError", "GetIntegerv", "GetString",
+		"GenFramebuffer", "BindFramebuffer", "CheckFramebufferStatus", "DeleteFramebuffer",
+		"GenRenderbuffer", "BindRenderbuffer", "RenderbufferStorage", "FramebufferRenderbuffer", "DeleteRenderbuffer",
+		"FramebufferTexture2D", "DrawBuffer", "ReadBuffer",
+		"ReadPixels", "Finish",
+		"MapBufferRange", "UnmapBuffer", "FenceSync", "ClientWaitSync", "DeleteSync"
+	};
+	static_assert(sizeof(commandNames) / sizeof(commandNames[0]) == static_cast<int>(RenderCommandType::Count),
+		"commandNames must match RenderCommandType");
+
+	int64_t ComponentCount(GLenum format)
+	{
+		switch (format)
+		{
+		case GL_RED: return 1;
+		case GL_RG: return 2;
+		case GL_RGB: return 3;
+		default: return 4;
+		}
+	}
+
+	int64_t ComponentSize(GLenum type)
+	{
+		switch (type)
+		{
+		case GL_UNSIGNED_SHORT:
+		case GL_SHORT:
+		case GL_HALF_FLOAT: return 2;
+		case GL_UNSIGNED_INT:
+		case GL_INT:
+		case GL_FLOAT: return 4;
+		default: return 1;
+		}
+	}
+
+	uint64_t PrimitiveCount(GLenum mode, GLsizei count)
+	{
+		return mode == GL_TRIANGLES ? static_cast<uint64_t>(count / 3) : 0;
+	}
+}
+
+const char* RecordingRenderDevice::CommandName(RenderCommandType type)
+{
+	return commandNames[static_cast<int>(type)];
+}
+
+void RecordingRenderDevice::Record(RenderCommandType type, GLenum target, GLuint object, int64_t size)
+{
+	stats.calls++;
+	stats.callsByType[static_cast<int>(type)]++;
+	if (captureCommands) {
+		commands.push_back({ type, target, object, size });
+	}
+}
+
+void RecordingRenderDevice::Reset()
+{
+	stats = RenderDeviceStats();
+	commands.clear();
+}
+
+void RecordingRenderDevice::PrintStats() const
+{
+	std::cout << "[RENDER DEVICE] calls: " << stats.calls
+			  << ", draws: " << stats.drawCalls
+			  << ", triangles: " << stats.primitives
+			  << ", buffer bytes: " << stats.bufferBytesUploaded
+			  << ", texture bytes: " << stats.textureBytesUploaded
+			  << ", read back bytes: " << stats.bytesReadBack
+			  << ", uniform updates: " << stats.uniformUpdates << std::endl;
+
+	for (int i = 0; i < static_cast<int>(RenderCommandType::Count); i++) {
+		if (stats.callsByType[i] > 0) {
+			std::cout << "[RENDER DEVICE]   " << commandNames[i] << ": " << stats.callsByType[i] << std::endl;
+		}
+	}
+}
+
+// Buffers
+GLuint RecordingRenderDevice::GenBuffer()
+{
+	GLuint buffer = nextObject++;
+	Record(RenderCommandType::GenBuffer, 0, buffer);
+	return buffer;
+}
+
+void RecordingRenderDevice::BindBuffer(GLenum target, GLuint buffer)
+{
+	boundBuffers[target] = buffer;
+	Record(RenderCommandType::BindBuffer, target, buffer);
+}
+
+void RecordingRenderDevice::BufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage)
+{
+	stats.bufferBytesUploaded += static_cast<uint64_t>(size);
+	Record(RenderCommandType::BufferData, target, 0, size);
+}
+
+void RecordingRenderDevice::DeleteBuffer(GLuint buffer)
+{
+	mappedStorage.erase(buffer);
+	Record(RenderCommandType::DeleteBuffer, 0, buffer);
+}
+
+// Vertex arrays
+GLuint RecordingRenderDevice::GenVertexArray()
+{
+	GLuint vertexArray = nextObject++;
+	Record(RenderCommandType::GenVertexArray, 0, vertexArray);
+	return vertexArray;
+}
+
+void RecordingRenderDevice::BindVertexArray(GLuint vertexArray)
+{
+	Record(RenderCommandType::BindVertexArray, 0, vertexArray);
+}
+
+void RecordingRenderDevice::VertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void* pointer)
+{
+	Record(RenderCommandType::VertexAttribPointer, type, index, size);
+}
+
+void RecordingRenderDevice::EnableVertexAttribArray(GLuint index)
+{
+	Record(RenderCommandType::EnableVertexAttribArray, 0, index);
+}
+
+void RecordingRenderDevice::DeleteVertexArray(GLuint vertexArray)
+{
+	Record(RenderCommandType::DeleteVertexArray, 0, vertexArray);
+}
+
+// Textures
+GLuint RecordingRenderDevice::GenTexture()
+{
+	GLuint texture = nextObject++;
+	Record(RenderCommandType::GenTexture, 0, texture);
+	return texture;
+}
+
+void RecordingRenderDevice::ActiveTexture(GLenum unit)
+{
+	Record(RenderCommandType::ActiveTexture, unit);
+}
+
+void RecordingRenderDevice::BindTexture(GLenum target, GLuint texture)
+{
+	Record(RenderCommandType::BindTexture, target, texture);
+}
+
+void RecordingRenderDevice::TexParameteri(GLenum target, GLenum name, GLint value)
+{
+	Record(RenderCommandType::TexParameteri, target, name, value);
+}
+
+void RecordingRenderDevice::TexImage2D(GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height, GLenum format, GLenum type, const void* pixels)
+{
+	int64_t bytes = pixels != nullptr ? static_cast<int64_t>(width) * height * ComponentCount(format) * ComponentSize(type) : 0;
+	stats.textureBytesUploaded += static_cast<uint64_t>(bytes);
+	Record(RenderCommandType::TexImage2D, target, 0, bytes);
+}
+
+void RecordingRenderDevice::GenerateMipmap(GLenum target)
+{
+	Record(RenderCommandType::GenerateMipmap, target);
+}
+
+void RecordingRenderDevice::TexBuffer(GLenum internalFormat, GLuint buffer)
+{
+	Record(RenderCommandType::TexBuffer, internalFormat, buffer);
+}
+
+void RecordingRenderDevice::DeleteTexture(GLuint texture)
+{
+	Record(RenderCommandType::DeleteTexture, 0, texture);
+}
+
+// Shaders and programs
+GLuint RecordingRenderDevice::CreateShader(GLenum type)
+{
+	GLuint shader = nextObject++;
+	Record(RenderCommandType::CreateShader, type, shader);
+	return shader;
+}
+
+void RecordingRenderDevice::ShaderSource(GLuint shader, const char* source)
+{
+	Record(RenderCommandType::ShaderSource, 0, shader);
+}
+
+void RecordingRenderDevice::CompileShader(GLuint shader)
+{
+	Record(RenderCommandType::CompileShader, 0, shader);
+}
+
+void RecordingRenderDevice::DeleteShader(GLuint shader)
+{
+	Record(RenderCommandType::DeleteShader, 0, shader);
+}
+
+GLuint RecordingRenderDevice::CreateProgram()
+{
+	GLuint program = nextObject++;
+	Record(RenderCommandType::CreateProgram, 0, program);
+	return program;
+}
+
+void RecordingRenderDevice::AttachShader(GLuint program, GLuint shader)
+{
+	Record(RenderCommandType::AttachShader, 0, program, shader);
+}
+
+void RecordingRenderDevice::LinkProgram(GLuint program)
+{
+	Record(RenderCommandType::LinkProgram, 0, program);
+}
+
+void RecordingRenderDevice::UseProgram(GLuint program)
+{
+	Record(RenderCommandType::UseProgram, 0, program);
+}
+
+void RecordingRenderDevice::DeleteProgram(GLuint program)
+{
+	uniformLocations.erase(program);
+	Record(RenderCommandType::DeleteProgram, 0, program);
+}
+
+void RecordingRenderDevice::GetShaderiv(GLuint shader, GLenum name, GLint* value)
+{
+	// Every shader compiles at once, without a log
+	*value = name == GL_COMPILE_STATUS || name == GL_COMPLETION_STATUS_KHR ? GL_TRUE : 0;
+	Record(RenderCommandType::GetShaderiv, name, shader);
+}
+
+void RecordingRenderDevice::GetShaderInfoLog(GLuint shader, GLsizei bufferSize, GLchar* log)
+{
+	if (bufferSize > 0) {
+		log[0] = '\0';
+	}
+	Record(RenderCommandType::GetShaderInfoLog, 0, shader);
+}
+
+void RecordingRenderDevice::GetProgramiv(GLuint program, GLenum name, GLint* value)
+{
+	// Every program links at once; its binary is its name
+	if (name == GL_LINK_STATUS || name == GL_COMPLETION_STATUS_KHR) {
+		*value = GL_TRUE;
+	} else {
+		*value = name == GL_PROGRAM_BINARY_LENGTH ? static_cast<GLint>(sizeof(GLuint)) : 0;
+	}
+	Record(RenderCommandType::GetProgramiv, name, program);
+}
+
+void RecordingRenderDevice::GetProgramInfoLog(GLuint program, GLsizei bufferSize, GLchar* log)
+{
+	if (bufferSize > 0) {
+		log[0] = '\0';
+	}
+	Record(RenderCommandType::GetProgramInfoLog, 0, program);
+}
+
+bool RecordingRenderDevice::SupportsParallelShaderCompile()
+{
+	// Nothing to wait for, so builds take the polled path
+	return true;
+}
+
+// Program binaries
+void RecordingRenderDevice::ProgramParameteri(GLuint program, GLenum name, GLint value)
+{
+	Record(RenderCommandType::ProgramParameteri, name, program);
+}
+
+void RecordingRenderDevice::GetProgramBinary(GLuint program, GLsizei bufferSize, GLenum* format, void* binary)
+{
+	*format = 1;
+	std::memcpy(binary, &program, std::min<size_t>(bufferSize, sizeof(GLuint)));
+	Record(RenderCommandType::GetProgramBinary, 0, program, bufferSize);
+}
+
+void RecordingRenderDevice::ProgramBinary(GLuint program, GLenum format, const void* binary, GLsizei length)
+{
+	Record(RenderCommandType::ProgramBinary, format, program, length);
+}
+
+// Uniforms
+GLint RecordingRenderDevice::GetUniformLocation(GLuint program, const char* name)
+{
+	// Stable, per-program locations so captured streams can be compared
+	auto& locations = uniformLocations[program];
+	auto it = locations.find(name);
+	if (it == locations.end()) {
+		it = locations.emplace(name, static_cast<GLint>(locations.size())).first;
+	}
+	Record(RenderCommandType::GetUniformLocation, 0, program, it->second);
+	return it->second;
+}
+
+void RecordingRenderDevice::Uniform1i(GLint location, GLint value)
+{
+	stats.uniformUpdates++;
+	Record(RenderCommandType::Uniform1i, 0, static_cast<GLuint>(location), value);
+}
+
+void RecordingRenderDevice::Uniform1f(GLint location, GLfloat value)
+{
+	stats.uniformUpdates++;
+	Record(RenderCommandType::Uniform1f, 0, static_cast<GLuint>(location));
+}
+
+void RecordingRenderDevice::Uniform3f(GLint location, GLfloat x, GLfloat y, GLfloat z)
+{
+	stats.uniformUpdates++;
+	Record(RenderCommandType::Uniform3f, 0, static_cast<GLuint>(location));
+}
+
+void RecordingRenderDevice::Uniform4fv(GLint location, GLsizei count, const GLfloat* value)
+{
+	stats.uniformUpdates++;
+	Record(RenderCommandType::Uniform4fv, 0, static_cast<GLuint>(location), count);
+}
+
+void RecordingRenderDevice::UniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value)
+{
+	stats.uniformUpdates++;
+	Record(RenderCommandType::UniformMatrix4fv, 0, static_cast<GLuint>(location), count);
+}
+
+// Pipeline state and draws
+void RecordingRenderDevice::Enable(GLenum capability)
+{
+	Record(RenderCommandType::Enable, capability);
+}
+
+void RecordingRenderDevice::Disable(GLenum capability)
+{
+	Record(RenderCommandType::Disable, capability);
+}
+
+void RecordingRenderDevice::CullFace(GLenum mode)
+{
+	Record(RenderCommandType::CullFace, mode);
+}
+
+void RecordingRenderDevice::FrontFace(GLenum mode)
+{
+	Record(RenderCommandType::FrontFace, mode);
+}
+
+void RecordingRenderDevice::DepthFunc(GLenum func)
+{
+	Record(RenderCommandType::DepthFunc, func);
+}
+
+void RecordingRenderDevice::PolygonOffset(GLfloat factor, GLfloat units)
+{
+	Record(RenderCommandType::PolygonOffset);
+}
+
+void RecordingRenderDevice::Viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+	Record(RenderCommandType::Viewport, 0, 0, static_cast<int64_t>(width) * height);
+}
+
+void RecordingRenderDevice::ClearColor(GLfloat r, GLfloat g, GLfloat b, GLfloat a)
+{
+	Record(RenderCommandType::ClearColor);
+}
+
+void RecordingRenderDevice::Clear(GLbitfield mask)
+{
+	Record(RenderCommandType::Clear, mask);
+}
+
+void RecordingRenderDevice::DrawArrays(GLenum mode, GLint first, GLsizei count)
+{
+	stats.drawCalls++;
+	stats.primitives += PrimitiveCount(mode, count);
+	Record(RenderCommandType::DrawArrays, mode, 0, count);
+}
+
+void RecordingRenderDevice::DrawElements(GLenum mode, GLsizei count, GLenum type, const void* indices)
+{
+	stats.drawCalls++;
+	stats.primitives += PrimitiveCount(mode, count);
+	Record(RenderCommandType::DrawElements, mode, 0, count);
+}
+
+GLenum RecordingRenderDevice::GetError()
+{
+	Record(RenderCommandType::GetError);
+	return GL_NO_ERROR;
+}
+
+void RecordingRenderDevice::GetIntegerv(GLenum name, GLint* values)
+{
+	// No state is tracked: bindings read as the default objects, the
+	// viewport and other four component values as zeros
+	int count = name == GL_VIEWPORT || name == GL_SCISSOR_BOX ? 4 : 1;
+	for (int i = 0; i < count; i++) {
+		values[i] = 0;
+	}
+	// Program binaries are accepted, so caches of them can be exercised
+	if (name == GL_NUM_PROGRAM_BINARY_FORMATS) {
+		values[0] = 1;
+	}
+	Record(RenderCommandType::GetIntegerv, name);
+}
+
+const char* RecordingRenderDevice::GetString(GLenum name)
+{
+	Record(RenderCommandType::GetString, name);
+	return "RecordingRenderDevice";
+}
+
+// Framebuffers and readback
+GLuint RecordingRenderDevice::GenFramebuffer()
+{
+	GLuint framebuffer = nextObject++;
+	Record(RenderCommandType::GenFramebuffer, 0, framebuffer);
+	return framebuffer;
+}
+
+void RecordingRenderDevice::BindFramebuffer(GLenum target, GLuint framebuffer)
+{
+	Record(RenderCommandType::BindFramebuffer, target, framebuffer);
+}
+
+GLenum RecordingRenderDevice::CheckFramebufferStatus(GLenum target)
+{
+	Record(RenderCommandType::CheckFramebufferStatus, target);
+	return GL_FRAMEBUFFER_COMPLETE;
+}
+
+void RecordingRenderDevice::DeleteFramebuffer(GLuint framebuffer)
+{
+	Record(RenderCommandType::DeleteFramebuffer, 0, framebuffer);
+}
+
+GLuint RecordingRenderDevice::GenRenderbuffer()
+{
+	GLuint renderbuffer = nextObject++;
+	Record(RenderCommandType::GenRenderbuffer, 0, renderbuffer);
+	return renderbuffer;
+}
+
+void RecordingRenderDevice::BindRenderbuffer(GLuint renderbuffer)
+{
+	Record(RenderCommandType::BindRenderbuffer, GL_RENDERBUFFER, renderbuffer);
+}
+
+void RecordingRenderDevice::RenderbufferStorage(GLenum internalFormat, GLsizei width, GLsizei height)
+{
+	Record(RenderCommandType::RenderbufferStorage, internalFormat, 0, static_cast<int64_t>(width) * height);
+}
+
+void RecordingRenderDevice::FramebufferRenderbuffer(GLenum target, GLenum attachment, GLuint renderbuffer)
+{
+	Record(RenderCommandType::FramebufferRenderbuffer, attachment, renderbuffer);
+}
+
+void RecordingRenderDevice::DeleteRenderbuffer(GLuint renderbuffer)
+{
+	Record(RenderCommandType::DeleteRenderbuffer, 0, renderbuffer);
+}
+
+void RecordingRenderDevice::FramebufferTexture2D(GLenum target, GLenum attachment, GLuint texture)
+{
+	Record(RenderCommandType::FramebufferTexture2D, attachment, texture);
+}
+
+void RecordingRenderDevice::DrawBuffer(GLenum mode)
+{
+	Record(RenderCommandType::DrawBuffer, mode);
+}
+
+void RecordingRenderDevice::ReadBuffer(GLenum mode)
+{
+	Record(RenderCommandType::ReadBuffer, mode);
+}
+
+void RecordingRenderDevice::ReadPixels(GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, void* pixels)
+{
+	int64_t bytes = static_cast<int64_t>(width) * height * ComponentCount(format) * ComponentSize(type);
+	stats.bytesReadBack += static_cast<uint64_t>(bytes);
+	// Nothing is rendered, hand back a black image. With a pixel pack buffer
+	// bound, pixels is an offset into that buffer and there is nothing to fill.
+	if (pixels != nullptr && boundBuffers[GL_PIXEL_PACK_BUFFER] == 0) {
+		memset(pixels, 0, static_cast<size_t>(bytes));
+	}
+	Record(RenderCommandType::ReadPixels, format, 0, bytes);
+}
+
+void RecordingRenderDevice::Finish()
+{
+	Record(RenderCommandType::Finish);
+}
+
+// Buffer mapping and sync objects
+void* RecordingRenderDevice::MapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access)
+{
+	std::vector<unsigned char>& storage = mappedStorage[boundBuffers[target]];
+	storage.assign(static_cast<size_t>(offset + length), 0);
+	Record(RenderCommandType::MapBufferRange, target, boundBuffers[target], length);
+	return storage.data() + offset;
+}
+
+GLboolean RecordingRenderDevice::UnmapBuffer(GLenum target)
+{
+	Record(RenderCommandType::UnmapBuffer, target, boundBuffers[target]);
+	return GL_TRUE;
+}
+
+GLsync RecordingRenderDevice::FenceSync()
+{
+	// Never dereferenced, only needs to be unique and non-null
+	GLuint sync = nextObject++;
+	Record(RenderCommandType::FenceSync, 0, sync);
+	return reinterpret_cast<GLsync>(static_cast<uintptr_t>(sync));
+}
+
+GLenum RecordingRenderDevice::ClientWaitSync(GLsync sync, GLuint64 timeoutNs)
+{
+	Record(RenderCommandType::ClientWaitSync, 0, static_cast<GLuint>(reinterpret_cast<uintptr_t>(sync)));
+	return GL_ALREADY_SIGNALED;
+}
+
+void RecordingRenderDevice::DeleteSync(GLsync sync)
+{
+	Record(RenderCommandType::DeleteSync, 0, static_cast<GLuint>(reinterpret_cast<uintptr_t>(sync)));
+}
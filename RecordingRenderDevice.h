@@ -0,0 +1,162 @@
+#ifndef RECORDING_RENDER_DEVICE_CLASS_H
+#define RECORDING_RENDER_DEVICE_CLASS_H
+
+#include<cstdint>
+#include<map>
+#include<string>
+#include<vector>
+#include"RenderDevice.h"
+
+enum class RenderCommandType
+{
+	GenBuffer, BindBuffer, BufferData, DeleteBuffer,
+	GenVertexArray, BindVertexArray, VertexAttribPointer, EnableVertexAttribArray, DeleteVertexArray,
+	GenTexture, ActiveTexture, BindTexture, TexParameteri, TexImage2D, GenerateMipmap, TexBuffer, DeleteTexture,
+	CreateShader, ShaderSource, CompileShader, DeleteShader,
+	CreateProgram, AttachShader, LinkProgram, UseProgram, DeleteProgram,
+	GetShaderiv, GetShaderInfoLog, GetProgramiv, GetProgramInfoLog,
+	ProgramParameteri, GetProgramBinary, ProgramBinary,
+	GetUniformLocation, Uniform1i, Uniform1f, Uniform3f, Uniform4fv, UniformMatrix4fv,
+	Enable, Disable, CullFace, FrontFace, DepthFunc, PolygonOffset, Viewport, ClearColor, Clear,
+	DrawArrays, DrawElements, GetError, GetIntegerv, GetString,
+	GenFramebuffer, BindFramebuffer, CheckFramebufferStatus, DeleteFramebuffer,
+	GenRenderbuffer, BindRenderbuffer, RenderbufferStorage, FramebufferRenderbuffer, DeleteRenderbuffer,
+	FramebufferTexture2D, DrawBuffer, ReadBuffer,
+	ReadPixels, Finish,
+	MapBufferRange, UnmapBuffer, FenceSync, ClientWaitSync, DeleteSync,
+	Count
+};
+
+// One captured call; arguments that don't apply are left at zero
+struct RenderCommand
+{
+	RenderCommandType type;
+	GLenum target = 0;       // buffer/texture target, capability, mode or enum argument
+	GLuint object = 0;       // buffer, texture, vertex array, shader or program name, or location
+	int64_t size = 0;        // uploaded bytes or element/vertex count
+};
+
+struct RenderDeviceStats
+{
+	uint64_t calls = 0;
+	uint64_t drawCalls = 0;
+	uint64_t primitives = 0;          // triangles for GL_TRIANGLES draws
+	uint64_t bufferBytesUploaded = 0;
+	uint64_t textureBytesUploaded = 0;
+	uint64_t bytesReadBack = 0;
+	uint64_t uniformUpdates = 0;
+	uint64_t callsByType[static_cast<int>(RenderCommandType::Count)] = {};
+};
+
+// Device that never touches the GPU. It hands out fake object names, counts
+// every call and uploaded byte and, unless captureCommands is false (null
+// device mode), keeps the full command stream for inspection.
+class RecordingRenderDevice : public RenderDevice
+{
+public:
+	bool captureCommands = true;
+
+	const RenderDeviceStats& GetStats() const { return stats; }
+	const std::vector<RenderCommand>& GetCommands() const { return commands; }
+	uint64_t GetCallCount(RenderCommandType type) const { return stats.callsByType[static_cast<int>(type)]; }
+
+	// Clears counters and the command stream, keeps allocated object names
+	void Reset();
+	void PrintStats() const;
+
+	static const char* CommandName(RenderCommandType type);
+
+	GLuint GenBuffer() override;
+	void BindBuffer(GLenum target, GLuint buffer) override;
+	void BufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage) override;
+	void DeleteBuffer(GLuint buffer) override;
+
+	GLuint GenVertexArray() override;
+	void BindVertexArray(GLuint vertexArray) override;
+	void VertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void* pointer) override;
+	void EnableVertexAttribArray(GLuint index) override;
+	void DeleteVertexArray(GLuint vertexArray) override;
+
+	GLuint GenTexture() override;
+	void ActiveTexture(GLenum unit) override;
+	void BindTexture(GLenum target, GLuint texture) override;
+	void TexParameteri(GLenum target, GLenum name, GLint value) override;
+	void TexImage2D(GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height, GLenum format, GLenum type, const void* pixels) override;
+	void GenerateMipmap(GLenum target) override;
+	void TexBuffer(GLenum internalFormat, GLuint buffer) override;
+	void DeleteTexture(GLuint texture) override;
+
+	GLuint CreateShader(GLenum type) override;
+	void ShaderSource(GLuint shader, const char* source) override;
+	void CompileShader(GLuint shader) override;
+	void DeleteShader(GLuint shader) override;
+	GLuint CreateProgram() override;
+	void AttachShader(GLuint program, GLuint shader) override;
+	void LinkProgram(GLuint program) override;
+	void UseProgram(GLuint program) override;
+	void DeleteProgram(GLuint program) override;
+	void GetShaderiv(GLuint shader, GLenum name, GLint* value) override;
+	void GetShaderInfoLog(GLuint shader, GLsizei bufferSize, GLchar* log) override;
+	void GetProgramiv(GLuint program, GLenum name, GLint* value) override;
+	void GetProgramInfoLog(GLuint program, GLsizei bufferSize, GLchar* log) override;
+	bool SupportsParallelShaderCompile() override;
+
+	void ProgramParameteri(GLuint program, GLenum name, GLint value) override;
+	void GetProgramBinary(GLuint program, GLsizei bufferSize, GLenum* format, void* binary) override;
+	void ProgramBinary(GLuint program, GLenum format, const void* binary, GLsizei length) override;
+
+	GLint GetUniformLocation(GLuint program, const char* name) override;
+	void Uniform1i(GLint location, GLint value) override;
+	void Uniform1f(GLint location, GLfloat value) override;
+	void Uniform3f(GLint location, GLfloat x, GLfloat y, GLfloat z) override;
+	void Uniform4fv(GLint location, GLsizei count, const GLfloat* value) override;
+	void UniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value) override;
+
+	void Enable(GLenum capability) override;
+	void Disable(GLenum capability) override;
+	void CullFace(GLenum mode) override;
+	void FrontFace(GLenum mode) override;
+	void DepthFunc(GLenum func) override;
+	void PolygonOffset(GLfloat factor, GLfloat units) override;
+	void Viewport(GLint x, GLint y, GLsizei width, GLsizei height) override;
+	void ClearColor(GLfloat r, GLfloat g, GLfloat b, GLfloat a) override;
+	void Clear(GLbitfield mask) override;
+	void DrawArrays(GLenum mode, GLint first, GLsizei count) override;
+	void DrawElements(GLenum mode, GLsizei count, GLenum type, const void* indices) override;
+	GLenum GetError() override;
+	void GetIntegerv(GLenum name, GLint* values) override;
+	const char* GetString(GLenum name) override;
+
+	GLuint GenFramebuffer() override;
+	void BindFramebuffer(GLenum target, GLuint framebuffer) override;
+	GLenum CheckFramebufferStatus(GLenum target) override;
+	void DeleteFramebuffer(GLuint framebuffer) override;
+	GLuint GenRenderbuffer() override;
+	void BindRenderbuffer(GLuint renderbuffer) override;
+	void RenderbufferStorage(GLenum internalFormat, GLsizei width, GLsizei height) override;
+	void FramebufferRenderbuffer(GLenum target, GLenum attachment, GLuint renderbuffer) override;
+	void FramebufferTexture2D(GLenum target, GLenum attachment, GLuint texture) override;
+	void DrawBuffer(GLenum mode) override;
+	void ReadBuffer(GLenum mode) override;
+	void DeleteRenderbuffer(GLuint renderbuffer) override;
+	void ReadPixels(GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, void* pixels) override;
+	void Finish() override;
+
+	void* MapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access) override;
+	GLboolean UnmapBuffer(GLenum target) override;
+	GLsync FenceSync() override;
+	GLenum ClientWaitSync(GLsync sync, GLuint64 timeoutNs) override;
+	void DeleteSync(GLsync sync) override;
+
+private:
+	RenderDeviceStats stats;
+	std::vector<RenderCommand> commands;
+	GLuint nextObject = 1;
+	std::map<GLuint, std::map<std::string, GLint>> uniformLocations;
+	std::map<GLenum, GLuint> boundBuffers;
+	std::map<GLuint, std::vector<unsigned char>> mappedStorage;    // zero filled memory handed out by MapBufferRange
+
+	void Record(RenderCommandType type, GLenum target = 0, GLuint object = 0, int64_t size = 0);
+};
+
+#endif
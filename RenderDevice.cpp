@@ -0,0 +1,473 @@
+#include"RenderDevice.h"
+#include<cstring>
+
+namespace
+{
+	typedef void (APIENTRYP ProgramParameteriProc)(GLuint program, GLenum name, GLint value);
+	typedef void (APIENTRYP GetProgramBinaryProc)(GLuint program, GLsizei bufferSize, GLsizei* length, GLenum* format, void* binary);
+	typedef void (APIENTRYP ProgramBinaryProc)(GLuint program, GLenum format, const void* binary, GLsizei length);
+	typedef void (APIENTRYP MaxShaderCompilerThreadsProc)(GLuint count);
+
+	GLRenderDevice glDevice;
+	ProgramParameteriProc programParameteri = nullptr;
+	GetProgramBinaryProc getProgramBinary = nullptr;
+	ProgramBinaryProc programBinary = nullptr;
+	bool parallelShaderCompile = false;
+
+	bool HasExtension(const char* name)
+	{
+		GLint count = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+		for (GLint i = 0; i < count; i++) {
+			const char* extension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+			if (extension != nullptr && std::strcmp(extension, name) == 0) {
+				return true;
+			}
+		}
+		return false;
+	}
+}
+
+RenderDevice* RenderDevice::current = &glDevice;
+
+RenderDevice& RenderDevice::Get()
+{
+	return *current;
+}
+
+void RenderDevice::Set(RenderDevice* device)
+{
+	current = device != nullptr ? device : &glDevice;
+}
+
+void GLRenderDevice::LoadExtensions(GLADloadproc load)
+{
+	GLint major = 0, minor = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &major);
+	glGetIntegerv(GL_MINOR_VERSION, &minor);
+	bool programBinaries = major > 4 || (major == 4 && minor >= 1) || HasExtension("GL_ARB_get_program_binary");
+	programParameteri = programBinaries ? reinterpret_cast<ProgramParameteriProc>(load("glProgramParameteri")) : nullptr;
+	getProgramBinary = programBinaries ? reinterpret_cast<GetProgramBinaryProc>(load("glGetProgramBinary")) : nullptr;
+	programBinary = programBinaries ? reinterpret_cast<ProgramBinaryProc>(load("glProgramBinary")) : nullptr;
+	if (programParameteri == nullptr || getProgramBinary == nullptr || programBinary == nullptr) {
+		programParameteri = nullptr;
+		getProgramBinary = nullptr;
+		programBinary = nullptr;
+	}
+
+	// Both extensions share the enum; the thread count is the driver's choice
+	MaxShaderCompilerThreadsProc maxShaderCompilerThreads = nullptr;
+	if (HasExtension("GL_KHR_parallel_shader_compile")) {
+		maxShaderCompilerThreads = reinterpret_cast<MaxShaderCompilerThreadsProc>(load("glMaxShaderCompilerThreadsKHR"));
+	} else if (HasExtension("GL_ARB_parallel_shader_compile")) {
+		maxShaderCompilerThreads = reinterpret_cast<MaxShaderCompilerThreadsProc>(load("glMaxShaderCompilerThreadsARB"));
+	}
+	parallelShaderCompile = maxShaderCompilerThreads != nullptr;
+	if (parallelShaderCompile) {
+		maxShaderCompilerThreads(0xFFFFFFFFu);
+	}
+}
+
+// Buffers
+GLuint GLRenderDevice::GenBuffer()
+{
+	GLuint buffer = 0;
+	glGenBuffers(1, &buffer);
+	return buffer;
+}
+
+void GLRenderDevice::BindBuffer(GLenum target, GLuint buffer)
+{
+	glBindBuffer(target, buffer);
+}
+
+void GLRenderDevice::BufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage)
+{
+	glBufferData(target, size, data, usage);
+}
+
+void GLRenderDevice::DeleteBuffer(GLuint buffer)
+{
+	glDeleteBuffers(1, &buffer);
+}
+
+// Vertex arrays
+GLuint GLRenderDevice::GenVertexArray()
+{
+	GLuint vertexArray = 0;
+	glGenVertexArrays(1, &vertexArray);
+	return vertexArray;
+}
+
+void GLRenderDevice::BindVertexArray(GLuint vertexArray)
+{
+	glBindVertexArray(vertexArray);
+}
+
+void GLRenderDevice::VertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void* pointer)
+{
+	glVertexAttribPointer(index, size, type, normalized, stride, pointer);
+}
+
+void GLRenderDevice::EnableVertexAttribArray(GLuint index)
+{
+	glEnableVertexAttribArray(index);
+}
+
+void GLRenderDevice::DeleteVertexArray(GLuint vertexArray)
+{
+	glDeleteVertexArrays(1, &vertexArray);
+}
+
+// Textures
+GLuint GLRenderDevice::GenTexture()
+{
+	GLuint texture = 0;
+	glGenTextures(1, &texture);
+	return texture;
+}
+
+void GLRenderDevice::ActiveTexture(GLenum unit)
+{
+	glActiveTexture(unit);
+}
+
+void GLRenderDevice::BindTexture(GLenum target, GLuint texture)
+{
+	glBindTexture(target, texture);
+}
+
+void GLRenderDevice::TexParameteri(GLenum target, GLenum name, GLint value)
+{
+	glTexParameteri(target, name, value);
+}
+
+void GLRenderDevice::TexImage2D(GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height, GLenum format, GLenum type, const void* pixels)
+{
+	glTexImage2D(target, level, internalFormat, width, height, 0, format, type, pixels);
+}
+
+void GLRenderDevice::GenerateMipmap(GLenum target)
+{
+	glGenerateMipmap(target);
+}
+
+void GLRenderDevice::TexBuffer(GLenum internalFormat, GLuint buffer)
+{
+	glTexBuffer(GL_TEXTURE_BUFFER, internalFormat, buffer);
+}
+
+void GLRenderDevice::DeleteTexture(GLuint texture)
+{
+	glDeleteTextures(1, &texture);
+}
+
+// Shaders and programs
+GLuint GLRenderDevice::CreateShader(GLenum type)
+{
+	return glCreateShader(type);
+}
+
+void GLRenderDevice::ShaderSource(GLuint shader, const char* source)
+{
+	glShaderSource(shader, 1, &source, nullptr);
+}
+
+void GLRenderDevice::CompileShader(GLuint shader)
+{
+	glCompileShader(shader);
+}
+
+void GLRenderDevice::DeleteShader(GLuint shader)
+{
+	glDeleteShader(shader);
+}
+
+GLuint GLRenderDevice::CreateProgram()
+{
+	return glCreateProgram();
+}
+
+void GLRenderDevice::AttachShader(GLuint program, GLuint shader)
+{
+	glAttachShader(program, shader);
+}
+
+void GLRenderDevice::LinkProgram(GLuint program)
+{
+	glLinkProgram(program);
+}
+
+void GLRenderDevice::UseProgram(GLuint program)
+{
+	glUseProgram(program);
+}
+
+void GLRenderDevice::DeleteProgram(GLuint program)
+{
+	glDeleteProgram(program);
+}
+
+void GLRenderDevice::GetShaderiv(GLuint shader, GLenum name, GLint* value)
+{
+	if (name == GL_COMPLETION_STATUS_KHR && !parallelShaderCompile) {
+		*value = GL_TRUE;
+		return;
+	}
+	glGetShaderiv(shader, name, value);
+}
+
+void GLRenderDevice::GetShaderInfoLog(GLuint shader, GLsizei bufferSize, GLchar* log)
+{
+	glGetShaderInfoLog(shader, bufferSize, nullptr, log);
+}
+
+void GLRenderDevice::GetProgramiv(GLuint program, GLenum name, GLint* value)
+{
+	if (name == GL_COMPLETION_STATUS_KHR && !parallelShaderCompile) {
+		*value = GL_TRUE;
+		return;
+	}
+	glGetProgramiv(program, name, value);
+}
+
+void GLRenderDevice::GetProgramInfoLog(GLuint program, GLsizei bufferSize, GLchar* log)
+{
+	glGetProgramInfoLog(program, bufferSize, nullptr, log);
+}
+
+bool GLRenderDevice::SupportsParallelShaderCompile()
+{
+	return parallelShaderCompile;
+}
+
+// Program binaries
+void GLRenderDevice::ProgramParameteri(GLuint program, GLenum name, GLint value)
+{
+	if (programParameteri != nullptr) {
+		programParameteri(program, name, value);
+	}
+}
+
+void GLRenderDevice::GetProgramBinary(GLuint program, GLsizei bufferSize, GLenum* format, void* binary)
+{
+	if (getProgramBinary != nullptr) {
+		getProgramBinary(program, bufferSize, nullptr, format, binary);
+	}
+}
+
+void GLRenderDevice::ProgramBinary(GLuint program, GLenum format, const void* binary, GLsizei length)
+{
+	if (programBinary != nullptr) {
+		programBinary(program, format, binary, length);
+	}
+}
+
+// Uniforms
+GLint GLRenderDevice::GetUniformLocation(GLuint program, const char* name)
+{
+	return glGetUniformLocation(program, name);
+}
+
+void GLRenderDevice::Uniform1i(GLint location, GLint value)
+{
+	glUniform1i(location, value);
+}
+
+void GLRenderDevice::Uniform1f(GLint location, GLfloat value)
+{
+	glUniform1f(location, value);
+}
+
+void GLRenderDevice::Uniform3f(GLint location, GLfloat x, GLfloat y, GLfloat z)
+{
+	glUniform3f(location, x, y, z);
+}
+
+void GLRenderDevice::Uniform4fv(GLint location, GLsizei count, const GLfloat* value)
+{
+	glUniform4fv(location, count, value);
+}
+
+void GLRenderDevice::UniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value)
+{
+	glUniformMatrix4fv(location, count, transpose, value);
+}
+
+// Pipeline state and draws
+void GLRenderDevice::Enable(GLenum capability)
+{
+	glEnable(capability);
+}
+
+void GLRenderDevice::Disable(GLenum capability)
+{
+	glDisable(capability);
+}
+
+void GLRenderDevice::CullFace(GLenum mode)
+{
+	glCullFace(mode);
+}
+
+void GLRenderDevice::FrontFace(GLenum mode)
+{
+	glFrontFace(mode);
+}
+
+void GLRenderDevice::DepthFunc(GLenum func)
+{
+	glDepthFunc(func);
+}
+
+void GLRenderDevice::PolygonOffset(GLfloat factor, GLfloat units)
+{
+	glPolygonOffset(factor, units);
+}
+
+void GLRenderDevice::Viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+	glViewport(x, y, width, height);
+}
+
+void GLRenderDevice::ClearColor(GLfloat r, GLfloat g, GLfloat b, GLfloat a)
+{
+	glClearColor(r, g, b, a);
+}
+
+void GLRenderDevice::Clear(GLbitfield mask)
+{
+	glClear(mask);
+}
+
+void GLRenderDevice::DrawArrays(GLenum mode, GLint first, GLsizei count)
+{
+	glDrawArrays(mode, first, count);
+}
+
+void GLRenderDevice::DrawElements(GLenum mode, GLsizei count, GLenum type, const void* indices)
+{
+	glDrawElements(mode, count, type, indices);
+}
+
+GLenum GLRenderDevice::GetError()
+{
+	return glGetError();
+}
+
+void GLRenderDevice::GetIntegerv(GLenum name, GLint* values)
+{
+	// An unknown enum to a driver without program binaries
+	if (name == GL_NUM_PROGRAM_BINARY_FORMATS && programBinary == nullptr) {
+		values[0] = 0;
+		return;
+	}
+	glGetIntegerv(name, values);
+}
+
+const char* GLRenderDevice::GetString(GLenum name)
+{
+	const GLubyte* value = glGetString(name);
+	return value != nullptr ? reinterpret_cast<const char*>(value) : "";
+}
+
+// Framebuffers and readback
+GLuint GLRenderDevice::GenFramebuffer()
+{
+	GLuint framebuffer = 0;
+	glGenFramebuffers(1, &framebuffer);
+	return framebuffer;
+}
+
+void GLRenderDevice::BindFramebuffer(GLenum target, GLuint framebuffer)
+{
+	glBindFramebuffer(target, framebuffer);
+}
+
+GLenum GLRenderDevice::CheckFramebufferStatus(GLenum target)
+{
+	return glCheckFramebufferStatus(target);
+}
+
+void GLRenderDevice::DeleteFramebuffer(GLuint framebuffer)
+{
+	glDeleteFramebuffers(1, &framebuffer);
+}
+
+GLuint GLRenderDevice::GenRenderbuffer()
+{
+	GLuint renderbuffer = 0;
+	glGenRenderbuffers(1, &renderbuffer);
+	return renderbuffer;
+}
+
+void GLRenderDevice::BindRenderbuffer(GLuint renderbuffer)
+{
+	glBindRenderbuffer(GL_RENDERBUFFER, renderbuffer);
+}
+
+void GLRenderDevice::RenderbufferStorage(GLenum internalFormat, GLsizei width, GLsizei height)
+{
+	glRenderbufferStorage(GL_RENDERBUFFER, internalFormat, width, height);
+}
+
+void GLRenderDevice::FramebufferRenderbuffer(GLenum target, GLenum attachment, GLuint renderbuffer)
+{
+	glFramebufferRenderbuffer(target, attachment, GL_RENDERBUFFER, renderbuffer);
+}
+
+void GLRenderDevice::DeleteRenderbuffer(GLuint renderbuffer)
+{
+	glDeleteRenderbuffers(1, &renderbuffer);
+}
+
+void GLRenderDevice::FramebufferTexture2D(GLenum target, GLenum attachment, GLuint texture)
+{
+	glFramebufferTexture2D(target, attachment, GL_TEXTURE_2D, texture, 0);
+}
+
+void GLRenderDevice::DrawBuffer(GLenum mode)
+{
+	glDrawBuffer(mode);
+}
+
+void GLRenderDevice::ReadBuffer(GLenum mode)
+{
+	glReadBuffer(mode);
+}
+
+void GLRenderDevice::ReadPixels(GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, void* pixels)
+{
+	glReadPixels(x, y, width, height, format, type, pixels);
+}
+
+void GLRenderDevice::Finish()
+{
+	glFinish();
+}
+
+// Buffer mapping and sync objects
+void* GLRenderDevice::MapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access)
+{
+	return glMapBufferRange(target, offset, length, access);
+}
+
+GLboolean GLRenderDevice::UnmapBuffer(GLenum target)
+{
+	return glUnmapBuffer(target);
+}
+
+GLsync GLRenderDevice::FenceSync()
+{
+	return glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+GLenum GLRenderDevice::ClientWaitSync(GLsync sync, GLuint64 timeoutNs)
+{
+	return glClientWaitSync(sync, GL_SYNC_FLUSH_COMMANDS_BIT, timeoutNs);
+}
+
+void GLRenderDevice::DeleteSync(GLsync sync)
+{
+	glDeleteSync(sync);
+}
@@ -0,0 +1,220 @@
+#ifndef RENDER_DEVICE_CLASS_H
+#define RENDER_DEVICE_CLASS_H
+
+#include<glad/glad.h>
+
+// ARB_get_program_binary (core since 4.1) and KHR_parallel_shader_compile
+// are past the GL 3.3 glad header; GLRenderDevice::LoadExtensions finds
+// their entry points when the driver has them
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+// Thin layer over the GL calls used by the engine classes. The default device
+// forwards to OpenGL; RecordingRenderDevice can be installed instead to run
+// loaders and draw submission without a GL context.
+class RenderDevice
+{
+public:
+	virtual ~RenderDevice() = default;
+
+	// Buffers
+	virtual GLuint GenBuffer() = 0;
+	virtual void BindBuffer(GLenum target, GLuint buffer) = 0;
+	virtual void BufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage) = 0;
+	virtual void DeleteBuffer(GLuint buffer) = 0;
+
+	// Vertex arrays
+	virtual GLuint GenVertexArray() = 0;
+	virtual void BindVertexArray(GLuint vertexArray) = 0;
+	virtual void VertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void* pointer) = 0;
+	virtual void EnableVertexAttribArray(GLuint index) = 0;
+	virtual void DeleteVertexArray(GLuint vertexArray) = 0;
+
+	// Textures
+	virtual GLuint GenTexture() = 0;
+	virtual void ActiveTexture(GLenum unit) = 0;
+	virtual void BindTexture(GLenum target, GLuint texture) = 0;
+	virtual void TexParameteri(GLenum target, GLenum name, GLint value) = 0;
+	virtual void TexImage2D(GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height, GLenum format, GLenum type, const void* pixels) = 0;
+	virtual void GenerateMipmap(GLenum target) = 0;
+	virtual void TexBuffer(GLenum internalFormat, GLuint buffer) = 0;
+	virtual void DeleteTexture(GLuint texture) = 0;
+
+	// Shaders and programs
+	virtual GLuint CreateShader(GLenum type) = 0;
+	virtual void ShaderSource(GLuint shader, const char* source) = 0;
+	virtual void CompileShader(GLuint shader) = 0;
+	virtual void DeleteShader(GLuint shader) = 0;
+	virtual GLuint CreateProgram() = 0;
+	virtual void AttachShader(GLuint program, GLuint shader) = 0;
+	virtual void LinkProgram(GLuint program) = 0;
+	virtual void UseProgram(GLuint program) = 0;
+	virtual void DeleteProgram(GLuint program) = 0;
+	virtual void GetShaderiv(GLuint shader, GLenum name, GLint* value) = 0;
+	virtual void GetShaderInfoLog(GLuint shader, GLsizei bufferSize, GLchar* log) = 0;
+	virtual void GetProgramiv(GLuint program, GLenum name, GLint* value) = 0;
+	virtual void GetProgramInfoLog(GLuint program, GLsizei bufferSize, GLchar* log) = 0;
+	// True when compiles and links run in the background and
+	// GL_COMPLETION_STATUS_KHR tells when they are done; otherwise it reads
+	// GL_TRUE and the first status query waits for them
+	virtual bool SupportsParallelShaderCompile() = 0;
+
+	// Program binaries; GL_NUM_PROGRAM_BINARY_FORMATS reads 0 without them
+	virtual void ProgramParameteri(GLuint program, GLenum name, GLint value) = 0;
+	virtual void GetProgramBinary(GLuint program, GLsizei bufferSize, GLenum* format, void* binary) = 0;
+	virtual void ProgramBinary(GLuint program, GLenum format, const void* binary, GLsizei length) = 0;
+
+	// Uniforms
+	virtual GLint GetUniformLocation(GLuint program, const char* name) = 0;
+	virtual void Uniform1i(GLint location, GLint value) = 0;
+	virtual void Uniform1f(GLint location, GLfloat value) = 0;
+	virtual void Uniform3f(GLint location, GLfloat x, GLfloat y, GLfloat z) = 0;
+	virtual void Uniform4fv(GLint location, GLsizei count, const GLfloat* value) = 0;
+	virtual void UniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value) = 0;
+
+	// Pipeline state and draws
+	virtual void Enable(GLenum capability) = 0;
+	virtual void Disable(GLenum capability) = 0;
+	virtual void CullFace(GLenum mode) = 0;
+	virtual void FrontFace(GLenum mode) = 0;
+	virtual void DepthFunc(GLenum func) = 0;
+	virtual void PolygonOffset(GLfloat factor, GLfloat units) = 0;
+	virtual void Viewport(GLint x, GLint y, GLsizei width, GLsizei height) = 0;
+	virtual void ClearColor(GLfloat r, GLfloat g, GLfloat b, GLfloat a) = 0;
+	virtual void Clear(GLbitfield mask) = 0;
+	virtual void DrawArrays(GLenum mode, GLint first, GLsizei count) = 0;
+	virtual void DrawElements(GLenum mode, GLsizei count, GLenum type, const void* indices) = 0;
+	virtual GLenum GetError() = 0;
+	virtual void GetIntegerv(GLenum name, GLint* values) = 0;
+	virtual const char* GetString(GLenum name) = 0;
+
+	// Framebuffers and readback
+	virtual GLuint GenFramebuffer() = 0;
+	virtual void BindFramebuffer(GLenum target, GLuint framebuffer) = 0;
+	virtual GLenum CheckFramebufferStatus(GLenum target) = 0;
+	virtual void DeleteFramebuffer(GLuint framebuffer) = 0;
+	virtual GLuint GenRenderbuffer() = 0;
+	virtual void BindRenderbuffer(GLuint renderbuffer) = 0;
+	virtual void RenderbufferStorage(GLenum internalFormat, GLsizei width, GLsizei height) = 0;
+	virtual void FramebufferRenderbuffer(GLenum target, GLenum attachment, GLuint renderbuffer) = 0;
+	virtual void FramebufferTexture2D(GLenum target, GLenum attachment, GLuint texture) = 0;
+	virtual void DrawBuffer(GLenum mode) = 0;
+	virtual void ReadBuffer(GLenum mode) = 0;
+	virtual void DeleteRenderbuffer(GLuint renderbuffer) = 0;
+	virtual void ReadPixels(GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, void* pixels) = 0;
+	virtual void Finish() = 0;
+
+	// Buffer mapping and sync objects
+	virtual void* MapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access) = 0;
+	virtual GLboolean UnmapBuffer(GLenum target) = 0;
+	virtual GLsync FenceSync() = 0;
+	virtual GLenum ClientWaitSync(GLsync sync, GLuint64 timeoutNs) = 0;
+	virtual void DeleteSync(GLsync sync) = 0;
+
+	// Device used by VBO, EBO, VAO, Texture, Shader, Model and Skybox.
+	// Passing nullptr restores the OpenGL device.
+	static RenderDevice& Get();
+	static void Set(RenderDevice* device);
+
+private:
+	static RenderDevice* current;
+};
+
+// Forwards every call to the current OpenGL context
+class GLRenderDevice : public RenderDevice
+{
+public:
+	// Entry points of the extensions above, through the loader the context's
+	// GL functions came from; call once the context is current
+	static void LoadExtensions(GLADloadproc load);
+
+	GLuint GenBuffer() override;
+	void BindBuffer(GLenum target, GLuint buffer) override;
+	void BufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage) override;
+	void DeleteBuffer(GLuint buffer) override;
+
+	GLuint GenVertexArray() override;
+	void BindVertexArray(GLuint vertexArray) override;
+	void VertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, const void* pointer) override;
+	void EnableVertexAttribArray(GLuint index) override;
+	void DeleteVertexArray(GLuint vertexArray) override;
+
+	GLuint GenTexture() override;
+	void ActiveTexture(GLenum unit) override;
+	void BindTexture(GLenum target, GLuint texture) override;
+	void TexParameteri(GLenum target, GLenum name, GLint value) override;
+	void TexImage2D(GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height, GLenum format, GLenum type, const void* pixels) override;
+	void GenerateMipmap(GLenum target) override;
+	void TexBuffer(GLenum internalFormat, GLuint buffer) override;
+	void DeleteTexture(GLuint texture) override;
+
+	GLuint CreateShader(GLenum type) override;
+	void ShaderSource(GLuint shader, const char* source) override;
+	void CompileShader(GLuint shader) override;
+	void DeleteShader(GLuint shader) override;
+	GLuint CreateProgram() override;
+	void AttachShader(GLuint program, GLuint shader) override;
+	void LinkProgram(GLuint program) override;
+	void UseProgram(GLuint program) override;
+	void DeleteProgram(GLuint program) override;
+	void GetShaderiv(GLuint shader, GLenum name, GLint* value) override;
+	void GetShaderInfoLog(GLuint shader, GLsizei bufferSize, GLchar* log) override;
+	void GetProgramiv(GLuint program, GLenum name, GLint* value) override;
+	void GetProgramInfoLog(GLuint program, GLsizei bufferSize, GLchar* log) override;
+	bool SupportsParallelShaderCompile() override;
+
+	void ProgramParameteri(GLuint program, GLenum name, GLint value) override;
+	void GetProgramBinary(GLuint program, GLsizei bufferSize, GLenum* format, void* binary) override;
+	void ProgramBinary(GLuint program, GLenum format, const void* binary, GLsizei length) override;
+
+	GLint GetUniformLocation(GLuint program, const char* name) override;
+	void Uniform1i(GLint location, GLint value) override;
+	void Uniform1f(GLint location, GLfloat value) override;
+	void Uniform3f(GLint location, GLfloat x, GLfloat y, GLfloat z) override;
+	void Uniform4fv(GLint location, GLsizei count, const GLfloat* value) override;
+	void UniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value) override;
+
+	void Enable(GLenum capability) override;
+	void Disable(GLenum capability) override;
+	void CullFace(GLenum mode) override;
+	void FrontFace(GLenum mode) override;
+	void DepthFunc(GLenum func) override;
+	void PolygonOffset(GLfloat factor, GLfloat units) override;
+	void Viewport(GLint x, GLint y, GLsizei width, GLsizei height) override;
+	void ClearColor(GLfloat r, GLfloat g, GLfloat b, GLfloat a) override;
+	void Clear(GLbitfield mask) override;
+	void DrawArrays(GLenum mode, GLint first, GLsizei count) override;
+	void DrawElements(GLenum mode, GLsizei count, GLenum type, const void* indices) override;
+	GLenum GetError() override;
+	void GetIntegerv(GLenum name, GLint* values) override;
+	const char* GetString(GLenum name) override;
+
+	GLuint GenFramebuffer() override;
+	void BindFramebuffer(GLenum target, GLuint framebuffer) override;
+	GLenum CheckFramebufferStatus(GLenum target) override;
+	void DeleteFramebuffer(GLuint framebuffer) override;
+	GLuint GenRenderbuffer() override;
+	void BindRenderbuffer(GLuint renderbuffer) override;
+	void RenderbufferStorage(GLenum internalFormat, GLsizei width, GLsizei height) override;
+	void FramebufferRenderbuffer(GLenum target, GLenum attachment, GLuint renderbuffer) override;
+	void FramebufferTexture2D(GLenum target, GLenum attachment, GLuint texture) override;
+	void DrawBuffer(GLenum mode) override;
+	void ReadBuffer(GLenum mode) override;
+	void DeleteRenderbuffer(GLuint renderbuffer) override;
+	void ReadPixels(GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, void* pixels) override;
+	void Finish() override;
+
+	void* MapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access) override;
+	GLboolean UnmapBuffer(GLenum target) override;
+	GLsync FenceSync() override;
+	GLenum ClientWaitSync(GLsync sync, GLuint64 timeoutNs) override;
+	void DeleteSync(GLsync sync) override;
+};
+
+#endif
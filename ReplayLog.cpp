@@ -0,0 +1,453 @@
+#include"ReplayLog.h"
+#include<algorithm>
+#include<cmath>
+#include<cstring>
+#include<fstream>
+#include<iostream>
+#include<iterator>
+
+namespace
+{
+	const uint32_t REPLAY_MAGIC = 0x4C505242;   // "BRPL" read as little-endian bytes
+	const float QUATERNION_RANGE = 0.70710678f; // the three smallest components lie within +-1/sqrt(2)
+	const float QUANTIZE_STEPS = 65535.0f;
+
+	const uint64_t FNV_OFFSET = 1469598103934665603ull;
+	const uint64_t FNV_PRIME = 1099511628211ull;
+
+	void Mix(uint64_t& hash, const void* data, size_t size)
+	{
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+		for (size_t i = 0; i < size; i++) {
+			hash = (hash ^ bytes[i]) * FNV_PRIME;
+		}
+	}
+
+	template<class T>
+	void Put(std::vector<uint8_t>& out, const T& value)
+	{
+		const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+		out.insert(out.end(), bytes, bytes + sizeof(T));
+	}
+
+	struct Reader
+	{
+		const std::vector<uint8_t>& data;
+		size_t offset = 0;
+
+		template<class T>
+		bool Get(T& value)
+		{
+			if (offset + sizeof(T) > data.size()) {
+				return false;
+			}
+			std::memcpy(&value, data.data() + offset, sizeof(T));
+			offset += sizeof(T);
+			return true;
+		}
+	};
+}
+
+PackedBall PackedBall::Pack(const BallSet& balls, int i)
+{
+	PackedBall ball;
+	ball.px = balls.px[i];
+	ball.pz = balls.pz[i];
+	ball.phase = balls.phase[i];
+
+	float q[4] = { balls.qw[i], balls.qx[i], balls.qy[i], balls.qz[i] };
+	int largest = 0;
+	for (int k = 1; k < 4; k++) {
+		if (std::fabs(q[k]) > std::fabs(q[largest])) {
+			largest = k;
+		}
+	}
+	// q and -q are the same rotation; make the dropped component positive
+	float sign = q[largest] < 0.0f ? -1.0f : 1.0f;
+	ball.largest = static_cast<uint8_t>(largest);
+	for (int k = 0, slot = 0; k < 4; k++) {
+		if (k == largest) {
+			continue;
+		}
+		float unit = std::clamp(0.5f + 0.5f * sign * q[k] / QUATERNION_RANGE, 0.0f, 1.0f);
+		ball.orientation[slot++] = static_cast<uint16_t>(std::lround(unit * QUANTIZE_STEPS));
+	}
+	return ball;
+}
+
+void PackedBall::Unpack(BallSet& balls, int i) const
+{
+	balls.px[i] = px;
+	balls.pz[i] = pz;
+	balls.vx[i] = 0.0f;
+	balls.vz[i] = 0.0f;
+	balls.wx[i] = 0.0f;
+	balls.wy[i] = 0.0f;
+	balls.wz[i] = 0.0f;
+	balls.phase[i] = phase;
+
+	float q[4];
+	float sum = 0.0f;
+	for (int k = 0, slot = 0; k < 4; k++) {
+		if (k == largest) {
+			continue;
+		}
+		q[k] = (orientation[slot++] / QUANTIZE_STEPS * 2.0f - 1.0f) * QUATERNION_RANGE;
+		sum += q[k] * q[k];
+	}
+	q[largest] = std::sqrt(std::max(0.0f, 1.0f - sum));
+	balls.qw[i] = q[0];
+	balls.qx[i] = q[1];
+	balls.qy[i] = q[2];
+	balls.qz[i] = q[3];
+}
+
+void ReplayLog::Begin(const TableSpec& table, const PhysicsParams& params, const BallSet& balls)
+{
+	this->table = table;
+	this->table.geometry = nullptr;
+	this->params = params;
+	geometry = table.geometry;
+	hasGeometry = geometry != nullptr;
+	geometryHash = GeometryHash(geometry);
+	ballCount = balls.count;
+	shots.clear();
+	snapshots.clear();
+	packed.clear();
+	AddSnapshot(0, true, balls);
+	lastRest = RestHash(balls);
+}
+
+void ReplayLog::RecordShot(const BallSet& before, int ball, glm::vec2 direction, float speed, float follow, float english,
+	const BallSet& after)
+{
+	if (snapshots.empty() || before.count != ballCount) {
+		return;
+	}
+	int index = GetShotCount();
+	bool placed = RestHash(before) != lastRest;
+	bool periodic = snapshotInterval > 0 && index % snapshotInterval == 0;
+	if ((placed || periodic) && snapshots.back().shot != index) {
+		AddSnapshot(index, placed, before);
+	}
+
+	ReplayShot shot;
+	shot.ball = ball;
+	shot.direction = direction;
+	shot.speed = speed;
+	shot.follow = follow;
+	shot.english = english;
+	BallSet rest = after;
+	SettleBalls(rest);
+	shot.restHash = RestHash(rest);
+	shots.push_back(shot);
+	lastRest = shot.restHash;
+}
+
+void ReplayLog::AddSnapshot(int shot, bool placed, const BallSet& balls)
+{
+	snapshots.push_back({ shot, placed, static_cast<int>(packed.size()) });
+	for (int i = 0; i < ballCount; i++) {
+		packed.push_back(PackedBall::Pack(balls, i));
+	}
+}
+
+void ReplayLog::UnpackSnapshot(const Snapshot& snapshot, BallSet& balls) const
+{
+	balls = BallSet();
+	balls.count = ballCount;
+	for (int i = 0; i < ballCount; i++) {
+		packed[snapshot.first + i].Unpack(balls, i);
+	}
+}
+
+bool ReplayLog::AttachGeometry(const TableGeometry* geometry)
+{
+	if ((geometry != nullptr) != hasGeometry || GeometryHash(geometry) != geometryHash) {
+		std::cout << "[REPLAY] Cushion geometry differs from the recording" << std::endl;
+		return false;
+	}
+	this->geometry = geometry;
+	return true;
+}
+
+bool ReplayLog::Prepare(EventSimulator& simulator) const
+{
+	if (snapshots.empty() || (hasGeometry && geometry == nullptr)) {
+		return false;
+	}
+	simulator.table = table;
+	simulator.table.geometry = geometry;
+	simulator.params = params;
+	return true;
+}
+
+void ReplayLog::PlayToRest(int shot, EventSimulator& simulator, BallSet& balls) const
+{
+	const ReplayShot& strike = shots[shot];
+	simulator.Reset(balls);
+	simulator.Strike(strike.ball, strike.direction, strike.speed, strike.follow, strike.english);
+	simulator.SimulateToRest();
+	// Every ball rests, so their own reference times no longer matter
+	const BallSet& rest = simulator.GetBalls();
+	for (int i = 0; i < ballCount; i++) {
+		balls.px[i] = rest.px[i];
+		balls.pz[i] = rest.pz[i];
+		balls.vx[i] = rest.vx[i];
+		balls.vz[i] = rest.vz[i];
+		balls.wx[i] = rest.wx[i];
+		balls.wy[i] = rest.wy[i];
+		balls.wz[i] = rest.wz[i];
+		balls.phase[i] = rest.phase[i];
+	}
+	SettleBalls(balls);
+}
+
+bool ReplayLog::StateBeforeShot(int shot, EventSimulator& simulator, BallSet& out) const
+{
+	if (shot < 0 || shot > GetShotCount() || !Prepare(simulator)) {
+		return false;
+	}
+	auto nearest = std::upper_bound(snapshots.begin(), snapshots.end(), shot,
+		[](int s, const Snapshot& snapshot) { return s < snapshot.shot; });
+	const Snapshot& start = *(nearest - 1);
+	UnpackSnapshot(start, out);
+
+	bool history = simulator.recordHistory;
+	simulator.recordHistory = false;
+	for (int k = start.shot; k < shot; k++) {
+		PlayToRest(k, simulator, out);
+	}
+	simulator.recordHistory = history;
+	return true;
+}
+
+bool ReplayLog::Seek(int shot, double time, EventSimulator& simulator, BallSet& out) const
+{
+	if (shot >= GetShotCount() || !StateBeforeShot(shot, simulator, out)) {
+		return false;
+	}
+	const ReplayShot& strike = shots[shot];
+	simulator.Reset(out);
+	simulator.Strike(strike.ball, strike.direction, strike.speed, strike.follow, strike.english);
+	simulator.SimulateToRest();
+	simulator.StateAt(std::max(time, 0.0), out);
+	return true;
+}
+
+int ReplayLog::Verify(EventSimulator& simulator) const
+{
+	if (!Prepare(simulator)) {
+		return 0;
+	}
+	bool history = simulator.recordHistory;
+	simulator.recordHistory = false;
+	BallSet balls;
+	size_t next = 0;
+	int diverged = -1;
+	for (int k = 0; k < GetShotCount() && diverged < 0; k++) {
+		// Only hand-placed snapshots; the periodic ones would hide a divergence
+		for (; next < snapshots.size() && snapshots[next].shot <= k; next++) {
+			if (snapshots[next].placed) {
+				UnpackSnapshot(snapshots[next], balls);
+			}
+		}
+		PlayToRest(k, simulator, balls);
+		if (RestHash(balls) != shots[k].restHash) {
+			diverged = k;
+		}
+	}
+	simulator.recordHistory = history;
+	return diverged;
+}
+
+uint64_t ReplayLog::RestHash(const BallSet& balls)
+{
+	uint64_t hash = FNV_OFFSET;
+	size_t bytes = sizeof(float) * balls.count;
+	Mix(hash, balls.px, bytes);
+	Mix(hash, balls.pz, bytes);
+	Mix(hash, balls.vx, bytes);
+	Mix(hash, balls.vz, bytes);
+	Mix(hash, balls.wx, bytes);
+	Mix(hash, balls.wy, bytes);
+	Mix(hash, balls.wz, bytes);
+	Mix(hash, balls.phase, sizeof(BallPhase) * balls.count);
+	return hash;
+}
+
+void ReplayLog::SettleBalls(BallSet& balls)
+{
+	for (int i = 0; i < balls.count; i++) {
+		if (balls.phase[i] == BallPhase::Stationary || balls.phase[i] == BallPhase::Pocketed) {
+			balls.vx[i] = 0.0f;
+			balls.vz[i] = 0.0f;
+			balls.wx[i] = 0.0f;
+			balls.wy[i] = 0.0f;
+			balls.wz[i] = 0.0f;
+		}
+	}
+}
+
+uint64_t ReplayLog::GeometryHash(const TableGeometry* geometry)
+{
+	uint64_t hash = FNV_OFFSET;
+	if (geometry == nullptr) {
+		return hash;
+	}
+	for (const CushionSegment& segment : geometry->segments) {
+		Mix(hash, &segment.start, sizeof(glm::vec2));
+		Mix(hash, &segment.end, sizeof(glm::vec2));
+		Mix(hash, &segment.normal, sizeof(glm::vec2));
+	}
+	for (const CushionArc& arc : geometry->arcs) {
+		Mix(hash, &arc.center, sizeof(glm::vec2));
+		Mix(hash, &arc.radius, sizeof(float));
+		Mix(hash, &arc.from, sizeof(glm::vec2));
+		Mix(hash, &arc.to, sizeof(glm::vec2));
+		Mix(hash, &arc.sweep, sizeof(float));
+	}
+	return hash;
+}
+
+void ReplayLog::Serialize(std::vector<uint8_t>& out) const
+{
+	out.clear();
+	Put(out, REPLAY_MAGIC);
+	Put(out, FORMAT_VERSION);
+	Put(out, static_cast<uint32_t>(ballCount));
+	Put(out, table.center);
+	Put(out, table.halfSizeX);
+	Put(out, table.halfSizeZ);
+	Put(out, table.surfaceHeight);
+	Put(out, table.ballRadius);
+	Put(out, table.pocketRadius);
+	Put(out, static_cast<uint32_t>(table.pocketCount));
+	for (int p = 0; p < table.pocketCount; p++) {
+		Put(out, table.pockets[p]);
+	}
+	Put(out, params.gravity);
+	Put(out, params.slidingFriction);
+	Put(out, params.rollingFriction);
+	Put(out, params.spinningFriction);
+	Put(out, params.ballRestitution);
+	Put(out, params.cushionRestitution);
+	Put(out, static_cast<uint8_t>(hasGeometry));
+	Put(out, geometryHash);
+	Put(out, static_cast<uint32_t>(shots.size()));
+	Put(out, static_cast<uint32_t>(snapshots.size()));
+
+	for (const ReplayShot& shot : shots) {
+		Put(out, static_cast<uint8_t>(shot.ball));
+		Put(out, shot.direction);
+		Put(out, shot.speed);
+		Put(out, shot.follow);
+		Put(out, shot.english);
+		Put(out, shot.restHash);
+	}
+	for (const Snapshot& snapshot : snapshots) {
+		Put(out, static_cast<uint32_t>(snapshot.shot));
+		Put(out, static_cast<uint8_t>(snapshot.placed));
+		for (int i = 0; i < ballCount; i++) {
+			Put(out, packed[snapshot.first + i]);
+		}
+	}
+}
+
+size_t ReplayLog::GetByteSize() const
+{
+	std::vector<uint8_t> bytes;
+	Serialize(bytes);
+	return bytes.size();
+}
+
+bool ReplayLog::Save(const std::string& path) const
+{
+	std::vector<uint8_t> bytes;
+	Serialize(bytes);
+	std::ofstream file(path, std::ios::binary);
+	if (!file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size())) {
+		std::cout << "[REPLAY] Could not write " << path << std::endl;
+		return false;
+	}
+	std::cout << "[REPLAY] Saved " << shots.size() << " shots to " << path << " (" << bytes.size() << " bytes)" << std::endl;
+	return true;
+}
+
+bool ReplayLog::Load(const std::string& path)
+{
+	shots.clear();
+	snapshots.clear();
+	packed.clear();
+	geometry = nullptr;
+
+	std::ifstream file(path, std::ios::binary);
+	std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	Reader reader{ bytes };
+	uint32_t magic = 0, version = 0, balls = 0, pockets = 0, shotCount = 0, snapshotCount = 0;
+	uint8_t geometryFlag = 0;
+	bool ok = reader.Get(magic) && magic == REPLAY_MAGIC && reader.Get(version) && version == FORMAT_VERSION
+		&& reader.Get(balls) && balls <= MAX_BALLS
+		&& reader.Get(table.center) && reader.Get(table.halfSizeX) && reader.Get(table.halfSizeZ)
+		&& reader.Get(table.surfaceHeight) && reader.Get(table.ballRadius) && reader.Get(table.pocketRadius)
+		&& reader.Get(pockets) && pockets <= MAX_POCKETS;
+	for (uint32_t p = 0; ok && p < pockets; p++) {
+		ok = reader.Get(table.pockets[p]);
+	}
+	ok = ok && reader.Get(params.gravity) && reader.Get(params.slidingFriction) && reader.Get(params.rollingFriction)
+		&& reader.Get(params.spinningFriction) && reader.Get(params.ballRestitution)
+		&& reader.Get(params.cushionRestitution) && reader.Get(geometryFlag) && reader.Get(geometryHash)
+		&& reader.Get(shotCount) && reader.Get(snapshotCount) && snapshotCount > 0;
+	table.pocketCount = static_cast<int>(pockets);
+	table.geometry = nullptr;
+	hasGeometry = geometryFlag != 0;
+	ballCount = static_cast<int>(balls);
+
+	for (uint32_t k = 0; ok && k < shotCount; k++) {
+		ReplayShot shot;
+		uint8_t ball = 0;
+		ok = reader.Get(ball) && ball < balls && reader.Get(shot.direction) && reader.Get(shot.speed)
+			&& reader.Get(shot.follow) && reader.Get(shot.english) && reader.Get(shot.restHash);
+		shot.ball = ball;
+		shots.push_back(shot);
+	}
+	int previous = -1;
+	for (uint32_t k = 0; ok && k < snapshotCount; k++) {
+		uint32_t shot = 0;
+		uint8_t placed = 0;
+		// Sorted by shot, starting at the first one, as Begin and RecordShot write them
+		ok = reader.Get(shot) && static_cast<int>(shot) > previous && shot <= shotCount
+			&& (k > 0 || shot == 0) && reader.Get(placed);
+		snapshots.push_back({ static_cast<int>(shot), placed != 0, static_cast<int>(packed.size()) });
+		for (int i = 0; ok && i < ballCount; i++) {
+			PackedBall ball;
+			// Unpack indexes the quaternion by largest and keeps the phase as is
+			ok = reader.Get(ball) && ball.largest < 4 && ball.phase <= BallPhase::Pocketed;
+			packed.push_back(ball);
+		}
+		previous = static_cast<int>(shot);
+	}
+
+	if (!ok) {
+		std::cout << "[REPLAY] " << path << " is not a readable replay" << std::endl;
+		shots.clear();
+		snapshots.clear();
+		packed.clear();
+		ballCount = 0;
+		return false;
+	}
+	lastRest = shots.empty() ? 0 : shots.back().restHash;
+	if (shots.empty()) {
+		BallSet start;
+		UnpackSnapshot(snapshots.front(), start);
+		lastRest = RestHash(start);
+	}
+	std::cout << "[REPLAY] Loaded " << shots.size() << " shots, " << snapshots.size() << " snapshots from " << path << std::endl;
+	return true;
+}
+
+void ReplayLog::PrintStats() const
+{
+	std::cout << "[REPLAY] " << shots.size() << " shots, " << snapshots.size() << " snapshots of "
+			  << ballCount << " balls, " << GetByteSize() << " bytes" << std::endl;
+}
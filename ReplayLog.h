@@ -0,0 +1,132 @@
+#ifndef REPLAY_LOG_CLASS_H
+#define REPLAY_LOG_CLASS_H
+
+#include<cstdint>
+#include<string>
+#include<vector>
+#include<glm/glm.hpp>
+
+#include"BilliardPhysics.h"
+#include"EventSimulator.h"
+#include"TableGeometry.h"
+
+// One ball of a snapshot in 16 bytes: the exact position, the phase and the
+// drawing orientation as the three smallest quaternion components. Snapshots
+// are only taken with the table at rest, so the velocities are all zero and
+// need no room.
+struct PackedBall
+{
+	float px = 0.0f;
+	float pz = 0.0f;
+	uint16_t orientation[3] = {};
+	uint8_t largest = 0;        // index of the quaternion component left out
+	BallPhase phase = BallPhase::Stationary;
+
+	static PackedBall Pack(const BallSet& balls, int i);
+	void Unpack(BallSet& balls, int i) const;
+};
+static_assert(sizeof(PackedBall) == 16, "PackedBall must stay 16 bytes");
+
+// A cue strike as passed to BilliardPhysics::Strike, plus a hash of the
+// table once the shot came to rest so a replay can tell where it diverged
+struct ReplayShot
+{
+	int ball = 0;
+	glm::vec2 direction = glm::vec2(1.0f, 0.0f);
+	float speed = 0.0f;
+	float follow = 0.0f;
+	float english = 0.0f;
+	uint64_t restHash = 0;
+};
+
+// Everything that happened on a table in a few kilobytes: the table, the
+// physics parameters, the starting balls and then only the cue strikes.
+// The event simulator is deterministic for a given build (scalar float
+// math in a fixed order, no fast-math), so replaying the strikes rebuilds
+// every moment of the game bit for bit.
+//
+// A snapshot of the resting table is kept every snapshotInterval shots and
+// whenever the balls were moved between shots (a re-rack), so Seek never
+// re-simulates more than snapshotInterval shots. Mesh cushions are not
+// stored, only a hash of them; the player has to attach the same geometry.
+//
+// The binary file is little-endian:
+//   header   magic "BRPL", version, ball count, TableSpec, PhysicsParams,
+//            geometry flag and hash, shot count, snapshot count
+//   shots    ball u8, direction, speed, follow, english, rest hash u64
+//   snaps    shot u32, placed u8, then one PackedBall per ball
+class ReplayLog
+{
+public:
+	static constexpr uint32_t FORMAT_VERSION = 1;
+	static const int DEFAULT_SNAPSHOT_INTERVAL = 8;
+
+	int snapshotInterval = DEFAULT_SNAPSHOT_INTERVAL;
+
+	// Starts a new log; table.geometry is hashed and must be attached again
+	// to play a loaded log back
+	void Begin(const TableSpec& table, const PhysicsParams& params, const BallSet& balls);
+	// Appends a shot played from before (at rest) that came to rest as after
+	void RecordShot(const BallSet& before, int ball, glm::vec2 direction, float speed, float follow, float english,
+		const BallSet& after);
+
+	bool Save(const std::string& path) const;
+	// Replaces the log; false, leaving it empty, when the file is not a replay
+	bool Load(const std::string& path);
+	// False when geometry is not what the log was recorded with
+	bool AttachGeometry(const TableGeometry* geometry);
+
+	int GetShotCount() const { return static_cast<int>(shots.size()); }
+	int GetBallCount() const { return ballCount; }
+	const ReplayShot& GetShot(int shot) const { return shots[shot]; }
+	size_t GetByteSize() const;
+
+	// The resting table just before shot; shot == GetShotCount() is the end
+	// of the game. Replays from the nearest snapshot at or before shot.
+	bool StateBeforeShot(int shot, EventSimulator& simulator, BallSet& out) const;
+	// The table time seconds after shot was struck. simulator is left
+	// holding the solved shot, so playback can go on with StateAt.
+	bool Seek(int shot, double time, EventSimulator& simulator, BallSet& out) const;
+	// Plays every shot from the start and compares the resting tables with
+	// the recorded hashes; the first shot that differs, -1 when none does.
+	// 0 when the log cannot be played, e.g. without its geometry attached.
+	int Verify(EventSimulator& simulator) const;
+
+	// FNV-1a over the simulated state, as BilliardPhysics::StateHash
+	static uint64_t RestHash(const BallSet& balls);
+	// A ball counts as stationary with velocities up to the physics epsilons
+	// left over; this zeroes them, as a snapshot would. Call it on the table
+	// before every recorded shot so live play and replay start alike.
+	static void SettleBalls(BallSet& balls);
+
+	void PrintStats() const;
+
+private:
+	struct Snapshot
+	{
+		int shot;
+		bool placed;   // balls moved by hand, not where the previous shot left them
+		int first;     // packed[first, first + ballCount)
+	};
+
+	TableSpec table;
+	PhysicsParams params;
+	uint64_t geometryHash = 0;
+	bool hasGeometry = false;
+	const TableGeometry* geometry = nullptr;
+	int ballCount = 0;
+	uint64_t lastRest = 0;
+	std::vector<ReplayShot> shots;
+	std::vector<Snapshot> snapshots;
+	std::vector<PackedBall> packed;
+
+	void AddSnapshot(int shot, bool placed, const BallSet& balls);
+	void UnpackSnapshot(const Snapshot& snapshot, BallSet& balls) const;
+	// Plays shot from balls (at rest) to rest, leaving the result in balls
+	void PlayToRest(int shot, EventSimulator& simulator, BallSet& balls) const;
+	bool Prepare(EventSimulator& simulator) const;
+	void Serialize(std::vector<uint8_t>& out) const;
+	static uint64_t GeometryHash(const TableGeometry* geometry);
+};
+
+#endif
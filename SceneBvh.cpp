@@ -0,0 +1,511 @@
+#include"SceneBvh.h"
+#include<algorithm>
+#include<iostream>
+#include<limits>
+#include<numeric>
+
+namespace
+{
+	const float TRAVERSAL_COST = 1.0f;   // relative to testing one item
+
+	float SurfaceArea(glm::vec3 boundsMin, glm::vec3 boundsMax)
+	{
+		glm::vec3 size = glm::max(boundsMax - boundsMin, glm::vec3(0.0f));
+		return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+	}
+
+	glm::vec3 Centroid(const SceneItem& item)
+	{
+		return 0.5f * (item.boundsMin + item.boundsMax);
+	}
+
+	// Entry distance of the ray into the box, or infinity when it misses
+	float RayBox(glm::vec3 origin, glm::vec3 inverseDirection, glm::vec3 boundsMin, glm::vec3 boundsMax, float maxDistance)
+	{
+		glm::vec3 t0 = (boundsMin - origin) * inverseDirection;
+		glm::vec3 t1 = (boundsMax - origin) * inverseDirection;
+		glm::vec3 tNear = glm::min(t0, t1);
+		glm::vec3 tFar = glm::max(t0, t1);
+		float entry = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+		float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, maxDistance));
+		return entry <= exit ? entry : std::numeric_limits<float>::infinity();
+	}
+
+	bool SphereBox(glm::vec3 center, float radius, glm::vec3 boundsMin, glm::vec3 boundsMax)
+	{
+		glm::vec3 offset = center - glm::clamp(center, boundsMin, boundsMax);
+		return glm::dot(offset, offset) <= radius * radius;
+	}
+
+	enum class Containment { Outside, Intersecting, Inside };
+
+	Containment ClassifyBox(const Frustum& frustum, glm::vec3 boundsMin, glm::vec3 boundsMax)
+	{
+		Containment result = Containment::Inside;
+		for (const glm::vec4& plane : frustum.planes) {
+			glm::vec3 normal(plane);
+			glm::vec3 furthest = glm::mix(boundsMin, boundsMax, glm::vec3(glm::greaterThanEqual(normal, glm::vec3(0.0f))));
+			glm::vec3 nearest = glm::mix(boundsMax, boundsMin, glm::vec3(glm::greaterThanEqual(normal, glm::vec3(0.0f))));
+			if (glm::dot(normal, furthest) + plane.w < 0.0f) {
+				return Containment::Outside;
+			}
+			if (glm::dot(normal, nearest) + plane.w < 0.0f) {
+				result = Containment::Intersecting;
+			}
+		}
+		return result;
+	}
+}
+
+int SceneBvh::AddModel(Model& model, const std::vector<int>& dynamicNodes)
+{
+	int modelIndex = static_cast<int>(models.size());
+	models.push_back(&model);
+	model.UpdateTransforms();
+
+	int nodeCount = model.GetNodeCount();
+	std::vector<uint8_t> moving(nodeCount, 0);
+	for (int node : dynamicNodes) {
+		if (node >= 0 && node < nodeCount) {
+			moving[node] = 1;
+		}
+	}
+	for (int i = 0; i < nodeCount; i++) {
+		moving[i] |= model.IsNodeAnimated(i) ? 1 : 0;
+	}
+
+	for (int i = 0; i < nodeCount; i++) {
+		if (model.GetNode(i).meshIndex < 0) {
+			continue;
+		}
+		SceneItem item;
+		item.model = modelIndex;
+		item.node = i;
+		// A node moves with any of its ancestors
+		for (int n = i; n >= 0 && !item.dynamic; n = model.GetNode(n).parent) {
+			item.dynamic = moving[n] != 0;
+		}
+		ReadBounds(item);
+		items.push_back(item);
+	}
+	visibleNodes.emplace_back(nodeCount, 1);
+	return modelIndex;
+}
+
+void SceneBvh::Clear()
+{
+	models.clear();
+	items.clear();
+	itemOrder.clear();
+	itemLeaf.clear();
+	nodes.clear();
+	parents.clear();
+	dynamicItems.clear();
+	visibleNodes.clear();
+	stats = SceneBvhStats();
+}
+
+void SceneBvh::ReadBounds(SceneItem& item) const
+{
+	const Node& node = models[item.model]->GetNode(item.node);
+	item.boundsMin = node.worldBoundsMin;
+	item.boundsMax = node.worldBoundsMax;
+}
+
+void SceneBvh::Build()
+{
+	int itemCount = static_cast<int>(items.size());
+	itemOrder.resize(itemCount);
+	std::iota(itemOrder.begin(), itemOrder.end(), 0);
+	itemLeaf.assign(itemCount, -1);
+	dynamicItems.clear();
+	for (int i = 0; i < itemCount; i++) {
+		if (items[i].dynamic) {
+			dynamicItems.push_back(i);
+		}
+	}
+
+	nodes.clear();
+	parents.clear();
+	stats.depth = 0;
+	if (itemCount > 0) {
+		// A binary tree over n items never needs more than 2n - 1 nodes
+		nodes.reserve(2 * static_cast<size_t>(itemCount));
+		nodes.push_back(BvhNode{ glm::vec3(0.0f), 0, glm::vec3(0.0f), itemCount });
+		parents.push_back(-1);
+		Subdivide(0, 1);
+	}
+	dirty.assign(nodes.size(), 0);
+
+	stats.items = itemCount;
+	stats.dynamicItems = static_cast<int>(dynamicItems.size());
+	stats.nodes = static_cast<int>(nodes.size());
+	stats.builds++;
+	stats.buildCost = Cost();
+	stats.cost = stats.buildCost;
+}
+
+void SceneBvh::FitNode(BvhNode& node) const
+{
+	if (node.count > 0) {
+		node.boundsMin = glm::vec3(std::numeric_limits<float>::max());
+		node.boundsMax = glm::vec3(-std::numeric_limits<float>::max());
+		for (int i = node.first; i < node.first + node.count; i++) {
+			const SceneItem& item = items[itemOrder[i]];
+			node.boundsMin = glm::min(node.boundsMin, item.boundsMin);
+			node.boundsMax = glm::max(node.boundsMax, item.boundsMax);
+		}
+		return;
+	}
+	const BvhNode& left = nodes[node.first];
+	const BvhNode& right = nodes[node.first + 1];
+	node.boundsMin = glm::min(left.boundsMin, right.boundsMin);
+	node.boundsMax = glm::max(left.boundsMax, right.boundsMax);
+}
+
+void SceneBvh::Subdivide(int nodeIndex, int depth)
+{
+	FitNode(nodes[nodeIndex]);
+	stats.depth = std::max(stats.depth, depth);
+	int first = nodes[nodeIndex].first;
+	int count = nodes[nodeIndex].count;
+
+	auto makeLeaf = [&]() {
+		for (int i = first; i < first + count; i++) {
+			itemLeaf[itemOrder[i]] = nodeIndex;
+		}
+	};
+	if (count <= 1 || depth >= MAX_DEPTH) {
+		makeLeaf();
+		return;
+	}
+
+	glm::vec3 centroidMin(std::numeric_limits<float>::max());
+	glm::vec3 centroidMax(-std::numeric_limits<float>::max());
+	for (int i = first; i < first + count; i++) {
+		glm::vec3 centroid = Centroid(items[itemOrder[i]]);
+		centroidMin = glm::min(centroidMin, centroid);
+		centroidMax = glm::max(centroidMax, centroid);
+	}
+
+	// Cheapest split over BIN_COUNT bins of centroids along each axis
+	struct Bin
+	{
+		glm::vec3 boundsMin = glm::vec3(std::numeric_limits<float>::max());
+		glm::vec3 boundsMax = glm::vec3(-std::numeric_limits<float>::max());
+		int count = 0;
+	};
+	float bestCost = std::numeric_limits<float>::max();
+	int bestAxis = -1;
+	int bestSplit = 0;
+	for (int axis = 0; axis < 3; axis++) {
+		float extent = centroidMax[axis] - centroidMin[axis];
+		if (extent <= 0.0f) {
+			continue;
+		}
+		float scale = BIN_COUNT / extent;
+		Bin bins[BIN_COUNT];
+		for (int i = first; i < first + count; i++) {
+			const SceneItem& item = items[itemOrder[i]];
+			int bin = std::min(static_cast<int>((Centroid(item)[axis] - centroidMin[axis]) * scale), BIN_COUNT - 1);
+			bins[bin].boundsMin = glm::min(bins[bin].boundsMin, item.boundsMin);
+			bins[bin].boundsMax = glm::max(bins[bin].boundsMax, item.boundsMax);
+			bins[bin].count++;
+		}
+		// Sweep from the right for the right-hand areas, then from the left
+		float rightArea[BIN_COUNT];
+		int rightCount[BIN_COUNT];
+		Bin right;
+		for (int b = BIN_COUNT - 1; b > 0; b--) {
+			right.boundsMin = glm::min(right.boundsMin, bins[b].boundsMin);
+			right.boundsMax = glm::max(right.boundsMax, bins[b].boundsMax);
+			right.count += bins[b].count;
+			rightArea[b] = SurfaceArea(right.boundsMin, right.boundsMax);
+			rightCount[b] = right.count;
+		}
+		Bin left;
+		for (int b = 0; b < BIN_COUNT - 1; b++) {
+			left.boundsMin = glm::min(left.boundsMin, bins[b].boundsMin);
+			left.boundsMax = glm::max(left.boundsMax, bins[b].boundsMax);
+			left.count += bins[b].count;
+			if (left.count == 0 || rightCount[b + 1] == 0) {
+				continue;
+			}
+			float cost = SurfaceArea(left.boundsMin, left.boundsMax) * left.count + rightArea[b + 1] * rightCount[b + 1];
+			if (cost < bestCost) {
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplit = b + 1;
+			}
+		}
+	}
+
+	float area = SurfaceArea(nodes[nodeIndex].boundsMin, nodes[nodeIndex].boundsMax);
+	float leafCost = area * count;
+	if (count <= MAX_LEAF_ITEMS && (bestAxis < 0 || TRAVERSAL_COST * area + bestCost >= leafCost)) {
+		makeLeaf();
+		return;
+	}
+
+	int* begin = itemOrder.data() + first;
+	int* end = begin + count;
+	int* middle = begin + count / 2;
+	if (bestAxis >= 0) {
+		float scale = BIN_COUNT / (centroidMax[bestAxis] - centroidMin[bestAxis]);
+		middle = std::partition(begin, end, [&](int item) {
+			int bin = std::min(static_cast<int>((Centroid(items[item])[bestAxis] - centroidMin[bestAxis]) * scale), BIN_COUNT - 1);
+			return bin < bestSplit;
+		});
+	}
+	if (middle == begin || middle == end) {
+		// Every centroid in one spot: halve the list instead
+		middle = begin + count / 2;
+	}
+	int leftCount = static_cast<int>(middle - begin);
+
+	int left = static_cast<int>(nodes.size());
+	nodes.push_back(BvhNode{ glm::vec3(0.0f), first, glm::vec3(0.0f), leftCount });
+	nodes.push_back(BvhNode{ glm::vec3(0.0f), first + leftCount, glm::vec3(0.0f), count - leftCount });
+	parents.push_back(nodeIndex);
+	parents.push_back(nodeIndex);
+	nodes[nodeIndex].first = left;
+	nodes[nodeIndex].count = 0;
+	Subdivide(left, depth + 1);
+	Subdivide(left + 1, depth + 1);
+}
+
+void SceneBvh::Refit()
+{
+	if (dynamicItems.empty()) {
+		return;
+	}
+	// Children always come after their parent, so fitting the touched nodes
+	// from the highest index down refits every subtree before its parent
+	touched.clear();
+	for (int item : dynamicItems) {
+		ReadBounds(items[item]);
+		for (int n = itemLeaf[item]; n >= 0 && !dirty[n]; n = parents[n]) {
+			dirty[n] = 1;
+			touched.push_back(n);
+		}
+	}
+	std::sort(touched.begin(), touched.end(), std::greater<int>());
+	for (int n : touched) {
+		FitNode(nodes[n]);
+		dirty[n] = 0;
+	}
+	stats.refits++;
+
+	stats.cost = Cost();
+	if (stats.cost > REBUILD_COST_RATIO * stats.buildCost) {
+		Build();
+	}
+}
+
+float SceneBvh::Cost() const
+{
+	if (nodes.empty()) {
+		return 0.0f;
+	}
+	float rootArea = SurfaceArea(nodes[0].boundsMin, nodes[0].boundsMax);
+	if (rootArea <= 0.0f) {
+		return 0.0f;
+	}
+	float cost = 0.0f;
+	for (const BvhNode& node : nodes) {
+		float area = SurfaceArea(node.boundsMin, node.boundsMax);
+		cost += node.count > 0 ? area * node.count : TRAVERSAL_COST * area;
+	}
+	return cost / rootArea;
+}
+
+void SceneBvh::CollectItems(int nodeIndex, std::vector<int>& result) const
+{
+	const BvhNode& node = nodes[nodeIndex];
+	if (node.count > 0) {
+		result.insert(result.end(), itemOrder.begin() + node.first, itemOrder.begin() + node.first + node.count);
+		return;
+	}
+	CollectItems(node.first, result);
+	CollectItems(node.first + 1, result);
+}
+
+void SceneBvh::QueryFrustum(const Frustum& frustum, std::vector<int>& result) const
+{
+	QueryFrustum(frustum, result, nullptr);
+}
+
+void SceneBvh::QueryFrustum(const Frustum& frustum, std::vector<int>& result, std::vector<int>* straddling) const
+{
+	result.clear();
+	if (straddling != nullptr) {
+		straddling->clear();
+	}
+	if (nodes.empty()) {
+		return;
+	}
+	int stack[2 * MAX_DEPTH + 2];
+	int top = 0;
+	stack[top++] = 0;
+	while (top > 0) {
+		const BvhNode& node = nodes[stack[--top]];
+		Containment containment = ClassifyBox(frustum, node.boundsMin, node.boundsMax);
+		if (containment == Containment::Outside) {
+			continue;
+		}
+		if (containment == Containment::Inside) {
+			CollectItems(static_cast<int>(&node - nodes.data()), result);
+			continue;
+		}
+		if (node.count > 0) {
+			for (int i = node.first; i < node.first + node.count; i++) {
+				const SceneItem& item = items[itemOrder[i]];
+				if (straddling != nullptr) {
+					straddling->push_back(itemOrder[i]);
+				}
+				else if (frustum.IntersectsBox(item.boundsMin, item.boundsMax)) {
+					result.push_back(itemOrder[i]);
+				}
+			}
+			continue;
+		}
+		stack[top++] = node.first;
+		stack[top++] = node.first + 1;
+	}
+}
+
+void SceneBvh::QueryRay(glm::vec3 origin, glm::vec3 direction, float maxDistance, std::vector<SceneRayHit>& result) const
+{
+	result.clear();
+	if (nodes.empty()) {
+		return;
+	}
+	glm::vec3 inverseDirection = 1.0f / direction;
+	const float miss = std::numeric_limits<float>::infinity();
+	int stack[2 * MAX_DEPTH + 2];
+	int top = 0;
+	if (RayBox(origin, inverseDirection, nodes[0].boundsMin, nodes[0].boundsMax, maxDistance) == miss) {
+		return;
+	}
+	stack[top++] = 0;
+	while (top > 0) {
+		const BvhNode& node = nodes[stack[--top]];
+		if (node.count > 0) {
+			for (int i = node.first; i < node.first + node.count; i++) {
+				const SceneItem& item = items[itemOrder[i]];
+				float distance = RayBox(origin, inverseDirection, item.boundsMin, item.boundsMax, maxDistance);
+				if (distance != miss) {
+					result.push_back({ itemOrder[i], distance });
+				}
+			}
+			continue;
+		}
+		const BvhNode& left = nodes[node.first];
+		const BvhNode& right = nodes[node.first + 1];
+		float leftDistance = RayBox(origin, inverseDirection, left.boundsMin, left.boundsMax, maxDistance);
+		float rightDistance = RayBox(origin, inverseDirection, right.boundsMin, right.boundsMax, maxDistance);
+		// The nearer child goes on top of the stack
+		bool leftFirst = leftDistance <= rightDistance;
+		float farDistance = leftFirst ? rightDistance : leftDistance;
+		float nearDistance = leftFirst ? leftDistance : rightDistance;
+		if (farDistance != miss) {
+			stack[top++] = leftFirst ? node.first + 1 : node.first;
+		}
+		if (nearDistance != miss) {
+			stack[top++] = leftFirst ? node.first : node.first + 1;
+		}
+	}
+	std::sort(result.begin(), result.end(), [](const SceneRayHit& a, const SceneRayHit& b) {
+		return a.distance < b.distance;
+	});
+}
+
+void SceneBvh::QuerySphere(glm::vec3 center, float radius, std::vector<int>& result) const
+{
+	result.clear();
+	if (nodes.empty()) {
+		return;
+	}
+	int stack[2 * MAX_DEPTH + 2];
+	int top = 0;
+	stack[top++] = 0;
+	while (top > 0) {
+		const BvhNode& node = nodes[stack[--top]];
+		if (!SphereBox(center, radius, node.boundsMin, node.boundsMax)) {
+			continue;
+		}
+		if (node.count > 0) {
+			for (int i = node.first; i < node.first + node.count; i++) {
+				const SceneItem& item = items[itemOrder[i]];
+				if (SphereBox(center, radius, item.boundsMin, item.boundsMax)) {
+					result.push_back(itemOrder[i]);
+				}
+			}
+			continue;
+		}
+		stack[top++] = node.first;
+		stack[top++] = node.first + 1;
+	}
+}
+
+bool SceneBvh::Pick(glm::vec3 origin, glm::vec3 direction, float maxDistance, ScenePick& pick)
+{
+	QueryRay(origin, direction, maxDistance, rayItems);
+	float bestDistance = maxDistance;
+	bool found = false;
+	for (const SceneRayHit& candidate : rayItems) {
+		if (candidate.distance >= bestDistance) {
+			break;
+		}
+		const SceneItem& item = items[candidate.item];
+		const Model& model = *models[item.model];
+		TriangleHit hit;
+		if (model.RaycastNode(item.node, origin, direction, bestDistance, hit)) {
+			bestDistance = hit.distance;
+			pick.model = item.model;
+			pick.node = item.node;
+			pick.mesh = model.GetNode(item.node).meshIndex;
+			pick.triangle = hit.triangle;
+			pick.distance = hit.distance;
+			pick.point = origin + hit.distance * direction;
+			found = true;
+		}
+	}
+	return found;
+}
+
+void SceneBvh::CullModels(const Frustum& frustum)
+{
+	for (std::vector<uint8_t>& visible : visibleNodes) {
+		std::fill(visible.begin(), visible.end(), 0);
+	}
+	QueryFrustum(frustum, frustumItems, &straddlingItems);
+
+	// Spheres reject most of the cut leaves' items, the box only the rest
+	int count = static_cast<int>(straddlingItems.size());
+	straddlingSpheres.Resize(count);
+	for (int k = 0; k < count; k++) {
+		const SceneItem& item = items[straddlingItems[k]];
+		const Node& node = models[item.model]->GetNode(item.node);
+		straddlingSpheres.Set(k, node.worldCenter, node.worldRadius);
+	}
+	frustum.CullSpheres(straddlingSpheres, straddlingVisible);
+	for (int k = 0; k < count; k++) {
+		const SceneItem& item = items[straddlingItems[k]];
+		if (straddlingVisible[k] && frustum.IntersectsBox(item.boundsMin, item.boundsMax)) {
+			frustumItems.push_back(straddlingItems[k]);
+		}
+	}
+
+	for (int item : frustumItems) {
+		visibleNodes[items[item].model][items[item].node] = 1;
+	}
+}
+
+void SceneBvh::PrintStats() const
+{
+	std::cout << "[BVH] " << stats.items << " items (" << stats.dynamicItems << " dynamic) from " << models.size()
+			  << " models, " << stats.nodes << " nodes, depth " << stats.depth << ", SAH cost " << stats.cost
+			  << " (" << stats.buildCost << " when built), " << stats.builds << " builds, " << stats.refits << " refits"
+			  << std::endl;
+}
@@ -0,0 +1,141 @@
+#ifndef SCENE_BVH_CLASS_H
+#define SCENE_BVH_CLASS_H
+
+#include<cstdint>
+#include<vector>
+#include<glm/glm.hpp>
+
+#include"Frustum.h"
+#include"Model.h"
+
+// One mesh node of a registered model
+struct SceneItem
+{
+	int model = -1;            // index from SceneBvh::AddModel
+	int node = -1;
+	bool dynamic = false;      // moved by the clip or the physics, refit every frame
+	glm::vec3 boundsMin = glm::vec3(0.0f);
+	glm::vec3 boundsMax = glm::vec3(0.0f);
+};
+
+struct SceneRayHit
+{
+	int item = -1;
+	float distance = 0.0f;     // along the ray to where it enters the item's box
+};
+
+// Nearest triangle under a ray
+struct ScenePick
+{
+	int model = -1;
+	int node = -1;
+	int mesh = -1;
+	int triangle = -1;
+	float distance = 0.0f;
+	glm::vec3 point = glm::vec3(0.0f);   // world space
+};
+
+struct SceneBvhStats
+{
+	int items = 0;
+	int dynamicItems = 0;
+	int nodes = 0;
+	int depth = 0;
+	int builds = 0;
+	int refits = 0;
+	float buildCost = 0.0f;    // SAH cost right after the last build
+	float cost = 0.0f;         // and after the last refit
+};
+
+// Bounding volume hierarchy over the world boxes of every mesh node of the
+// registered models (table, lamp, further tables and props), answering
+// frustum, ray and sphere queries in logarithmic time.
+//
+// Build splits by the surface area heuristic over binned centroids, once,
+// after the models are added. Afterwards only dynamic items move: Refit
+// re-reads their boxes (Model::UpdateTransforms must have run) and widens
+// or shrinks just the nodes above them. When refitting has made the tree
+// REBUILD_COST_RATIO times costlier than when it was built, it is rebuilt.
+class SceneBvh
+{
+public:
+	static const int MAX_LEAF_ITEMS = 4;
+	static const int MAX_DEPTH = 32;         // deeper subtrees become one leaf
+	static const int BIN_COUNT = 16;
+	static constexpr float REBUILD_COST_RATIO = 2.0f;
+
+	// Registers every mesh node of model; nodes animated by its clip or
+	// listed in dynamicNodes (with their children) are refit every frame.
+	// The model must outlive the tree. Returns the model's index.
+	int AddModel(Model& model, const std::vector<int>& dynamicNodes = {});
+	void Clear();
+
+	void Build();
+	void Refit();
+
+	const SceneItem& GetItem(int index) const { return items[index]; }
+	int GetItemCount() const { return static_cast<int>(items.size()); }
+	Model& GetModel(int index) const { return *models[index]; }
+
+	// Items whose box is not entirely outside the frustum
+	void QueryFrustum(const Frustum& frustum, std::vector<int>& result) const;
+	// Items whose box the ray enters before maxDistance, nearest first
+	void QueryRay(glm::vec3 origin, glm::vec3 direction, float maxDistance, std::vector<SceneRayHit>& result) const;
+	// Items whose box is within radius of center
+	void QuerySphere(glm::vec3 center, float radius, std::vector<int>& result) const;
+	// Nearest triangle hit by the ray: the items' boxes nearest first, each
+	// through its mesh's TriangleBvh, until a box starts beyond the best hit
+	bool Pick(glm::vec3 origin, glm::vec3 direction, float maxDistance, ScenePick& pick);
+
+	// QueryFrustum as per-node flags of every model, for Model::Draw. The
+	// items of leaves the frustum cuts go through Frustum::CullSpheres in
+	// one batch, with their nodes' world spheres, before the box test.
+	void CullModels(const Frustum& frustum);
+	const std::vector<uint8_t>& GetVisibleNodes(int model) const { return visibleNodes[model]; }
+	// Items found by the last CullModels, and clearing one's flag again (occlusion)
+	const std::vector<int>& GetFrustumItems() const { return frustumItems; }
+	void HideItem(int item) { visibleNodes[items[item].model][items[item].node] = 0; }
+
+	const SceneBvhStats& GetStats() const { return stats; }
+	void PrintStats() const;
+
+private:
+	// 32 bytes; a leaf holds count items from itemOrder[first], an inner
+	// node has count 0 and its children at first and first + 1
+	struct BvhNode
+	{
+		glm::vec3 boundsMin;
+		int first;
+		glm::vec3 boundsMax;
+		int count;
+	};
+
+	std::vector<Model*> models;
+	std::vector<SceneItem> items;
+	std::vector<int> itemOrder;
+	std::vector<int> itemLeaf;       // leaf holding each item
+	std::vector<BvhNode> nodes;
+	std::vector<int> parents;
+	std::vector<int> dynamicItems;
+	std::vector<uint8_t> dirty;      // per node, during Refit
+	std::vector<int> touched;        // nodes above the moved items
+	std::vector<std::vector<uint8_t>> visibleNodes;
+	std::vector<int> frustumItems;
+	std::vector<int> straddlingItems;    // in leaves the frustum cuts, during CullModels
+	SphereBatch straddlingSpheres;
+	std::vector<uint8_t> straddlingVisible;
+	std::vector<SceneRayHit> rayItems;
+	SceneBvhStats stats;
+
+	void ReadBounds(SceneItem& item) const;
+	void Subdivide(int nodeIndex, int depth);
+	void FitNode(BvhNode& node) const;
+	float Cost() const;
+	// QueryFrustum leaving the items of leaves the frustum cuts untested in
+	// straddling, when given
+	void QueryFrustum(const Frustum& frustum, std::vector<int>& result, std::vector<int>* straddling) const;
+	// All items of a subtree, without further tests
+	void CollectItems(int nodeIndex, std::vector<int>& result) const;
+};
+
+#endif
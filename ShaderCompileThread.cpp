@@ -0,0 +1,87 @@
+#include"ShaderCompileThread.h"
+#include"Tracer.h"
+#include<future>
+#include<iostream>
+
+ShaderCompileThread::~ShaderCompileThread()
+{
+	Stop();
+}
+
+bool ShaderCompileThread::Start(MakeCurrentFunction makeCurrent, ReleaseFunction release)
+{
+	Stop();
+	stopping = false;
+	std::promise<bool> started;
+	std::future<bool> current = started.get_future();
+	worker = std::thread([this, makeCurrent, release, &started]()
+	{
+		bool ok = makeCurrent();
+		started.set_value(ok);
+		if (ok) {
+			Run(release);
+		}
+	});
+	if (!current.get()) {
+		worker.join();
+		std::cout << "[SHADER] No shared context for the compile thread, building on the render thread" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+void ShaderCompileThread::Stop()
+{
+	if (!worker.joinable()) {
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake.notify_one();
+	worker.join();
+}
+
+void ShaderCompileThread::Submit(std::shared_ptr<ProgramBuild> build)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		queue.push_back(std::move(build));
+	}
+	wake.notify_one();
+}
+
+void ShaderCompileThread::Wait(const ProgramBuild& build)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	finished.wait(lock, [&build]() { return build.done.load(); });
+}
+
+void ShaderCompileThread::Run(ReleaseFunction release)
+{
+	for (;;) {
+		std::shared_ptr<ProgramBuild> build;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [this]() { return stopping || !queue.empty(); });
+			if (queue.empty()) {
+				break;
+			}
+			build = std::move(queue.front());
+			queue.pop_front();
+		}
+		{
+			TRACE_ZONE("Shader build");
+			build->Issue(device);
+			build->Finish(device);
+			device.Finish();
+		}
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			build->done = true;
+		}
+		finished.notify_all();
+	}
+	release();
+}
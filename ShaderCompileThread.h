@@ -0,0 +1,55 @@
+#ifndef SHADER_COMPILE_THREAD_CLASS_H
+#define SHADER_COMPILE_THREAD_CLASS_H
+
+#include<condition_variable>
+#include<deque>
+#include<functional>
+#include<memory>
+#include<mutex>
+#include<thread>
+
+#include"RenderDevice.h"
+#include"shaderClass.h"
+
+// Builds programs on its own thread, in a GL context shared with the render
+// thread's, for drivers without KHR_parallel_shader_compile. Programs are
+// shared between the contexts, and the thread calls glFinish after each
+// build, so the render thread may use a program as soon as its build is
+// done. Builds run one at a time, in the order they were submitted.
+class ShaderCompileThread
+{
+public:
+	// Run on the new thread: binds a context shared with the render thread's
+	// and returns false when it could not, and releases it before the thread ends
+	using MakeCurrentFunction = std::function<bool()>;
+	using ReleaseFunction = std::function<void()>;
+
+	ShaderCompileThread() = default;
+	~ShaderCompileThread();
+
+	ShaderCompileThread(const ShaderCompileThread&) = delete;
+	ShaderCompileThread& operator=(const ShaderCompileThread&) = delete;
+
+	// False, with no thread left running, when makeCurrent failed
+	bool Start(MakeCurrentFunction makeCurrent, ReleaseFunction release);
+	// Builds what was submitted before it returns
+	void Stop();
+	bool IsRunning() const { return worker.joinable(); }
+
+	void Submit(std::shared_ptr<ProgramBuild> build);
+	// Blocks until build is done
+	void Wait(const ProgramBuild& build);
+
+private:
+	std::thread worker;
+	std::mutex mutex;
+	std::condition_variable wake;       // a build was submitted or Stop called
+	std::condition_variable finished;   // a build is done
+	std::deque<std::shared_ptr<ProgramBuild>> queue;
+	bool stopping = false;
+	GLRenderDevice device;              // the shared context, never the render thread's device
+
+	void Run(ReleaseFunction release);
+};
+
+#endif
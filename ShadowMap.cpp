@@ -0,0 +1,256 @@
+#include"ShadowMap.h"
+#include"RenderDevice.h"
+#include"Tracer.h"
+#include<algorithm>
+#include<chrono>
+#include<cmath>
+#include<iostream>
+#include<glm/gtc/matrix_transform.hpp>
+
+namespace
+{
+	const char* qualityNames[] = { "off", "hard", "PCF 3x3", "PCF 5x5" };
+	static_assert(sizeof(qualityNames) / sizeof(qualityNames[0]) == static_cast<int>(ShadowQuality::Count),
+		"qualityNames must match ShadowQuality");
+}
+
+ShadowMap::ShadowMap(int size)
+	: size(size), depthShader("shadow.vert", "shadow.frag")
+{
+	staticTarget = CreateTarget(size);
+	dynamicTarget = CreateTarget(size);
+	SetQuality(quality);
+}
+
+ShadowMap::Target ShadowMap::CreateTarget(int size)
+{
+	RenderDevice& device = RenderDevice::Get();
+	Target target;
+
+	// Sampled with a depth comparison, so linear filtering gives 2x2 PCF per tap
+	target.texture = device.GenTexture();
+	device.BindTexture(GL_TEXTURE_2D, target.texture);
+	device.TexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, size, size, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, nullptr);
+	device.TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	device.TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	device.TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+	device.TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+	device.BindTexture(GL_TEXTURE_2D, 0);
+
+	// Depth only: no color attachment to draw into or read from
+	target.framebuffer = device.GenFramebuffer();
+	device.BindFramebuffer(GL_FRAMEBUFFER, target.framebuffer);
+	device.FramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, target.texture);
+	device.DrawBuffer(GL_NONE);
+	device.ReadBuffer(GL_NONE);
+	device.BindFramebuffer(GL_FRAMEBUFFER, 0);
+	return target;
+}
+
+bool ShadowMap::IsComplete()
+{
+	RenderDevice& device = RenderDevice::Get();
+	bool complete = true;
+	for (const Target* target : { &staticTarget, &dynamicTarget }) {
+		device.BindFramebuffer(GL_FRAMEBUFFER, target->framebuffer);
+		complete = complete && device.CheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+	}
+	device.BindFramebuffer(GL_FRAMEBUFFER, 0);
+	return complete;
+}
+
+void ShadowMap::SetLight(glm::vec3 position, glm::vec3 direction, float fovDegrees, float nearPlane, float farPlane)
+{
+	// Any up vector not along the light will do
+	glm::vec3 up = std::abs(direction.y) > 0.99f * glm::length(direction) ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+	glm::mat4 view = glm::lookAt(position, position + direction, up);
+	glm::mat4 projection = glm::perspective(glm::radians(fovDegrees), 1.0f, nearPlane, farPlane);
+	lightMatrix = projection * view;
+	lightFrustum = Frustum::FromMatrix(lightMatrix);
+	staticValid = false;
+	dynamicValid = false;
+}
+
+void ShadowMap::SetCaster(int model, bool caster)
+{
+	if (model >= static_cast<int>(casterModels.size())) {
+		casterModels.resize(model + 1, 1);
+	}
+	casterModels[model] = caster ? 1 : 0;
+	itemCount = -1;
+}
+
+void ShadowMap::SetQuality(ShadowQuality newQuality)
+{
+	quality = newQuality;
+	// One exact comparison for hard shadows, bilinear ones under PCF
+	GLint filter = quality == ShadowQuality::Hard ? GL_NEAREST : GL_LINEAR;
+	RenderDevice& device = RenderDevice::Get();
+	for (GLuint texture : { staticTarget.texture, dynamicTarget.texture }) {
+		device.BindTexture(GL_TEXTURE_2D, texture);
+		device.TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+		device.TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+	}
+	device.BindTexture(GL_TEXTURE_2D, 0);
+}
+
+const char* ShadowMap::QualityName(ShadowQuality quality)
+{
+	return qualityNames[static_cast<int>(quality)];
+}
+
+void ShadowMap::Invalidate()
+{
+	staticValid = false;
+}
+
+void ShadowMap::CollectCasters(const SceneBvh& scene)
+{
+	itemCount = scene.GetItemCount();
+	dynamicCasters.clear();
+	int modelCount = 0;
+	for (int i = 0; i < itemCount; i++) {
+		const SceneItem& item = scene.GetItem(i);
+		modelCount = std::max(modelCount, item.model + 1);
+		if (item.dynamic && IsCaster(item.model)) {
+			dynamicCasters.push_back({ i, glm::mat4(1.0f) });
+		}
+	}
+	nodeLists.assign(modelCount, std::vector<int>());
+	staticValid = false;
+	dynamicValid = false;
+}
+
+void ShadowMap::Update(SceneBvh& scene)
+{
+	if (quality == ShadowQuality::Off) {
+		return;
+	}
+	TRACE_ZONE("ShadowMap::Update");
+	auto start = std::chrono::steady_clock::now();
+	stats.frames++;
+
+	if (scene.GetItemCount() != itemCount) {
+		CollectCasters(scene);
+	}
+	// Only the moving items are looked at in a frame where nothing else changed
+	bool dynamicMoved = !dynamicValid;
+	for (DynamicCaster& caster : dynamicCasters) {
+		const SceneItem& item = scene.GetItem(caster.item);
+		const glm::mat4& transform = scene.GetModel(item.model).GetNode(item.node).globalTransform;
+		if (transform != caster.transform) {
+			caster.transform = transform;
+			dynamicMoved = true;
+		}
+	}
+	if (staticValid && !dynamicMoved) {
+		return;
+	}
+
+	RenderDevice& device = RenderDevice::Get();
+	GLint framebuffer = 0;
+	GLint viewport[4] = {};
+	device.GetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &framebuffer);
+	device.GetIntegerv(GL_VIEWPORT, viewport);
+
+	// Open meshes would let light through their missing back faces, so both
+	// sides are drawn and pushed back by the slope bias instead
+	device.Viewport(0, 0, size, size);
+	device.Disable(GL_CULL_FACE);
+	device.Enable(GL_POLYGON_OFFSET_FILL);
+	device.PolygonOffset(DEPTH_BIAS_SLOPE, DEPTH_BIAS_UNITS);
+	depthShader.SetMat4("lightMatrix", lightMatrix);
+
+	if (!staticValid) {
+		Render(staticTarget, scene, false);
+		staticValid = true;
+		stats.staticRenders++;
+	}
+	if (dynamicMoved) {
+		Render(dynamicTarget, scene, true);
+		dynamicValid = true;
+		stats.dynamicRenders++;
+	}
+
+	device.Disable(GL_POLYGON_OFFSET_FILL);
+	device.Enable(GL_CULL_FACE);
+	device.BindFramebuffer(GL_FRAMEBUFFER, static_cast<GLuint>(framebuffer));
+	device.Viewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+	stats.renderMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void ShadowMap::Render(const Target& target, SceneBvh& scene, bool dynamic)
+{
+	RenderDevice& device = RenderDevice::Get();
+	device.BindFramebuffer(GL_FRAMEBUFFER, target.framebuffer);
+	device.Clear(GL_DEPTH_BUFFER_BIT);
+
+	for (std::vector<int>& nodeList : nodeLists) {
+		nodeList.clear();
+	}
+	auto addCaster = [&](int index)
+	{
+		const SceneItem& item = scene.GetItem(index);
+		if (lightFrustum.IntersectsBox(item.boundsMin, item.boundsMax)) {
+			nodeLists[item.model].push_back(item.node);
+		}
+	};
+	if (dynamic) {
+		for (const DynamicCaster& caster : dynamicCasters) {
+			addCaster(caster.item);
+		}
+	} else {
+		for (int i = 0; i < itemCount; i++) {
+			const SceneItem& item = scene.GetItem(i);
+			if (!item.dynamic && IsCaster(item.model)) {
+				addCaster(i);
+			}
+		}
+	}
+
+	for (int model = 0; model < static_cast<int>(nodeLists.size()); model++) {
+		if (!nodeLists[model].empty()) {
+			scene.GetModel(model).DrawDepth(depthShader, nodeLists[model]);
+			if (dynamic) {
+				stats.dynamicCasters += static_cast<int>(nodeLists[model].size());
+			}
+		}
+	}
+}
+
+void ShadowMap::Apply(Shader& shader)
+{
+	RenderDevice& device = RenderDevice::Get();
+	device.ActiveTexture(GL_TEXTURE0 + STATIC_UNIT);
+	device.BindTexture(GL_TEXTURE_2D, staticTarget.texture);
+	device.ActiveTexture(GL_TEXTURE0 + DYNAMIC_UNIT);
+	device.BindTexture(GL_TEXTURE_2D, dynamicTarget.texture);
+	device.ActiveTexture(GL_TEXTURE0);
+
+	shader.SetInt("staticShadowMap", STATIC_UNIT);
+	shader.SetInt("dynamicShadowMap", DYNAMIC_UNIT);
+	shader.SetInt("shadowQuality", static_cast<int>(quality));
+	shader.SetMat4("lightMatrix", lightMatrix);
+}
+
+void ShadowMap::PrintStats() const
+{
+	if (stats.frames == 0) {
+		return;
+	}
+	std::cout << "[SHADOW] " << stats.frames << " frames at " << QualityName(quality) << ", static map rendered "
+			  << stats.staticRenders << " times, dynamic map " << stats.dynamicRenders << " times ("
+			  << (stats.dynamicRenders > 0 ? static_cast<float>(stats.dynamicCasters) / stats.dynamicRenders : 0.0f)
+			  << " casters each), " << stats.renderMs * 1000.0 / stats.frames << " us per frame" << std::endl;
+}
+
+void ShadowMap::Delete()
+{
+	RenderDevice& device = RenderDevice::Get();
+	for (Target* target : { &staticTarget, &dynamicTarget }) {
+		device.DeleteFramebuffer(target->framebuffer);
+		device.DeleteTexture(target->texture);
+		*target = Target();
+	}
+	depthShader.Delete();
+}
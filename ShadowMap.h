@@ -0,0 +1,109 @@
+#ifndef SHADOW_MAP_CLASS_H
+#define SHADOW_MAP_CLASS_H
+
+#include<glad/glad.h>
+#include<cstdint>
+#include<vector>
+#include<glm/glm.hpp>
+
+#include"SceneBvh.h"
+#include"shaderClass.h"
+
+// Filtering of the shadow edge, cheapest first. Hard takes one depth
+// comparison, the PCF tiers average 3x3 or 5x5 bilinear comparisons.
+enum class ShadowQuality { Off, Hard, Pcf3x3, Pcf5x5, Count };
+
+struct ShadowStats
+{
+	int frames = 0;
+	int staticRenders = 0;
+	int dynamicRenders = 0;
+	int dynamicCasters = 0;     // summed over the dynamic renders
+	double renderMs = 0.0;      // CPU time submitting both maps
+};
+
+// Shadows of one spot light, kept in two depth maps that default.frag
+// samples together. The static map holds every caster that never moves
+// (the table) and is rendered once, then only after Invalidate. The
+// dynamic map holds the SceneBvh's dynamic items (the balls, whatever the
+// clip moves) inside the light's frustum and is rendered again only in
+// frames where one of them has moved, so the cost of a frame follows the
+// moving objects rather than the scene.
+class ShadowMap
+{
+public:
+	static const int DEFAULT_SIZE = 2048;
+	static const int STATIC_UNIT = 1;                   // texture units, 0 holds the diffuse texture
+	static const int DYNAMIC_UNIT = 2;
+	static constexpr float DEPTH_BIAS_SLOPE = 2.0f;     // glPolygonOffset while rendering the maps
+	static constexpr float DEPTH_BIAS_UNITS = 4.0f;
+
+	explicit ShadowMap(int size = DEFAULT_SIZE);
+
+	ShadowMap(const ShadowMap&) = delete;
+	ShadowMap& operator=(const ShadowMap&) = delete;
+
+	// True when the driver accepted both depth attachments
+	bool IsComplete();
+
+	// Perspective frustum of the light; both maps are rendered again
+	void SetLight(glm::vec3 position, glm::vec3 direction, float fovDegrees, float nearPlane, float farPlane);
+	// Models of the SceneBvh cast shadows unless turned off here, e.g. the
+	// lamp the light sits in
+	void SetCaster(int model, bool caster);
+	void SetQuality(ShadowQuality quality);
+	ShadowQuality GetQuality() const { return quality; }
+	static const char* QualityName(ShadowQuality quality);
+
+	// Static casters are rendered again at the next Update, e.g. after the
+	// scene's models were changed
+	void Invalidate();
+
+	// Renders whichever map is out of date; the scene must be refit. Keeps
+	// the bound framebuffer and viewport.
+	void Update(SceneBvh& scene);
+	// Binds the maps and sets lightMatrix, the samplers and shadowQuality
+	// on the active shader
+	void Apply(Shader& shader);
+
+	const ShadowStats& GetStats() const { return stats; }
+	void PrintStats() const;
+
+	void Delete();
+
+private:
+	struct Target
+	{
+		GLuint framebuffer = 0;
+		GLuint texture = 0;
+	};
+
+	// A dynamic item and its transform when the dynamic map was rendered
+	struct DynamicCaster
+	{
+		int item;
+		glm::mat4 transform;
+	};
+
+	int size;
+	Shader depthShader;
+	Target staticTarget;
+	Target dynamicTarget;
+	glm::mat4 lightMatrix = glm::mat4(1.0f);
+	Frustum lightFrustum = Frustum::FromMatrix(glm::mat4(1.0f));
+	ShadowQuality quality = ShadowQuality::Pcf3x3;
+	std::vector<uint8_t> casterModels;          // per scene model, 0 when it casts no shadow
+	std::vector<DynamicCaster> dynamicCasters;  // every dynamic item of a caster model
+	std::vector<std::vector<int>> nodeLists;    // per scene model, nodes of the pass being rendered
+	int itemCount = -1;                         // of the scene the lists were made for
+	bool staticValid = false;
+	bool dynamicValid = false;
+	ShadowStats stats;
+
+	static Target CreateTarget(int size);
+	bool IsCaster(int model) const { return model >= static_cast<int>(casterModels.size()) || casterModels[model] != 0; }
+	void CollectCasters(const SceneBvh& scene);
+	void Render(const Target& target, SceneBvh& scene, bool dynamic);
+};
+
+#endif
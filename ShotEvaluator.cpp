@@ -0,0 +1,237 @@
+#include"ShotEvaluator.h"
+#include<algorithm>
+#include<chrono>
+#include<cmath>
+#include<iostream>
+#include<random>
+#include<glm/gtc/constants.hpp>
+
+namespace
+{
+	const float POCKET_SCORE = 1.0f;      // per object ball pocketed
+	const float SCRATCH_PENALTY = 2.0f;
+	const float FOUL_PENALTY = 1.0f;
+	const float POSITION_WEIGHT = 0.5f;   // the best follow-up shot scores at most this
+	const float MAX_TIP_OFFSET = 0.5f;    // ball radii, as far as BilliardPhysics::ApplyStrike goes
+
+	// Best first when sorting, worst on top as a heap order. Ties go to the
+	// earlier candidate, whichever worker ran it, so results repeat exactly.
+	bool Better(const ShotResult& a, const ShotResult& b)
+	{
+		if (a.score != b.score) {
+			return a.score > b.score;
+		}
+		return a.candidate < b.candidate;
+	}
+}
+
+ShotEvaluator::ShotEvaluator(int threadCount)
+	: pool(threadCount), arenas(new WorkerArena[pool.GetWorkerCount()])
+{
+}
+
+ShotEvaluator::~ShotEvaluator()
+{
+	if (thread.joinable()) {
+		thread.join();
+	}
+}
+
+void ShotEvaluator::GenerateCandidates(int count, float minSpeed, float maxSpeed, uint32_t seed,
+	std::vector<ShotCandidate>& candidates)
+{
+	candidates.resize(std::max(count, 0));
+	std::mt19937 random(seed);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	for (int i = 0; i < count; i++) {
+		ShotCandidate& candidate = candidates[i];
+		float angle = (static_cast<float>(i) + unit(random)) / static_cast<float>(count) * glm::two_pi<float>();
+		candidate.direction = glm::vec2(std::cos(angle), std::sin(angle));
+		candidate.speed = minSpeed + (maxSpeed - minSpeed) * unit(random);
+		candidate.follow = MAX_TIP_OFFSET * (2.0f * unit(random) - 1.0f);
+		candidate.english = MAX_TIP_OFFSET * (2.0f * unit(random) - 1.0f);
+	}
+}
+
+int ShotEvaluator::Evaluate(const TableSpec& table, const PhysicsParams& params, const BallSet& balls, int cueBall,
+	const std::vector<ShotCandidate>& candidates, int topK, std::vector<ShotResult>& best)
+{
+	auto start = std::chrono::steady_clock::now();
+	best.clear();
+	stats = ShotEvaluatorStats();
+	stats.threads = pool.GetWorkerCount();
+	if (cueBall < 0 || cueBall >= balls.count || topK <= 0) {
+		return 0;
+	}
+
+	// Everything the loop touches is sized here: the rails, each arena's
+	// heap and, through one Reset, the simulator's queue and history
+	TableSpec shared = table;
+	if (shared.geometry == nullptr) {
+		rails.BuildFromRails(shared);
+		shared.geometry = &rails;
+	}
+	for (int i = 0; i < pool.GetWorkerCount(); i++) {
+		WorkerArena& arena = arenas[i];
+		arena.simulator.table = shared;
+		arena.simulator.params = params;
+		arena.simulator.recordHistory = false;
+		arena.simulator.Reset(balls);
+		arena.best.clear();
+		arena.best.reserve(topK);
+		arena.events = 0;
+	}
+
+	uint64_t stealsBefore = pool.GetStealCount();
+	auto body = [&](int begin, int end, int worker) {
+		WorkerArena& arena = arenas[worker];
+		for (int k = begin; k < end; k++) {
+			ShotResult result;
+			result.candidate = k;
+			Play(arena, candidates[k], balls, cueBall, result);
+			arena.events += result.events;
+			if (static_cast<int>(arena.best.size()) < topK) {
+				arena.best.push_back(result);
+				std::push_heap(arena.best.begin(), arena.best.end(), Better);
+			}
+			else if (Better(result, arena.best.front())) {
+				std::pop_heap(arena.best.begin(), arena.best.end(), Better);
+				arena.best.back() = result;
+				std::push_heap(arena.best.begin(), arena.best.end(), Better);
+			}
+		}
+	};
+	pool.ParallelFor(static_cast<int>(candidates.size()), DEFAULT_GRAIN, body);
+
+	for (int i = 0; i < pool.GetWorkerCount(); i++) {
+		best.insert(best.end(), arenas[i].best.begin(), arenas[i].best.end());
+		stats.events += arenas[i].events;
+	}
+	std::sort(best.begin(), best.end(), Better);
+	if (static_cast<int>(best.size()) > topK) {
+		best.resize(topK);
+	}
+
+	stats.shots = static_cast<int>(candidates.size());
+	stats.steals = pool.GetStealCount() - stealsBefore;
+	stats.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	return static_cast<int>(best.size());
+}
+
+void ShotEvaluator::Begin(const TableSpec& table, const PhysicsParams& params, const BallSet& balls, int cueBall,
+	const std::vector<ShotCandidate>& candidates, int topK)
+{
+	if (thread.joinable()) {
+		thread.join();
+	}
+	pendingTable = table;
+	pendingParams = params;
+	pendingBalls = balls;
+	pendingCueBall = cueBall;
+	pendingCandidates = candidates;
+	pendingTopK = topK;
+	finished.store(false);
+	thread = std::thread([this]()
+	{
+		Evaluate(pendingTable, pendingParams, pendingBalls, pendingCueBall, pendingCandidates, pendingTopK, pendingBest);
+		finished.store(true, std::memory_order_release);
+	});
+}
+
+bool ShotEvaluator::Poll(std::vector<ShotResult>& best)
+{
+	if (!thread.joinable() || !finished.load(std::memory_order_acquire)) {
+		return false;
+	}
+	thread.join();
+	best.swap(pendingBest);
+	return true;
+}
+
+void ShotEvaluator::Play(WorkerArena& arena, const ShotCandidate& candidate, const BallSet& balls, int cueBall,
+	ShotResult& result) const
+{
+	EventSimulator& simulator = arena.simulator;
+	simulator.Reset(balls);
+	simulator.Strike(cueBall, candidate.direction, candidate.speed, candidate.follow, candidate.english);
+
+	bool touched = false;
+	SimEvent event;
+	int events = 0;
+	while (events < MAX_EVENTS_PER_SHOT && simulator.ProcessNextEvent(&event)) {
+		if (event.type == SimEventType::BallBall && (event.ball == cueBall || event.other == cueBall)) {
+			touched = true;
+		}
+		events++;
+	}
+
+	const BallSet& after = simulator.GetBalls();
+	const TableSpec& table = simulator.table;
+	result.shot = candidate;
+	result.events = events;
+	result.scratch = after.phase[cueBall] == BallPhase::Pocketed;
+	result.foul = !touched;
+	result.cueRest = glm::vec2(after.px[cueBall], after.pz[cueBall]);
+	result.pocketed = 0;
+	for (int i = 0; i < after.count; i++) {
+		if (i != cueBall && after.phase[i] == BallPhase::Pocketed && balls.phase[i] != BallPhase::Pocketed) {
+			result.pocketed++;
+		}
+	}
+
+	result.score = POCKET_SCORE * static_cast<float>(result.pocketed);
+	if (result.scratch) {
+		result.score -= SCRATCH_PENALTY;
+	}
+	else {
+		result.score += POSITION_WEIGHT * PositionScore(after, cueBall, table);
+	}
+	if (result.foul) {
+		result.score -= FOUL_PENALTY;
+	}
+}
+
+// How easy the best straight pot is from where the cue ball stopped: the
+// cosine of the cut angle, shrinking with the distance the balls travel.
+// Other balls in the way are not considered.
+float ShotEvaluator::PositionScore(const BallSet& balls, int cueBall, const TableSpec& table)
+{
+	glm::vec2 cue(balls.px[cueBall], balls.pz[cueBall]);
+	float tableLength = 2.0f * std::max(table.halfSizeX, table.halfSizeZ);
+	float bestEase = 0.0f;
+	for (int i = 0; i < balls.count; i++) {
+		if (i == cueBall || balls.phase[i] == BallPhase::Pocketed) {
+			continue;
+		}
+		glm::vec2 ball(balls.px[i], balls.pz[i]);
+		for (int p = 0; p < table.pocketCount; p++) {
+			glm::vec2 toPocket = table.pockets[p] - ball;
+			float pocketDistance = glm::length(toPocket);
+			if (pocketDistance <= 0.0f) {
+				continue;
+			}
+			// Where the cue ball has to be at contact to send the ball at the pocket
+			glm::vec2 ghost = ball - toPocket / pocketDistance * (2.0f * table.ballRadius);
+			glm::vec2 toGhost = ghost - cue;
+			float ghostDistance = glm::length(toGhost);
+			if (ghostDistance <= 0.0f) {
+				continue;
+			}
+			float cut = glm::dot(toGhost / ghostDistance, toPocket / pocketDistance);
+			if (cut <= 0.0f) {
+				continue;
+			}
+			float ease = cut / (1.0f + (ghostDistance + pocketDistance) / tableLength);
+			bestEase = std::max(bestEase, ease);
+		}
+	}
+	return bestEase;
+}
+
+void ShotEvaluator::PrintStats() const
+{
+	double shotsPerSecond = stats.milliseconds > 0.0 ? 1000.0 * stats.shots / stats.milliseconds : 0.0;
+	std::cout << "[AIM] " << stats.shots << " shots on " << stats.threads << " threads in "
+			  << stats.milliseconds << " ms (" << static_cast<int64_t>(shotsPerSecond) << " shots/s, "
+			  << stats.events << " events, " << stats.steals << " steals)" << std::endl;
+}
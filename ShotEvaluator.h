@@ -0,0 +1,123 @@
+#ifndef SHOT_EVALUATOR_CLASS_H
+#define SHOT_EVALUATOR_CLASS_H
+
+#include<atomic>
+#include<cstdint>
+#include<memory>
+#include<thread>
+#include<vector>
+#include<glm/glm.hpp>
+
+#include"BilliardPhysics.h"
+#include"EventSimulator.h"
+#include"JobPool.h"
+#include"TableGeometry.h"
+
+// One cue strike to try, in the units of BilliardPhysics::Strike
+struct ShotCandidate
+{
+	glm::vec2 direction = glm::vec2(1.0f, 0.0f);
+	float speed = 0.0f;
+	float follow = 0.0f;
+	float english = 0.0f;
+};
+
+struct ShotResult
+{
+	ShotCandidate shot;
+	int candidate = -1;          // index into the candidates passed to Evaluate
+	float score = 0.0f;
+	int pocketed = 0;            // object balls, not counting the cue ball
+	bool scratch = false;        // cue ball pocketed
+	bool foul = false;           // cue ball touched no object ball
+	glm::vec2 cueRest = glm::vec2(0.0f);
+	int events = 0;
+};
+
+struct ShotEvaluatorStats
+{
+	int shots = 0;
+	int threads = 0;
+	int64_t events = 0;
+	uint64_t steals = 0;
+	double milliseconds = 0.0;
+};
+
+// Aim assistance by brute force: every candidate is played to rest by the
+// event simulator on a worker's own copy of the table and scored for the
+// balls it pockets and how well the cue ball is left for the next shot.
+// The candidates are spread over a JobPool; each worker keeps a WorkerArena
+// with its simulator and its running top K, all sized before the loop, so
+// evaluating allocates nothing per shot.
+//
+// Begin runs the same evaluation on a background thread against its own
+// copy of the table, so the simulation keeps ticking meanwhile; Poll hands
+// over the result once it is done.
+class ShotEvaluator
+{
+public:
+	static const int DEFAULT_GRAIN = 16;           // candidates per job
+	static const int MAX_EVENTS_PER_SHOT = 2000;
+
+	// threadCount 0 uses every hardware thread
+	explicit ShotEvaluator(int threadCount = 0);
+	~ShotEvaluator();
+
+	ShotEvaluator(const ShotEvaluator&) = delete;
+	ShotEvaluator& operator=(const ShotEvaluator&) = delete;
+
+	// Monte Carlo candidates: stratified directions around the full circle,
+	// uniform speeds in [minSpeed, maxSpeed] and tip offsets over the
+	// whole usable cue tip. The same seed gives the same candidates.
+	static void GenerateCandidates(int count, float minSpeed, float maxSpeed, uint32_t seed,
+		std::vector<ShotCandidate>& candidates);
+
+	// Plays every candidate from balls and writes the topK best, best first,
+	// into best. Returns the number written. Not while IsEvaluating.
+	int Evaluate(const TableSpec& table, const PhysicsParams& params, const BallSet& balls, int cueBall,
+		const std::vector<ShotCandidate>& candidates, int topK, std::vector<ShotResult>& best);
+
+	// Starts Evaluate on a copy of the arguments and returns at once; waits
+	// for an evaluation still running first
+	void Begin(const TableSpec& table, const PhysicsParams& params, const BallSet& balls, int cueBall,
+		const std::vector<ShotCandidate>& candidates, int topK);
+	// True, with the results in best, once the evaluation Begin started is done
+	bool Poll(std::vector<ShotResult>& best);
+	bool IsEvaluating() const { return thread.joinable(); }
+
+	const ShotEvaluatorStats& GetLastStats() const { return stats; }
+	void PrintStats() const;
+
+	// How well the cue ball is left for a straight pot, 0 (nothing to play)
+	// to 1 (a short, straight shot)
+	static float PositionScore(const BallSet& balls, int cueBall, const TableSpec& table);
+
+private:
+	struct alignas(64) WorkerArena
+	{
+		EventSimulator simulator;
+		std::vector<ShotResult> best;   // min-heap on score, at most topK entries
+		int64_t events = 0;
+	};
+
+	JobPool pool;
+	std::unique_ptr<WorkerArena[]> arenas;
+	TableGeometry rails;   // cushions when the table has no geometry of its own
+	ShotEvaluatorStats stats;
+
+	// The evaluation Begin started, owned by its thread until finished
+	std::thread thread;
+	std::atomic<bool> finished{ false };
+	TableSpec pendingTable;
+	PhysicsParams pendingParams;
+	BallSet pendingBalls;
+	int pendingCueBall = 0;
+	std::vector<ShotCandidate> pendingCandidates;
+	int pendingTopK = 0;
+	std::vector<ShotResult> pendingBest;
+
+	void Play(WorkerArena& arena, const ShotCandidate& candidate, const BallSet& balls, int cueBall,
+		ShotResult& result) const;
+};
+
+#endif
@@ -0,0 +1,444 @@
+#include"ShotPlanner.h"
+#include<algorithm>
+#include<cmath>
+#include<cstring>
+#include<iostream>
+#include<iterator>
+#include<limits>
+#include<random>
+#include<glm/gtc/constants.hpp>
+
+namespace
+{
+	const float POCKET_SCORE = 1.0f;      // per object ball pocketed
+	const float SCRATCH_PENALTY = 2.0f;
+	const float FOUL_PENALTY = 1.0f;
+	const float POSITION_WEIGHT = 0.5f;   // a perfect leave for the next shot
+	const float DISCOUNT = 0.8f;          // later plies are less certain to play out as planned
+	const float CELL_IN_RADII = 0.25f;    // transposition grid, in ball radii
+	const int MAX_GRID_CELLS = 1 << 14;   // per axis
+	const uint64_t HASH_SEED = 0x5eed5eedull;
+
+	// Shot speeds as fractions of the maximum, tip offsets in ball radii
+	const float ROOT_SPEEDS[] = { 0.25f, 0.5f, 0.8f };
+	const float ROOT_FOLLOWS[] = { -0.3f, 0.0f, 0.3f };
+	const float INNER_SPEEDS[] = { 0.35f, 0.7f };
+	const float INNER_FOLLOWS[] = { 0.0f };
+
+	// Puts the cue ball back on the head spot after a scratch
+	void RespotCue(BallSet& balls, int cueBall, const TableSpec& table)
+	{
+		balls.px[cueBall] = table.center.x - 0.5f * table.halfSizeX;
+		balls.pz[cueBall] = table.center.y;
+		balls.vx[cueBall] = balls.vz[cueBall] = 0.0f;
+		balls.wx[cueBall] = balls.wy[cueBall] = balls.wz[cueBall] = 0.0f;
+		balls.phase[cueBall] = BallPhase::Stationary;
+	}
+
+	uint64_t PackEntry(float value, int depth, uint8_t generation)
+	{
+		uint32_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		return static_cast<uint64_t>(bits) | static_cast<uint64_t>(depth & 0xff) << 32
+			| static_cast<uint64_t>(generation) << 40;
+	}
+
+	int EntryDepth(uint64_t data) { return static_cast<int>((data >> 32) & 0xff); }
+	uint8_t EntryGeneration(uint64_t data) { return static_cast<uint8_t>(data >> 40); }
+
+	float EntryValue(uint64_t data)
+	{
+		uint32_t bits = static_cast<uint32_t>(data);
+		float value;
+		std::memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
+}
+
+void TableHasher::Build(const TableSpec& table, float cellSize, int ballCount, uint64_t seed)
+{
+	glm::vec2 margin(2.0f * table.ballRadius);
+	glm::vec2 halfSize(table.halfSizeX, table.halfSizeZ);
+	origin = table.center - halfSize - margin;
+	inverseCell = 1.0f / std::max(cellSize, 1e-6f);
+	glm::vec2 extent = 2.0f * (halfSize + margin);
+	columns = std::clamp(static_cast<int>(std::ceil(extent.x * inverseCell)) + 1, 1, MAX_GRID_CELLS);
+	rows = std::clamp(static_cast<int>(std::ceil(extent.y * inverseCell)) + 1, 1, MAX_GRID_CELLS);
+
+	std::mt19937_64 random(seed);
+	columnKeys.resize(static_cast<size_t>(ballCount) * columns);
+	rowKeys.resize(static_cast<size_t>(ballCount) * rows);
+	pocketKeys.resize(ballCount);
+	for (uint64_t& key : columnKeys) {
+		key = random();
+	}
+	for (uint64_t& key : rowKeys) {
+		key = random();
+	}
+	for (uint64_t& key : pocketKeys) {
+		key = random();
+	}
+}
+
+uint64_t TableHasher::Hash(const BallSet& balls) const
+{
+	uint64_t hash = 0;
+	int count = std::min(balls.count, static_cast<int>(pocketKeys.size()));
+	for (int i = 0; i < count; i++) {
+		if (balls.phase[i] == BallPhase::Pocketed) {
+			hash ^= pocketKeys[i];
+			continue;
+		}
+		int column = std::clamp(static_cast<int>((balls.px[i] - origin.x) * inverseCell), 0, columns - 1);
+		int row = std::clamp(static_cast<int>((balls.pz[i] - origin.y) * inverseCell), 0, rows - 1);
+		hash ^= columnKeys[static_cast<size_t>(i) * columns + column] ^ rowKeys[static_cast<size_t>(i) * rows + row];
+	}
+	return hash;
+}
+
+TranspositionTable::TranspositionTable(int log2Size)
+	: entries(new Entry[size_t(1) << log2Size]), mask((uint64_t(1) << log2Size) - 1)
+{
+}
+
+void TranspositionTable::NewSearch()
+{
+	generation = static_cast<uint8_t>(generation + 1);
+	// Once the counter wraps, entries 256 searches old would pass for new ones
+	if (generation == 0) {
+		for (uint64_t i = 0; i <= mask; i++) {
+			entries[i].data.store(0, std::memory_order_relaxed);
+			entries[i].check.store(0, std::memory_order_relaxed);
+		}
+		generation = 1;
+	}
+}
+
+bool TranspositionTable::Probe(uint64_t key, int depth, float& value) const
+{
+	const Entry& entry = entries[key & mask];
+	uint64_t data = entry.data.load(std::memory_order_relaxed);
+	uint64_t check = entry.check.load(std::memory_order_relaxed);
+	if ((check ^ data) != key || EntryGeneration(data) != generation || EntryDepth(data) < depth) {
+		return false;
+	}
+	value = EntryValue(data);
+	return true;
+}
+
+void TranspositionTable::Store(uint64_t key, int depth, float value)
+{
+	Entry& entry = entries[key & mask];
+	uint64_t data = entry.data.load(std::memory_order_relaxed);
+	uint64_t check = entry.check.load(std::memory_order_relaxed);
+	// Keep a deeper entry of this search for another position
+	if ((check ^ data) != key && EntryGeneration(data) == generation && EntryDepth(data) > depth) {
+		return;
+	}
+	uint64_t packed = PackEntry(value, depth, generation);
+	entry.data.store(packed, std::memory_order_relaxed);
+	entry.check.store(key ^ packed, std::memory_order_relaxed);
+}
+
+ShotPlanner::ShotPlanner(int threadCount)
+	: pool(threadCount), arenas(new WorkerArena[pool.GetWorkerCount()])
+{
+}
+
+ShotPlanner::~ShotPlanner()
+{
+	Cancel();
+}
+
+void ShotPlanner::Begin(const TableSpec& table, const PhysicsParams& params, const BallSet& balls, int cueBall, float maxSpeed)
+{
+	Cancel();
+	this->table = table;
+	if (this->table.geometry == nullptr) {
+		rails.BuildFromRails(this->table);
+		this->table.geometry = &rails;
+	}
+	this->params = params;
+	start = balls;
+	this->cueBall = cueBall;
+	this->maxSpeed = maxSpeed;
+	settings.maxDepth = std::clamp(settings.maxDepth, 1, MAX_DEPTH);
+
+	for (int i = 0; i < pool.GetWorkerCount(); i++) {
+		WorkerArena& arena = arenas[i];
+		arena.simulator.table = this->table;
+		arena.simulator.params = params;
+		arena.simulator.recordHistory = false;
+		arena.simulator.Reset(balls);
+		arena.simulations = 0;
+		arena.probes = 0;
+		arena.hits = 0;
+	}
+	hasher.Build(this->table, CELL_IN_RADII * table.ballRadius, balls.count, HASH_SEED);
+	transpositions.NewSearch();
+	best = PlannerResult();
+	stats = PlannerStats();
+
+	aborted.store(false);
+	finished.store(false);
+	startTime = std::chrono::steady_clock::now();
+	deadline = startTime + std::chrono::microseconds(static_cast<int64_t>(settings.timeBudgetMs * 1000.0));
+	thread = std::thread(&ShotPlanner::Think, this);
+}
+
+bool ShotPlanner::Poll(PlannerResult& result)
+{
+	if (!thread.joinable() || !finished.load(std::memory_order_acquire)) {
+		return false;
+	}
+	thread.join();
+	result = best;
+	return true;
+}
+
+void ShotPlanner::Cancel()
+{
+	if (!thread.joinable()) {
+		return;
+	}
+	cancelled.store(true);
+	thread.join();
+	cancelled.store(false);
+}
+
+bool ShotPlanner::Expired(bool firstPly) const
+{
+	if (cancelled.load(std::memory_order_relaxed)) {
+		return true;
+	}
+	return !firstPly && std::chrono::steady_clock::now() >= deadline;
+}
+
+void ShotPlanner::Think()
+{
+	for (int depth = 1; depth <= settings.maxDepth; depth++) {
+		if (!SearchRoot(depth)) {
+			stats.timedOut = !cancelled.load();
+			break;
+		}
+		stats.depth = depth;
+		const Outcome& chosen = root[rootOrder.front()];
+		best.shot = chosen.shot;
+		best.value = rootValues[rootOrder.front()];
+		best.depth = depth;
+		best.pocketed = chosen.pocketed;
+		best.keepsTurn = chosen.keepsTurn;
+	}
+
+	for (int i = 0; i < pool.GetWorkerCount(); i++) {
+		stats.simulations += arenas[i].simulations;
+		stats.probes += arenas[i].probes;
+		stats.hits += arenas[i].hits;
+	}
+	stats.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+	finished.store(true, std::memory_order_release);
+}
+
+bool ShotPlanner::SearchRoot(int depth)
+{
+	if (depth == 1) {
+		std::vector<ShotCandidate> shots;
+		GenerateShots(start, true, shots);
+		int count = static_cast<int>(shots.size());
+		root.resize(count);
+		rootValues.resize(count);
+		auto body = [&](int begin, int end, int worker) {
+			for (int k = begin; k < end && !Expired(true); k++) {
+				Play(arenas[worker], start, shots[k], root[k]);
+				rootValues[k] = Total(root[k], false, 0.0f);
+			}
+		};
+		pool.ParallelFor(count, ShotEvaluator::DEFAULT_GRAIN, body);
+		if (count == 0 || Expired(true)) {
+			return false;
+		}
+		rootOrder.resize(count);
+		for (int k = 0; k < count; k++) {
+			rootOrder[k] = k;
+		}
+		std::stable_sort(rootOrder.begin(), rootOrder.end(),
+			[this](int a, int b) { return rootValues[a] > rootValues[b]; });
+		return true;
+	}
+
+	// Deeper plies only for the best shots of the previous depth
+	int count = std::min(settings.rootBeam, static_cast<int>(rootOrder.size()));
+	std::vector<float> values(count);
+	auto body = [&](int begin, int end, int worker) {
+		for (int k = begin; k < end && !aborted.load(std::memory_order_relaxed); k++) {
+			const Outcome& outcome = root[rootOrder[k]];
+			float future = Search(arenas[worker], outcome.rest, depth - 1);
+			values[k] = Total(outcome, true, future);
+		}
+	};
+	pool.ParallelFor(count, 1, body);
+	if (aborted.load()) {
+		return false;
+	}
+	for (int k = 0; k < count; k++) {
+		rootValues[rootOrder[k]] = values[k];
+	}
+	std::stable_sort(rootOrder.begin(), rootOrder.begin() + count,
+		[this](int a, int b) { return rootValues[a] > rootValues[b]; });
+	return true;
+}
+
+float ShotPlanner::Search(WorkerArena& arena, const BallSet& balls, int depth)
+{
+	uint64_t key = hasher.Hash(balls);
+	float cached;
+	arena.probes++;
+	if (transpositions.Probe(key, depth, cached)) {
+		arena.hits++;
+		return cached;
+	}
+
+	// Each depth has its own ply, so the caller's outcomes stay intact
+	Ply& ply = arena.plies[depth - 1];
+	GenerateShots(balls, false, ply.candidates);
+	int count = static_cast<int>(ply.candidates.size());
+	ply.outcomes.resize(count);
+	ply.order.resize(count);
+	for (int k = 0; k < count; k++) {
+		if (Expired(false)) {
+			aborted.store(true);
+			return 0.0f;
+		}
+		Play(arena, balls, ply.candidates[k], ply.outcomes[k]);
+		ply.order[k] = k;
+	}
+	if (count == 0) {
+		return 0.0f;
+	}
+	std::sort(ply.order.begin(), ply.order.end(), [&ply, this](int a, int b) {
+		float valueA = Total(ply.outcomes[a], false, 0.0f);
+		float valueB = Total(ply.outcomes[b], false, 0.0f);
+		return valueA != valueB ? valueA > valueB : a < b;
+	});
+
+	float value = Total(ply.outcomes[ply.order.front()], false, 0.0f);
+	if (depth > 1) {
+		value = -std::numeric_limits<float>::infinity();
+		int expand = std::min(settings.beamWidth, count);
+		for (int k = 0; k < expand; k++) {
+			const Outcome& outcome = ply.outcomes[ply.order[k]];
+			float future = Search(arena, outcome.rest, depth - 1);
+			if (aborted.load(std::memory_order_relaxed)) {
+				return 0.0f;
+			}
+			value = std::max(value, Total(outcome, true, future));
+		}
+	}
+	transpositions.Store(key, depth, value);
+	return value;
+}
+
+float ShotPlanner::Total(const Outcome& outcome, bool searched, float future) const
+{
+	float side = outcome.keepsTurn ? 1.0f : -1.0f;
+	if (!searched) {
+		// The next shot is not searched: only how the cue ball was left for it
+		return outcome.immediate + side * POSITION_WEIGHT * outcome.position;
+	}
+	return outcome.immediate + DISCOUNT * side * future;
+}
+
+void ShotPlanner::GenerateShots(const BallSet& balls, bool rootPly, std::vector<ShotCandidate>& shots) const
+{
+	shots.clear();
+	if (balls.phase[cueBall] == BallPhase::Pocketed) {
+		return;
+	}
+	const float* speeds = rootPly ? ROOT_SPEEDS : INNER_SPEEDS;
+	int speedCount = rootPly ? static_cast<int>(std::size(ROOT_SPEEDS)) : static_cast<int>(std::size(INNER_SPEEDS));
+	const float* follows = rootPly ? ROOT_FOLLOWS : INNER_FOLLOWS;
+	int followCount = rootPly ? static_cast<int>(std::size(ROOT_FOLLOWS)) : static_cast<int>(std::size(INNER_FOLLOWS));
+	auto add = [&](glm::vec2 direction) {
+		for (int s = 0; s < speedCount; s++) {
+			for (int f = 0; f < followCount; f++) {
+				ShotCandidate shot;
+				shot.direction = direction;
+				shot.speed = speeds[s] * maxSpeed;
+				shot.follow = follows[f];
+				shots.push_back(shot);
+			}
+		}
+	};
+
+	// At the ghost ball of every object ball and pocket that can be cut in
+	glm::vec2 cue(balls.px[cueBall], balls.pz[cueBall]);
+	for (int i = 0; i < balls.count; i++) {
+		if (i == cueBall || balls.phase[i] == BallPhase::Pocketed) {
+			continue;
+		}
+		glm::vec2 ball(balls.px[i], balls.pz[i]);
+		for (int p = 0; p < table.pocketCount; p++) {
+			glm::vec2 toPocket = table.pockets[p] - ball;
+			float pocketDistance = glm::length(toPocket);
+			if (pocketDistance <= 0.0f) {
+				continue;
+			}
+			glm::vec2 ghost = ball - toPocket / pocketDistance * (2.0f * table.ballRadius);
+			glm::vec2 toGhost = ghost - cue;
+			float ghostDistance = glm::length(toGhost);
+			if (ghostDistance > 0.0f && glm::dot(toGhost, toPocket) > 0.0f) {
+				add(toGhost / ghostDistance);
+			}
+		}
+	}
+	// and around the circle for safeties and breaks
+	for (int k = 0; k < settings.ringDirections; k++) {
+		float angle = glm::two_pi<float>() * static_cast<float>(k) / static_cast<float>(settings.ringDirections);
+		add(glm::vec2(std::cos(angle), std::sin(angle)));
+	}
+}
+
+void ShotPlanner::Play(WorkerArena& arena, const BallSet& balls, const ShotCandidate& shot, Outcome& outcome) const
+{
+	EventSimulator& simulator = arena.simulator;
+	simulator.Reset(balls);
+	simulator.Strike(cueBall, shot.direction, shot.speed, shot.follow, shot.english);
+
+	bool touched = false;
+	SimEvent event;
+	int events = 0;
+	while (events < MAX_EVENTS_PER_SHOT && simulator.ProcessNextEvent(&event)) {
+		if (event.type == SimEventType::BallBall && (event.ball == cueBall || event.other == cueBall)) {
+			touched = true;
+		}
+		events++;
+	}
+	arena.simulations++;
+
+	outcome.shot = shot;
+	outcome.rest = simulator.GetBalls();
+	BallSet& rest = outcome.rest;
+	bool scratch = rest.phase[cueBall] == BallPhase::Pocketed;
+	outcome.pocketed = 0;
+	for (int i = 0; i < rest.count; i++) {
+		if (i != cueBall && rest.phase[i] == BallPhase::Pocketed && balls.phase[i] != BallPhase::Pocketed) {
+			outcome.pocketed++;
+		}
+	}
+	outcome.immediate = POCKET_SCORE * static_cast<float>(outcome.pocketed);
+	outcome.immediate -= scratch ? SCRATCH_PENALTY : 0.0f;
+	outcome.immediate -= touched ? 0.0f : FOUL_PENALTY;
+	outcome.keepsTurn = outcome.pocketed > 0 && !scratch && touched;
+	if (scratch) {
+		RespotCue(rest, cueBall, table);
+	}
+	outcome.position = ShotEvaluator::PositionScore(rest, cueBall, table);
+}
+
+void ShotPlanner::PrintStats() const
+{
+	std::cout << "[PLAN] Depth " << stats.depth << (stats.timedOut ? " (out of time)" : "") << " in "
+			  << stats.milliseconds << " ms: " << stats.simulations << " shots simulated, "
+			  << stats.hits << " of " << stats.probes << " positions from the transposition table, value "
+			  << best.value << std::endl;
+}
@@ -0,0 +1,199 @@
+#ifndef SHOT_PLANNER_CLASS_H
+#define SHOT_PLANNER_CLASS_H
+
+#include<atomic>
+#include<chrono>
+#include<cstdint>
+#include<memory>
+#include<thread>
+#include<vector>
+#include<glm/glm.hpp>
+
+#include"BilliardPhysics.h"
+#include"EventSimulator.h"
+#include"JobPool.h"
+#include"ShotEvaluator.h"
+#include"TableGeometry.h"
+
+struct PlannerSettings
+{
+	int maxDepth = 3;               // plies: own shot, the reply, the follow-up
+	int rootBeam = 16;              // own shots searched past the first ply
+	int beamWidth = 4;              // shots expanded per deeper position
+	int ringDirections = 24;        // evenly spaced directions added to the aimed ones
+	double timeBudgetMs = 1500.0;   // the first ply always completes
+};
+
+struct PlannerResult
+{
+	ShotCandidate shot;
+	float value = 0.0f;     // for the player to shoot, discounted over the plies searched
+	int depth = 0;          // plies fully searched
+	int pocketed = 0;       // by the shot itself
+	bool keepsTurn = false;
+};
+
+struct PlannerStats
+{
+	int depth = 0;
+	int64_t simulations = 0;
+	int64_t probes = 0;     // transposition table lookups
+	int64_t hits = 0;
+	double milliseconds = 0.0;
+	bool timedOut = false;
+};
+
+// Zobrist hashing of a table: every ball position is quantized to a grid
+// and the keys of its row and column (or of "pocketed") are XORed in, so
+// positions that differ by less than a cell share a key
+class TableHasher
+{
+public:
+	void Build(const TableSpec& table, float cellSize, int ballCount, uint64_t seed);
+	uint64_t Hash(const BallSet& balls) const;
+
+private:
+	glm::vec2 origin = glm::vec2(0.0f);
+	float inverseCell = 1.0f;
+	int columns = 0;
+	int rows = 0;
+	std::vector<uint64_t> columnKeys;   // [ball * columns + column]
+	std::vector<uint64_t> rowKeys;      // [ball * rows + row]
+	std::vector<uint64_t> pocketKeys;   // [ball]
+};
+
+// Fixed-size, lock-free transposition table shared by the search threads.
+// An entry keeps the key XORed with its data, so a torn concurrent write
+// simply fails the check on the next probe instead of returning garbage.
+class TranspositionTable
+{
+public:
+	explicit TranspositionTable(int log2Size = 16);
+
+	// Starts a new search. The key covers only the balls, so entries of older
+	// searches, made with other settings or another table, are never probed
+	// and get replaced first. Not while a search is running.
+	void NewSearch();
+	bool Probe(uint64_t key, int depth, float& value) const;
+	void Store(uint64_t key, int depth, float value);
+
+private:
+	struct Entry
+	{
+		std::atomic<uint64_t> check{ 0 };   // key ^ data
+		std::atomic<uint64_t> data{ 0 };    // value bits, depth, generation
+	};
+
+	std::unique_ptr<Entry[]> entries;
+	uint64_t mask;
+	uint8_t generation = 0;
+};
+
+// AI opponent that looks a few shots ahead. Shots are discretized: aimed at
+// the ghost ball for every object ball and pocket plus a ring of plain
+// directions, at a few speeds and spins. Each ply plays every shot through
+// the event simulator, keeps the beamWidth best by immediate score and
+// searches those further; a shot that pockets a ball keeps the turn,
+// anything else hands the table to the opponent, whose best value then
+// counts against the shooter.
+//
+// Search runs by iterative deepening on a background thread, with the
+// root shots spread over a JobPool, so Begin returns at once and Poll is
+// cheap enough to call every tick. Each finished depth replaces the plan;
+// when the time budget runs out the last finished depth is used. Resting
+// positions go through a transposition table keyed by TableHasher, so a
+// table reached by different shots is searched once. Which thread fills
+// an entry first can change the result slightly between runs.
+class ShotPlanner
+{
+public:
+	static const int MAX_DEPTH = 4;
+	static const int MAX_EVENTS_PER_SHOT = 2000;
+
+	PlannerSettings settings;
+
+	// threadCount 0 uses every hardware thread
+	explicit ShotPlanner(int threadCount = 0);
+	~ShotPlanner();
+
+	ShotPlanner(const ShotPlanner&) = delete;
+	ShotPlanner& operator=(const ShotPlanner&) = delete;
+
+	// Starts planning a shot of the cue ball from balls at rest, with shot
+	// speeds up to maxSpeed; cancels a search still running
+	void Begin(const TableSpec& table, const PhysicsParams& params, const BallSet& balls, int cueBall, float maxSpeed);
+	// True, with the plan in result, once the search has finished
+	bool Poll(PlannerResult& result);
+	bool IsThinking() const { return thread.joinable(); }
+	// Stops the search and drops its result
+	void Cancel();
+
+	const PlannerStats& GetLastStats() const { return stats; }
+	void PrintStats() const;
+
+private:
+	// One played shot and the table it left
+	struct Outcome
+	{
+		ShotCandidate shot;
+		float immediate = 0.0f;   // pots and fouls
+		float position = 0.0f;    // how the cue ball was left, for whoever shoots next
+		int pocketed = 0;
+		bool keepsTurn = false;
+		BallSet rest;
+	};
+
+	struct Ply
+	{
+		std::vector<ShotCandidate> candidates;
+		std::vector<Outcome> outcomes;
+		std::vector<int> order;   // outcomes, best immediate score first
+	};
+
+	struct alignas(64) WorkerArena
+	{
+		EventSimulator simulator;
+		Ply plies[MAX_DEPTH];
+		int64_t simulations = 0;
+		int64_t probes = 0;
+		int64_t hits = 0;
+	};
+
+	JobPool pool;
+	std::unique_ptr<WorkerArena[]> arenas;
+	TranspositionTable transpositions;
+	TableHasher hasher;
+	TableGeometry rails;
+
+	TableSpec table;
+	PhysicsParams params;
+	BallSet start;
+	int cueBall = 0;
+	float maxSpeed = 1.0f;
+
+	std::thread thread;
+	std::atomic<bool> cancelled{ false };
+	std::atomic<bool> aborted{ false };    // the deadline passed during a ply
+	std::atomic<bool> finished{ false };
+	std::chrono::steady_clock::time_point startTime;
+	std::chrono::steady_clock::time_point deadline;
+
+	std::vector<Outcome> root;
+	std::vector<float> rootValues;
+	std::vector<int> rootOrder;
+	PlannerResult best;
+	PlannerStats stats;
+
+	void Think();
+	bool SearchRoot(int depth);
+	// Value of the table for the player to shoot, depth plies ahead
+	float Search(WorkerArena& arena, const BallSet& balls, int depth);
+	void GenerateShots(const BallSet& balls, bool rootPly, std::vector<ShotCandidate>& shots) const;
+	void Play(WorkerArena& arena, const BallSet& balls, const ShotCandidate& shot, Outcome& outcome) const;
+	// Immediate score plus, once the next ply was searched, its value
+	// (against the shooter when the turn passed), else the cue ball leave
+	float Total(const Outcome& outcome, bool searched, float future) const;
+	bool Expired(bool firstPly) const;
+};
+
+#endif
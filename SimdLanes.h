@@ -0,0 +1,182 @@
+#ifndef SIMD_LANES_H
+#define SIMD_LANES_H
+
+#include<cmath>
+
+// Thin wrapper over the widest float vector the build targets: 8 lanes with
+// AVX2, 4 with SSE2 or NEON (AArch64), and a single lane otherwise. Kernels
+// are written once against Lanes/LaneMask and loop in steps of LANE_WIDTH.
+// Loads and stores are aligned, so arrays must be alignas(32) and padded to
+// a multiple of the width.
+#if defined(__AVX2__)
+#define SIMD_LANES_AVX2
+#include<immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SIMD_LANES_SSE2
+#include<emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#define SIMD_LANES_NEON
+#include<arm_neon.h>
+#endif
+
+#if defined(SIMD_LANES_AVX2)
+
+const int LANE_WIDTH = 8;
+const char* const LANE_BACKEND = "avx2";
+
+struct LaneMask { __m256 m; };
+
+struct Lanes
+{
+	__m256 v;
+
+	static Lanes Load(const float* p) { return { _mm256_load_ps(p) }; }
+	static Lanes Set(float x) { return { _mm256_set1_ps(x) }; }
+	void Store(float* p) const { _mm256_store_ps(p, v); }
+};
+
+inline Lanes operator+(Lanes a, Lanes b) { return { _mm256_add_ps(a.v, b.v) }; }
+inline Lanes operator-(Lanes a, Lanes b) { return { _mm256_sub_ps(a.v, b.v) }; }
+inline Lanes operator*(Lanes a, Lanes b) { return { _mm256_mul_ps(a.v, b.v) }; }
+inline Lanes operator/(Lanes a, Lanes b) { return { _mm256_div_ps(a.v, b.v) }; }
+inline Lanes Min(Lanes a, Lanes b) { return { _mm256_min_ps(a.v, b.v) }; }
+inline Lanes Max(Lanes a, Lanes b) { return { _mm256_max_ps(a.v, b.v) }; }
+inline Lanes Sqrt(Lanes a) { return { _mm256_sqrt_ps(a.v) }; }
+inline Lanes Abs(Lanes a) { return { _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v) }; }
+// Magnitude of a with the sign of b
+inline Lanes CopySign(Lanes a, Lanes b)
+{
+	__m256 sign = _mm256_set1_ps(-0.0f);
+	return { _mm256_or_ps(_mm256_andnot_ps(sign, a.v), _mm256_and_ps(sign, b.v)) };
+}
+inline LaneMask operator<(Lanes a, Lanes b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ) }; }
+inline LaneMask operator<=(Lanes a, Lanes b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ) }; }
+inline LaneMask operator>(Lanes a, Lanes b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ) }; }
+inline LaneMask operator>=(Lanes a, Lanes b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ) }; }
+inline LaneMask operator==(Lanes a, Lanes b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_EQ_OQ) }; }
+inline LaneMask operator&(LaneMask a, LaneMask b) { return { _mm256_and_ps(a.m, b.m) }; }
+inline LaneMask operator|(LaneMask a, LaneMask b) { return { _mm256_or_ps(a.m, b.m) }; }
+inline LaneMask AndNot(LaneMask a, LaneMask b) { return { _mm256_andnot_ps(b.m, a.m) }; }   // a & ~b
+inline Lanes Select(LaneMask m, Lanes a, Lanes b) { return { _mm256_blendv_ps(b.v, a.v, m.m) }; }
+inline int MoveMask(LaneMask m) { return _mm256_movemask_ps(m.m); }
+
+#elif defined(SIMD_LANES_SSE2)
+
+const int LANE_WIDTH = 4;
+const char* const LANE_BACKEND = "sse2";
+
+struct LaneMask { __m128 m; };
+
+struct Lanes
+{
+	__m128 v;
+
+	static Lanes Load(const float* p) { return { _mm_load_ps(p) }; }
+	static Lanes Set(float x) { return { _mm_set1_ps(x) }; }
+	void Store(float* p) const { _mm_store_ps(p, v); }
+};
+
+inline Lanes operator+(Lanes a, Lanes b) { return { _mm_add_ps(a.v, b.v) }; }
+inline Lanes operator-(Lanes a, Lanes b) { return { _mm_sub_ps(a.v, b.v) }; }
+inline Lanes operator*(Lanes a, Lanes b) { return { _mm_mul_ps(a.v, b.v) }; }
+inline Lanes operator/(Lanes a, Lanes b) { return { _mm_div_ps(a.v, b.v) }; }
+inline Lanes Min(Lanes a, Lanes b) { return { _mm_min_ps(a.v, b.v) }; }
+inline Lanes Max(Lanes a, Lanes b) { return { _mm_max_ps(a.v, b.v) }; }
+inline Lanes Sqrt(Lanes a) { return { _mm_sqrt_ps(a.v) }; }
+inline Lanes Abs(Lanes a) { return { _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v) }; }
+inline Lanes CopySign(Lanes a, Lanes b)
+{
+	__m128 sign = _mm_set1_ps(-0.0f);
+	return { _mm_or_ps(_mm_andnot_ps(sign, a.v), _mm_and_ps(sign, b.v)) };
+}
+inline LaneMask operator<(Lanes a, Lanes b) { return { _mm_cmplt_ps(a.v, b.v) }; }
+inline LaneMask operator<=(Lanes a, Lanes b) { return { _mm_cmple_ps(a.v, b.v) }; }
+inline LaneMask operator>(Lanes a, Lanes b) { return { _mm_cmpgt_ps(a.v, b.v) }; }
+inline LaneMask operator>=(Lanes a, Lanes b) { return { _mm_cmpge_ps(a.v, b.v) }; }
+inline LaneMask operator==(Lanes a, Lanes b) { return { _mm_cmpeq_ps(a.v, b.v) }; }
+inline LaneMask operator&(LaneMask a, LaneMask b) { return { _mm_and_ps(a.m, b.m) }; }
+inline LaneMask operator|(LaneMask a, LaneMask b) { return { _mm_or_ps(a.m, b.m) }; }
+inline LaneMask AndNot(LaneMask a, LaneMask b) { return { _mm_andnot_ps(b.m, a.m) }; }
+inline Lanes Select(LaneMask m, Lanes a, Lanes b) { return { _mm_or_ps(_mm_and_ps(m.m, a.v), _mm_andnot_ps(m.m, b.v)) }; }
+inline int MoveMask(LaneMask m) { return _mm_movemask_ps(m.m); }
+
+#elif defined(SIMD_LANES_NEON)
+
+const int LANE_WIDTH = 4;
+const char* const LANE_BACKEND = "neon";
+
+struct LaneMask { uint32x4_t m; };
+
+struct Lanes
+{
+	float32x4_t v;
+
+	static Lanes Load(const float* p) { return { vld1q_f32(p) }; }
+	static Lanes Set(float x) { return { vdupq_n_f32(x) }; }
+	void Store(float* p) const { vst1q_f32(p, v); }
+};
+
+inline Lanes operator+(Lanes a, Lanes b) { return { vaddq_f32(a.v, b.v) }; }
+inline Lanes operator-(Lanes a, Lanes b) { return { vsubq_f32(a.v, b.v) }; }
+inline Lanes operator*(Lanes a, Lanes b) { return { vmulq_f32(a.v, b.v) }; }
+inline Lanes operator/(Lanes a, Lanes b) { return { vdivq_f32(a.v, b.v) }; }
+inline Lanes Min(Lanes a, Lanes b) { return { vminq_f32(a.v, b.v) }; }
+inline Lanes Max(Lanes a, Lanes b) { return { vmaxq_f32(a.v, b.v) }; }
+inline Lanes Sqrt(Lanes a) { return { vsqrtq_f32(a.v) }; }
+inline Lanes Abs(Lanes a) { return { vabsq_f32(a.v) }; }
+inline Lanes CopySign(Lanes a, Lanes b) { return { vbslq_f32(vdupq_n_u32(0x80000000u), b.v, a.v) }; }
+inline LaneMask operator<(Lanes a, Lanes b) { return { vcltq_f32(a.v, b.v) }; }
+inline LaneMask operator<=(Lanes a, Lanes b) { return { vcleq_f32(a.v, b.v) }; }
+inline LaneMask operator>(Lanes a, Lanes b) { return { vcgtq_f32(a.v, b.v) }; }
+inline LaneMask operator>=(Lanes a, Lanes b) { return { vcgeq_f32(a.v, b.v) }; }
+inline LaneMask operator==(Lanes a, Lanes b) { return { vceqq_f32(a.v, b.v) }; }
+inline LaneMask operator&(LaneMask a, LaneMask b) { return { vandq_u32(a.m, b.m) }; }
+inline LaneMask operator|(LaneMask a, LaneMask b) { return { vorrq_u32(a.m, b.m) }; }
+inline LaneMask AndNot(LaneMask a, LaneMask b) { return { vbicq_u32(a.m, b.m) }; }
+inline Lanes Select(LaneMask m, Lanes a, Lanes b) { return { vbslq_f32(m.m, a.v, b.v) }; }
+inline int MoveMask(LaneMask m)
+{
+	uint32_t bits[4];
+	vst1q_u32(bits, vshrq_n_u32(m.m, 31));
+	return static_cast<int>(bits[0] | (bits[1] << 1) | (bits[2] << 2) | (bits[3] << 3));
+}
+
+#else
+
+const int LANE_WIDTH = 1;
+const char* const LANE_BACKEND = "scalar";
+
+struct LaneMask { bool m; };
+
+struct Lanes
+{
+	float v;
+
+	static Lanes Load(const float* p) { return { *p }; }
+	static Lanes Set(float x) { return { x }; }
+	void Store(float* p) const { *p = v; }
+};
+
+inline Lanes operator+(Lanes a, Lanes b) { return { a.v + b.v }; }
+inline Lanes operator-(Lanes a, Lanes b) { return { a.v - b.v }; }
+inline Lanes operator*(Lanes a, Lanes b) { return { a.v * b.v }; }
+inline Lanes operator/(Lanes a, Lanes b) { return { a.v / b.v }; }
+inline Lanes Min(Lanes a, Lanes b) { return { b.v < a.v ? b.v : a.v }; }
+inline Lanes Max(Lanes a, Lanes b) { return { b.v > a.v ? b.v : a.v }; }
+inline Lanes Sqrt(Lanes a) { return { std::sqrt(a.v) }; }
+inline Lanes Abs(Lanes a) { return { std::fabs(a.v) }; }
+inline Lanes CopySign(Lanes a, Lanes b) { return { std::copysign(a.v, b.v) }; }
+inline LaneMask operator<(Lanes a, Lanes b) { return { a.v < b.v }; }
+inline LaneMask operator<=(Lanes a, Lanes b) { return { a.v <= b.v }; }
+inline LaneMask operator>(Lanes a, Lanes b) { return { a.v > b.v }; }
+inline LaneMask operator>=(Lanes a, Lanes b) { return { a.v >= b.v }; }
+inline LaneMask operator==(Lanes a, Lanes b) { return { a.v == b.v }; }
+inline LaneMask operator&(LaneMask a, LaneMask b) { return { a.m && b.m }; }
+inline LaneMask operator|(LaneMask a, LaneMask b) { return { a.m || b.m }; }
+inline LaneMask AndNot(LaneMask a, LaneMask b) { return { a.m && !b.m }; }
+inline Lanes Select(LaneMask m, Lanes a, Lanes b) { return m.m ? a : b; }
+inline int MoveMask(LaneMask m) { return m.m ? 1 : 0; }
+
+#endif
+
+#endif
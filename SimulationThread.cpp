@@ -0,0 +1,190 @@
+#include"SimulationThread.h"
+#include<algorithm>
+#include<chrono>
+#include<iostream>
+#include<glm/gtc/quaternion.hpp>
+
+#include"Tracer.h"
+
+namespace
+{
+	int64_t SteadyNowNs()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+}
+
+SimulationThread::~SimulationThread()
+{
+	Stop();
+}
+
+void SimulationThread::Start(int rate, const SimulationFrame& initial, TickFunction tick)
+{
+	Stop();
+	this->rate = std::max(rate, 1);
+	this->tick = std::move(tick);
+	stats = SimulationStats();
+
+	// Every slot starts as the initial frame, so the reader never sees an empty one
+	SimulationFrame first = initial;
+	first.publishedNs = SteadyNowNs();
+	for (int i = 0; i < 3; i++) {
+		frames.WriteSlot() = first;
+		frames.Publish();
+	}
+	frames.Acquire();
+	previous = first;
+	current = first;
+	hasFrame = true;
+
+	running.store(true, std::memory_order_release);
+	worker = std::thread(&SimulationThread::Run, this);
+}
+
+void SimulationThread::Stop()
+{
+	if (!worker.joinable()) {
+		return;
+	}
+	running.store(false, std::memory_order_release);
+	worker.join();
+	RunCommands();
+}
+
+void SimulationThread::Post(std::function<void()> command)
+{
+	if (!IsRunning()) {
+		command();
+		return;
+	}
+	std::lock_guard<std::mutex> lock(commandMutex);
+	commands.push_back(std::move(command));
+}
+
+void SimulationThread::RunCommands()
+{
+	{
+		std::lock_guard<std::mutex> lock(commandMutex);
+		runningCommands.swap(commands);
+	}
+	for (std::function<void()>& command : runningCommands) {
+		command();
+	}
+	runningCommands.clear();
+}
+
+void SimulationThread::Run()
+{
+	const int64_t periodNs = 1000000000ll / rate;
+	const float deltaTime = 1.0f / static_cast<float>(rate);
+	int64_t nextNs = SteadyNowNs() + periodNs;
+
+	while (running.load(std::memory_order_acquire)) {
+		RunCommands();
+
+		int64_t startNs = SteadyNowNs();
+		SimulationFrame& frame = frames.WriteSlot();
+		{
+			TraceZone zone("SimulationTick");
+			tick(deltaTime, frame);
+		}
+		stats.ticks++;
+		frame.tick = stats.ticks;
+		frame.time = static_cast<double>(stats.ticks) / rate;
+		frame.publishedNs = SteadyNowNs();
+		frames.Publish();
+
+		double tickMs = (frame.publishedNs - startNs) / 1e6;
+		stats.totalTickMs += tickMs;
+		stats.maxTickMs = std::max(stats.maxTickMs, tickMs);
+
+		int64_t nowNs = SteadyNowNs();
+		if (nowNs > nextNs) {
+			stats.lateTicks++;
+			// Too far behind to catch up without a burst of ticks: drop them
+			if (nowNs - nextNs > MAX_CATCH_UP_TICKS * periodNs) {
+				stats.skippedTicks += (nowNs - nextNs) / periodNs;
+				nextNs = nowNs;
+			}
+		}
+		else {
+			std::this_thread::sleep_for(std::chrono::nanoseconds(nextNs - nowNs));
+		}
+		nextNs += periodNs;
+	}
+}
+
+bool SimulationThread::Sample(SimulationFrame& out)
+{
+	if (!hasFrame) {
+		return false;
+	}
+	if (frames.Acquire()) {
+		std::swap(previous, current);
+		current = frames.ReadSlot();
+		stats.framesAcquired++;
+	}
+
+	// Show the moment one tick ago, which lies between the two frames held
+	int64_t renderNs = SteadyNowNs() - 1000000000ll / rate;
+	int64_t spanNs = current.publishedNs - previous.publishedNs;
+	float alpha = 1.0f;
+	if (spanNs > 0) {
+		alpha = std::clamp(static_cast<float>(renderNs - previous.publishedNs) / static_cast<float>(spanNs), 0.0f, 1.0f);
+	}
+	Blend(previous, current, alpha, out);
+	return true;
+}
+
+void SimulationThread::Blend(const SimulationFrame& a, const SimulationFrame& b, float alpha, SimulationFrame& out)
+{
+	out.tick = b.tick;
+	out.time = a.time + (b.time - a.time) * alpha;
+	out.publishedNs = b.publishedNs;
+	out.ballsDriven = b.ballsDriven;
+
+	size_t nodes = b.localTransforms.size();
+	out.localTransforms.resize(nodes);
+	bool sameNodes = a.localTransforms.size() == nodes;
+	for (size_t i = 0; i < nodes; i++) {
+		out.localTransforms[i] = sameNodes ? a.localTransforms[i] + (b.localTransforms[i] - a.localTransforms[i]) * alpha
+			: b.localTransforms[i];
+	}
+
+	out.balls = b.balls;
+	if (!a.ballsDriven || a.balls.count != b.balls.count) {
+		return;
+	}
+	BallSet& balls = out.balls;
+	for (int i = 0; i < balls.count; i++) {
+		// A ball that dropped into a pocket between the frames stays where it was until halfway
+		if (a.balls.phase[i] != b.balls.phase[i] && alpha < 0.5f) {
+			balls.phase[i] = a.balls.phase[i];
+		}
+		if (a.balls.phase[i] == BallPhase::Pocketed || b.balls.phase[i] == BallPhase::Pocketed) {
+			const BallSet& nearest = alpha < 0.5f ? a.balls : b.balls;
+			balls.px[i] = nearest.px[i];
+			balls.pz[i] = nearest.pz[i];
+			continue;
+		}
+		balls.px[i] = a.balls.px[i] + (b.balls.px[i] - a.balls.px[i]) * alpha;
+		balls.pz[i] = a.balls.pz[i] + (b.balls.pz[i] - a.balls.pz[i]) * alpha;
+		glm::quat from(a.balls.qw[i], a.balls.qx[i], a.balls.qy[i], a.balls.qz[i]);
+		glm::quat to(b.balls.qw[i], b.balls.qx[i], b.balls.qy[i], b.balls.qz[i]);
+		glm::quat orientation = glm::slerp(from, to, alpha);
+		balls.qw[i] = orientation.w;
+		balls.qx[i] = orientation.x;
+		balls.qy[i] = orientation.y;
+		balls.qz[i] = orientation.z;
+	}
+}
+
+void SimulationThread::PrintStats() const
+{
+	double averageMs = stats.ticks > 0 ? stats.totalTickMs / stats.ticks : 0.0;
+	std::cout << "[SIM] " << stats.ticks << " ticks at " << rate << " Hz, " << averageMs << " ms average, "
+			  << stats.maxTickMs << " ms max, " << stats.lateTicks << " late, " << stats.skippedTicks << " skipped, "
+			  << stats.framesAcquired << " frames picked up by the renderer" << std::endl;
+}
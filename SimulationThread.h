@@ -0,0 +1,106 @@
+#ifndef SIMULATION_THREAD_CLASS_H
+#define SIMULATION_THREAD_CLASS_H
+
+#include<atomic>
+#include<cstdint>
+#include<functional>
+#include<mutex>
+#include<thread>
+#include<vector>
+#include<glm/glm.hpp>
+
+#include"BilliardPhysics.h"
+#include"TripleBuffer.h"
+
+// Everything the render thread needs from one simulation tick
+struct SimulationFrame
+{
+	uint64_t tick = 0;
+	double time = 0.0;                        // simulated seconds since Start
+	int64_t publishedNs = 0;                  // steady clock when the tick finished
+	std::vector<glm::mat4> localTransforms;   // table model nodes, indexed by node
+	BallSet balls;
+	bool ballsDriven = false;                 // balls come from the physics, not from localTransforms
+};
+
+struct SimulationStats
+{
+	uint64_t ticks = 0;
+	uint64_t lateTicks = 0;      // finished after the next one was due
+	uint64_t skippedTicks = 0;   // dropped when the thread fell too far behind
+	double maxTickMs = 0.0;
+	double totalTickMs = 0.0;
+	uint64_t framesAcquired = 0; // new frames the render thread picked up
+};
+
+// Runs the simulation (physics and animation sampling) on its own thread at
+// a fixed rate, independent of the render frame rate. Each tick fills a
+// SimulationFrame that is handed to the render thread through a lock-free
+// TripleBuffer; the render thread keeps the two newest frames and blends
+// them for a point one tick in the past, so motion stays smooth at any
+// frame rate and a slow frame never holds the simulation up.
+//
+// Input that changes the simulation is Posted as commands, which the
+// simulation thread runs before its next tick, so the simulated state is
+// only ever touched by one thread.
+class SimulationThread
+{
+public:
+	static const int DEFAULT_RATE = 240;        // ticks per second, BilliardPhysics::FIXED_TIMESTEP
+	static const int MAX_CATCH_UP_TICKS = 8;    // further behind than this the clock restarts instead
+
+	// Fills frame for a tick of deltaTime seconds. frame is a reused slot
+	// holding an older frame, so every field the reader uses must be set.
+	using TickFunction = std::function<void(float deltaTime, SimulationFrame& frame)>;
+
+	SimulationThread() = default;
+	~SimulationThread();
+
+	SimulationThread(const SimulationThread&) = delete;
+	SimulationThread& operator=(const SimulationThread&) = delete;
+
+	// Starts ticking rate times per second; initial is shown until the first tick
+	void Start(int rate, const SimulationFrame& initial, TickFunction tick);
+	// Runs the commands still queued, then joins the thread
+	void Stop();
+	bool IsRunning() const { return worker.joinable(); }
+	int GetRate() const { return rate; }
+
+	// Runs command on the simulation thread before its next tick, or right
+	// away when the thread is not running
+	void Post(std::function<void()> command);
+
+	// Render thread: the blend of the two newest frames for the time one
+	// tick before now. False until a frame is available.
+	bool Sample(SimulationFrame& out);
+
+	// a and b mixed by alpha in [0, 1]: transforms and positions linearly,
+	// ball orientations along the shorter arc
+	static void Blend(const SimulationFrame& a, const SimulationFrame& b, float alpha, SimulationFrame& out);
+
+	// Only consistent once the thread has stopped
+	const SimulationStats& GetStats() const { return stats; }
+	void PrintStats() const;
+
+private:
+	TripleBuffer<SimulationFrame> frames;
+	SimulationFrame previous;   // render thread copies of the two newest frames
+	SimulationFrame current;
+	bool hasFrame = false;
+
+	std::thread worker;
+	std::atomic<bool> running{ false };
+	int rate = DEFAULT_RATE;
+	TickFunction tick;
+
+	std::mutex commandMutex;
+	std::vector<std::function<void()>> commands;
+	std::vector<std::function<void()>> runningCommands;   // swapped out so Post never waits on a command
+
+	SimulationStats stats;
+
+	void Run();
+	void RunCommands();
+};
+
+#endif
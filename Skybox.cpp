@@ -1,4 +1,5 @@
 #include "Skybox.h"
+#include "Tracer.h"
 #include <stb/stb_image.h>
 #include <iostream>
 
@@ -55,6 +56,8 @@ Skybox::Skybox(const std::vector<std::string>& faces)
     textureID = loadCubemap(faces);
     setupSkybox();
     skyboxShader = new Shader("skybox.vert", "skybox.frag");
+    // Filtry wlaczane klawiszami kompiluja sie od razu w tle
+    skyboxShader->Precompile(SHADER_GRAYSCALE | SHADER_RAINBOW_LIGHT);
 }
 
 Skybox::~Skybox()
@@ -64,32 +67,39 @@ Skybox::~Skybox()
 
 void Skybox::setupSkybox()
 {
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
+    RenderDevice& device = RenderDevice::Get();
+    VAO = device.GenVertexArray();
+    VBO = device.GenBuffer();
 
-    glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), &skyboxVertices, GL_STATIC_DRAW);
+    device.BindVertexArray(VAO);
+    device.BindBuffer(GL_ARRAY_BUFFER, VBO);
+    device.BufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), &skyboxVertices, GL_STATIC_DRAW);
 
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    device.EnableVertexAttribArray(0);
+    device.VertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
 
-    glBindVertexArray(0);
+    device.BindVertexArray(0);
 }
 
 GLuint Skybox::loadCubemap(const std::vector<std::string>& faces)
 {
+    RenderDevice& device = RenderDevice::Get();
+    TRACE_ZONE("Skybox::loadCubemap");
     bool previous = false;
     stbi_set_flip_vertically_on_load(true);
 
     GLuint textureID;
-    glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+    textureID = device.GenTexture();
+    device.BindTexture(GL_TEXTURE_CUBE_MAP, textureID);
 
     int width, height, nrChannels;
     for (unsigned int i = 0; i < faces.size(); i++)
     {
-        unsigned char* data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
+        unsigned char* data;
+        {
+            TRACE_ZONE("Image decode");
+            data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
+        }
         if (data)
         {
             GLenum format = GL_RGB;
@@ -98,8 +108,9 @@ GLuint Skybox::loadCubemap(const std::vector<std::string>& faces)
             else if (nrChannels == 1)
                 format = GL_RED;
 
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i,
-                0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+            TRACE_ZONE("glTexImage2D upload");
+            device.TexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i,
+                0, format, width, height, format, GL_UNSIGNED_BYTE, data);
             stbi_image_free(data);
         }
         else
@@ -109,11 +120,11 @@ GLuint Skybox::loadCubemap(const std::vector<std::string>& faces)
         }
     }
 
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    device.TexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    device.TexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    device.TexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    device.TexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    device.TexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
 
     // Przywr poprzednie ustawienie
     stbi_set_flip_vertically_on_load(previous);
@@ -123,7 +134,8 @@ GLuint Skybox::loadCubemap(const std::vector<std::string>& faces)
 
 void Skybox::Draw(Camera& camera, int width, int height)
 {
-    glDepthFunc(GL_LEQUAL);
+    RenderDevice& device = RenderDevice::Get();
+    device.DepthFunc(GL_LEQUAL);
 
     skyboxShader->Activate();
 
@@ -135,35 +147,36 @@ void Skybox::Draw(Camera& camera, int width, int height)
 
     glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)width / (float)height, 0.1f, 100.0f);
 
-    glUniformMatrix4fv(glGetUniformLocation(skyboxShader->ID, "view"), 1, GL_FALSE, glm::value_ptr(view));
-    glUniformMatrix4fv(glGetUniformLocation(skyboxShader->ID, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+    device.UniformMatrix4fv(device.GetUniformLocation(skyboxShader->ID, "view"), 1, GL_FALSE, glm::value_ptr(view));
+    device.UniformMatrix4fv(device.GetUniformLocation(skyboxShader->ID, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
 
-    glBindVertexArray(VAO);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
-    glUniform1i(glGetUniformLocation(skyboxShader->ID, "skybox"), 0);
+    device.BindVertexArray(VAO);
+    device.ActiveTexture(GL_TEXTURE0);
+    device.BindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+    device.Uniform1i(device.GetUniformLocation(skyboxShader->ID, "skybox"), 0);
 
-    glDrawArrays(GL_TRIANGLES, 0, 36);
-    glBindVertexArray(0);
+    device.DrawArrays(GL_TRIANGLES, 0, 36);
+    device.BindVertexArray(0);
 
-    glDepthFunc(GL_LESS);
+    device.DepthFunc(GL_LESS);
 }
 
 void Skybox::Delete()
 {
+    RenderDevice& device = RenderDevice::Get();
     // Delete OpenGL resources only if they exist
     if (VAO != 0) {
-        glDeleteVertexArrays(1, &VAO);
+        device.DeleteVertexArray(VAO);
         VAO = 0;
     }
 
     if (VBO != 0) {
-        glDeleteBuffers(1, &VBO);
+        device.DeleteBuffer(VBO);
         VBO = 0;
     }
 
     if (textureID != 0) {
-        glDeleteTextures(1, &textureID);
+        device.DeleteTexture(textureID);
         textureID = 0;
     }
 
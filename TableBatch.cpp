@@ -0,0 +1,398 @@
+#include"TableBatch.h"
+#include"BallKernels.h"
+#include"SimdLanes.h"
+#include<algorithm>
+#include<chrono>
+#include<iostream>
+
+namespace
+{
+	const int TABLES_PER_EVENT_JOB = 8;
+
+	inline Lanes PhaseLanes(BallPhase phase)
+	{
+		return Lanes::Set(static_cast<float>(phase));
+	}
+
+	// BilliardPhysics::ClassifyPhase for lanes that are not pocketed
+	Lanes ClassifyLanes(Lanes vx, Lanes vz, Lanes wx, Lanes wy, Lanes wz, Lanes R)
+	{
+		const Lanes velocityEpsilon = Lanes::Set(BilliardPhysics::VELOCITY_EPSILON);
+		const Lanes spinEpsilon = Lanes::Set(BilliardPhysics::SPIN_EPSILON);
+		Lanes slipX = vx + R * wz;
+		Lanes slipZ = vz - R * wx;
+		LaneMask sliding = Sqrt(slipX * slipX + slipZ * slipZ) > velocityEpsilon;
+		LaneMask moving = Sqrt(vx * vx + vz * vz) > velocityEpsilon;
+		LaneMask spinning = Abs(wy) > spinEpsilon;
+		return Select(sliding, PhaseLanes(BallPhase::Sliding),
+			Select(moving, PhaseLanes(BallPhase::Rolling),
+			Select(spinning, PhaseLanes(BallPhase::Spinning), PhaseLanes(BallPhase::Stationary))));
+	}
+}
+
+TableBatch::TableBatch(int threadCount)
+	: pool(threadCount), simulators(new EventSimulator[pool.GetWorkerCount()])
+{
+	for (int i = 0; i < pool.GetWorkerCount(); i++) {
+		simulators[i].recordHistory = false;
+	}
+}
+
+void TableBatch::Resize(int tables, int balls)
+{
+	tableCount = std::max(tables, 0);
+	ballCount = std::clamp(balls, 0, MAX_BALLS);
+	const int blockWidth = static_cast<int>(sizeof(LaneBlock) / sizeof(float));
+	stride = (tableCount + blockWidth - 1) / blockWidth * blockWidth;
+	storage.assign(static_cast<size_t>(FIELD_COUNT) * ballCount * stride / blockWidth, LaneBlock());
+	for (int b = 0; b < ballCount; b++) {
+		std::fill(Row(PHASE, b), Row(PHASE, b) + stride, static_cast<float>(BallPhase::Pocketed));
+	}
+}
+
+void TableBatch::SetTable(int t, const BallSet& balls)
+{
+	for (int b = 0; b < ballCount; b++) {
+		bool present = b < balls.count;
+		Row(PHASE, b)[t] = static_cast<float>(present ? balls.phase[b] : BallPhase::Pocketed);
+		Row(PX, b)[t] = present ? balls.px[b] : 0.0f;
+		Row(PZ, b)[t] = present ? balls.pz[b] : 0.0f;
+		Row(VX, b)[t] = present ? balls.vx[b] : 0.0f;
+		Row(VZ, b)[t] = present ? balls.vz[b] : 0.0f;
+		Row(WX, b)[t] = present ? balls.wx[b] : 0.0f;
+		Row(WY, b)[t] = present ? balls.wy[b] : 0.0f;
+		Row(WZ, b)[t] = present ? balls.wz[b] : 0.0f;
+	}
+}
+
+void TableBatch::GetTable(int t, BallSet& balls) const
+{
+	balls = BallSet();
+	balls.count = ballCount;
+	for (int b = 0; b < ballCount; b++) {
+		balls.phase[b] = static_cast<BallPhase>(static_cast<int>(Row(PHASE, b)[t]));
+		balls.px[b] = Row(PX, b)[t];
+		balls.pz[b] = Row(PZ, b)[t];
+		balls.vx[b] = Row(VX, b)[t];
+		balls.vz[b] = Row(VZ, b)[t];
+		balls.wx[b] = Row(WX, b)[t];
+		balls.wy[b] = Row(WY, b)[t];
+		balls.wz[b] = Row(WZ, b)[t];
+		balls.qw[b] = 1.0f;
+	}
+}
+
+void TableBatch::Strike(int t, int ball, glm::vec2 direction, float speed, float follow, float english)
+{
+	if (t < 0 || t >= tableCount || ball < 0 || ball >= ballCount) {
+		return;
+	}
+	BallSet balls;
+	GetTable(t, balls);
+	BilliardPhysics::ApplyStrike(balls, ball, direction, speed, follow, english, table.ballRadius);
+	SetTable(t, balls);
+}
+
+TableBatchStats TableBatch::SimulateToRest(BatchMode mode, int maxSteps, int maxEvents)
+{
+	auto start = std::chrono::steady_clock::now();
+	TableBatchStats stats;
+	stats.tables = tableCount;
+	stats.threads = pool.GetWorkerCount();
+	std::vector<int> work;   // steps per block or events per table, each written by one job
+
+	if (mode == BatchMode::Event) {
+		work.assign(tableCount, 0);
+		TableSpec shared = table;
+		if (shared.geometry == nullptr) {
+			rails.BuildFromRails(shared);
+			shared.geometry = &rails;
+		}
+		for (int i = 0; i < pool.GetWorkerCount(); i++) {
+			simulators[i].table = shared;
+			simulators[i].params = params;
+		}
+		auto body = [&](int begin, int end, int worker) {
+			EventSimulator& simulator = simulators[worker];
+			BallSet balls;
+			for (int t = begin; t < end; t++) {
+				GetTable(t, balls);
+				simulator.Reset(balls);
+				work[t] = simulator.SimulateToRest(maxEvents);
+				SetTable(t, simulator.GetBalls());
+			}
+		};
+		pool.ParallelFor(tableCount, TABLES_PER_EVENT_JOB, body);
+		for (int events : work) {
+			stats.events += events;
+		}
+	}
+	else if (table.geometry != nullptr) {
+		// Mesh cushions are not in the lane kernels; swept steps per table
+		work.assign(tableCount, 0);
+		auto body = [&](int begin, int end, int) {
+			BilliardPhysics physics;
+			physics.table = table;
+			physics.params = params;
+			for (int t = begin; t < end; t++) {
+				GetTable(t, physics.balls);
+				while (work[t] < maxSteps && !physics.IsAtRest()) {
+					physics.Step();
+					work[t]++;
+				}
+				SetTable(t, physics.balls);
+			}
+		};
+		pool.ParallelFor(tableCount, TABLES_PER_EVENT_JOB, body);
+		for (int steps : work) {
+			stats.steps += steps;
+		}
+	}
+	else {
+		int blockCount = (tableCount + LANE_WIDTH - 1) / LANE_WIDTH;
+		work.assign(blockCount, 0);
+		auto body = [&](int begin, int end, int) {
+			for (int block = begin; block < end; block++) {
+				work[block] = StepBlock(block * LANE_WIDTH, maxSteps);
+			}
+		};
+		pool.ParallelFor(blockCount, 1, body);
+		for (int steps : work) {
+			stats.steps += steps;
+		}
+	}
+
+	for (int t = 0; t < tableCount; t++) {
+		if (!IsAtRest(t)) {
+			stats.unfinished++;
+		}
+	}
+	stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return stats;
+}
+
+int TableBatch::StepBlock(int base, int maxSteps)
+{
+	const float dt = BilliardPhysics::FIXED_TIMESTEP;
+	for (int step = 0; step < maxSteps; step++) {
+		if (BlockAtRest(base)) {
+			return step;
+		}
+		for (int b = 0; b < ballCount; b++) {
+			BallArrays arrays = { Row(PHASE, b) + base, Row(PX, b) + base, Row(PZ, b) + base, Row(VX, b) + base,
+				Row(VZ, b) + base, Row(WX, b) + base, Row(WY, b) + base, Row(WZ, b) + base, LANE_WIDTH };
+			BallKernels::IntegrateArrays(arrays, dt, params, table.ballRadius);
+		}
+		ResolveBallContacts(base);
+		ResolveRailsAndPockets(base);
+	}
+	return maxSteps;
+}
+
+// BilliardPhysics::ResolveBallCollisions on LANE_WIDTH tables at once: pairs
+// in index order, each lane separating and colliding only where it overlaps
+void TableBatch::ResolveBallContacts(int base)
+{
+	const Lanes zero = Lanes::Set(0.0f);
+	const Lanes one = Lanes::Set(1.0f);
+	const Lanes half = Lanes::Set(0.5f);
+	const Lanes R = Lanes::Set(table.ballRadius);
+	const Lanes diameter = Lanes::Set(2.0f * table.ballRadius);
+	const Lanes diameter2 = diameter * diameter;
+	const Lanes impulseScale = Lanes::Set(0.5f * (1.0f + params.ballRestitution));
+	const Lanes pocketed = PhaseLanes(BallPhase::Pocketed);
+
+	for (int i = 0; i < ballCount; i++) {
+		Lanes phaseI = Lanes::Load(Row(PHASE, i) + base);
+		LaneMask liveI = phaseI < pocketed;
+		if (MoveMask(liveI) == 0) {
+			continue;
+		}
+		Lanes pxI = Lanes::Load(Row(PX, i) + base);
+		Lanes pzI = Lanes::Load(Row(PZ, i) + base);
+		Lanes vxI = Lanes::Load(Row(VX, i) + base);
+		Lanes vzI = Lanes::Load(Row(VZ, i) + base);
+		bool changedI = false;
+
+		for (int j = i + 1; j < ballCount; j++) {
+			Lanes phaseJ = Lanes::Load(Row(PHASE, j) + base);
+			Lanes pxJ = Lanes::Load(Row(PX, j) + base);
+			Lanes pzJ = Lanes::Load(Row(PZ, j) + base);
+			Lanes dx = pxJ - pxI;
+			Lanes dz = pzJ - pzI;
+			Lanes distance2 = dx * dx + dz * dz;
+			LaneMask overlap = liveI & (phaseJ < pocketed) & (distance2 < diameter2);
+			if (MoveMask(overlap) == 0) {
+				continue;
+			}
+			changedI = true;
+
+			Lanes distance = Sqrt(distance2);
+			LaneMask apart = distance > zero;
+			Lanes safeDistance = Select(apart, distance, one);
+			Lanes nx = Select(apart, dx / safeDistance, one);
+			Lanes nz = Select(apart, dz / safeDistance, zero);
+			Lanes push = half * (diameter - distance);
+			pxI = Select(overlap, pxI - nx * push, pxI);
+			pzI = Select(overlap, pzI - nz * push, pzI);
+			pxJ = Select(overlap, pxJ + nx * push, pxJ);
+			pzJ = Select(overlap, pzJ + nz * push, pzJ);
+
+			Lanes vxJ = Lanes::Load(Row(VX, j) + base);
+			Lanes vzJ = Lanes::Load(Row(VZ, j) + base);
+			Lanes approach = (vxI - vxJ) * nx + (vzI - vzJ) * nz;
+			LaneMask collide = overlap & (approach > zero);
+			Lanes impulse = impulseScale * approach;
+			vxI = Select(collide, vxI - impulse * nx, vxI);
+			vzI = Select(collide, vzI - impulse * nz, vzI);
+			vxJ = Select(collide, vxJ + impulse * nx, vxJ);
+			vzJ = Select(collide, vzJ + impulse * nz, vzJ);
+
+			Lanes classifiedI = ClassifyLanes(vxI, vzI, Lanes::Load(Row(WX, i) + base), Lanes::Load(Row(WY, i) + base),
+				Lanes::Load(Row(WZ, i) + base), R);
+			Lanes classifiedJ = ClassifyLanes(vxJ, vzJ, Lanes::Load(Row(WX, j) + base), Lanes::Load(Row(WY, j) + base),
+				Lanes::Load(Row(WZ, j) + base), R);
+			phaseI = Select(collide, classifiedI, phaseI);
+			Select(collide, classifiedJ, phaseJ).Store(Row(PHASE, j) + base);
+			pxJ.Store(Row(PX, j) + base);
+			pzJ.Store(Row(PZ, j) + base);
+			vxJ.Store(Row(VX, j) + base);
+			vzJ.Store(Row(VZ, j) + base);
+		}
+
+		if (changedI) {
+			phaseI.Store(Row(PHASE, i) + base);
+			pxI.Store(Row(PX, i) + base);
+			pzI.Store(Row(PZ, i) + base);
+			vxI.Store(Row(VX, i) + base);
+			vzI.Store(Row(VZ, i) + base);
+		}
+	}
+}
+
+// BilliardPhysics::ResolvePockets and the rail branch of ResolveCushions
+void TableBatch::ResolveRailsAndPockets(int base)
+{
+	const Lanes zero = Lanes::Set(0.0f);
+	const Lanes R = Lanes::Set(table.ballRadius);
+	const Lanes e = Lanes::Set(params.cushionRestitution);
+	const Lanes pocketed = PhaseLanes(BallPhase::Pocketed);
+	const Lanes pocketRadius2 = Lanes::Set(table.pocketRadius * table.pocketRadius);
+	const Lanes minX = Lanes::Set(table.center.x - table.halfSizeX + table.ballRadius);
+	const Lanes maxX = Lanes::Set(table.center.x + table.halfSizeX - table.ballRadius);
+	const Lanes minZ = Lanes::Set(table.center.y - table.halfSizeZ + table.ballRadius);
+	const Lanes maxZ = Lanes::Set(table.center.y + table.halfSizeZ - table.ballRadius);
+
+	for (int b = 0; b < ballCount; b++) {
+		Lanes phase = Lanes::Load(Row(PHASE, b) + base);
+		LaneMask live = phase < pocketed;
+		if (MoveMask(live) == 0) {
+			continue;
+		}
+		Lanes px = Lanes::Load(Row(PX, b) + base);
+		Lanes pz = Lanes::Load(Row(PZ, b) + base);
+		Lanes vx = Lanes::Load(Row(VX, b) + base);
+		Lanes vz = Lanes::Load(Row(VZ, b) + base);
+		Lanes wx = Lanes::Load(Row(WX, b) + base);
+		Lanes wy = Lanes::Load(Row(WY, b) + base);
+		Lanes wz = Lanes::Load(Row(WZ, b) + base);
+
+		LaneMask captured = AndNot(live, live);   // no lane yet
+		Lanes pocketX = zero, pocketZ = zero;
+		for (int p = 0; p < table.pocketCount; p++) {
+			Lanes x = Lanes::Set(table.pockets[p].x);
+			Lanes z = Lanes::Set(table.pockets[p].y);
+			Lanes dx = px - x;
+			Lanes dz = pz - z;
+			LaneMask inside = AndNot(live & (dx * dx + dz * dz < pocketRadius2), captured);
+			pocketX = Select(inside, x, pocketX);
+			pocketZ = Select(inside, z, pocketZ);
+			captured = captured | inside;
+		}
+		live = AndNot(live, captured);
+
+		LaneMask left = live & (px < minX);
+		LaneMask right = AndNot(live & (px > maxX), left);
+		LaneMask near = live & (pz < minZ);
+		LaneMask far = AndNot(live & (pz > maxZ), near);
+		px = Select(left, minX + (minX - px) * e, Select(right, maxX - (px - maxX) * e, px));
+		vx = Select(left, Abs(vx) * e, Select(right, zero - Abs(vx) * e, vx));
+		pz = Select(near, minZ + (minZ - pz) * e, Select(far, maxZ - (pz - maxZ) * e, pz));
+		vz = Select(near, Abs(vz) * e, Select(far, zero - Abs(vz) * e, vz));
+		LaneMask hit = left | right | near | far;
+		phase = Select(hit, ClassifyLanes(vx, vz, wx, wy, wz, R), phase);
+
+		phase = Select(captured, pocketed, phase);
+		px = Select(captured, pocketX, px);
+		pz = Select(captured, pocketZ, pz);
+		vx = Select(captured, zero, vx);
+		vz = Select(captured, zero, vz);
+		phase.Store(Row(PHASE, b) + base);
+		px.Store(Row(PX, b) + base);
+		pz.Store(Row(PZ, b) + base);
+		vx.Store(Row(VX, b) + base);
+		vz.Store(Row(VZ, b) + base);
+		Select(captured, zero, wx).Store(Row(WX, b) + base);
+		Select(captured, zero, wy).Store(Row(WY, b) + base);
+		Select(captured, zero, wz).Store(Row(WZ, b) + base);
+	}
+}
+
+bool TableBatch::BlockAtRest(int base) const
+{
+	const Lanes spinning = PhaseLanes(BallPhase::Spinning);
+	const Lanes pocketed = PhaseLanes(BallPhase::Pocketed);
+	for (int b = 0; b < ballCount; b++) {
+		// Stationary is the only phase below Spinning
+		Lanes phase = Lanes::Load(Row(PHASE, b) + base);
+		if (MoveMask((phase >= spinning) & (phase < pocketed)) != 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool TableBatch::IsAtRest(int t) const
+{
+	for (int b = 0; b < ballCount; b++) {
+		BallPhase phase = static_cast<BallPhase>(static_cast<int>(Row(PHASE, b)[t]));
+		if (phase != BallPhase::Stationary && phase != BallPhase::Pocketed) {
+			return false;
+		}
+	}
+	return true;
+}
+
+uint64_t TableBatch::StateHash() const
+{
+	uint64_t hash = 1469598103934665603ull;
+	for (int t = 0; t < tableCount; t++) {
+		for (int field = PHASE; field < FIELD_COUNT; field++) {
+			for (int b = 0; b < ballCount; b++) {
+				const unsigned char* bytes = reinterpret_cast<const unsigned char*>(Row(static_cast<Field>(field), b) + t);
+				for (size_t k = 0; k < sizeof(float); k++) {
+					hash = (hash ^ bytes[k]) * 1099511628211ull;
+				}
+			}
+		}
+	}
+	return hash;
+}
+
+void TableBatch::PrintStats(const TableBatchStats& stats, BatchMode mode)
+{
+	std::cout << "[BATCH] " << stats.tables << " shots, "
+			  << (mode == BatchMode::Event ? "event" : "fixed step") << " mode on " << stats.threads << " threads ("
+			  << BallKernels::GetBackendName() << "): " << stats.seconds * 1000.0 << " ms, "
+			  << static_cast<int64_t>(stats.ShotsPerSecond()) << " shots/s";
+	if (mode == BatchMode::Event) {
+		std::cout << ", " << stats.events << " events";
+	}
+	else {
+		std::cout << ", " << stats.steps << " steps";
+	}
+	if (stats.unfinished > 0) {
+		std::cout << ", " << stats.unfinished << " tables still moving";
+	}
+	std::cout << std::endl;
+}
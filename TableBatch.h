@@ -0,0 +1,102 @@
+#ifndef TABLE_BATCH_CLASS_H
+#define TABLE_BATCH_CLASS_H
+
+#include<cstdint>
+#include<memory>
+#include<vector>
+#include<glm/glm.hpp>
+
+#include"BilliardPhysics.h"
+#include"EventSimulator.h"
+#include"JobPool.h"
+#include"TableGeometry.h"
+
+enum class BatchMode : uint8_t
+{
+	FixedStep,   // SIMD lanes across tables, threads across blocks of tables
+	Event        // one EventSimulator per worker, threads across tables
+};
+
+struct TableBatchStats
+{
+	int tables = 0;
+	int threads = 0;
+	int64_t steps = 0;    // FixedStep: steps summed over the blocks of tables stepped together
+	int64_t events = 0;   // Event: events summed over tables
+	int unfinished = 0;   // tables still moving when the step or event limit was hit
+	double seconds = 0.0;
+
+	double ShotsPerSecond() const { return seconds > 0.0 ? tables / seconds : 0.0; }
+};
+
+// Thousands of independent tables for offline self-play and parameter
+// tuning, with no rendering involved. All tables share one TableSpec and
+// PhysicsParams; the ball state is structure-of-arrays with the tables
+// innermost, so field f of ball b on table t is
+//   data[(f * ballCount + b) * stride + t]
+// and one SIMD load picks up the same ball on LANE_WIDTH neighbouring tables.
+//
+// FixedStep integrates through BallKernels::IntegrateArrays and resolves
+// ball, rail and pocket contacts with masked lane math. Those contacts are
+// found by overlap after each step, not swept like BilliardPhysics::Step,
+// so use it for volume and Event for exact results. With table.geometry
+// set, FixedStep plays each table through BilliardPhysics instead.
+class TableBatch
+{
+public:
+	static const int DEFAULT_MAX_STEPS = 240 * 60;   // a minute of play at BilliardPhysics::FIXED_TIMESTEP
+
+	TableSpec table;
+	PhysicsParams params;
+
+	// threadCount 0 uses every hardware thread
+	explicit TableBatch(int threadCount = 0);
+
+	// Room for ballCount balls per table, all of them pocketed (off the
+	// table) until SetTable places them
+	void Resize(int tableCount, int ballCount);
+	int GetTableCount() const { return tableCount; }
+	int GetBallCount() const { return ballCount; }
+
+	void SetTable(int t, const BallSet& balls);
+	void GetTable(int t, BallSet& balls) const;
+	// BilliardPhysics::Strike on one table
+	void Strike(int t, int ball, glm::vec2 direction, float speed, float follow, float english);
+
+	// Runs every table until its balls rest or the limit is reached
+	TableBatchStats SimulateToRest(BatchMode mode, int maxSteps = DEFAULT_MAX_STEPS,
+		int maxEvents = EventSimulator::DEFAULT_MAX_EVENTS);
+
+	bool IsAtRest(int t) const;
+	// FNV-1a over every table's positions, velocities and phases
+	uint64_t StateHash() const;
+
+	static void PrintStats(const TableBatchStats& stats, BatchMode mode);
+
+private:
+	enum Field { PHASE, PX, PZ, VX, VZ, WX, WY, WZ, FIELD_COUNT };
+
+	struct alignas(32) LaneBlock
+	{
+		float values[8];
+	};
+
+	JobPool pool;
+	int tableCount = 0;
+	int ballCount = 0;
+	int stride = 0;                    // tables per row, padded to whole lane blocks
+	std::vector<LaneBlock> storage;
+	std::unique_ptr<EventSimulator[]> simulators;   // one per worker for Event mode
+	TableGeometry rails;                            // their cushions when the table has no geometry
+
+	float* Row(Field field, int ball) { return reinterpret_cast<float*>(storage.data()) + (static_cast<size_t>(field) * ballCount + ball) * stride; }
+	const float* Row(Field field, int ball) const { return reinterpret_cast<const float*>(storage.data()) + (static_cast<size_t>(field) * ballCount + ball) * stride; }
+
+	// Steps LANE_WIDTH tables from base until they rest; returns the steps taken
+	int StepBlock(int base, int maxSteps);
+	void ResolveBallContacts(int base);
+	void ResolveRailsAndPockets(int base);
+	bool BlockAtRest(int base) const;
+};
+
+#endif
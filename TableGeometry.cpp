@@ -0,0 +1,598 @@
+#include"TableGeometry.h"
+#include<algorithm>
+#include<cmath>
+#include<cstdint>
+#include<limits>
+#include<unordered_map>
+#include<glm/gtc/constants.hpp>
+
+namespace
+{
+	const float WELD_FRACTION = 0.25f;        // of the fit tolerance, slice endpoints closer than this are one point
+	const float CORNER_ANGLE = 0.2f;          // radians, sharper turns between pieces get a corner point; below it a ball sinks in under 0.5% of its radius
+	const float STRAIGHT_ANGLE = 1e-3f;       // radians, smaller turns are points along one straight edge
+	const float MAX_ARC_RADIUS = 400.0f;      // in fit tolerances, flatter curves are left to lines
+	const size_t MAX_LINE_BACKOFF = 3;        // points a line may hand back to the arc after it
+	const int MAX_LEAF_SIZE = 4;
+	const int MAX_QUERY_DEPTH = 64;
+	const float NO_HIT = std::numeric_limits<float>::infinity();
+
+	inline float Cross(glm::vec2 a, glm::vec2 b)
+	{
+		return a.x * b.y - a.y * b.x;
+	}
+
+	// Distance from point to the segment a-b
+	float DistanceToSegment(glm::vec2 point, glm::vec2 a, glm::vec2 b)
+	{
+		glm::vec2 along = b - a;
+		float length2 = glm::dot(along, along);
+		float u = length2 > 0.0f ? glm::clamp(glm::dot(point - a, along) / length2, 0.0f, 1.0f) : 0.0f;
+		return glm::length(point - (a + along * u));
+	}
+
+	// Straight-line sweep of a circle of radius R against one segment, both
+	// sides; NO_HIT when it misses or is moving away
+	float SegmentHitTime(const CushionSegment& segment, glm::vec2 p, glm::vec2 v, float R)
+	{
+		glm::vec2 along = segment.end - segment.start;
+		float length = glm::length(along);
+		if (length <= 0.0f) {
+			return NO_HIT;
+		}
+		glm::vec2 tangent = along / length;
+		glm::vec2 d = p - segment.start;
+		float side = glm::dot(segment.normal, d);
+		float rate = std::copysign(1.0f, side) * glm::dot(segment.normal, v);
+		if (rate >= 0.0f) {
+			return NO_HIT;
+		}
+		float t = std::max(std::fabs(side) - R, 0.0f) / -rate;
+		float u = glm::dot(tangent, d + v * t);
+		return u >= 0.0f && u <= length ? t : NO_HIT;
+	}
+
+	// The same against an arc: met from outside with the center r + R away,
+	// or from inside at r - R, also after coming in through the open part
+	float ArcHitTime(const CushionArc& arc, glm::vec2 p, glm::vec2 v, float R)
+	{
+		glm::vec2 d = p - arc.center;
+		float distance2 = glm::dot(d, d);
+		bool inside = distance2 < arc.radius * arc.radius;
+		float a = glm::dot(v, v);
+		float b = glm::dot(d, v);
+		float t = NO_HIT;
+
+		float c = distance2 - (arc.radius + R) * (arc.radius + R);
+		float discriminant = b * b - a * c;
+		if (!inside && b < 0.0f && discriminant >= 0.0f) {
+			float candidate = std::max(c, 0.0f) / (std::sqrt(discriminant) - b);
+			if (arc.Contains(d + v * candidate)) {
+				t = candidate;
+			}
+		}
+		if (arc.radius > R) {
+			c = distance2 - (arc.radius - R) * (arc.radius - R);
+			discriminant = b * b - a * c;
+			float candidate = -1.0f;
+			if (inside && c >= 0.0f && b > 0.0f) {
+				candidate = 0.0f;
+			}
+			else if (a > 0.0f && discriminant >= 0.0f) {
+				float root = std::sqrt(discriminant);
+				candidate = b > 0.0f ? -c / (b + root) : (root - b) / a;
+			}
+			if (candidate >= 0.0f && arc.Contains(d + v * candidate)) {
+				t = std::min(t, candidate);
+			}
+		}
+		return t;
+	}
+
+	uint64_t CellKey(int64_t x, int64_t z)
+	{
+		return (static_cast<uint64_t>(x) << 32) ^ static_cast<uint64_t>(static_cast<uint32_t>(z));
+	}
+}
+
+bool CushionArc::Contains(glm::vec2 direction) const
+{
+	float sign = sweep >= 0.0f ? 1.0f : -1.0f;
+	bool afterFrom = Cross(from, direction) * sign >= 0.0f;
+	bool beforeTo = Cross(direction, to) * sign >= 0.0f;
+	return std::fabs(sweep) <= glm::pi<float>() ? afterFrom && beforeTo : afterFrom || beforeTo;
+}
+
+void TableGeometry::BuildFromRails(const TableSpec& table)
+{
+	segments.clear();
+	arcs.clear();
+	std::array<CushionSegment, 4> rails = table.GetRails();
+	segments.assign(rails.begin(), rails.end());
+	BuildBvh();
+}
+
+bool TableGeometry::BuildFromTriangles(const std::vector<glm::vec3>& triangles, float sliceHeight,
+	glm::vec2 areaMin, glm::vec2 areaMax, float tolerance)
+{
+	segments.clear();
+	arcs.clear();
+	nodes.clear();
+	refs.clear();
+	boundsMin = boundsMax = glm::vec2(0.0f);
+
+	// Weld the slice endpoints on a grid, checking the neighbouring cells so
+	// points straddling a cell border still meet
+	const float weld = tolerance * WELD_FRACTION;
+	std::unordered_map<uint64_t, int> grid;
+	std::vector<glm::vec2> points;
+	auto weldPoint = [&](glm::vec2 point) {
+		int64_t cx = static_cast<int64_t>(std::floor(point.x / weld));
+		int64_t cz = static_cast<int64_t>(std::floor(point.y / weld));
+		for (int64_t x = cx - 1; x <= cx + 1; x++) {
+			for (int64_t z = cz - 1; z <= cz + 1; z++) {
+				auto found = grid.find(CellKey(x, z));
+				if (found != grid.end() && glm::length(points[found->second] - point) <= weld) {
+					return found->second;
+				}
+			}
+		}
+		int index = static_cast<int>(points.size());
+		points.push_back(point);
+		grid.emplace(CellKey(cx, cz), index);
+		return index;
+	};
+	auto inArea = [&](glm::vec2 point) {
+		return point.x >= areaMin.x && point.x <= areaMax.x && point.y >= areaMin.y && point.y <= areaMax.y;
+	};
+
+	// Slice: every triangle crossing the plane leaves one segment. A vertex
+	// exactly on the plane counts as above, so shared edges are cut once.
+	std::vector<std::pair<int, int>> edges;
+	for (size_t t = 0; t + 2 < triangles.size(); t += 3) {
+		const glm::vec3* corner = &triangles[t];
+		glm::vec2 cut[2];
+		int cuts = 0;
+		for (int k = 0; k < 3; k++) {
+			const glm::vec3& a = corner[k];
+			const glm::vec3& b = corner[(k + 1) % 3];
+			bool aboveA = a.y >= sliceHeight;
+			bool aboveB = b.y >= sliceHeight;
+			if (aboveA != aboveB && cuts < 2) {
+				float s = (sliceHeight - a.y) / (b.y - a.y);
+				glm::vec3 point = a + (b - a) * s;
+				cut[cuts++] = glm::vec2(point.x, point.z);
+			}
+		}
+		if (cuts < 2 || !inArea(cut[0]) || !inArea(cut[1])) {
+			continue;
+		}
+		int a = weldPoint(cut[0]);
+		int b = weldPoint(cut[1]);
+		if (a != b) {
+			edges.push_back({ std::min(a, b), std::max(a, b) });
+		}
+	}
+	// Thin walls slice into the same edge twice
+	std::sort(edges.begin(), edges.end());
+	edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+	if (edges.empty()) {
+		return false;
+	}
+
+	// Adjacency in compressed rows
+	std::vector<int> offsets(points.size() + 1, 0);
+	for (const auto& edge : edges) {
+		offsets[edge.first + 1]++;
+		offsets[edge.second + 1]++;
+	}
+	for (size_t k = 1; k < offsets.size(); k++) {
+		offsets[k] += offsets[k - 1];
+	}
+	std::vector<int> adjacent(offsets.back());
+	std::vector<int> fill(offsets.begin(), offsets.end() - 1);
+	for (int e = 0; e < static_cast<int>(edges.size()); e++) {
+		adjacent[fill[edges[e].first]++] = e;
+		adjacent[fill[edges[e].second]++] = e;
+	}
+	auto degree = [&](int vertex) { return offsets[vertex + 1] - offsets[vertex]; };
+
+	// Chains run between vertices that are not simple (ends, T-junctions);
+	// whatever is left afterwards are closed loops
+	std::vector<bool> used(edges.size(), false);
+	std::vector<glm::vec2> chain;
+	auto walk = [&](int start, int edge) {
+		chain.clear();
+		chain.push_back(points[start]);
+		int vertex = start;
+		while (edge >= 0) {
+			used[edge] = true;
+			vertex = edges[edge].first == vertex ? edges[edge].second : edges[edge].first;
+			chain.push_back(points[vertex]);
+			edge = -1;
+			if (degree(vertex) == 2 && vertex != start) {
+				for (int k = offsets[vertex]; k < offsets[vertex + 1]; k++) {
+					if (!used[adjacent[k]]) {
+						edge = adjacent[k];
+						break;
+					}
+				}
+			}
+		}
+	};
+	for (int pass = 0; pass < 2; pass++) {
+		for (int vertex = 0; vertex < static_cast<int>(points.size()); vertex++) {
+			if (pass == 0 && degree(vertex) == 2) {
+				continue;
+			}
+			for (int k = offsets[vertex]; k < offsets[vertex + 1]; k++) {
+				if (used[adjacent[k]]) {
+					continue;
+				}
+				walk(vertex, adjacent[k]);
+				bool closed = chain.size() > 3 && chain.front() == chain.back();
+				if (closed) {
+					// Start the loop at its sharpest corner, or failing one at the
+					// start of its longest edge, so no arc is cut in two
+					size_t count = chain.size() - 1;
+					auto turnAt = [&](size_t p) {
+						glm::vec2 in = chain[p] - chain[(p + count - 1) % count];
+						glm::vec2 out = chain[(p + 1) % count] - chain[p];
+						return std::fabs(std::atan2(Cross(in, out), glm::dot(in, out)));
+					};
+					size_t sharpest = 0, longest = 0;
+					float largestTurn = -1.0f, largestEdge = -1.0f;
+					for (size_t p = 0; p < count; p++) {
+						glm::vec2 out = chain[(p + 1) % count] - chain[p];
+						float turn = turnAt(p);
+						if (turn > largestTurn) {
+							largestTurn = turn;
+							sharpest = p;
+						}
+						if (glm::length(out) > largestEdge) {
+							largestEdge = glm::length(out);
+							longest = p;
+						}
+					}
+					// Back to where the straight run through that edge begins
+					for (size_t steps = 0; steps < count && turnAt(longest) < STRAIGHT_ANGLE; steps++) {
+						longest = (longest + count - 1) % count;
+					}
+					chain.pop_back();
+					std::rotate(chain.begin(), chain.begin() + (largestTurn > CORNER_ANGLE ? sharpest : longest), chain.end());
+					chain.push_back(chain.front());
+				}
+				FitChain(chain, tolerance);
+			}
+		}
+	}
+
+	// Give the lines a consistent orientation, facing the middle of the area
+	glm::vec2 middle = 0.5f * (areaMin + areaMax);
+	for (CushionSegment& segment : segments) {
+		glm::vec2 along = segment.end - segment.start;
+		segment.normal = glm::normalize(glm::vec2(-along.y, along.x));
+		if (glm::dot(segment.normal, middle - segment.start) < 0.0f) {
+			segment.normal = -segment.normal;
+		}
+	}
+
+	BuildBvh();
+	return !IsEmpty();
+}
+
+// Greedy piecewise fit: from each break point take whichever of the longest
+// line or the longest arc within tolerance covers more of the chain. Breaks
+// with a sharp turn get a zero-radius arc, a corner the ball can strike.
+void TableGeometry::FitChain(const std::vector<glm::vec2>& points, float tolerance)
+{
+	const size_t count = points.size();
+	if (count < 2) {
+		return;
+	}
+	bool closed = count > 3 && points.front() == points.back();
+
+	auto lineDeviation = [&](size_t s, size_t e) {
+		float deviation = 0.0f;
+		for (size_t k = s + 1; k < e; k++) {
+			deviation = std::max(deviation, DistanceToSegment(points[k], points[s], points[e]));
+		}
+		return deviation;
+	};
+	auto fitArc = [&](size_t s, size_t e, CushionArc& arc) {
+		// Circle through the first, middle and last point
+		glm::vec2 a = points[s];
+		glm::vec2 b = points[(s + e) / 2] - a;
+		glm::vec2 c = points[e] - a;
+		float det = 2.0f * Cross(b, c);
+		if (std::fabs(det) <= std::numeric_limits<float>::epsilon() * glm::dot(c, c)) {
+			return false;
+		}
+		glm::vec2 offset = glm::vec2(c.y * glm::dot(b, b) - b.y * glm::dot(c, c),
+			b.x * glm::dot(c, c) - c.x * glm::dot(b, b)) / det;
+		float radius = glm::length(offset);
+		if (radius > MAX_ARC_RADIUS * tolerance) {
+			return false;
+		}
+		glm::vec2 center = a + offset;
+		// Every point on the circle, turning the same way throughout
+		float sweep = 0.0f;
+		for (size_t k = s; k <= e; k++) {
+			if (std::fabs(glm::length(points[k] - center) - radius) > tolerance) {
+				return false;
+			}
+			if (k > s) {
+				glm::vec2 previous = points[k - 1] - center;
+				glm::vec2 current = points[k] - center;
+				float turn = std::atan2(Cross(previous, current), glm::dot(previous, current));
+				if (k > s + 1 && turn * sweep <= 0.0f) {
+					return false;
+				}
+				sweep += turn;
+			}
+		}
+		if (std::fabs(sweep) >= glm::two_pi<float>()) {
+			return false;
+		}
+		arc.center = center;
+		arc.radius = radius;
+		arc.from = glm::normalize(points[s] - center);
+		arc.to = glm::normalize(points[e] - center);
+		arc.sweep = sweep;
+		return true;
+	};
+	auto addCorner = [&](size_t k) {
+		bool end = !closed && (k == 0 || k == count - 1);
+		if (!end) {
+			size_t before = k == 0 ? count - 2 : k - 1;
+			size_t after = k == count - 1 ? 1 : k + 1;
+			glm::vec2 in = points[k] - points[before];
+			glm::vec2 out = points[after] - points[k];
+			if (std::fabs(std::atan2(Cross(in, out), glm::dot(in, out))) <= CORNER_ANGLE) {
+				return;
+			}
+		}
+		CushionArc corner;
+		corner.center = points[k];
+		corner.sweep = glm::two_pi<float>();
+		arcs.push_back(corner);
+	};
+
+	auto longestArc = [&](size_t s, CushionArc& arc) {
+		size_t end = s;
+		CushionArc candidate;
+		for (size_t e = s + 3; e < count && fitArc(s, e, candidate); e++) {
+			end = e;
+			arc = candidate;
+		}
+		return end;
+	};
+
+	addCorner(0);
+	size_t s = 0;
+	while (s + 1 < count) {
+		size_t lineEnd = s + 1;
+		while (lineEnd + 1 < count && lineDeviation(s, lineEnd + 1) <= tolerance) {
+			lineEnd++;
+		}
+		CushionArc arc;
+		size_t arcEnd = longestArc(s, arc);
+
+		if (arcEnd > lineEnd) {
+			arcs.push_back(arc);
+			s = arcEnd;
+		}
+		else {
+			// A line running into a tangent curve swallows the first point or
+			// two of it. Among the ends that leave the following arc at least
+			// as long, keep the one the line fits best.
+			size_t nextEnd = longestArc(lineEnd, arc);
+			size_t bestEnd = lineEnd;
+			float bestDeviation = lineDeviation(s, lineEnd);
+			for (size_t back = 1; back <= MAX_LINE_BACKOFF && lineEnd - back > s; back++) {
+				size_t end = lineEnd - back;
+				CushionArc earlier;
+				size_t reach = longestArc(end, earlier);
+				float deviation = lineDeviation(s, end);
+				if (reach > end && reach >= nextEnd && deviation < bestDeviation) {
+					bestEnd = end;
+					bestDeviation = deviation;
+				}
+			}
+			lineEnd = bestEnd;
+			CushionSegment segment;
+			segment.start = points[s];
+			segment.end = points[lineEnd];
+			segments.push_back(segment);
+			s = lineEnd;
+		}
+		// A closed chain's last point is its first, already handled
+		if (s < count - 1 || !closed) {
+			addCorner(s);
+		}
+	}
+}
+
+void TableGeometry::BuildBvh()
+{
+	nodes.clear();
+	refs.clear();
+	refMin.clear();
+	refMax.clear();
+	const int total = static_cast<int>(segments.size() + arcs.size());
+	if (total == 0) {
+		boundsMin = boundsMax = glm::vec2(0.0f);
+		return;
+	}
+
+	std::vector<glm::vec2> mins(total), maxs(total), centers(total);
+	for (int k = 0; k < static_cast<int>(segments.size()); k++) {
+		mins[k] = glm::min(segments[k].start, segments[k].end);
+		maxs[k] = glm::max(segments[k].start, segments[k].end);
+		refs.push_back(k);
+	}
+	for (int k = 0; k < static_cast<int>(arcs.size()); k++) {
+		const CushionArc& arc = arcs[k];
+		int slot = static_cast<int>(segments.size()) + k;
+		glm::vec2 from = arc.center + arc.from * arc.radius;
+		glm::vec2 to = arc.center + arc.to * arc.radius;
+		mins[slot] = glm::min(from, to);
+		maxs[slot] = glm::max(from, to);
+		// Plus the extreme points along each axis the arc passes through
+		const glm::vec2 axes[] = { glm::vec2(1.0f, 0.0f), glm::vec2(-1.0f, 0.0f), glm::vec2(0.0f, 1.0f), glm::vec2(0.0f, -1.0f) };
+		for (glm::vec2 axis : axes) {
+			if (arc.Contains(axis)) {
+				mins[slot] = glm::min(mins[slot], arc.center + axis * arc.radius);
+				maxs[slot] = glm::max(maxs[slot], arc.center + axis * arc.radius);
+			}
+		}
+		refs.push_back(~k);
+	}
+	for (int k = 0; k < total; k++) {
+		centers[k] = 0.5f * (mins[k] + maxs[k]);
+	}
+	nodes.reserve(2 * total / MAX_LEAF_SIZE + 1);
+	BuildNode(0, total, centers, mins, maxs);
+	refMin.resize(total);
+	refMax.resize(total);
+	for (int k = 0; k < total; k++) {
+		int slot = refs[k] >= 0 ? refs[k] : static_cast<int>(segments.size()) + ~refs[k];
+		refMin[k] = mins[slot];
+		refMax[k] = maxs[slot];
+	}
+	boundsMin = nodes[0].boundsMin;
+	boundsMax = nodes[0].boundsMax;
+}
+
+// Median split along the longer axis of the primitive centers
+int TableGeometry::BuildNode(int begin, int end, std::vector<glm::vec2>& centers,
+	std::vector<glm::vec2>& mins, std::vector<glm::vec2>& maxs)
+{
+	const int segmentCount = static_cast<int>(segments.size());
+	auto slot = [segmentCount](int ref) { return ref >= 0 ? ref : segmentCount + ~ref; };
+
+	BvhNode node;
+	node.boundsMin = glm::vec2(std::numeric_limits<float>::max());
+	node.boundsMax = glm::vec2(-std::numeric_limits<float>::max());
+	glm::vec2 centerMin = node.boundsMin;
+	glm::vec2 centerMax = node.boundsMax;
+	for (int k = begin; k < end; k++) {
+		int s = slot(refs[k]);
+		node.boundsMin = glm::min(node.boundsMin, mins[s]);
+		node.boundsMax = glm::max(node.boundsMax, maxs[s]);
+		centerMin = glm::min(centerMin, centers[s]);
+		centerMax = glm::max(centerMax, centers[s]);
+	}
+
+	int index = static_cast<int>(nodes.size());
+	if (end - begin <= MAX_LEAF_SIZE) {
+		node.first = begin;
+		node.count = end - begin;
+		nodes.push_back(node);
+		return index;
+	}
+	node.first = -1;
+	node.count = 0;
+	nodes.push_back(node);
+
+	int axis = centerMax.x - centerMin.x >= centerMax.y - centerMin.y ? 0 : 1;
+	int middle = (begin + end) / 2;
+	std::nth_element(refs.begin() + begin, refs.begin() + middle, refs.begin() + end,
+		[&](int a, int b) { return centers[slot(a)][axis] < centers[slot(b)][axis]; });
+	BuildNode(begin, middle, centers, mins, maxs);
+	int second = BuildNode(middle, end, centers, mins, maxs);
+	nodes[index].first = second;
+	return index;
+}
+
+int TableGeometry::Query(glm::vec2 queryMin, glm::vec2 queryMax, int* out, int maxRefs) const
+{
+	if (nodes.empty()) {
+		return 0;
+	}
+	int found = 0;
+	int stack[MAX_QUERY_DEPTH];
+	int depth = 0;
+	stack[depth++] = 0;
+	while (depth > 0) {
+		int current = stack[--depth];
+		const BvhNode& node = nodes[current];
+		if (node.boundsMin.x > queryMax.x || node.boundsMax.x < queryMin.x
+			|| node.boundsMin.y > queryMax.y || node.boundsMax.y < queryMin.y) {
+			continue;
+		}
+		if (node.count > 0) {
+			for (int k = node.first; k < node.first + node.count; k++) {
+				if (refMin[k].x > queryMax.x || refMax[k].x < queryMin.x
+					|| refMin[k].y > queryMax.y || refMax[k].y < queryMin.y) {
+					continue;
+				}
+				if (found < maxRefs) {
+					out[found] = refs[k];
+				}
+				found++;
+			}
+			continue;
+		}
+		// Median splits keep the tree balanced, so the depth is about log2 of
+		// the primitive count and the stack cannot overflow
+		stack[depth++] = node.first;
+		stack[depth++] = current + 1;
+	}
+	return found;
+}
+
+bool TableGeometry::Separation(int ref, glm::vec2 point, float& distance, glm::vec2& normal) const
+{
+	if (ref >= 0) {
+		const CushionSegment& segment = segments[ref];
+		glm::vec2 along = segment.end - segment.start;
+		float side = glm::dot(segment.normal, point - segment.start);
+		distance = std::fabs(side);
+		normal = side >= 0.0f ? segment.normal : -segment.normal;
+		float u = glm::dot(along, point - segment.start);
+		return u >= 0.0f && u <= glm::dot(along, along);
+	}
+	const CushionArc& arc = arcs[~ref];
+	glm::vec2 offset = point - arc.center;
+	float length = glm::length(offset);
+	glm::vec2 outward = length > 0.0f ? offset / length : glm::vec2(1.0f, 0.0f);
+	distance = std::fabs(length - arc.radius);
+	normal = length >= arc.radius ? outward : -outward;
+	return length > 0.0f && arc.Contains(offset);
+}
+
+bool TableGeometry::CastCircle(glm::vec2 origin, glm::vec2 direction, float radius, float maxDistance,
+	float& distance, glm::vec2& normal) const
+{
+	glm::vec2 target = origin + direction * maxDistance;
+	glm::vec2 queryMin = glm::min(origin, target) - glm::vec2(radius);
+	glm::vec2 queryMax = glm::max(origin, target) + glm::vec2(radius);
+	const int capacity = 256;
+	int found[capacity];
+	int count = Query(queryMin, queryMax, found, capacity);
+	int total = static_cast<int>(segments.size() + arcs.size());
+	bool everything = count > capacity;
+
+	distance = maxDistance;
+	int hit = 0;
+	bool any = false;
+	for (int k = 0; k < (everything ? total : count); k++) {
+		int ref = everything ? (k < static_cast<int>(segments.size()) ? k : ~(k - static_cast<int>(segments.size()))) : found[k];
+		float t = ref >= 0 ? SegmentHitTime(segments[ref], origin, direction, radius)
+			: ArcHitTime(arcs[~ref], origin, direction, radius);
+		if (t <= distance) {
+			distance = t;
+			hit = ref;
+			any = true;
+		}
+	}
+	if (!any) {
+		return false;
+	}
+
+	// Normal at the contact, facing the moving circle
+	float separation;
+	Separation(hit, origin + direction * distance, separation, normal);
+	return true;
+}
@@ -0,0 +1,89 @@
+#ifndef TABLE_GEOMETRY_CLASS_H
+#define TABLE_GEOMETRY_CLASS_H
+
+#include<vector>
+#include<glm/glm.hpp>
+
+#include"BilliardPhysics.h"
+
+// A circular piece of cushion, such as a rounded pocket jaw. It runs from
+// direction 'from' to direction 'to' (unit vectors from the center), turning
+// counterclockwise in X/Z when sweep > 0. Balls touch it from either side.
+struct CushionArc
+{
+	glm::vec2 center = glm::vec2(0.0f);
+	float radius = 0.0f;
+	glm::vec2 from = glm::vec2(1.0f, 0.0f);
+	glm::vec2 to = glm::vec2(1.0f, 0.0f);
+	float sweep = 0.0f;   // radians
+
+	// Whether the unit direction from the center lies on the arc
+	bool Contains(glm::vec2 direction) const;
+};
+
+// The playing-surface boundary as 2D lines and arcs in the X/Z plane, in a
+// bounding volume hierarchy so a ball only tests the few pieces near its
+// path. BuildFromTriangles slices the table meshes at ball-center height and
+// fits the cross-section with lines and arcs; BuildFromRails is the plain
+// rectangle used when there is no mesh.
+//
+// Lines are two-sided here: their normal only fixes an orientation, the
+// physics turns it toward whichever side the ball is on.
+class TableGeometry
+{
+public:
+	std::vector<CushionSegment> segments;
+	std::vector<CushionArc> arcs;
+
+	void BuildFromRails(const TableSpec& table);
+	// triangles holds three world-space vertices per triangle. Only the part
+	// of the cross-section inside [areaMin, areaMax] (world X/Z) is kept.
+	// False, leaving the geometry empty, when the slice found nothing.
+	bool BuildFromTriangles(const std::vector<glm::vec3>& triangles, float sliceHeight,
+		glm::vec2 areaMin, glm::vec2 areaMax, float tolerance);
+	// Rebuilds the hierarchy after segments or arcs were changed directly
+	void BuildBvh();
+
+	bool IsEmpty() const { return segments.empty() && arcs.empty(); }
+	glm::vec2 GetBoundsMin() const { return boundsMin; }
+	glm::vec2 GetBoundsMax() const { return boundsMax; }
+
+	// Writes up to maxRefs primitives whose boxes overlap [queryMin,
+	// queryMax]: r >= 0 is segments[r], r < 0 is arcs[~r]. Returns the total
+	// number found, which may exceed maxRefs.
+	int Query(glm::vec2 queryMin, glm::vec2 queryMax, int* refs, int maxRefs) const;
+
+	// Distance from point to piece ref and the unit normal from the piece
+	// toward the point. Both are filled in either way; false when the point
+	// lies beside the piece rather than in front of it.
+	bool Separation(int ref, glm::vec2 point, float& distance, glm::vec2& normal) const;
+
+	// Sweeps a circle of the given radius from origin along a unit direction
+	// and reports the first contact, e.g. for an aim line
+	bool CastCircle(glm::vec2 origin, glm::vec2 direction, float radius, float maxDistance,
+		float& distance, glm::vec2& normal) const;
+
+private:
+	// Flat tree: an inner node's first child follows it, 'first' indexes the
+	// second child; a leaf (count > 0) owns refs[first, first + count)
+	struct BvhNode
+	{
+		glm::vec2 boundsMin;
+		glm::vec2 boundsMax;
+		int first;
+		int count;
+	};
+
+	std::vector<BvhNode> nodes;
+	std::vector<int> refs;
+	std::vector<glm::vec2> refMin;   // box of refs[k], in the same order
+	std::vector<glm::vec2> refMax;
+	glm::vec2 boundsMin = glm::vec2(0.0f);
+	glm::vec2 boundsMax = glm::vec2(0.0f);
+
+	void FitChain(const std::vector<glm::vec2>& points, float tolerance);
+	int BuildNode(int begin, int end, std::vector<glm::vec2>& centers,
+		std::vector<glm::vec2>& mins, std::vector<glm::vec2>& maxs);
+};
+
+#endif
@@ -0,0 +1,115 @@
+#include "Tracer.h"
+#include "json.hpp"
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+	struct TraceEvent {
+		const char* name;
+		int64_t beginNs;
+		int64_t durationNs;
+	};
+
+	// One buffer per recording thread; the lock is only contended while a trace is being written
+	struct ThreadBuffer {
+		uint32_t threadId = 0;
+		std::mutex mutex;
+		std::vector<TraceEvent> events;
+	};
+
+	std::mutex registryMutex;
+	std::vector<std::shared_ptr<ThreadBuffer>> registry;
+	thread_local std::shared_ptr<ThreadBuffer> localBuffer;
+
+	const std::chrono::steady_clock::time_point traceEpoch = std::chrono::steady_clock::now();
+
+	ThreadBuffer& GetLocalBuffer()
+	{
+		if (!localBuffer) {
+			localBuffer = std::make_shared<ThreadBuffer>();
+			localBuffer->events.reserve(1024);
+
+			std::lock_guard<std::mutex> lock(registryMutex);
+			localBuffer->threadId = static_cast<uint32_t>(registry.size() + 1);
+			registry.push_back(localBuffer);
+		}
+		return *localBuffer;
+	}
+}
+
+std::atomic<bool> Tracer::enabled(false);
+
+void Tracer::Enable(bool enable)
+{
+	enabled.store(enable, std::memory_order_relaxed);
+}
+
+int64_t Tracer::NowNs()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now() - traceEpoch).count();
+}
+
+void Tracer::Record(const char* name, int64_t beginNs, int64_t endNs)
+{
+	ThreadBuffer& buffer = GetLocalBuffer();
+	std::lock_guard<std::mutex> lock(buffer.mutex);
+	buffer.events.push_back({ name, beginNs, endNs - beginNs });
+}
+
+void Tracer::Clear()
+{
+	std::lock_guard<std::mutex> lock(registryMutex);
+	for (auto& buffer : registry) {
+		std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+		buffer->events.clear();
+	}
+}
+
+bool Tracer::WriteChromeTrace(const std::string& path)
+{
+	nlohmann::json events = nlohmann::json::array();
+	size_t eventCount = 0;
+
+	{
+		std::lock_guard<std::mutex> lock(registryMutex);
+		for (auto& buffer : registry) {
+			std::lock_guard<std::mutex> bufferLock(buffer->mutex);
+
+			events.push_back({
+				{ "name", "thread_name" }, { "ph", "M" }, { "pid", 1 }, { "tid", buffer->threadId },
+				{ "args", { { "name", buffer->threadId == 1 ? std::string("main") : "worker " + std::to_string(buffer->threadId) } } }
+			});
+
+			for (const auto& event : buffer->events) {
+				// trace_event timestamps are in microseconds
+				events.push_back({
+					{ "name", event.name }, { "cat", "load" }, { "ph", "X" },
+					{ "ts", event.beginNs / 1000.0 }, { "dur", event.durationNs / 1000.0 },
+					{ "pid", 1 }, { "tid", buffer->threadId }
+				});
+			}
+			eventCount += buffer->events.size();
+		}
+	}
+
+	nlohmann::json trace = {
+		{ "traceEvents", events },
+		{ "displayTimeUnit", "ms" }
+	};
+
+	std::ofstream out(path);
+	if (!out) {
+		std::cout << "[TRACE DEBUG] Failed to open trace file: " << path << std::endl;
+		return false;
+	}
+	out << trace.dump();
+
+	std::cout << "[TRACE DEBUG] Wrote " << eventCount << " trace events to " << path << std::endl;
+	return true;
+}
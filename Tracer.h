@@ -0,0 +1,60 @@
+#ifndef TRACER_CLASS_H
+#define TRACER_CLASS_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Scoped, thread-aware trace zones written out as Chrome trace_event JSON
+// (opens in Perfetto or about:tracing). When tracing is disabled a zone costs
+// a single relaxed atomic load.
+class Tracer
+{
+public:
+	static void Enable(bool enable);
+	static bool IsEnabled() { return enabled.load(std::memory_order_relaxed); }
+
+	// Writes everything recorded so far; recording continues afterwards
+	static bool WriteChromeTrace(const std::string& path);
+	static void Clear();
+
+	// Records one complete event on the calling thread's buffer
+	static void Record(const char* name, int64_t beginNs, int64_t endNs);
+	static int64_t NowNs();
+
+private:
+	static std::atomic<bool> enabled;
+};
+
+class TraceZone
+{
+public:
+	explicit TraceZone(const char* name)
+		: name(name), beginNs(Tracer::IsEnabled() ? Tracer::NowNs() : -1) {}
+
+	~TraceZone()
+	{
+		if (beginNs >= 0) {
+			Tracer::Record(name, beginNs, Tracer::NowNs());
+		}
+	}
+
+	TraceZone(const TraceZone&) = delete;
+	TraceZone& operator=(const TraceZone&) = delete;
+
+private:
+	const char* name;
+	int64_t beginNs;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+
+// name must be a string literal (or otherwise outlive the trace)
+#ifdef DISABLE_TRACING
+#define TRACE_ZONE(name)
+#else
+#define TRACE_ZONE(name) TraceZone TRACE_CONCAT(traceZone_, __LINE__)(name)
+#endif
+
+#endif
@@ -0,0 +1,284 @@
+#include"TriangleBvh.h"
+#include"SimdLanes.h"
+#include<algorithm>
+#include<limits>
+
+namespace
+{
+	float SurfaceArea(glm::vec3 boundsMin, glm::vec3 boundsMax)
+	{
+		glm::vec3 size = glm::max(boundsMax - boundsMin, glm::vec3(0.0f));
+		return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+	}
+
+	// Entry distance of the ray into the box, or infinity when it misses
+	float RayBox(glm::vec3 origin, glm::vec3 inverseDirection, glm::vec3 boundsMin, glm::vec3 boundsMax, float maxDistance)
+	{
+		glm::vec3 t0 = (boundsMin - origin) * inverseDirection;
+		glm::vec3 t1 = (boundsMax - origin) * inverseDirection;
+		glm::vec3 tNear = glm::min(t0, t1);
+		glm::vec3 tFar = glm::max(t0, t1);
+		float entry = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+		float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, maxDistance));
+		return entry <= exit ? entry : std::numeric_limits<float>::infinity();
+	}
+}
+
+void TriangleBvh::Build(const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& triangles)
+{
+	nodes.clear();
+	blocks.clear();
+
+	std::vector<BuildTriangle> build;
+	build.reserve(triangles.size() / 3);
+	for (size_t i = 0; i + 2 < triangles.size(); i += 3) {
+		if (triangles[i] >= positions.size() || triangles[i + 1] >= positions.size() || triangles[i + 2] >= positions.size()) {
+			continue;
+		}
+		glm::vec3 a = positions[triangles[i]];
+		glm::vec3 b = positions[triangles[i + 1]];
+		glm::vec3 c = positions[triangles[i + 2]];
+		BuildTriangle triangle;
+		triangle.boundsMin = glm::min(a, glm::min(b, c));
+		triangle.boundsMax = glm::max(a, glm::max(b, c));
+		triangle.centroid = (a + b + c) / 3.0f;
+		triangle.index = static_cast<int>(i / 3);
+		build.push_back(triangle);
+	}
+	if (build.empty()) {
+		return;
+	}
+
+	int count = static_cast<int>(build.size());
+	nodes.reserve(2 * static_cast<size_t>(count) / LEAF_TRIANGLES + 2);
+	blocks.reserve(static_cast<size_t>(count) / (LEAF_TRIANGLES / 2) + 1);
+	nodes.push_back(BvhNode());
+	Subdivide(build, 0, 0, count, 1, positions, triangles);
+}
+
+void TriangleBvh::Subdivide(std::vector<BuildTriangle>& build, int nodeIndex, int first, int count, int depth,
+	const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& triangles)
+{
+	glm::vec3 boundsMin(std::numeric_limits<float>::max());
+	glm::vec3 boundsMax(-std::numeric_limits<float>::max());
+	glm::vec3 centroidMin(std::numeric_limits<float>::max());
+	glm::vec3 centroidMax(-std::numeric_limits<float>::max());
+	for (int i = first; i < first + count; i++) {
+		boundsMin = glm::min(boundsMin, build[i].boundsMin);
+		boundsMax = glm::max(boundsMax, build[i].boundsMax);
+		centroidMin = glm::min(centroidMin, build[i].centroid);
+		centroidMax = glm::max(centroidMax, build[i].centroid);
+	}
+	nodes[nodeIndex].boundsMin = boundsMin;
+	nodes[nodeIndex].boundsMax = boundsMax;
+
+	if (count <= LEAF_TRIANGLES) {
+		TriangleBlock block = {};
+		for (int lane = 0; lane < LEAF_TRIANGLES; lane++) {
+			block.triangle[lane] = -1;
+		}
+		for (int lane = 0; lane < count; lane++) {
+			int triangle = build[first + lane].index;
+			glm::vec3 v0 = positions[triangles[3 * triangle]];
+			glm::vec3 e1 = positions[triangles[3 * triangle + 1]] - v0;
+			glm::vec3 e2 = positions[triangles[3 * triangle + 2]] - v0;
+			block.v0x[lane] = v0.x;
+			block.v0y[lane] = v0.y;
+			block.v0z[lane] = v0.z;
+			block.e1x[lane] = e1.x;
+			block.e1y[lane] = e1.y;
+			block.e1z[lane] = e1.z;
+			block.e2x[lane] = e2.x;
+			block.e2y[lane] = e2.y;
+			block.e2z[lane] = e2.z;
+			block.triangle[lane] = triangle;
+		}
+		nodes[nodeIndex].first = static_cast<int>(blocks.size());
+		nodes[nodeIndex].count = count;
+		blocks.push_back(block);
+		return;
+	}
+
+	// Binned SAH over the centroids; past MAX_DEPTH, or when every centroid
+	// coincides, the triangles are halved by centroid instead
+	float bestCost = std::numeric_limits<float>::max();
+	int bestAxis = -1;
+	int bestSplit = 0;
+	for (int axis = 0; axis < 3 && depth < MAX_DEPTH; axis++) {
+		float extent = centroidMax[axis] - centroidMin[axis];
+		if (extent <= 0.0f) {
+			continue;
+		}
+		float scale = BIN_COUNT / extent;
+		glm::vec3 binMin[BIN_COUNT];
+		glm::vec3 binMax[BIN_COUNT];
+		int binCount[BIN_COUNT] = {};
+		for (int b = 0; b < BIN_COUNT; b++) {
+			binMin[b] = glm::vec3(std::numeric_limits<float>::max());
+			binMax[b] = glm::vec3(-std::numeric_limits<float>::max());
+		}
+		for (int i = first; i < first + count; i++) {
+			int bin = std::min(static_cast<int>((build[i].centroid[axis] - centroidMin[axis]) * scale), BIN_COUNT - 1);
+			binMin[bin] = glm::min(binMin[bin], build[i].boundsMin);
+			binMax[bin] = glm::max(binMax[bin], build[i].boundsMax);
+			binCount[bin]++;
+		}
+		float rightArea[BIN_COUNT];
+		int rightCount[BIN_COUNT];
+		glm::vec3 sweepMin(std::numeric_limits<float>::max());
+		glm::vec3 sweepMax(-std::numeric_limits<float>::max());
+		int sweepCount = 0;
+		for (int b = BIN_COUNT - 1; b > 0; b--) {
+			sweepMin = glm::min(sweepMin, binMin[b]);
+			sweepMax = glm::max(sweepMax, binMax[b]);
+			sweepCount += binCount[b];
+			rightArea[b] = SurfaceArea(sweepMin, sweepMax);
+			rightCount[b] = sweepCount;
+		}
+		sweepMin = glm::vec3(std::numeric_limits<float>::max());
+		sweepMax = glm::vec3(-std::numeric_limits<float>::max());
+		sweepCount = 0;
+		for (int b = 0; b < BIN_COUNT - 1; b++) {
+			sweepMin = glm::min(sweepMin, binMin[b]);
+			sweepMax = glm::max(sweepMax, binMax[b]);
+			sweepCount += binCount[b];
+			if (sweepCount == 0 || rightCount[b + 1] == 0) {
+				continue;
+			}
+			float cost = SurfaceArea(sweepMin, sweepMax) * sweepCount + rightArea[b + 1] * rightCount[b + 1];
+			if (cost < bestCost) {
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplit = b + 1;
+			}
+		}
+	}
+
+	auto begin = build.begin() + first;
+	auto end = begin + count;
+	auto middle = begin + count / 2;
+	if (bestAxis >= 0) {
+		float scale = BIN_COUNT / (centroidMax[bestAxis] - centroidMin[bestAxis]);
+		middle = std::partition(begin, end, [&](const BuildTriangle& triangle) {
+			return std::min(static_cast<int>((triangle.centroid[bestAxis] - centroidMin[bestAxis]) * scale), BIN_COUNT - 1) < bestSplit;
+		});
+	}
+	if (bestAxis < 0 || middle == begin || middle == end) {
+		glm::vec3 extent = centroidMax - centroidMin;
+		int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+		middle = begin + count / 2;
+		std::nth_element(begin, middle, end, [axis](const BuildTriangle& a, const BuildTriangle& b) {
+			return a.centroid[axis] < b.centroid[axis];
+		});
+	}
+	int leftCount = static_cast<int>(middle - begin);
+
+	int left = static_cast<int>(nodes.size());
+	nodes.push_back(BvhNode());
+	nodes.push_back(BvhNode());
+	nodes[nodeIndex].first = left;
+	nodes[nodeIndex].count = 0;
+	Subdivide(build, left, first, leftCount, depth + 1, positions, triangles);
+	Subdivide(build, left + 1, first + leftCount, count - leftCount, depth + 1, positions, triangles);
+}
+
+bool TriangleBvh::Raycast(glm::vec3 origin, glm::vec3 direction, float maxDistance, TriangleHit& hit) const
+{
+	if (nodes.empty()) {
+		return false;
+	}
+	const float miss = std::numeric_limits<float>::infinity();
+	glm::vec3 inverseDirection = 1.0f / direction;
+	TriangleHit best;
+	best.distance = maxDistance;
+
+	// Median splits past MAX_DEPTH halve the triangles, so the tree stays
+	// well inside this many levels for any mesh that fits in memory
+	int stack[2 * (MAX_DEPTH + 32)];
+	int top = 0;
+	if (RayBox(origin, inverseDirection, nodes[0].boundsMin, nodes[0].boundsMax, best.distance) != miss) {
+		stack[top++] = 0;
+	}
+	while (top > 0) {
+		const BvhNode& node = nodes[stack[--top]];
+		if (node.count > 0) {
+			IntersectBlock(blocks[node.first], origin, direction, best);
+			continue;
+		}
+		const BvhNode& left = nodes[node.first];
+		const BvhNode& right = nodes[node.first + 1];
+		float leftDistance = RayBox(origin, inverseDirection, left.boundsMin, left.boundsMax, best.distance);
+		float rightDistance = RayBox(origin, inverseDirection, right.boundsMin, right.boundsMax, best.distance);
+		bool leftFirst = leftDistance <= rightDistance;
+		float nearDistance = leftFirst ? leftDistance : rightDistance;
+		float farDistance = leftFirst ? rightDistance : leftDistance;
+		if (farDistance != miss) {
+			stack[top++] = leftFirst ? node.first + 1 : node.first;
+		}
+		if (nearDistance != miss) {
+			stack[top++] = leftFirst ? node.first : node.first + 1;
+		}
+	}
+
+	if (best.triangle < 0) {
+		return false;
+	}
+	hit = best;
+	return true;
+}
+
+void TriangleBvh::IntersectBlock(const TriangleBlock& block, glm::vec3 origin, glm::vec3 direction, TriangleHit& hit) const
+{
+	const Lanes zero = Lanes::Set(0.0f);
+	const Lanes one = Lanes::Set(1.0f);
+	const Lanes dx = Lanes::Set(direction.x);
+	const Lanes dy = Lanes::Set(direction.y);
+	const Lanes dz = Lanes::Set(direction.z);
+	for (int offset = 0; offset < LEAF_TRIANGLES; offset += LANE_WIDTH) {
+		Lanes e1x = Lanes::Load(block.e1x + offset);
+		Lanes e1y = Lanes::Load(block.e1y + offset);
+		Lanes e1z = Lanes::Load(block.e1z + offset);
+		Lanes e2x = Lanes::Load(block.e2x + offset);
+		Lanes e2y = Lanes::Load(block.e2y + offset);
+		Lanes e2z = Lanes::Load(block.e2z + offset);
+
+		// Moller-Trumbore: p = d x e2, det = e1 . p
+		Lanes px = dy * e2z - dz * e2y;
+		Lanes py = dz * e2x - dx * e2z;
+		Lanes pz = dx * e2y - dy * e2x;
+		Lanes det = e1x * px + e1y * py + e1z * pz;
+		Lanes inverseDet = one / det;
+
+		Lanes sx = Lanes::Set(origin.x) - Lanes::Load(block.v0x + offset);
+		Lanes sy = Lanes::Set(origin.y) - Lanes::Load(block.v0y + offset);
+		Lanes sz = Lanes::Set(origin.z) - Lanes::Load(block.v0z + offset);
+		Lanes u = (sx * px + sy * py + sz * pz) * inverseDet;
+
+		Lanes qx = sy * e1z - sz * e1y;
+		Lanes qy = sz * e1x - sx * e1z;
+		Lanes qz = sx * e1y - sy * e1x;
+		Lanes v = (dx * qx + dy * qy + dz * qz) * inverseDet;
+		Lanes t = (e2x * qx + e2y * qy + e2z * qz) * inverseDet;
+
+		// Degenerate (padding) lanes have det 0; their NaNs fail every compare
+		LaneMask hits = (Abs(det) > zero) & (u >= zero) & (v >= zero) & (u + v <= one) & (t > zero) & (t < Lanes::Set(hit.distance));
+		int bits = MoveMask(hits);
+		if (bits == 0) {
+			continue;
+		}
+		alignas(32) float distances[LEAF_TRIANGLES];
+		alignas(32) float us[LEAF_TRIANGLES];
+		alignas(32) float vs[LEAF_TRIANGLES];
+		t.Store(distances);
+		u.Store(us);
+		v.Store(vs);
+		for (int lane = 0; lane < LANE_WIDTH; lane++) {
+			if ((bits >> lane) & 1 && distances[lane] < hit.distance) {
+				hit.distance = distances[lane];
+				hit.u = us[lane];
+				hit.v = vs[lane];
+				hit.triangle = block.triangle[offset + lane];
+			}
+		}
+	}
+}
@@ -0,0 +1,73 @@
+#ifndef TRIANGLE_BVH_CLASS_H
+#define TRIANGLE_BVH_CLASS_H
+
+#include<vector>
+#include<glm/glm.hpp>
+
+struct TriangleHit
+{
+	int triangle = -1;      // index into the mesh's triangle list, i.e. triangles[3 * triangle]
+	float distance = 0.0f;  // ray parameter: hit point = origin + distance * direction
+	float u = 0.0f;         // barycentrics of the hit, towards the second and third vertex
+	float v = 0.0f;
+};
+
+// Bounding volume hierarchy over the triangles of one mesh, in the mesh's
+// local space, built at load for ray picking. Leaves hold up to eight
+// triangles, stored as one block of vertex and edge arrays so a leaf is
+// tested with LANE_WIDTH-wide Moller-Trumbore intersections instead of one
+// triangle at a time.
+class TriangleBvh
+{
+public:
+	static const int LEAF_TRIANGLES = 8;
+	static const int BIN_COUNT = 12;
+	static const int MAX_DEPTH = 40;
+
+	// triangles holds three indices into positions per triangle
+	void Build(const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& triangles);
+	bool IsEmpty() const { return nodes.empty(); }
+	int GetNodeCount() const { return static_cast<int>(nodes.size()); }
+
+	// Nearest hit with distance in (0, maxDistance); direction need not be normalized
+	bool Raycast(glm::vec3 origin, glm::vec3 direction, float maxDistance, TriangleHit& hit) const;
+
+private:
+	// A leaf has count triangles in block first; an inner node has count 0
+	// and its children at first and first + 1
+	struct BvhNode
+	{
+		glm::vec3 boundsMin;
+		int first;
+		glm::vec3 boundsMax;
+		int count;
+	};
+
+	// Up to LEAF_TRIANGLES triangles as structure of arrays; unused lanes
+	// are degenerate and never hit
+	struct alignas(32) TriangleBlock
+	{
+		float v0x[LEAF_TRIANGLES], v0y[LEAF_TRIANGLES], v0z[LEAF_TRIANGLES];
+		float e1x[LEAF_TRIANGLES], e1y[LEAF_TRIANGLES], e1z[LEAF_TRIANGLES];
+		float e2x[LEAF_TRIANGLES], e2y[LEAF_TRIANGLES], e2z[LEAF_TRIANGLES];
+		int triangle[LEAF_TRIANGLES];
+	};
+
+	struct BuildTriangle
+	{
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+		glm::vec3 centroid;
+		int index;
+	};
+
+	std::vector<BvhNode> nodes;
+	std::vector<TriangleBlock> blocks;
+
+	void Subdivide(std::vector<BuildTriangle>& build, int nodeIndex, int first, int count, int depth,
+		const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& triangles);
+	// Nearest hit among the block's triangles closer than hit.distance
+	void IntersectBlock(const TriangleBlock& block, glm::vec3 origin, glm::vec3 direction, TriangleHit& hit) const;
+};
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef TRIPLE_BUFFER_CLASS_H
+#define TRIPLE_BUFFER_CLASS_H
+
+#include<atomic>
+#include<cstdint>
+
+// Lock-free handoff of the newest value from one writer thread to one
+// reader thread. Writer and reader each own a slot; the third sits in the
+// middle. Publish swaps the written slot into the middle, Acquire swaps the
+// middle out when it holds something newer, so neither side ever waits and
+// the reader always gets the latest complete value (older ones are
+// dropped, not queued).
+template<class T>
+class TripleBuffer
+{
+public:
+	// Writer side: fill this slot, then Publish it
+	T& WriteSlot() { return slots[writeIndex]; }
+	void Publish()
+	{
+		writeIndex = middle.exchange(static_cast<uint8_t>(writeIndex | FRESH), std::memory_order_acq_rel) & INDEX_MASK;
+	}
+
+	// Reader side: true when a newer value replaced ReadSlot()
+	bool Acquire()
+	{
+		if ((middle.load(std::memory_order_relaxed) & FRESH) == 0) {
+			return false;
+		}
+		readIndex = middle.exchange(readIndex, std::memory_order_acq_rel) & INDEX_MASK;
+		return true;
+	}
+	const T& ReadSlot() const { return slots[readIndex]; }
+
+private:
+	static const uint8_t INDEX_MASK = 0x3;
+	static const uint8_t FRESH = 0x4;   // the middle slot was published and not yet acquired
+
+	T slots[3];
+	alignas(64) std::atomic<uint8_t> middle{ 1 };
+	alignas(64) uint8_t writeIndex = 0;
+	alignas(64) uint8_t readIndex = 2;
+};
+
+#endif
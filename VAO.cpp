@@ -1,34 +1,36 @@
 #include"VAO.h"
+#include"RenderDevice.h"
 
 // Constructor that generates a VAO ID
 VAO::VAO()
 {
-	glGenVertexArrays(1, &ID);
+	ID = RenderDevice::Get().GenVertexArray();
 }
 
 // Links a VBO Attribute such as a position or color to the VAO
 void VAO::LinkAttrib(VBO& VBO, GLuint layout, GLuint numComponents, GLenum type, GLsizeiptr stride, void* offset)
 {
+	RenderDevice& device = RenderDevice::Get();
 	VBO.Bind();
-	glVertexAttribPointer(layout, numComponents, type, GL_FALSE, stride, offset);
-	glEnableVertexAttribArray(layout);
+	device.VertexAttribPointer(layout, numComponents, type, GL_FALSE, stride, offset);
+	device.EnableVertexAttribArray(layout);
 	VBO.Unbind();
 }
 
 // Binds the VAO
 void VAO::Bind()
 {
-	glBindVertexArray(ID);
+	RenderDevice::Get().BindVertexArray(ID);
 }
 
 // Unbinds the VAO
 void VAO::Unbind()
 {
-	glBindVertexArray(0);
+	RenderDevice::Get().BindVertexArray(0);
 }
 
 // Deletes the VAO
 void VAO::Delete()
 {
-	glDeleteVertexArrays(1, &ID);
+	RenderDevice::Get().DeleteVertexArray(ID);
 }
\ No newline at end of file
@@ -1,28 +1,32 @@
 #include"VBO.h"
+#include"Tracer.h"
+#include"RenderDevice.h"
 
 // Constructor that generates a Vertex Buffer Object and links it to vertices
 VBO::VBO(GLfloat* vertices, GLsizeiptr size)
 {
+	TRACE_ZONE("glBufferData VBO");
 	this->size = size;
-	glGenBuffers(1, &ID);
-	glBindBuffer(GL_ARRAY_BUFFER, ID);
-	glBufferData(GL_ARRAY_BUFFER, size, vertices, GL_STATIC_DRAW);
+	RenderDevice& device = RenderDevice::Get();
+	ID = device.GenBuffer();
+	device.BindBuffer(GL_ARRAY_BUFFER, ID);
+	device.BufferData(GL_ARRAY_BUFFER, size, vertices, GL_STATIC_DRAW);
 }
 
 // Binds the VBO
 void VBO::Bind()
 {
-	glBindBuffer(GL_ARRAY_BUFFER, ID);
+	RenderDevice::Get().BindBuffer(GL_ARRAY_BUFFER, ID);
 }
 
 // Unbinds the VBO
 void VBO::Unbind()
 {
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	RenderDevice::Get().BindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
 // Deletes the VBO
 void VBO::Delete()
 {
-	glDeleteBuffers(1, &ID);
+	RenderDevice::Get().DeleteBuffer(ID);
 }
\ No newline at end of file
@@ -3,24 +3,99 @@
 in vec3 Normal;
 in vec3 FragPos;
 in vec2 TexCoord;
+in vec4 LightSpacePos;
 
 out vec4 FragColor;
 
-uniform bool enableGrayscale;
-uniform bool enableRainbowLight; // <-- NOWE
-uniform float time;              // <-- NOWE
+// Variants: TEXTURED, GRAYSCALE, RAINBOW_LIGHT (see ShaderFeature)
+#if defined(RAINBOW_LIGHT) && !defined(GRAYSCALE)
+uniform float time;
+#endif
 
 uniform vec3 camPos;
-uniform vec4 baseColor;
 uniform vec3 lightPos;
 uniform vec3 lightColor;
 
+#ifdef TEXTURED
 uniform sampler2D texture_diffuse1;
-uniform int hasTexture;
+#else
+uniform vec4 baseColor;
+#endif
+uniform float highlight;         // 1 for the mesh under the cursor
+
+// Shadow of the lamp: static geometry and the moving balls in two depth maps
+uniform sampler2DShadow staticShadowMap;
+uniform sampler2DShadow dynamicShadowMap;
+uniform int shadowQuality;       // 0 off, 1 hard, 2 PCF 3x3, 3 PCF 5x5
+
+float ShadowTap(vec3 coord, vec2 offset)
+{
+    vec3 tap = vec3(coord.xy + offset, coord.z);
+    return min(texture(staticShadowMap, tap), texture(dynamicShadowMap, tap));
+}
+
+// 1 lit, 0 in shadow; outside the light's frustum everything is lit
+float Shadow()
+{
+    if (shadowQuality == 0 || LightSpacePos.w <= 0.0)
+        return 1.0;
+    vec3 coord = LightSpacePos.xyz / LightSpacePos.w * 0.5 + 0.5;
+    if (any(lessThan(coord, vec3(0.0))) || any(greaterThan(coord, vec3(1.0))))
+        return 1.0;
+    if (shadowQuality == 1)
+        return ShadowTap(coord, vec2(0.0));
+
+    int radius = shadowQuality == 2 ? 1 : 2;
+    vec2 texel = 1.0 / vec2(textureSize(staticShadowMap, 0));
+    float lit = 0.0;
+    for (int y = -radius; y <= radius; y++)
+        for (int x = -radius; x <= radius; x++)
+            lit += ShadowTap(coord, vec2(x, y) * texel);
+    return lit / float((2 * radius + 1) * (2 * radius + 1));
+}
+
+// Lamps of the hall, listed per view space cluster by LightClusters
+uniform samplerBuffer clusterLights;    // position and radius, then color, per light
+uniform usamplerBuffer clusterRanges;   // first index and count per cluster
+uniform usamplerBuffer clusterIndices;
+uniform vec3 clusterCounts;             // tiles across, tiles up, depth slices
+uniform vec3 clusterScale;              // tiles per pixel in x and y, slices per log of depth
+uniform float clusterBias;
+uniform vec4 clusterDepthRow;           // view depth of a world position
+
+// Diffuse and specular of the lights in this fragment's cluster
+vec3 ClusterLighting(vec3 normal, vec3 viewDirection)
+{
+    ivec3 counts = ivec3(clusterCounts);
+    float depth = max(dot(clusterDepthRow, vec4(FragPos, 1.0)), 1e-4);
+    vec3 cell = vec3(gl_FragCoord.xy * clusterScale.xy, log(depth) * clusterScale.z + clusterBias);
+    ivec3 cluster = clamp(ivec3(cell), ivec3(0), counts - 1);
+    uvec2 range = texelFetch(clusterRanges, (cluster.z * counts.y + cluster.y) * counts.x + cluster.x).rg;
+
+    vec3 sum = vec3(0.0);
+    for (uint i = 0u; i < range.y; i++) {
+        int light = int(texelFetch(clusterIndices, int(range.x + i)).r);
+        vec4 positionRadius = texelFetch(clusterLights, light * 2);
+        vec3 toLight = positionRadius.xyz - FragPos;
+        float distanceSq = dot(toLight, toLight);
+        float falloff = clamp(1.0 - distanceSq / (positionRadius.w * positionRadius.w), 0.0, 1.0);
+        if (falloff <= 0.0)
+            continue;
+        vec3 direction = toLight * inversesqrt(distanceSq);
+        float diffuse = max(dot(normal, direction), 0.0);
+        float specular = pow(max(dot(viewDirection, reflect(-direction, normal)), 0.0), 8);
+        sum += texelFetch(clusterLights, light * 2 + 1).rgb * (falloff * falloff) * (diffuse + specular);
+    }
+    return sum;
+}
 
 void main()
 {
-    vec3 color = hasTexture == 1 ? texture(texture_diffuse1, TexCoord).rgb : baseColor.rgb;
+#ifdef TEXTURED
+    vec3 color = texture(texture_diffuse1, TexCoord).rgb;
+#else
+    vec3 color = baseColor.rgb;
+#endif
 
     // AMBIENT
     float ambient = 0.2f;
@@ -38,22 +113,24 @@ void main()
     float specular = spec * specularStrength;
 
     // RAINBOW LIGHT COLOR
+#if defined(RAINBOW_LIGHT) && !defined(GRAYSCALE)
+    vec3 finalLightColor = vec3(
+        sin(time * 1.0) * 0.4 + 0.5,
+        sin(time * 1.0 + 2.094) * 0.4 + 0.5,
+        sin(time * 1.0 + 4.188) * 0.4 + 0.5
+    );
+#else
     vec3 finalLightColor = lightColor;
-    if (enableRainbowLight && !enableGrayscale) {
-        finalLightColor = vec3(
-            sin(time * 1.0) * 0.4 + 0.5,
-            sin(time * 1.0 + 2.094) * 0.4 + 0.5,
-            sin(time * 1.0 + 4.188) * 0.4 + 0.5
-        );
-    }
+#endif
 
-    float lighting = ambient + diffuse + specular;
-    vec3 result = color * finalLightColor * lighting;
+    float lighting = ambient + Shadow() * (diffuse + specular);
+    vec3 result = color * (finalLightColor * lighting + ClusterLighting(normal, viewDirection));
+    result = mix(result, vec3(1.0, 0.85, 0.3), highlight * 0.35);
 
-    if (enableGrayscale) {
-        float gray = dot(result, vec3(0.299, 0.587, 0.114));
-        result = vec3(gray);
-    }
+#ifdef GRAYSCALE
+    float gray = dot(result, vec3(0.299, 0.587, 0.114));
+    result = vec3(gray);
+#endif
 
     FragColor = vec4(result, 1.0);
 }
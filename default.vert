@@ -6,15 +6,18 @@ layout (location = 2) in vec2 aTexCoord;
 
 uniform mat4 modelMatrix;
 uniform mat4 camMatrix;
+uniform mat4 lightMatrix;
 
 out vec3 Normal;
 out vec3 FragPos;
 out vec2 TexCoord;
+out vec4 LightSpacePos;
 
 void main()
 {
     FragPos = vec3(modelMatrix * vec4(aPos, 1.0));
     Normal = mat3(transpose(inverse(modelMatrix))) * aNormal;
     TexCoord = aTexCoord;
+    LightSpacePos = lightMatrix * vec4(FragPos, 1.0);
     gl_Position = camMatrix * modelMatrix * vec4(aPos, 1.0);
 }
\ No newline at end of file
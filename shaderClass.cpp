@@ -1,4 +1,9 @@
 #include"shaderClass.h"
+#include"ShaderCompileThread.h"
+#include"Tracer.h"
+#include<algorithm>
+#include<chrono>
+#include<cstring>
 
 std::string get_file_contents(const char* filename)
 {
@@ -16,50 +21,450 @@ std::string get_file_contents(const char* filename)
 	throw(errno);
 }
 
+namespace
+{
+	const char* featureNames[SHADER_FEATURE_COUNT] = { "TEXTURED", "GRAYSCALE", "RAINBOW_LIGHT" };
+
+	// The shaders define RAINBOW only without GRAYSCALE, so a mask with both
+	// builds the same program as GRAYSCALE alone
+	uint32_t NormalizeFeatures(uint32_t features)
+	{
+		return features & SHADER_GRAYSCALE ? features & ~static_cast<uint32_t>(SHADER_RAINBOW_LIGHT) : features;
+	}
+
+	// The defines go right after the #version line, which must stay first
+	std::string InsertDefines(const std::string& source, const std::string& defines)
+	{
+		size_t version = source.find("#version");
+		size_t lineEnd = version == std::string::npos ? std::string::npos : source.find('\n', version);
+		if (lineEnd == std::string::npos) {
+			return defines + source;
+		}
+		return source.substr(0, lineEnd + 1) + defines + source.substr(lineEnd + 1);
+	}
+
+	// The driver's messages without the trailing line break, empty when it had none
+	std::string TrimLog(std::string log)
+	{
+		log.resize(std::strlen(log.c_str()));
+		while (!log.empty() && (log.back() == '\n' || log.back() == '\r' || log.back() == ' ')) {
+			log.pop_back();
+		}
+		return log;
+	}
+
+	double MillisecondsSince(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	// False on a compile error; the driver's messages are printed either way
+	bool StageStatus(RenderDevice& device, GLuint shader, const char* stage, const std::string& label)
+	{
+		GLint status = GL_FALSE, logLength = 0;
+		device.GetShaderiv(shader, GL_COMPILE_STATUS, &status);
+		device.GetShaderiv(shader, GL_INFO_LOG_LENGTH, &logLength);
+		std::string log;
+		if (logLength > 1) {
+			log.resize(logLength);
+			device.GetShaderInfoLog(shader, logLength, &log[0]);
+			log = TrimLog(log);
+		}
+		if (status != GL_TRUE) {
+			std::cout << "[SHADER] " << label << ": " << stage << " shader failed to compile:\n" << log << std::endl;
+		} else if (!log.empty()) {
+			std::cout << "[SHADER] " << label << ": " << stage << " shader log:\n" << log << std::endl;
+		}
+		return status == GL_TRUE;
+	}
+}
+
+ProgramCache* Shader::programCache = nullptr;
+ShaderCompileThread* Shader::compileThread = nullptr;
+ShaderCompileStats Shader::compileStats;
+GLuint Shader::boundProgram = 0;
+
+void ProgramBuild::Issue(RenderDevice& device)
+{
+	vertexShader = device.CreateShader(GL_VERTEX_SHADER);
+	device.ShaderSource(vertexShader, vertexSource.c_str());
+	device.CompileShader(vertexShader);
+
+	fragmentShader = device.CreateShader(GL_FRAGMENT_SHADER);
+	device.ShaderSource(fragmentShader, fragmentSource.c_str());
+	device.CompileShader(fragmentShader);
+
+	program = device.CreateProgram();
+	if (retrievable) {
+		device.ProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+	device.AttachShader(program, vertexShader);
+	device.AttachShader(program, fragmentShader);
+	device.LinkProgram(program);
+}
+
+bool ProgramBuild::IsComplete(RenderDevice& device) const
+{
+	GLint complete = GL_TRUE;
+	device.GetProgramiv(program, GL_COMPLETION_STATUS_KHR, &complete);
+	return complete == GL_TRUE;
+}
+
+void ProgramBuild::Finish(RenderDevice& device)
+{
+	bool compiled = StageStatus(device, vertexShader, "vertex", label);
+	compiled = StageStatus(device, fragmentShader, "fragment", label) && compiled;
+
+	GLint linked = GL_FALSE, logLength = 0;
+	device.GetProgramiv(program, GL_LINK_STATUS, &linked);
+	device.GetProgramiv(program, GL_INFO_LOG_LENGTH, &logLength);
+	std::string log;
+	if (logLength > 1) {
+		log.resize(logLength);
+		device.GetProgramInfoLog(program, logLength, &log[0]);
+		log = TrimLog(log);
+	}
+	if (linked != GL_TRUE) {
+		std::cout << "[SHADER] " << label << " failed to link:\n" << log << std::endl;
+	} else if (!log.empty()) {
+		std::cout << "[SHADER] " << label << " link log:\n" << log << std::endl;
+	}
+
+	// Attached shaders go with the program
+	device.DeleteShader(vertexShader);
+	device.DeleteShader(fragmentShader);
+	vertexShader = fragmentShader = 0;
+	succeeded = compiled && linked == GL_TRUE;
+}
+
 Shader::Shader(const char* vertexFile, const char* fragmentFile)
 {
-	std::string vertexCode = get_file_contents(vertexFile);
-	std::string fragmentCode = get_file_contents(fragmentFile);
+	name = std::string(vertexFile) + " + " + fragmentFile;
+	vertexCode = get_file_contents(vertexFile);
+	fragmentCode = get_file_contents(fragmentFile);
+	Request(0);
+}
+
+Shader::Variant& Shader::Request(uint32_t variantFeatures)
+{
+	variantFeatures = NormalizeFeatures(variantFeatures);
+	auto it = variants.find(variantFeatures);
+	if (it != variants.end()) {
+		return it->second;
+	}
+	Variant& variant = variants[variantFeatures];
+	TRACE_ZONE("Shader request");
+	auto start = std::chrono::steady_clock::now();
 
-	const char* vertexSource = vertexCode.c_str();
-	const char* fragmentSource = fragmentCode.c_str();
+	std::string defines;
+	std::string label = name;
+	for (uint32_t i = 0; i < SHADER_FEATURE_COUNT; i++) {
+		if (variantFeatures & (1u << i)) {
+			defines += std::string("#define ") + featureNames[i] + "\n";
+			label += std::string(label == name ? " (" : " ") + featureNames[i];
+		}
+	}
+	if (label != name) {
+		label += ")";
+	}
+	std::string vertexSource = InsertDefines(vertexCode, defines);
+	std::string fragmentSource = InsertDefines(fragmentCode, defines);
+
+	if (programCache != nullptr && programCache->IsEnabled()) {
+		variant.cacheKey = ProgramCache::Key(vertexSource, fragmentSource);
+		variant.program = programCache->Find(variant.cacheKey);
+		if (variant.program != 0) {
+			double loadMs = MillisecondsSince(start);
+			compileStats.loaded++;
+			compileStats.loadMs += loadMs;
+			compileStats.renderThreadMs += loadMs;
+			return variant;
+		}
+	}
 
-	GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-	glShaderSource(vertexShader, 1, &vertexSource, NULL);
-	glCompileShader(vertexShader);
+	auto build = std::make_shared<ProgramBuild>();
+	build->label = label;
+	build->vertexSource = std::move(vertexSource);
+	build->fragmentSource = std::move(fragmentSource);
+	build->retrievable = variant.cacheKey != 0;
+	build->issued = start;
+	RenderDevice& device = RenderDevice::Get();
+	if (compileThread != nullptr && !device.SupportsParallelShaderCompile()) {
+		compileThread->Submit(build);
+		variant.threaded = true;
+	} else {
+		build->Issue(device);
+	}
+	variant.build = std::move(build);
+	pending++;
+	compileStats.renderThreadMs += MillisecondsSince(start);
+	return variant;
+}
 
-	GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-	glShaderSource(fragmentShader, 1, &fragmentSource, NULL);
-	glCompileShader(fragmentShader);
+bool Shader::Poll(Variant& variant)
+{
+	if (variant.build == nullptr) {
+		return true;
+	}
+	if (variant.threaded) {
+		if (!variant.build->done) {
+			return false;
+		}
+	} else {
+		auto start = std::chrono::steady_clock::now();
+		RenderDevice& device = RenderDevice::Get();
+		bool complete = variant.build->IsComplete(device);
+		if (complete) {
+			variant.build->Finish(device);
+		}
+		compileStats.renderThreadMs += MillisecondsSince(start);
+		if (!complete) {
+			return false;
+		}
+	}
+	Complete(variant);
+	return true;
+}
 
-	ID = glCreateProgram();
-	glAttachShader(ID, vertexShader);
-	glAttachShader(ID, fragmentShader);
-	glLinkProgram(ID);
+void Shader::Wait(Variant& variant)
+{
+	if (variant.build == nullptr) {
+		return;
+	}
+	TRACE_ZONE("Shader wait");
+	auto start = std::chrono::steady_clock::now();
+	if (variant.threaded) {
+		compileThread->Wait(*variant.build);
+	} else {
+		// The status queries wait for the driver
+		variant.build->Finish(RenderDevice::Get());
+	}
+	compileStats.renderThreadMs += MillisecondsSince(start);
+	Complete(variant);
+}
 
-	glDeleteShader(vertexShader);
-	glDeleteShader(fragmentShader);
+void Shader::Complete(Variant& variant)
+{
+	ProgramBuild& build = *variant.build;
+	if (build.succeeded) {
+		double readyMs = MillisecondsSince(build.issued);
+		compileStats.compiled++;
+		compileStats.readyMs += readyMs;
+		if (variant.cacheKey != 0 && programCache != nullptr) {
+			programCache->Store(variant.cacheKey, build.program);
+		}
+		std::cout << "[SHADER] Built " << build.label << ", ready " << readyMs << " ms after it was issued" << std::endl;
+		variant.program = build.program;
+	} else {
+		// Never bound: a stand-in draws in its place from now on
+		compileStats.failed++;
+		RenderDevice::Get().DeleteProgram(build.program);
+		variant.failed = true;
+		std::cout << "[SHADER] Could not build " << build.label << ", drawing with another variant instead" << std::endl;
+	}
+	variant.build.reset();
+	pending--;
+}
+
+Shader::Variant* Shader::FindFallback(uint32_t variantFeatures)
+{
+	// The ready variant differing in the fewest features
+	Variant* best = nullptr;
+	uint32_t bestDifference = SHADER_FEATURE_COUNT + 1;
+	variantFeatures = NormalizeFeatures(variantFeatures);
+	for (auto& entry : variants) {
+		if (entry.second.build != nullptr || entry.second.failed) {
+			continue;
+		}
+		uint32_t difference = 0;
+		for (uint32_t i = 0; i < SHADER_FEATURE_COUNT; i++) {
+			difference += ((entry.first ^ variantFeatures) >> i) & 1;
+		}
+		if (difference < bestDifference) {
+			best = &entry.second;
+			bestDifference = difference;
+		}
+	}
+	return best;
+}
+
+void Shader::SetProgramCache(ProgramCache* cache)
+{
+	programCache = cache;
+}
+
+void Shader::SetCompileThread(ShaderCompileThread* thread)
+{
+	compileThread = thread;
+}
+
+void Shader::PrintCompileStats()
+{
+	std::cout << "[SHADER] " << compileStats.compiled << " programs compiled (ready " << compileStats.readyMs
+			  << " ms after issue in total), " << compileStats.loaded << " loaded from the cache in "
+			  << compileStats.loadMs << " ms, " << compileStats.renderThreadMs << " ms on the render thread";
+	if (compileStats.fallbacks > 0) {
+		std::cout << ", " << compileStats.fallbacks << " selections drawn with a stand-in variant";
+	}
+	if (compileStats.failed > 0) {
+		std::cout << ", " << compileStats.failed << " failed";
+	}
+	std::cout << std::endl;
 }
 
 void Shader::Activate()
 {
-	glUseProgram(ID);
+	if (current == nullptr) {
+		SetFeatures(features);
+	}
+	if (ID != boundProgram) {
+		RenderDevice::Get().UseProgram(ID);
+		boundProgram = ID;
+	}
+
+	// Only the uniforms set since this variant was last activated
+	if (ID != 0 && current->uniformVersion != uniformVersion) {
+		for (const auto& entry : uniforms) {
+			if (entry.second.version > current->uniformVersion) {
+				ApplyUniform(ID, entry.first, entry.second);
+			}
+		}
+		current->uniformVersion = uniformVersion;
+	}
 }
 
 void Shader::Delete()
 {
-	glDeleteProgram(ID);
+	RenderDevice& device = RenderDevice::Get();
+	for (auto& entry : variants) {
+		// A compile thread build must not outlive its program
+		Wait(entry.second);
+		if (entry.second.program == boundProgram) {
+			boundProgram = 0;
+		}
+		device.DeleteProgram(entry.second.program);
+	}
+	variants.clear();
+	current = nullptr;
+	fallback = false;
+	ID = 0;
+}
+
+void Shader::Precompile(uint32_t featureMask)
+{
+	// Every subset of the mask, the empty one last; a subset naming features
+	// the shaders ignore together is the same variant as one already issued
+	for (uint32_t subset = featureMask;; subset = (subset - 1) & featureMask) {
+		Request(subset);
+		if (subset == 0) {
+			break;
+		}
+	}
+}
+
+void Shader::SetFeatures(uint32_t newFeatures)
+{
+	features = newFeatures;
+	Variant& wanted = Request(newFeatures);
+	if (pending > 0) {
+		for (auto& entry : variants) {
+			Poll(entry.second);
+		}
+	}
+	Variant* chosen = &wanted;
+	if (wanted.build != nullptr || wanted.failed) {
+		chosen = FindFallback(newFeatures);
+		if (chosen == nullptr && wanted.build != nullptr) {
+			Wait(wanted);
+			chosen = wanted.failed ? nullptr : &wanted;
+		}
+	}
+	// With no variant built at all, program 0 draws nothing
+	fallback = chosen != &wanted;
+	if (chosen == nullptr) {
+		chosen = &wanted;
+	}
+	if (fallback) {
+		compileStats.fallbacks++;
+	}
+	current = chosen;
+	ID = current->program;
+}
+
+void Shader::SetFeature(ShaderFeature feature, bool enable)
+{
+	uint32_t newFeatures = enable ? features | feature : features & ~static_cast<uint32_t>(feature);
+	// Calls keep coming while builds are pending, so finished ones are taken
+	if (newFeatures != features || current == nullptr || fallback || pending > 0) {
+		SetFeatures(newFeatures);
+	}
 }
 
 void Shader::SetGrayscale(bool enable)
 {
-	Activate();
-	glUniform1i(glGetUniformLocation(ID, "enableGrayscale"), enable ? 1 : 0);
+	SetFeature(SHADER_GRAYSCALE, enable);
 }
 
 void Shader::SetRainbowLight(bool enable, float time)
 {
-	Activate();
-	glUniform1i(glGetUniformLocation(ID, "enableRainbowLight"), enable ? 1 : 0);
-	glUniform1f(glGetUniformLocation(ID, "time"), time);
-}
\ No newline at end of file
+	SetFeature(SHADER_RAINBOW_LIGHT, enable);
+	SetFloat("time", time);
+}
+
+void Shader::SetInt(const std::string& name, int value)
+{
+	SetUniform(name, UniformType::Int, value, nullptr, 0);
+}
+
+void Shader::SetFloat(const std::string& name, float value)
+{
+	SetUniform(name, UniformType::Float, 0, &value, 1);
+}
+
+void Shader::SetVec3(const std::string& name, const glm::vec3& value)
+{
+	SetUniform(name, UniformType::Vec3, 0, &value.x, 3);
+}
+
+void Shader::SetVec4(const std::string& name, const glm::vec4& value)
+{
+	SetUniform(name, UniformType::Vec4, 0, &value.x, 4);
+}
+
+void Shader::SetMat4(const std::string& name, const glm::mat4& value)
+{
+	SetUniform(name, UniformType::Mat4, 0, &value[0][0], 16);
+}
+
+void Shader::SetUniform(const std::string& name, UniformType type, int intValue, const float* values, int count)
+{
+	Uniform& uniform = uniforms[name];
+	uniform.type = type;
+	uniform.intValue = intValue;
+	std::copy(values, values + count, uniform.values);
+	// Applied by the next Activate, so the bound program stays as it is
+	uniform.version = ++uniformVersion;
+}
+
+void Shader::ApplyUniform(GLuint program, const std::string& name, const Uniform& uniform)
+{
+	RenderDevice& device = RenderDevice::Get();
+	GLint location = device.GetUniformLocation(program, name.c_str());
+	switch (uniform.type) {
+	case UniformType::Int:
+		device.Uniform1i(location, uniform.intValue);
+		break;
+	case UniformType::Float:
+		device.Uniform1f(location, uniform.values[0]);
+		break;
+	case UniformType::Vec3:
+		device.Uniform3f(location, uniform.values[0], uniform.values[1], uniform.values[2]);
+		break;
+	case UniformType::Vec4:
+		device.Uniform4fv(location, 1, uniform.values);
+		break;
+	case UniformType::Mat4:
+		device.UniformMatrix4fv(location, 1, GL_FALSE, uniform.values);
+		break;
+	}
+}
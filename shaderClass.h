@@ -2,32 +2,181 @@
 #define SHADER_CLASS_H
 
 #include<glad/glad.h>
+#include<atomic>
+#include<chrono>
+#include<cstdint>
+#include<memory>
 #include<string>
 #include<fstream>
 #include<sstream>
 #include<iostream>
 #include<cerrno>
+#include<map>
+#include<glm/glm.hpp>
+#include"RenderDevice.h"
+#include"ProgramCache.h"
+
+class ShaderCompileThread;
 
 std::string get_file_contents(const char* filename);
 
+// Features a shader variant is compiled with. Each one is a #define of its
+// name (TEXTURED, GRAYSCALE, RAINBOW_LIGHT) inserted after the #version line,
+// so a variant carries no branches for the features it lacks. GRAYSCALE
+// overrides RAINBOW_LIGHT, and a mask with both uses the GRAYSCALE variant.
+enum ShaderFeature : uint32_t
+{
+	SHADER_TEXTURED = 1u << 0,
+	SHADER_GRAYSCALE = 1u << 1,
+	SHADER_RAINBOW_LIGHT = 1u << 2,
+	SHADER_FEATURE_COUNT = 3
+};
+
+// Program builds of every Shader since the start
+struct ShaderCompileStats
+{
+	int compiled = 0;             // compiled and linked from source
+	int loaded = 0;               // made from a cached binary
+	int failed = 0;               // with a compile or link error
+	int fallbacks = 0;            // selections drawn with another variant while the chosen one built
+	double renderThreadMs = 0.0;  // the render thread issuing, waiting for and finishing builds
+	double readyMs = 0.0;         // from issuing each build to its program being ready, summed
+	double loadMs = 0.0;
+};
+
+// One program built from source. The render thread issues it and polls it
+// while the driver compiles in the background (KHR_parallel_shader_compile),
+// or a ShaderCompileThread runs all of it in a shared context.
+struct ProgramBuild
+{
+	std::string label;
+	std::string vertexSource;
+	std::string fragmentSource;
+	bool retrievable = false;          // linked for the program cache
+	GLuint program = 0;
+	GLuint vertexShader = 0;
+	GLuint fragmentShader = 0;
+	bool succeeded = false;
+	std::chrono::steady_clock::time_point issued;
+	std::atomic<bool> done{ false };   // set by the compile thread after Finish
+
+	// Starts compile and link without asking for their result
+	void Issue(RenderDevice& device);
+	// False while the driver still compiles; a device without parallel
+	// compile reports every build complete and Finish waits instead
+	bool IsComplete(RenderDevice& device) const;
+	// Reads the status and logs, prints them and frees the shader objects
+	void Finish(RenderDevice& device);
+};
+
+// A vertex and fragment shader pair, built as one program per feature set
+// and kept by feature mask. Uniforms set through the Set methods are
+// remembered and reach every variant when it is activated: one selected
+// later gets the values it missed, and no Set call binds a program.
+//
+// Builds are issued up front, the base variant's in the constructor and
+// more with Precompile, and finish in the background. A variant selected
+// before its program is ready is stood in for by the ready variant sharing
+// the most features until it is; only a Shader with no ready variant at
+// all waits. A variant that fails to build is stood in for the same way
+// for good.
 class Shader
 {
 public:
-	GLuint ID;
+	// Program of the variant in use, 0 before the first selection
+	GLuint ID = 0;
 	Shader(const char* vertexFile, const char* fragmentFile);
 
+	// Binds the selected variant, the base one on first use, and applies the
+	// uniforms set since it was last activated. Call it before drawing.
 	void Activate();
+	// Deletes every variant, waiting for those still building, which go to
+	// the program cache first
 	void Delete();
 
+	// Issues the builds of every combination of these features, so later
+	// selections find them ready
+	void Precompile(uint32_t featureMask);
+	// Selects the variant with exactly these features, or a stand-in while it
+	// builds; the next Activate binds it
+	void SetFeatures(uint32_t features);
+	// Selects the variant with one feature added or removed
+	void SetFeature(ShaderFeature feature, bool enable);
+	uint32_t GetFeatures() const { return features; }
+	int GetVariantCount() const { return static_cast<int>(variants.size()); }
+	// True while the selected features are drawn with another variant
+	bool IsFallback() const { return fallback; }
+
 	// Add grayscale functionality
 	void SetGrayscale(bool enable);
 
 	// Add rainbow light functionality
 	void SetRainbowLight(bool enable, float time);
 
-	void setInt(const std::string& name, int value) const
+	// Uniforms of every variant, set on the selected one when it is next activated
+	void SetInt(const std::string& name, int value);
+	void SetFloat(const std::string& name, float value);
+	void SetVec3(const std::string& name, const glm::vec3& value);
+	void SetVec4(const std::string& name, const glm::vec4& value);
+	void SetMat4(const std::string& name, const glm::mat4& value);
+
+	void setInt(const std::string& name, int value) { SetInt(name, value); }
+
+	// Variants are looked up in and added to this cache; nullptr compiles
+	// every one from source
+	static void SetProgramCache(ProgramCache* cache);
+	// Builds go to this thread when the device has no parallel shader
+	// compile; nullptr builds them on the render thread
+	static void SetCompileThread(ShaderCompileThread* thread);
+	static const ShaderCompileStats& GetCompileStats() { return compileStats; }
+	static void PrintCompileStats();
+
+private:
+	enum class UniformType { Int, Float, Vec3, Vec4, Mat4 };
+
+	struct Uniform
 	{
-		glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
-	}
+		UniformType type;
+		int intValue = 0;
+		float values[16] = {};
+		uint64_t version = 0;   // uniformVersion when it was last set
+	};
+
+	struct Variant
+	{
+		GLuint program = 0;            // 0 while building or after a failed build
+		uint64_t uniformVersion = 0;   // every uniform set up to this version is applied
+		uint64_t cacheKey = 0;         // 0 when not cached
+		std::shared_ptr<ProgramBuild> build;   // until the program is ready
+		bool threaded = false;         // built by the compile thread
+		bool failed = false;           // a compile or link error; never selected, program stays 0
+	};
+
+	static ProgramCache* programCache;
+	static ShaderCompileThread* compileThread;
+	static ShaderCompileStats compileStats;
+	static GLuint boundProgram;    // bound by the last Activate of any Shader
+
+	std::string name;            // the source files, for the logs
+	std::string vertexCode;
+	std::string fragmentCode;
+	std::map<uint32_t, Variant> variants;
+	std::map<std::string, Uniform> uniforms;
+	uint64_t uniformVersion = 0;
+	uint32_t features = 0;       // selected; in use unless fallback
+	Variant* current = nullptr;
+	int pending = 0;             // variants still building
+	bool fallback = false;
+
+	// The variant of these features, its build issued when it is new
+	Variant& Request(uint32_t variantFeatures);
+	// Takes the program of a finished build; true when the variant is ready
+	bool Poll(Variant& variant);
+	void Wait(Variant& variant);
+	// Stats, logs and the cache once the build of a variant is finished
+	void Complete(Variant& variant);
+	Variant* FindFallback(uint32_t variantFeatures);
+	void SetUniform(const std::string& name, UniformType type, int intValue, const float* values, int count);
+	static void ApplyUniform(GLuint program, const std::string& name, const Uniform& uniform);
 };
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,11 @@
+#version 330 core
+
+layout (location = 0) in vec3 aPos;
+
+uniform mat4 modelMatrix;
+uniform mat4 lightMatrix;
+
+void main()
+{
+    gl_Position = lightMatrix * modelMatrix * vec4(aPos, 1.0);
+}
@@ -4,35 +4,32 @@ out vec4 FragColor;
 in vec3 TexCoords;
 
 uniform samplerCube skybox;
-// Grayscale filter uniform
-uniform bool enableGrayscale;
-// Rainbow light filter uniform
-uniform bool enableRainbowLight;
+// Variants: GRAYSCALE, RAINBOW_LIGHT (see ShaderFeature)
+#if defined(RAINBOW_LIGHT) && !defined(GRAYSCALE)
 uniform float time;
+#endif
 
 void main()
 {    
     vec4 skyboxColor = texture(skybox, TexCoords);
     
     // RAINBOW LIGHT COLOR
-    vec3 finalLightColor = vec3(1.0); // Default white light
-    if (enableRainbowLight && !enableGrayscale) {
-        finalLightColor = vec3(
-            sin(time * 1.0) * 0.4 + 0.5,
-            sin(time * 1.0 + 2.094) * 0.4 + 0.5,
-            sin(time * 1.0 + 4.188) * 0.4 + 0.5
-        );
-    }
-    
+#if defined(RAINBOW_LIGHT) && !defined(GRAYSCALE)
+    vec3 finalLightColor = vec3(
+        sin(time * 1.0) * 0.4 + 0.5,
+        sin(time * 1.0 + 2.094) * 0.4 + 0.5,
+        sin(time * 1.0 + 4.188) * 0.4 + 0.5
+    );
+
     // Apply rainbow light effect
     skyboxColor.rgb *= finalLightColor;
-    
-    // Apply grayscale filter if enabled (after rainbow effect)
-    if (enableGrayscale) {
-        // Standard grayscale conversion using luminance weights
-        float gray = dot(skyboxColor.rgb, vec3(0.299, 0.587, 0.114));
-        skyboxColor.rgb = vec3(gray);
-    }
+#endif
+
+#ifdef GRAYSCALE
+    // Standard grayscale conversion using luminance weights, after the rainbow effect
+    float gray = dot(skyboxColor.rgb, vec3(0.299, 0.587, 0.114));
+    skyboxColor.rgb = vec3(gray);
+#endif
     
     FragColor = skyboxColor;
 }
\ No newline at end of file
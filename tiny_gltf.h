@@ -4537,6 +4537,20 @@ static bool ParseBuffer(Buffer *buffer, std::string *err, const detail::json &o,
   buffer->uri.clear();
   ParseStringProperty(&buffer->uri, err, o, "uri", false, "Buffer");
 
+  // EXT_meshopt_compression fallback buffers carry no data of their own. The
+  // application fills them in when decoding the compressed bufferViews.
+  if (buffer->uri.empty()) {
+    ParseExtrasAndExtensions(buffer, err, o,
+                             store_original_json_for_extras_and_extensions);
+    auto meshopt = buffer->extensions.find("EXT_meshopt_compression");
+    if (meshopt != buffer->extensions.end() &&
+        meshopt->second.Get("fallback").IsBool() &&
+        meshopt->second.Get("fallback").Get<bool>()) {
+      ParseStringProperty(&buffer->name, err, o, "name", false);
+      return true;
+    }
+  }
+
   // having an empty uri for a non embedded image should not be valid
   if (!is_binary && buffer->uri.empty()) {
     if (err) {